@@ -0,0 +1,73 @@
+# Throughput of infer_batch/3 against the batch size.
+#
+#     mix run bench/batch_size.exs
+#
+# Runs on the simulator by default. Set NX_HAILO_BENCH_HEF to a HEF path to
+# benchmark the real device instead. Each batch size gets its own network
+# group configured with that batch size, and every scenario call pushes
+# `batch_size` frames through a single device transfer.
+
+Code.require_file("support/report.exs", __DIR__)
+
+alias NxHailo.Bench.Report
+alias NxHailo.Hailo.API
+alias NxHailo.Hailo.Simulator
+
+batch_sizes = [1, 2, 4, 8, 16]
+
+{vdevice, hef_path} =
+  case System.get_env("NX_HAILO_BENCH_HEF") do
+    nil ->
+      # A transfer costs a fixed 8ms plus 2ms per frame, so the fixed part is
+      # amortized as batches grow
+      config = Simulator.yolov8(latency_us: 8_000, per_frame_latency_us: 2_000)
+      {:ok, vdevice} = Simulator.create_vdevice(config)
+      {vdevice, "yolov8m.hef"}
+
+    hef_path ->
+      {:ok, vdevice} = API.create_vdevice()
+      {vdevice, hef_path}
+  end
+
+inputs =
+  Map.new(batch_sizes, fn batch_size ->
+    {:ok, ng} = API.configure_network_group(vdevice, hef_path, batch_size: batch_size)
+    {:ok, pipeline} = API.create_pipeline(ng)
+
+    frames =
+      Map.new(pipeline.input_vstream_infos, fn info ->
+        {info.name, for(i <- 1..batch_size, do: :binary.copy(<<i>>, info.frame_size))}
+      end)
+
+    {"batch #{batch_size}", {batch_size, pipeline, frames}}
+  end)
+
+suite =
+  Benchee.run(
+    %{
+      "infer_batch" => fn {_batch_size, pipeline, frames} ->
+        {:ok, _outputs} = API.infer_batch(pipeline, frames)
+      end
+    },
+    inputs: inputs,
+    warmup: 1,
+    time: 5
+  )
+
+Report.write(suite, "batch_size", fn %{input: {batch_size, _, _}} = scenario ->
+  %{fps: batch_size * 1.0e9 / scenario.run_time_data.statistics.average}
+end)
+
+IO.puts("\nThroughput")
+
+for scenario <- Enum.sort_by(suite.scenarios, fn s -> elem(s.input, 0) end) do
+  {batch_size, _pipeline, _frames} = scenario.input
+  average_ns = scenario.run_time_data.statistics.average
+  fps = batch_size * 1.0e9 / average_ns
+
+  IO.puts(
+    "  batch #{String.pad_leading(to_string(batch_size), 2)}: " <>
+      "#{:erlang.float_to_binary(fps, decimals: 1)} frames/s, " <>
+      "#{:erlang.float_to_binary(average_ns / 1.0e6, decimals: 2)} ms/batch"
+  )
+end
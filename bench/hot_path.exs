@@ -0,0 +1,359 @@
+# Cost of the inference hot path on the host.
+#
+#     mix run bench/hot_path.exs
+#     NX_HAILO_BENCH_OUTPUT=/tmp/results mix run bench/hot_path.exs
+#
+# Runs against the simulator with no device latency, so that what is left is
+# the host-side cost: the NIF round trip of `infer/3` for different input
+# sizes, `NxHailo.Parsers.YoloV8.parse/2` for different detection densities,
+# native letterboxing, JPEG decoding and overlay drawing, tiled inference of
+# a 4K frame by tile size, batched classification of detected boxes, and
+# end-to-end frames/s of `NxHailo.Hailo.infer/4` with concurrent callers on
+# a device with a realistic latency. Results are printed by Benchee and
+# written as JSON, see bench/support/report.exs.
+#
+# For the host kernels alone, without the VM, see `make bench`.
+
+Code.require_file("support/report.exs", __DIR__)
+
+alias NxHailo.Bench.Report
+alias NxHailo.Hailo
+alias NxHailo.Hailo.API
+alias NxHailo.Hailo.Simulator
+alias NxHailo.Parsers.YoloV8
+alias NxHailo.Preprocess
+
+benchee_opts = [warmup: 1, time: 3, memory_time: 0.5, print: [configuration: false]]
+
+# NIF call overhead of infer/3 against the input size. Each device has a
+# single uint8 input of the given shape and a small float32 output.
+infer_inputs =
+  for {name, height, width} <- [
+        {"224x224x3", 224, 224},
+        {"640x640x3", 640, 640},
+        {"1280x1280x3", 1280, 1280}
+      ],
+      into: %{} do
+    config = %{
+      latency_us: 0,
+      input_vstreams: [
+        %{
+          name: "bench/input",
+          format: %{type: :uint8, order: :nhwc},
+          shape: %{height: height, width: width, features: 3}
+        }
+      ],
+      output_vstreams: [
+        %{
+          name: "bench/output",
+          format: %{type: :float32, order: :nhwc},
+          shape: %{height: 1, width: 1, features: 1000}
+        }
+      ]
+    }
+
+    {:ok, vdevice} = Simulator.create_vdevice(config)
+    {:ok, ng} = API.configure_network_group(vdevice, "bench.hef")
+    {:ok, pipeline} = API.create_pipeline(ng)
+    input = %{"bench/input" => :binary.copy(<<7>>, height * width * 3)}
+
+    {name, {pipeline, input}}
+  end
+
+infer_suite =
+  Benchee.run(
+    %{
+      "infer" => fn {pipeline, input} -> {:ok, _} = API.infer(pipeline, input) end,
+      "infer_timed" => fn {pipeline, input} -> {:ok, _, _} = API.infer_timed(pipeline, input) end
+    },
+    [inputs: infer_inputs] ++ benchee_opts
+  )
+
+Report.write(infer_suite, "infer_overhead", fn scenario ->
+  {pipeline, _input} = scenario.input
+  {:ok, stats} = API.pipeline_stats(pipeline)
+  %{native_stages_p50_us: Map.new(stats.stages, fn {stage, s} -> {stage, s.p50_us} end)}
+end)
+
+# YoloV8.parse/2 against the number of boxes in the NMS output
+classes = Map.new(0..79, &{&1, "class_#{&1}"})
+key = "yolov8m/yolov8_nms_postprocess"
+
+parse_inputs =
+  for density <- [0, 10, 100, 1000], into: %{} do
+    {:ok, vdevice} =
+      Simulator.create_vdevice(Simulator.yolov8(latency_us: 0, detections_per_frame: density))
+
+    {:ok, model} = Hailo.load("yolov8m.hef", vdevice: vdevice)
+    [info] = model.pipeline.input_vstream_infos
+    {:ok, outputs} = API.infer(model.pipeline, %{info.name => :binary.copy(<<1>>, info.frame_size)})
+
+    {"#{density} boxes", outputs}
+  end
+
+parse_suite =
+  Benchee.run(
+    %{
+      "parse" => fn outputs -> {:ok, _} = YoloV8.parse(outputs, key: key, classes: classes) end,
+      "parse top 10" => fn outputs ->
+        {:ok, _} = YoloV8.parse(outputs, key: key, classes: classes, top_k: 10)
+      end,
+      "parse_packed" => fn outputs ->
+        {:ok, _} = YoloV8.parse_packed(outputs, key: key, number_of_classes: 80)
+      end
+    },
+    [inputs: parse_inputs] ++ benchee_opts
+  )
+
+Report.write(parse_suite, "yolov8_parse")
+
+# Letterboxing camera frames into the 640x640 model input
+preprocess_inputs =
+  for {width, height, format} <- [
+        {640, 480, :rgb},
+        {1280, 720, :rgb},
+        {1920, 1080, :rgb},
+        {1280, 720, :yuyv}
+      ],
+      into: %{} do
+    bytes_per_pixel = if format == :yuyv, do: 2, else: 3
+    frame = :crypto.strong_rand_bytes(width * height * bytes_per_pixel)
+    {"#{width}x#{height} #{format}", {frame, [width: width, height: height, format: format]}}
+  end
+
+preprocess_suite =
+  Benchee.run(
+    %{
+      "letterbox" => fn {frame, opts} ->
+        {:ok, _} = Preprocess.letterbox(frame, [target_width: 640, target_height: 640] ++ opts)
+      end
+    },
+    [inputs: preprocess_inputs] ++ benchee_opts
+  )
+
+Report.write(preprocess_suite, "preprocess")
+
+# Decoding a still image into model inputs of different sizes, which picks
+# the DCT scaling of the decode
+jpeg = File.read!(Path.join(:code.priv_dir(:nx_hailo), "test_image.jpg"))
+
+jpeg_suite =
+  Benchee.run(
+    %{
+      "decode_jpeg" => fn target ->
+        {:ok, _} = Preprocess.decode_jpeg(jpeg, target_width: target, target_height: target)
+      end
+    },
+    [inputs: for(target <- [640, 320, 160], into: %{}, do: {"-> #{target}x#{target}", target})] ++
+      benchee_opts
+  )
+
+Report.write(jpeg_suite, "decode_jpeg")
+
+# Drawing 20 labelled detections over the preview frames of the letterbox
+# inputs, raw and JPEG encoded
+overlay_objects =
+  for i <- 0..19 do
+    x = rem(i, 5) * 120 + 10
+    y = div(i, 5) * 110 + 30
+    %YoloV8.DetectedObject{
+      class_id: i,
+      class_name: "class #{i}",
+      score: 0.5 + i / 50,
+      xmin: x,
+      ymin: y,
+      xmax: x + 100,
+      ymax: y + 80
+    }
+  end
+
+overlay_suite =
+  Benchee.run(
+    %{
+      "draw" => fn {frame, opts} ->
+        {:ok, _} = NxHailo.Overlay.draw(frame, overlay_objects, [fps: 30.0] ++ opts)
+      end,
+      "draw + jpeg" => fn {frame, opts} ->
+        {:ok, _} = NxHailo.Overlay.draw(frame, overlay_objects, [encode: :jpeg] ++ opts)
+      end
+    },
+    [inputs: preprocess_inputs] ++ benchee_opts
+  )
+
+Report.write(overlay_suite, "overlay")
+
+# Tiled inference of a 4K frame against the tile size and overlap, on a
+# device taking 1ms per frame of a transfer, so that the cost per megapixel
+# follows the tile count
+{:ok, tiling_vdevice} =
+  Simulator.create_vdevice(Simulator.yolov8(latency_us: 0, per_frame_latency_us: 1_000))
+
+{:ok, tiling_model} = Hailo.load("yolov8m.hef", vdevice: tiling_vdevice)
+uhd_frame = :crypto.strong_rand_bytes(3840 * 2160 * 3)
+
+tiling_inputs =
+  for {tile, overlap} <- [{640, 0.2}, {640, 0.1}, {960, 0.2}, {1280, 0.2}], into: %{} do
+    {"#{tile}px tiles, #{overlap} overlap", [tile_size: {tile, tile}, overlap: overlap]}
+  end
+
+tiling_suite =
+  Benchee.run(
+    %{
+      "tiled infer" => fn tile_opts ->
+        {:ok, _, _} =
+          NxHailo.Tiling.infer(
+            tiling_model,
+            uhd_frame,
+            [width: 3840, height: 2160, key: key, classes: classes] ++ tile_opts
+          )
+      end
+    },
+    [inputs: tiling_inputs] ++ benchee_opts
+  )
+
+Report.write(tiling_suite, "tiling", fn scenario ->
+  {:ok, tiles} = NxHailo.Tiling.tiles([width: 3840, height: 2160] ++ scenario.input)
+
+  %{
+    tiles: length(tiles) + 1,
+    us_per_megapixel: scenario.run_time_data.statistics.average / 1000 / (3840 * 2160 / 1.0e6)
+  }
+end)
+
+# Classifying the boxes of a 720p frame with a second model, as one batch of
+# native crops against a crop, letterbox and infer call per box, on a device
+# taking 1ms per transfer and 0.2ms per frame
+{:ok, cascade_vdevice} =
+  Simulator.create_vdevice(
+    Simulator.yolov8(
+      latency_us: 1_000,
+      per_frame_latency_us: 200,
+      networks: %{
+        "resnet_v1_18.hef" => %{
+          input_vstreams: [
+            %{
+              name: "resnet_v1_18/input_layer1",
+              format: %{type: :uint8, order: :nhwc},
+              shape: %{height: 224, width: 224, features: 3}
+            }
+          ],
+          output_vstreams: [
+            %{
+              name: "resnet_v1_18/fc1",
+              format: %{type: :uint8, order: :nhwc},
+              shape: %{height: 1, width: 1, features: 1000},
+              quant_info: %{qp_zp: 0.0, qp_scale: 0.1}
+            }
+          ]
+        }
+      }
+    )
+  )
+
+{:ok, classifier} =
+  Hailo.load("resnet_v1_18.hef", vdevice: cascade_vdevice, raw_outputs: true)
+
+[classifier_output] = classifier.pipeline.output_vstream_infos
+cascade_frame = :crypto.strong_rand_bytes(1280 * 720 * 3)
+
+cascade_inputs =
+  for boxes <- [1, 8, 32], into: %{} do
+    objects =
+      for i <- 0..(boxes - 1) do
+        x = rem(i, 8) * 150
+        y = div(i, 8) * 170
+        %YoloV8.DetectedObject{xmin: x + 10, ymin: y + 10, xmax: x + 130, ymax: y + 150}
+      end
+
+    {"#{boxes} boxes", objects}
+  end
+
+cascade_suite =
+  Benchee.run(
+    %{
+      "cascade batch" => fn objects ->
+        {:ok, _, _} =
+          NxHailo.Cascade.classify(classifier, cascade_frame, objects,
+            width: 1280,
+            height: 720,
+            classifier: [top_k: 1]
+          )
+      end,
+      "per-box infer" => fn objects ->
+        for %{xmin: x, ymin: y, xmax: xmax, ymax: ymax} <- objects do
+          {:ok, {crop, _}} =
+            Preprocess.letterbox(cascade_frame,
+              width: 1280,
+              height: 720,
+              crop: {x, y, xmax - x, ymax - y},
+              target_width: 224,
+              target_height: 224
+            )
+
+          {:ok, outputs} = API.infer(classifier.pipeline, %{"resnet_v1_18/input_layer1" => crop})
+
+          {:ok, _} =
+            NxHailo.Parsers.Classification.parse(outputs,
+              key: classifier_output.name,
+              info: classifier_output,
+              top_k: 1
+            )
+        end
+      end
+    },
+    [inputs: cascade_inputs] ++ benchee_opts
+  )
+
+Report.write(cascade_suite, "cascade")
+
+# End-to-end frames/s with concurrent callers: letterbox natively, infer and
+# parse through NxHailo.Hailo.infer/4, on a device taking 5ms per transfer
+frames_per_caller = 20
+{:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 5_000))
+{:ok, model} = Hailo.load("yolov8m.hef", vdevice: vdevice)
+[input_info] = model.pipeline.input_vstream_infos
+camera_frame = :crypto.strong_rand_bytes(1280 * 720 * 3)
+
+e2e_inputs =
+  for callers <- [1, 2, 4, 8], into: %{} do
+    {"#{callers} callers", callers}
+  end
+
+e2e_suite =
+  Benchee.run(
+    %{
+      "letterbox + infer + parse" => fn callers ->
+        1..callers
+        |> Task.async_stream(
+          fn _ ->
+            for _ <- 1..frames_per_caller do
+              {:ok, {input, letterbox}} =
+                Preprocess.letterbox_input(camera_frame, input_info, width: 1280, height: 720)
+
+              {:ok, _} =
+                Hailo.infer(model, %{input_info.name => input}, YoloV8,
+                  key: key,
+                  classes: classes,
+                  letterbox: letterbox
+                )
+            end
+          end,
+          max_concurrency: callers,
+          timeout: :infinity
+        )
+        |> Stream.run()
+      end
+    },
+    [inputs: e2e_inputs, warmup: 1, time: 5, print: [configuration: false]]
+  )
+
+Report.write(e2e_suite, "end_to_end", fn scenario ->
+  %{fps: scenario.input * frames_per_caller * 1.0e9 / scenario.run_time_data.statistics.average}
+end)
+
+IO.puts("\nEnd-to-end throughput (#{frames_per_caller} frames per caller)")
+
+for scenario <- Enum.sort_by(e2e_suite.scenarios, & &1.input) do
+  fps = scenario.input * frames_per_caller * 1.0e9 / scenario.run_time_data.statistics.average
+  IO.puts("  #{String.pad_trailing(scenario.input_name, 10)} #{:erlang.float_to_binary(fps, decimals: 1)} frames/s")
+end
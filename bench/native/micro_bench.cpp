@@ -0,0 +1,423 @@
+// Micro-benchmarks of the host-side kernels behind the NIFs.
+//
+//     make bench
+//     make bench BENCH_ARGS="--json" > micro_bench.json
+//
+// Built straight from the kernel sources in c_src, without the Erlang VM or
+// HailoRT, so that it runs anywhere the NIF compiles. Each case is repeated
+// until it has run for `--min-time` seconds per sample, and the median of
+// `--samples` samples is reported. Inputs are generated from a fixed seed,
+// so runs are comparable between releases.
+
+#include "buffer_pool.hpp"
+#include "detections.hpp"
+#include "latency_histogram.hpp"
+#include "motion.hpp"
+#include "preprocess.hpp"
+#include "quantization.hpp"
+#include "yolo_head.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  bool json = false;
+  double min_time = 0.2;
+  int samples = 5;
+  std::string filter;
+};
+
+struct Result {
+  std::string name;
+  std::string params;
+  uint64_t iterations;
+  double ns_per_op;
+  double min_ns_per_op;
+  double max_ns_per_op;
+  // Bytes the kernel reads per operation, 0 when not meaningful
+  size_t bytes_per_op;
+};
+
+// Keeps the compiler from optimizing away results that are never read
+template <typename T> void do_not_optimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class Runner {
+public:
+  explicit Runner(const Options &options) : options_(options) {}
+
+  void run(const std::string &name, const std::string &params,
+           size_t bytes_per_op, const std::function<void()> &op) {
+    std::string full_name = name + "/" + params;
+    if (!options_.filter.empty() &&
+        full_name.find(options_.filter) == std::string::npos) {
+      return;
+    }
+
+    // Calibrate the batch so that one sample takes about `min_time`
+    uint64_t batch = 1;
+    for (;;) {
+      double elapsed = time_batch(op, batch);
+      if (elapsed >= options_.min_time / 10 || batch >= (1ull << 30)) {
+        batch = std::max<uint64_t>(
+            1, static_cast<uint64_t>(batch * options_.min_time / elapsed));
+        break;
+      }
+      batch *= 10;
+    }
+
+    std::vector<double> samples;
+    for (int i = 0; i < options_.samples; i++) {
+      samples.push_back(time_batch(op, batch) * 1e9 / batch);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result{name,
+                  params,
+                  batch * samples.size(),
+                  samples[samples.size() / 2],
+                  samples.front(),
+                  samples.back(),
+                  bytes_per_op};
+    if (!options_.json) {
+      print_text(result);
+    }
+    results_.push_back(result);
+  }
+
+  void finish() const {
+    if (options_.json) {
+      print_json();
+    }
+  }
+
+private:
+  static double time_batch(const std::function<void()> &op, uint64_t batch) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < batch; i++) {
+      op();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+  static void print_text(const Result &result) {
+    std::printf("%-22s %-28s %12.1f ns/op", result.name.c_str(),
+                result.params.c_str(), result.ns_per_op);
+    if (result.bytes_per_op > 0) {
+      std::printf("  %8.2f GB/s", result.bytes_per_op / result.ns_per_op);
+    }
+    std::printf("\n");
+  }
+
+  void print_json() const {
+    std::printf("{\n  \"suite\": \"native\",\n  \"compiler\": \"%s\",\n",
+                __VERSION__);
+    std::printf("  \"min_time_s\": %g,\n  \"samples\": %d,\n",
+                options_.min_time, options_.samples);
+    std::printf("  \"results\": [");
+    for (size_t i = 0; i < results_.size(); i++) {
+      const auto &r = results_[i];
+      std::printf("%s\n    {\"name\": \"%s\", \"params\": \"%s\", "
+                  "\"iterations\": %llu, \"ns_per_op\": %.3f, "
+                  "\"min_ns_per_op\": %.3f, \"max_ns_per_op\": %.3f, "
+                  "\"bytes_per_op\": %zu}",
+                  i == 0 ? "" : ",", r.name.c_str(), r.params.c_str(),
+                  static_cast<unsigned long long>(r.iterations), r.ns_per_op,
+                  r.min_ns_per_op, r.max_ns_per_op, r.bytes_per_op);
+    }
+    std::printf("\n  ]\n}\n");
+  }
+
+  const Options &options_;
+  std::vector<Result> results_;
+};
+
+std::vector<uint8_t> random_bytes(size_t size, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> bytes(size);
+  for (auto &byte : bytes) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  return bytes;
+}
+
+void bench_letterbox(Runner &runner) {
+  struct Case {
+    uint32_t width, height;
+    nx_hailo::PixelFormat format;
+    const char *format_name;
+  };
+  const Case cases[] = {{640, 480, nx_hailo::PixelFormat::Rgb, "rgb"},
+                        {1280, 720, nx_hailo::PixelFormat::Rgb, "rgb"},
+                        {1920, 1080, nx_hailo::PixelFormat::Rgb, "rgb"},
+                        {1920, 1080, nx_hailo::PixelFormat::Bgr, "bgr"},
+                        {1280, 720, nx_hailo::PixelFormat::Yuyv, "yuyv"}};
+
+  std::vector<uint8_t> out(640 * 640 * 3);
+  for (const auto &c : cases) {
+    size_t stride = c.width * nx_hailo::bytes_per_pixel(c.format);
+    auto pixels = random_bytes(stride * c.height, 1);
+    nx_hailo::Frame frame{pixels.data(), pixels.size(), c.width,
+                          c.height,      stride,        c.format};
+    std::string params = std::to_string(c.width) + "x" +
+                         std::to_string(c.height) + " " + c.format_name +
+                         " -> 640x640";
+    runner.run("letterbox", params, pixels.size(), [&] {
+      nx_hailo::letterbox(frame, out.data(), 640, 640);
+      do_not_optimize(out[0]);
+    });
+  }
+}
+
+void bench_motion_gate(Runner &runner) {
+  struct Case {
+    uint32_t width, height;
+    nx_hailo::PixelFormat format;
+    const char *format_name;
+  };
+  const Case cases[] = {{640, 480, nx_hailo::PixelFormat::Rgb, "rgb"},
+                        {1920, 1080, nx_hailo::PixelFormat::Bgr, "bgr"},
+                        {1280, 720, nx_hailo::PixelFormat::Yuyv, "yuyv"}};
+
+  for (const auto &c : cases) {
+    size_t stride = c.width * nx_hailo::bytes_per_pixel(c.format);
+    auto pixels = random_bytes(stride * c.height, 2);
+    nx_hailo::Frame frame{pixels.data(), pixels.size(), c.width,
+                          c.height,      stride,        c.format};
+    // Every frame after the first is compared and skipped
+    nx_hailo::MotionGateParams params;
+    params.refresh_interval = 0;
+    nx_hailo::MotionGate gate(params);
+    gate.update(frame);
+    std::string params_name = std::to_string(c.width) + "x" +
+                              std::to_string(c.height) + " " + c.format_name;
+    runner.run("motion_gate", params_name, pixels.size(), [&] {
+      do_not_optimize(gate.update(frame));
+    });
+  }
+}
+
+// A HAILO_NMS_BY_CLASS frame of YoloV8 (80 classes, 100 boxes per class)
+// holding `detections` boxes spread over the classes
+std::vector<uint8_t> nms_frame(uint32_t detections) {
+  const uint32_t classes = 80, max_bboxes = 100;
+  std::mt19937 rng(detections);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  std::vector<float> floats;
+  floats.reserve(classes * (1 + max_bboxes * 5));
+  for (uint32_t cls = 0; cls < classes; cls++) {
+    uint32_t count = detections / classes + (cls < detections % classes);
+    floats.push_back(static_cast<float>(count));
+    for (uint32_t i = 0; i < count; i++) {
+      float y = unit(rng) * 0.8f, x = unit(rng) * 0.8f;
+      floats.insert(floats.end(), {y, x, y + 0.1f, x + 0.1f, unit(rng)});
+    }
+  }
+  floats.resize(classes * (1 + max_bboxes * 5), 0.0f);
+
+  std::vector<uint8_t> bytes(floats.size() * sizeof(float));
+  std::memcpy(bytes.data(), floats.data(), bytes.size());
+  return bytes;
+}
+
+void bench_nms(Runner &runner) {
+  std::vector<nx_hailo::Detection> detections;
+  for (uint32_t density : {0u, 10u, 100u, 1000u, 8000u}) {
+    auto frame = nms_frame(density);
+    std::string params = std::to_string(density) + " boxes";
+
+    nx_hailo::DetectionFilter all;
+    // Only the boxes present are read, so there is no meaningful throughput
+    runner.run("parse_nms_by_class", params, 0, [&] {
+      detections.clear();
+      nx_hailo::parse_nms_by_class(frame.data(), frame.size(), 80, all,
+                                   detections);
+      nx_hailo::select_top_k(detections, 0);
+      do_not_optimize(detections.data());
+    });
+
+    nx_hailo::DetectionFilter filtered;
+    filtered.score_threshold = 0.5f;
+    filtered.top_k = 10;
+    runner.run("parse_nms_by_class", params + " score>=0.5 top10", 0, [&] {
+                 detections.clear();
+                 nx_hailo::parse_nms_by_class(frame.data(), frame.size(), 80,
+                                              filtered, detections);
+                 nx_hailo::select_top_k(detections, filtered.top_k);
+                 do_not_optimize(detections.data());
+               });
+  }
+
+  // Merging the boxes of overlapping tiles, i.e. the boxes of a frame twice
+  std::vector<nx_hailo::Detection> boxes;
+  for (uint32_t density : {100u, 1000u, 8000u}) {
+    auto frame = nms_frame(density);
+    nx_hailo::DetectionFilter all;
+    detections.clear();
+    nx_hailo::parse_nms_by_class(frame.data(), frame.size(), 80, all,
+                                 detections);
+    boxes = detections;
+    boxes.insert(boxes.end(), detections.begin(), detections.end());
+
+    runner.run("suppress_overlaps", std::to_string(boxes.size()) + " boxes",
+               0, [&] {
+                 detections = boxes;
+                 nx_hailo::suppress_overlaps(detections, 0.5f,
+                                             nx_hailo::OverlapMetric::Iou,
+                                             true);
+                 do_not_optimize(detections.data());
+               });
+  }
+}
+
+void bench_yolo_head(Runner &runner) {
+  // The three scales of a 640x640 YoloV8 head, raw uint8, with `candidates`
+  // cells scoring above the threshold and the rest below it
+  const uint32_t classes = 80, reg_max = 16;
+  const uint32_t grids[] = {80, 40, 20};
+  for (uint32_t candidates : {10u, 100u, 1000u}) {
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<nx_hailo::YoloHeadScale> scales;
+    std::mt19937 rng(4);
+    size_t bytes = 0;
+    for (uint32_t grid : grids) {
+      size_t cells = size_t(grid) * grid;
+      buffers.push_back(random_bytes(cells * 4 * reg_max, 3));
+      std::vector<uint8_t> scores(cells * classes);
+      for (auto &score : scores) {
+        score = static_cast<uint8_t>(rng() % 32);
+      }
+      for (uint32_t i = 0; i < candidates * cells / 8400; i++) {
+        scores[rng() % scores.size()] = static_cast<uint8_t>(128 + rng() % 128);
+      }
+      buffers.push_back(std::move(scores));
+      bytes += buffers[buffers.size() - 2].size() + buffers.back().size();
+    }
+    for (size_t i = 0; i < 3; i++) {
+      const auto &boxes = buffers[2 * i];
+      const auto &scores = buffers[2 * i + 1];
+      nx_hailo::QuantizedTensor box_tensor{
+          boxes.data(), boxes.size(), nx_hailo::FormatType::Uint8, 128.0f,
+          0.1f};
+      nx_hailo::QuantizedTensor score_tensor{
+          scores.data(), scores.size(), nx_hailo::FormatType::Uint8, 0.0f,
+          1.0f / 255};
+      scales.push_back({box_tensor, score_tensor, grids[i], grids[i]});
+    }
+
+    nx_hailo::YoloHeadParams params;
+    nx_hailo::DetectionFilter filter;
+    filter.score_threshold = 0.25f;
+    std::vector<nx_hailo::Detection> detections;
+    runner.run("decode_yolov8_head",
+               std::to_string(candidates) + " candidates u8", bytes, [&] {
+                 nx_hailo::decode_yolov8_head(scales, params, filter,
+                                              detections);
+                 do_not_optimize(detections.data());
+               });
+  }
+}
+
+void bench_quantization(Runner &runner) {
+  // One YoloV8 head output (80x80x144) and a classifier output (1000)
+  struct Case {
+    uint32_t positions, features;
+    nx_hailo::FormatType type;
+    const char *type_name;
+  };
+  const Case cases[] = {{80 * 80, 144, nx_hailo::FormatType::Uint8, "u8"},
+                        {80 * 80, 144, nx_hailo::FormatType::Uint16, "u16"},
+                        {1, 1000, nx_hailo::FormatType::Uint8, "u8"}};
+
+  for (const auto &c : cases) {
+    size_t elements = size_t(c.positions) * c.features;
+    auto data =
+        random_bytes(elements * nx_hailo::format_type_size(c.type), 2);
+    nx_hailo::QuantizedTensor tensor{data.data(), data.size(), c.type,
+                                     128.0f,      0.05f,       c.features};
+    auto range = nx_hailo::check_quantized(tensor, nx_hailo::ChannelRange());
+    std::string params = std::to_string(c.positions) + "x" +
+                         std::to_string(c.features) + " " + c.type_name;
+
+    std::vector<float> out(elements);
+    runner.run("dequantize", params, data.size(), [&] {
+      nx_hailo::dequantize(tensor, range, out.data());
+      do_not_optimize(out[0]);
+    });
+
+    std::vector<uint32_t> indices;
+    std::vector<float> values;
+    runner.run("threshold_quantized", params + " >=6.0", data.size(), [&] {
+      indices.clear();
+      values.clear();
+      nx_hailo::threshold_quantized(tensor, range, 6.0f, indices, values);
+      do_not_optimize(indices.data());
+    });
+  }
+}
+
+void bench_bookkeeping(Runner &runner) {
+  nx_hailo::BufferPool pool(160320, 4);
+  runner.run("buffer_pool", "acquire+release", 0, [&] {
+    uint8_t *buffer = pool.acquire();
+    do_not_optimize(buffer);
+    pool.release(buffer);
+  });
+
+  nx_hailo::LatencyHistogram histogram;
+  uint64_t value = 12345;
+  runner.run("latency_histogram", "record", 0, [&] {
+    value = value * 6364136223846793005ull + 1442695040888963407ull;
+    histogram.record(value >> 40);
+  });
+}
+
+void print_usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--json] [--min-time SECONDS] [--samples N] "
+               "[--filter SUBSTRING]\n",
+               program);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--json") {
+      options.json = true;
+    } else if (arg == "--min-time" && i + 1 < argc) {
+      options.min_time = std::stod(argv[++i]);
+    } else if (arg == "--samples" && i + 1 < argc) {
+      options.samples = std::max(1, std::stoi(argv[++i]));
+    } else if (arg == "--filter" && i + 1 < argc) {
+      options.filter = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  Runner runner(options);
+  bench_letterbox(runner);
+  bench_motion_gate(runner);
+  bench_nms(runner);
+  bench_yolo_head(runner);
+  bench_quantization(runner);
+  bench_bookkeeping(runner);
+  runner.finish();
+  return 0;
+}
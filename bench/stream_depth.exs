@@ -0,0 +1,85 @@
+# Throughput of the streaming pipeline against its in-flight depth.
+#
+#     mix run bench/stream_depth.exs
+#
+# Runs on the simulator by default. Set NX_HAILO_BENCH_HEF to a HEF path to
+# benchmark the real device instead. Every scenario pushes the same frames
+# through the device and parses each result with the native YoloV8 parser,
+# so that host-side work overlaps with the device only when depth > 1. The
+# synchronous `infer/3` path is included as a baseline.
+
+Code.require_file("support/report.exs", __DIR__)
+
+alias NxHailo.Bench.Report
+alias NxHailo.Hailo.API
+alias NxHailo.Hailo.Simulator
+alias NxHailo.Parsers.YoloV8
+
+frames_per_run = 50
+depths = [1, 2, 4, 8]
+
+{vdevice, hef_path} =
+  case System.get_env("NX_HAILO_BENCH_HEF") do
+    nil ->
+      {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 10_000))
+      {vdevice, "yolov8m.hef"}
+
+    hef_path ->
+      {:ok, vdevice} = API.create_vdevice()
+      {vdevice, hef_path}
+  end
+
+{:ok, ng} = API.configure_network_group(vdevice, hef_path)
+{:ok, pipeline} = API.create_pipeline(ng)
+[%{name: output_key, nms_shape: %{number_of_classes: classes}}] = pipeline.output_vstream_infos
+
+frames =
+  for i <- 1..frames_per_run do
+    Map.new(pipeline.input_vstream_infos, fn info ->
+      {info.name, :binary.copy(<<i>>, info.frame_size)}
+    end)
+  end
+
+parse = fn {:ok, outputs} ->
+  {:ok, _} =
+    YoloV8.parse_packed(outputs,
+      key: output_key,
+      number_of_classes: classes,
+      score_threshold: 0.5
+    )
+end
+
+streams =
+  Map.new(depths, fn depth ->
+    {:ok, stream_pipeline} = API.create_stream_pipeline(ng, depth: depth)
+    {"stream depth #{depth}", stream_pipeline}
+  end)
+
+scenarios =
+  streams
+  |> Map.new(fn {name, stream_pipeline} ->
+    {name,
+     fn ->
+       stream_pipeline
+       |> API.stream(frames)
+       |> Enum.each(parse)
+     end}
+  end)
+  |> Map.put("infer (synchronous)", fn ->
+    Enum.each(frames, fn input -> parse.(API.infer(pipeline, input)) end)
+  end)
+
+suite = Benchee.run(scenarios, warmup: 1, time: 5)
+
+Report.write(suite, "stream_depth", fn scenario ->
+  %{fps: frames_per_run * 1.0e9 / scenario.run_time_data.statistics.average}
+end)
+
+IO.puts("\nThroughput (#{frames_per_run} frames per run)")
+
+for scenario <- Enum.sort_by(suite.scenarios, & &1.name) do
+  average_ns = scenario.run_time_data.statistics.average
+  fps = frames_per_run * 1.0e9 / average_ns
+
+  IO.puts("  #{String.pad_trailing(scenario.name, 20)} #{:erlang.float_to_binary(fps, decimals: 1)} frames/s")
+end
@@ -0,0 +1,65 @@
+defmodule NxHailo.Bench.Report do
+  @moduledoc false
+  # Writes Benchee results as JSON, so that runs can be compared between
+  # releases. Files go to $NX_HAILO_BENCH_OUTPUT (defaults to bench/results)
+  # as <name>.json, one file per suite, overwritten on every run.
+
+  @doc """
+  Writes the scenarios of a Benchee suite to `<name>.json`.
+
+  `extra` is a function of the scenario returning additional fields for it,
+  e.g. derived throughput, merged into its entry.
+  """
+  def write(%Benchee.Suite{} = suite, name, extra \\ fn _scenario -> %{} end) do
+    dir = System.get_env("NX_HAILO_BENCH_OUTPUT", Path.join(__DIR__, "../results"))
+    File.mkdir_p!(dir)
+    path = Path.join(dir, "#{name}.json")
+
+    report = %{
+      suite: name,
+      timestamp: DateTime.utc_now() |> DateTime.to_iso8601(),
+      git_revision: git_revision(),
+      simulated: System.get_env("NX_HAILO_BENCH_HEF") == nil,
+      system: %{
+        elixir: System.version(),
+        otp: System.otp_release(),
+        os: to_string(:erlang.system_info(:system_architecture)),
+        schedulers: System.schedulers_online()
+      },
+      scenarios:
+        suite.scenarios
+        |> Enum.sort_by(&{&1.name, &1.input_name})
+        |> Enum.map(&Map.merge(scenario(&1), extra.(&1)))
+    }
+
+    File.write!(path, Jason.encode_to_iodata!(report, pretty: true))
+    IO.puts("\nResults written to #{Path.relative_to_cwd(path)}")
+    path
+  end
+
+  defp scenario(scenario) do
+    stats = scenario.run_time_data.statistics
+
+    %{
+      name: scenario.name,
+      input: scenario.input_name,
+      samples: stats.sample_size,
+      ips: stats.ips,
+      average_ns: stats.average,
+      median_ns: stats.median,
+      min_ns: stats.minimum,
+      max_ns: stats.maximum,
+      std_dev_ratio: stats.std_dev_ratio,
+      p99_ns: stats.percentiles[99]
+    }
+  end
+
+  defp git_revision do
+    case System.cmd("git", ["rev-parse", "--short", "HEAD"], stderr_to_stdout: true) do
+      {revision, 0} -> String.trim(revision)
+      _ -> nil
+    end
+  rescue
+    _ -> nil
+  end
+end
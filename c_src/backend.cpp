@@ -0,0 +1,48 @@
+#include "backend.hpp"
+
+namespace nx_hailo {
+
+size_t format_type_size(FormatType type) {
+  switch (type) {
+  case FormatType::Uint16:
+    return sizeof(uint16_t);
+  case FormatType::Float32:
+    return sizeof(float);
+  default:
+    return sizeof(uint8_t);
+  }
+}
+
+void SchedulerStatsRecorder::record(uint64_t wait_us, size_t frames) {
+  transfers_.fetch_add(1, std::memory_order_relaxed);
+  frames_.fetch_add(frames, std::memory_order_relaxed);
+  total_wait_us_.fetch_add(wait_us, std::memory_order_relaxed);
+  uint64_t max = max_wait_us_.load(std::memory_order_relaxed);
+  while (wait_us > max && !max_wait_us_.compare_exchange_weak(
+                              max, wait_us, std::memory_order_relaxed)) {
+  }
+}
+
+void WaitEstimator::record(uint64_t elapsed_us, size_t frames) {
+  uint64_t fastest;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = fastest_us_.emplace(frames, elapsed_us);
+    if (!inserted && elapsed_us < it->second) {
+      it->second = elapsed_us;
+    }
+    fastest = it->second;
+  }
+  stats_->record(elapsed_us - fastest, frames);
+}
+
+SchedulerStats SchedulerStatsRecorder::snapshot() const {
+  SchedulerStats stats;
+  stats.transfers = transfers_.load(std::memory_order_relaxed);
+  stats.frames = frames_.load(std::memory_order_relaxed);
+  stats.total_wait_us = total_wait_us_.load(std::memory_order_relaxed);
+  stats.max_wait_us = max_wait_us_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // namespace nx_hailo
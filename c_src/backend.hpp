@@ -0,0 +1,293 @@
+#pragma once
+
+#include "file_cache.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Device abstraction sitting under the NIF layer.
+//
+// The NIFs only talk to `Device`, `NetworkGroup` and `Pipeline`. One
+// implementation forwards to HailoRT (hailort_backend.cpp) and another one
+// simulates an accelerator on the CPU (simulated_backend.cpp), so that the
+// whole inference path can be built and exercised without the hardware.
+
+namespace nx_hailo {
+
+// Errors are reported as exceptions carrying the message returned to Elixir
+class Error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+enum class Direction { H2D, D2H };
+
+enum class FormatType { Auto, Uint8, Uint16, Float32, Unknown };
+
+enum class FormatOrder {
+  Auto,
+  Nhwc,
+  Nhcw,
+  Nchw,
+  Fcr,
+  HailoNms,
+  HailoNmsWithByteMask,
+  HailoNmsByClass,
+  Unknown
+};
+
+enum class FormatFlags { None, Transposed, Unknown };
+
+enum class NmsOrder { ByClass, ByScore, Hw };
+
+// Backend-neutral description of a vstream, mirroring hailo_vstream_info_t
+struct VStreamInfo {
+  std::string name;
+  std::string network_name;
+  Direction direction = Direction::H2D;
+  FormatType format_type = FormatType::Auto;
+  FormatOrder format_order = FormatOrder::Auto;
+  FormatFlags format_flags = FormatFlags::None;
+
+  // Image shape, only meaningful for non-NMS vstreams
+  uint32_t height = 0;
+  uint32_t width = 0;
+  uint32_t features = 0;
+
+  // NMS shape, only meaningful for NMS vstreams. `max_bboxes` is per class,
+  // or the total when `nms_order` is ByScore.
+  uint32_t number_of_classes = 0;
+  uint32_t max_bboxes = 0;
+  NmsOrder nms_order = NmsOrder::ByClass;
+
+  float qp_zp = 0.0f;
+  float qp_scale = 0.0f;
+
+  // Size in bytes of one frame in the host buffer
+  size_t frame_size = 0;
+
+  bool is_nms() const {
+    return format_order == FormatOrder::HailoNms ||
+           format_order == FormatOrder::HailoNmsWithByteMask ||
+           format_order == FormatOrder::HailoNmsByClass;
+  }
+};
+
+// Size in bytes of one element of the given type (Auto is treated as uint8)
+size_t format_type_size(FormatType type);
+
+struct ConstBuffer {
+  const void *data;
+  size_t size;
+};
+
+struct MutableBuffer {
+  void *data;
+  size_t size;
+};
+
+struct PipelineParams {
+  // Host-side element type of the vstreams. Auto keeps the default of the
+  // backend. `output_format_types` overrides the output type per vstream
+  // name, e.g. to read raw quantized outputs.
+  FormatType input_format_type = FormatType::Auto;
+  FormatType output_format_type = FormatType::Auto;
+  std::map<std::string, FormatType> output_format_types;
+  uint32_t timeout_ms = 10000;
+  uint32_t queue_size = 2;
+
+  FormatType output_format_type_for(const std::string &name) const {
+    auto it = output_format_types.find(name);
+    return it == output_format_types.end() ? output_format_type : it->second;
+  }
+};
+
+// Scheduler priorities range from 0 to 31, higher runs first
+constexpr uint8_t kDefaultSchedulerPriority = 16;
+constexpr uint8_t kMaxSchedulerPriority = 31;
+
+struct NetworkGroupParams {
+  // Frames the device processes per transfer, 0 lets HailoRT decide
+  uint16_t batch_size = 0;
+  // Model scheduler settings. When several network groups share a device,
+  // the scheduler switches to this one once `scheduler_threshold` frames
+  // are pending or the oldest of them has waited `scheduler_timeout_ms`,
+  // and serves higher priorities first. 0 keeps the HailoRT default.
+  uint8_t scheduler_priority = kDefaultSchedulerPriority;
+  uint32_t scheduler_threshold = 0;
+  uint32_t scheduler_timeout_ms = 0;
+};
+
+// Time the transfers of one network group waited for the device, which is
+// shared with the other network groups configured on it
+struct SchedulerStats {
+  uint64_t transfers = 0;
+  uint64_t frames = 0;
+  uint64_t total_wait_us = 0;
+  uint64_t max_wait_us = 0;
+};
+
+// Lock-free accumulator behind NetworkGroup::scheduler_stats(), updated
+// from whichever thread ran the transfer
+class SchedulerStatsRecorder {
+public:
+  void record(uint64_t wait_us, size_t frames);
+  SchedulerStats snapshot() const;
+
+private:
+  std::atomic<uint64_t> transfers_{0};
+  std::atomic<uint64_t> frames_{0};
+  std::atomic<uint64_t> total_wait_us_{0};
+  std::atomic<uint64_t> max_wait_us_{0};
+};
+
+// HailoRT does not report how long the scheduler kept a network group off
+// the device, so it is estimated per transfer as the time above the fastest
+// transfer of as many frames seen so far, which approximates the unloaded
+// service time. Transfers of different sizes are never compared, as the
+// device time grows with the number of frames.
+class WaitEstimator {
+public:
+  explicit WaitEstimator(std::shared_ptr<SchedulerStatsRecorder> stats)
+      : stats_(std::move(stats)) {}
+
+  void record(uint64_t elapsed_us, size_t frames);
+
+private:
+  std::shared_ptr<SchedulerStatsRecorder> stats_;
+  std::mutex mutex_;
+  // Fastest transfer seen by number of frames
+  std::map<size_t, uint64_t> fastest_us_;
+};
+
+// Equivalent of hailort::InferVStreams
+class Pipeline {
+public:
+  virtual ~Pipeline() = default;
+
+  virtual const std::vector<VStreamInfo> &input_infos() const = 0;
+  virtual const std::vector<VStreamInfo> &output_infos() const = 0;
+
+  // Runs `frames_count` frames through the device. Buffers follow the order
+  // of input_infos()/output_infos() and hold `frames_count` consecutive
+  // frames each. Not thread-safe, callers serialize access.
+  virtual void infer(const std::vector<ConstBuffer> &inputs,
+                     const std::vector<MutableBuffer> &outputs,
+                     size_t frames_count) = 0;
+};
+
+// Equivalent of the individual hailort::InputVStream and OutputVStream
+// objects of a network group. Frames written to the inputs come out of the
+// outputs in the same order, with up to the vstream queue size in flight in
+// between, so that writing, device work and reading overlap. Each input and
+// output may be driven from its own thread.
+class StreamPipeline {
+public:
+  virtual ~StreamPipeline() = default;
+
+  virtual const std::vector<VStreamInfo> &input_infos() const = 0;
+  virtual const std::vector<VStreamInfo> &output_infos() const = 0;
+
+  // Writes one frame to input `index`, blocking while its queue is full
+  virtual void write(size_t index, ConstBuffer frame) = 0;
+
+  // Reads the next frame of output `index`, blocking until it is available
+  virtual void read(size_t index, MutableBuffer frame) = 0;
+
+  // Wakes up blocked write()/read() calls, which then throw like every
+  // later call does. Used to shut the pipeline down.
+  virtual void abort() = 0;
+};
+
+// Equivalent of hailort::ConfiguredNetworkGroup
+class NetworkGroup {
+public:
+  virtual ~NetworkGroup() = default;
+
+  virtual std::vector<VStreamInfo> input_infos() const = 0;
+  virtual std::vector<VStreamInfo> output_infos() const = 0;
+
+  // Batch size the network group was configured with, 0 when automatic
+  virtual uint16_t batch_size() const = 0;
+
+  virtual SchedulerStats scheduler_stats() const = 0;
+
+  virtual std::unique_ptr<Pipeline>
+  create_pipeline(const PipelineParams &params) = 0;
+
+  virtual std::unique_ptr<StreamPipeline>
+  create_stream_pipeline(const PipelineParams &params) = 0;
+};
+
+// Equivalent of hailort::VDevice
+class Device {
+public:
+  virtual ~Device() = default;
+
+  virtual std::shared_ptr<NetworkGroup>
+  configure(const std::string &hef_path, const NetworkGroupParams &params) = 0;
+};
+
+// Physical devices behind a HailoRT VDevice
+struct DeviceParams {
+  // IDs as returned by scan_hailort_devices(), e.g. PCIe addresses. Empty
+  // lets HailoRT pick `device_count` devices.
+  std::vector<std::string> device_ids;
+  // 0 leaves the count to HailoRT, which uses a single device
+  uint32_t device_count = 0;
+};
+
+// HailoRT backed device with the model scheduler enabled, so that network
+// groups configured on it share the device without manual activation.
+// Throws when the library was built without HailoRT.
+std::shared_ptr<Device>
+create_hailort_device(const DeviceParams &params = DeviceParams());
+
+// IDs of the Hailo devices present on the system
+std::vector<std::string> scan_hailort_devices();
+
+// Hits and size of the process-wide cache of parsed HEF files that every
+// HailoRT device configures network groups from
+FileCacheStats hef_cache_stats();
+
+// Vstreams of one simulated network group
+struct SimulatedNetwork {
+  std::vector<VStreamInfo> inputs;
+  std::vector<VStreamInfo> outputs;
+};
+
+struct SimulatorConfig {
+  // Vstreams of every network group configured on the device
+  std::vector<VStreamInfo> inputs;
+  std::vector<VStreamInfo> outputs;
+  // Overrides of the vstreams above, keyed by HEF file name without the
+  // directory, e.g. for a detector and a classifier on the same device
+  std::map<std::string, SimulatedNetwork> networks;
+  // Fixed cost of each device transfer
+  uint32_t latency_us = 0;
+  // Additional cost of each frame within a transfer
+  uint32_t per_frame_latency_us = 0;
+  // Uniform jitter added to (or removed from) every transfer
+  uint32_t jitter_us = 0;
+  // Report the scheduler wait estimated from transfer latencies, as on a
+  // real device, instead of the wait measured by the simulator
+  bool estimate_wait = false;
+  uint64_t seed = 0;
+  // Number of boxes written to each NMS output frame
+  uint32_t detections_per_frame = 5;
+};
+
+// CPU simulated device. Network groups configured on it expose the vstreams
+// described in `config` for their HEF file name, without reading the file.
+// Transfers of different network groups take turns on the device, highest
+// scheduler priority first.
+std::shared_ptr<Device> create_simulated_device(SimulatorConfig config);
+
+} // namespace nx_hailo
@@ -0,0 +1,53 @@
+#include "buffer_pool.hpp"
+
+#include <algorithm>
+
+namespace nx_hailo {
+
+BufferPool::BufferPool(size_t buffer_size, size_t capacity)
+    : buffer_size_(buffer_size), capacity_(capacity) {
+  idle_.reserve(capacity);
+  for (size_t i = 0; i < capacity; i++) {
+    idle_.emplace_back(new uint8_t[buffer_size]);
+  }
+}
+
+uint8_t *BufferPool::acquire() {
+  std::unique_ptr<uint8_t[]> buffer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    acquired_++;
+    in_use_++;
+    peak_in_use_ = std::max(peak_in_use_, in_use_);
+
+    if (!idle_.empty()) {
+      buffer = std::move(idle_.back());
+      idle_.pop_back();
+    } else {
+      misses_++;
+    }
+  }
+
+  if (!buffer) {
+    buffer.reset(new uint8_t[buffer_size_]);
+  }
+  return buffer.release();
+}
+
+void BufferPool::release(uint8_t *buffer) {
+  std::unique_ptr<uint8_t[]> owned(buffer);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  in_use_--;
+  if (idle_.size() < capacity_) {
+    idle_.push_back(std::move(owned));
+  }
+}
+
+BufferPool::Stats BufferPool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {buffer_size_, capacity_, idle_.size(), in_use_,
+          peak_in_use_, acquired_,  misses_};
+}
+
+} // namespace nx_hailo
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace nx_hailo {
+
+// Pool of equally sized byte buffers.
+//
+// Keeps up to `capacity` idle buffers around. When a caller asks for a buffer
+// and none is idle a new one is allocated (and counted as a miss). Buffers
+// released while the pool already holds `capacity` idle ones are freed, so the
+// pool never grows past what the workload actually keeps in flight.
+class BufferPool {
+public:
+  struct Stats {
+    size_t buffer_size;
+    size_t capacity;
+    size_t idle;
+    size_t in_use;
+    size_t peak_in_use;
+    uint64_t acquired;
+    uint64_t misses;
+  };
+
+  BufferPool(size_t buffer_size, size_t capacity);
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  size_t buffer_size() const { return buffer_size_; }
+
+  uint8_t *acquire();
+  void release(uint8_t *buffer);
+
+  Stats stats() const;
+
+private:
+  const size_t buffer_size_;
+  const size_t capacity_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<uint8_t[]>> idle_;
+  size_t in_use_ = 0;
+  size_t peak_in_use_ = 0;
+  uint64_t acquired_ = 0;
+  uint64_t misses_ = 0;
+};
+
+} // namespace nx_hailo
@@ -0,0 +1,193 @@
+#include "detections.hpp"
+#include "backend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace nx_hailo {
+
+void parse_nms_by_class(const uint8_t *data, size_t size,
+                        uint32_t number_of_classes,
+                        const DetectionFilter &filter,
+                        std::vector<Detection> &detections) {
+  const size_t box_size = 5 * sizeof(float);
+  size_t offset = 0;
+
+  for (uint32_t class_id = 0; class_id < number_of_classes; class_id++) {
+    float count_value;
+    if (offset + sizeof(float) > size) {
+      throw Error("Malformed NMS output: frame ends before class " +
+                  std::to_string(class_id));
+    }
+    std::memcpy(&count_value, data + offset, sizeof(float));
+    offset += sizeof(float);
+
+    if (!(count_value >= 0.0f) || count_value != std::floor(count_value)) {
+      throw Error("Malformed NMS output: invalid box count for class " +
+                  std::to_string(class_id));
+    }
+    size_t count = static_cast<size_t>(count_value);
+    if (count > (size - offset) / box_size) {
+      throw Error("Malformed NMS output: boxes of class " +
+                  std::to_string(class_id) + " overflow the frame");
+    }
+
+    if (!filter.allows(class_id)) {
+      offset += count * box_size;
+      continue;
+    }
+
+    for (size_t i = 0; i < count; i++, offset += box_size) {
+      float box[5];
+      std::memcpy(box, data + offset, box_size);
+      if (box[4] < filter.score_threshold) {
+        continue;
+      }
+      detections.push_back({static_cast<float>(class_id), box[4], box[0],
+                            box[1], box[2], box[3]});
+    }
+  }
+}
+
+void select_top_k(std::vector<Detection> &detections, size_t top_k) {
+  std::stable_sort(detections.begin(), detections.end(),
+                   [](const Detection &a, const Detection &b) {
+                     return a.score > b.score;
+                   });
+  if (top_k > 0 && detections.size() > top_k) {
+    detections.resize(top_k);
+  }
+}
+
+namespace {
+
+float remap_coordinate(float coordinate, double scale, double offset,
+                       double size) {
+  double value = std::round(coordinate * scale - offset);
+  return static_cast<float>(std::min(std::max(value, 0.0), size));
+}
+
+} // namespace
+
+void remap_boxes(std::vector<Detection> &detections, const BoxRemap &remap) {
+  for (auto &detection : detections) {
+    detection.ymin = remap_coordinate(detection.ymin, remap.y_scale,
+                                      remap.y_offset, remap.height);
+    detection.xmin = remap_coordinate(detection.xmin, remap.x_scale,
+                                      remap.x_offset, remap.width);
+    detection.ymax = remap_coordinate(detection.ymax, remap.y_scale,
+                                      remap.y_offset, remap.height);
+    detection.xmax = remap_coordinate(detection.xmax, remap.x_scale,
+                                      remap.x_offset, remap.width);
+  }
+}
+
+void offset_boxes(Detection *detections, size_t count, float dx, float dy) {
+  for (size_t i = 0; i < count; i++) {
+    detections[i].ymin += dy;
+    detections[i].xmin += dx;
+    detections[i].ymax += dy;
+    detections[i].xmax += dx;
+  }
+}
+
+namespace {
+
+// Boxes in structure-of-arrays form, so that the overlap loop vectorizes
+struct BoxColumns {
+  std::vector<float> ymin, xmin, ymax, xmax, area;
+};
+
+// Flags every box of [begin, end) overlapping box `i` by at least
+// `threshold`. Kept branch-free and with flags as wide as the coordinates,
+// so that it compiles to SIMD compares.
+template <bool Ios>
+void mark_overlaps(const BoxColumns &boxes, size_t i, size_t begin,
+                   size_t end, float threshold, uint32_t *suppressed) {
+  const float ymin = boxes.ymin[i], xmin = boxes.xmin[i];
+  const float ymax = boxes.ymax[i], xmax = boxes.xmax[i];
+  const float area = boxes.area[i];
+  const float *ymins = boxes.ymin.data(), *xmins = boxes.xmin.data();
+  const float *ymaxs = boxes.ymax.data(), *xmaxs = boxes.xmax.data();
+  const float *areas = boxes.area.data();
+  for (size_t j = begin; j < end; j++) {
+    float h = std::min(ymax, ymaxs[j]) - std::max(ymin, ymins[j]);
+    float w = std::min(xmax, xmaxs[j]) - std::max(xmin, xmins[j]);
+    float intersection = std::max(h, 0.0f) * std::max(w, 0.0f);
+    float base = Ios ? std::min(area, areas[j])
+                     : area + areas[j] - intersection;
+    // intersection >= threshold * base, without dividing by empty boxes
+    suppressed[j] |= static_cast<uint32_t>(intersection > 0.0f) &
+                     static_cast<uint32_t>(intersection >= threshold * base);
+  }
+}
+
+} // namespace
+
+void suppress_overlaps(std::vector<Detection> &detections, float threshold,
+                       OverlapMetric metric, bool class_aware) {
+  // Best first, and grouped by class when only classes suppress each other
+  std::stable_sort(detections.begin(), detections.end(),
+                   [class_aware](const Detection &a, const Detection &b) {
+                     if (class_aware && a.class_id != b.class_id) {
+                       return a.class_id < b.class_id;
+                     }
+                     return a.score > b.score;
+                   });
+
+  const size_t count = detections.size();
+  BoxColumns boxes;
+  for (auto *column :
+       {&boxes.ymin, &boxes.xmin, &boxes.ymax, &boxes.xmax, &boxes.area}) {
+    column->resize(count);
+  }
+  for (size_t i = 0; i < count; i++) {
+    const auto &d = detections[i];
+    boxes.ymin[i] = d.ymin;
+    boxes.xmin[i] = d.xmin;
+    boxes.ymax[i] = d.ymax;
+    boxes.xmax[i] = d.xmax;
+    boxes.area[i] =
+        std::max(d.ymax - d.ymin, 0.0f) * std::max(d.xmax - d.xmin, 0.0f);
+  }
+
+  std::vector<uint32_t> suppressed(count, 0);
+  size_t group_start = 0;
+  while (group_start < count) {
+    size_t group_end = group_start + 1;
+    while (group_end < count &&
+           (!class_aware ||
+            detections[group_end].class_id == detections[group_start].class_id)) {
+      group_end++;
+    }
+
+    for (size_t i = group_start; i < group_end; i++) {
+      if (suppressed[i]) {
+        continue;
+      }
+      if (metric == OverlapMetric::Ios) {
+        mark_overlaps<true>(boxes, i, i + 1, group_end, threshold,
+                            suppressed.data());
+      } else {
+        mark_overlaps<false>(boxes, i, i + 1, group_end, threshold,
+                             suppressed.data());
+      }
+    }
+    group_start = group_end;
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!suppressed[i]) {
+      detections[kept++] = detections[i];
+    }
+  }
+  detections.resize(kept);
+  if (class_aware) {
+    select_top_k(detections, 0);
+  }
+}
+
+} // namespace nx_hailo
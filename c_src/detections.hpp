@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nx_hailo {
+
+// One detection, laid out exactly as in the packed binaries returned to
+// Elixir: six native-endian float32 values per box. Coordinates are
+// normalized to the model input unless they were remapped.
+struct Detection {
+  float class_id;
+  float score;
+  float ymin;
+  float xmin;
+  float ymax;
+  float xmax;
+};
+
+static_assert(sizeof(Detection) == 6 * sizeof(float),
+              "Detection must stay packed");
+
+struct DetectionFilter {
+  // Boxes scoring below this are dropped
+  float score_threshold = 0.0f;
+  // Classes to keep, indexed by class id. Empty keeps every class.
+  std::vector<bool> allowed_classes;
+  // Keep only the best `top_k` boxes, 0 keeps all of them
+  size_t top_k = 0;
+
+  bool allows(uint32_t class_id) const {
+    return allowed_classes.empty() ||
+           (class_id < allowed_classes.size() && allowed_classes[class_id]);
+  }
+};
+
+// Affine map from normalized model coordinates back to image pixels, as in
+// `pixel = round(coordinate * scale - offset)` clamped to [0, size]. This
+// undoes a letterbox: scale is the side of the padded square in original
+// pixels and offset the padding on that axis.
+struct BoxRemap {
+  double y_scale = 1.0;
+  double y_offset = 0.0;
+  double height = 1.0;
+  double x_scale = 1.0;
+  double x_offset = 0.0;
+  double width = 1.0;
+};
+
+// Decodes a float32 HAILO_NMS_BY_CLASS frame, i.e. for each of the
+// `number_of_classes` classes a box count followed by that many
+// (ymin, xmin, ymax, xmax, score) tuples. Boxes rejected by the score
+// threshold or the class allow-list are skipped while reading. The frame
+// does not need to be aligned. Throws nx_hailo::Error on malformed input.
+void parse_nms_by_class(const uint8_t *data, size_t size,
+                        uint32_t number_of_classes,
+                        const DetectionFilter &filter,
+                        std::vector<Detection> &detections);
+
+// Orders detections by descending score and keeps the first `top_k`
+// (all of them when 0). Ties keep their original order.
+void select_top_k(std::vector<Detection> &detections, size_t top_k);
+
+void remap_boxes(std::vector<Detection> &detections, const BoxRemap &remap);
+
+// Moves boxes in pixels by (dx, dy), e.g. from a tile into its frame
+void offset_boxes(Detection *detections, size_t count, float dx, float dy);
+
+// How much two boxes overlap: intersection over union, or intersection over
+// the area of the smaller box, which also matches a box cut off at a tile
+// edge to the whole one
+enum class OverlapMetric { Iou, Ios };
+
+// Greedy non-maximum suppression. Drops every detection that overlaps a
+// better one by at least `threshold` and leaves the rest best first. With
+// `class_aware` only detections of the same class suppress each other.
+void suppress_overlaps(std::vector<Detection> &detections, float threshold,
+                       OverlapMetric metric, bool class_aware);
+
+} // namespace nx_hailo
@@ -0,0 +1,99 @@
+#include "file_cache.hpp"
+#include "backend.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nx_hailo {
+
+namespace {
+
+std::string errno_message(const std::string &what, const std::string &path) {
+  return what + " " + path + ": " + std::strerror(errno);
+}
+
+uint64_t rotate_left(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw Error(errno_message("Failed to open", path));
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw Error(errno_message("Failed to stat", path));
+  }
+  size_ = static_cast<size_t>(st.st_size);
+
+  // mmap rejects empty mappings, and an empty file has nothing to map
+  if (size_ > 0) {
+    void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw Error(errno_message("Failed to map", path));
+    }
+    // The whole file is read right away, for the hash and then the parser
+    ::madvise(data, size_, MADV_WILLNEED);
+    data_ = static_cast<const uint8_t *>(data);
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    ::munmap(const_cast<uint8_t *>(data_), size_);
+  }
+}
+
+uint64_t content_hash(const uint8_t *data, size_t size) {
+  constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+  constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+  // Four independent lanes keep the multiplies pipelined
+  uint64_t lanes[4] = {prime1, prime2, ~prime1, ~prime2};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int k = 0; k < 4; k++) {
+      uint64_t word;
+      std::memcpy(&word, data + i + 8 * k, sizeof(word));
+      lanes[k] = rotate_left(lanes[k] + word * prime2, 31) * prime1;
+    }
+  }
+
+  uint64_t hash = size * prime1;
+  for (int k = 0; k < 4; k++) {
+    hash = rotate_left(hash ^ lanes[k], 27) * prime1 + prime2;
+  }
+  for (; i < size; i++) {
+    hash = rotate_left(hash ^ (data[i] * prime2), 11) * prime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= prime2;
+  hash ^= hash >> 29;
+  return hash;
+}
+
+FileIdentity file_identity(const std::string &path) {
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) {
+    throw Error(errno_message("Failed to stat", path));
+  }
+  FileIdentity identity;
+  identity.size = static_cast<uint64_t>(st.st_size);
+  identity.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                      st.st_mtim.tv_nsec;
+  return identity;
+}
+
+} // namespace nx_hailo
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace nx_hailo {
+
+// Read-only memory mapping of a whole file. Throws nx_hailo::Error when
+// the file cannot be opened or mapped.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// 64-bit hash of a buffer, 8 bytes at a time. Only meant to tell file
+// contents apart, not for security.
+uint64_t content_hash(const uint8_t *data, size_t size);
+
+// Size and modification time of a file, used to skip rehashing files that
+// did not change since they were last seen
+struct FileIdentity {
+  uint64_t size = 0;
+  int64_t mtime_ns = 0;
+
+  bool operator==(const FileIdentity &other) const {
+    return size == other.size && mtime_ns == other.mtime_ns;
+  }
+};
+
+FileIdentity file_identity(const std::string &path);
+
+struct FileCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t entries = 0;
+  uint64_t bytes = 0;
+};
+
+// Process-wide cache of values parsed from files, keyed by file contents.
+// A file is mapped, hashed and parsed the first time it is seen. Later
+// lookups of an unchanged path skip all three, and a copy of the same
+// contents under another path is recognised by its hash. Entries keep
+// their mapping and are never evicted, which suits a handful of models
+// loaded at startup.
+template <typename T> class FileCache {
+public:
+  using Loader = std::function<std::shared_ptr<T>(const MappedFile &)>;
+
+  // Returns the cached value for `path`, calling `load` on a miss. Loads
+  // are serialized; `load` reports errors by throwing.
+  std::shared_ptr<T> get(const std::string &path, const Loader &load) {
+    auto identity = file_identity(path);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto known = paths_.find(path);
+    if (known != paths_.end() && known->second.first == identity) {
+      auto it = entries_.find(known->second.second);
+      if (it != entries_.end()) {
+        hits_++;
+        return it->second.value;
+      }
+    }
+
+    auto file = std::make_shared<MappedFile>(path);
+    Key key{content_hash(file->data(), file->size()), file->size()};
+    paths_[path] = {identity, key};
+
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      hits_++;
+      return it->second.value;
+    }
+
+    misses_++;
+    auto value = load(*file);
+    bytes_ += file->size();
+    entries_[key] = {std::move(file), value};
+    return value;
+  }
+
+  FileCacheStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FileCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+  }
+
+private:
+  // Content hash and size
+  using Key = std::pair<uint64_t, uint64_t>;
+
+  struct Entry {
+    std::shared_ptr<MappedFile> file;
+    std::shared_ptr<T> value;
+  };
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::pair<FileIdentity, Key>> paths_;
+  std::map<Key, Entry> entries_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t bytes_ = 0;
+};
+
+} // namespace nx_hailo
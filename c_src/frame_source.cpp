@@ -0,0 +1,534 @@
+#include "frame_source.hpp"
+#include "backend.hpp"
+#include "file_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace nx_hailo {
+
+namespace {
+
+uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// SourceFrame that keeps whatever backs its pixels alive
+template <typename Owner> struct OwnedFrame : SourceFrame {
+  Owner owner;
+};
+
+} // namespace
+
+#ifdef __linux__
+
+namespace {
+
+uint32_t v4l2_pixel_format(PixelFormat format) {
+  switch (format) {
+  case PixelFormat::Rgb:
+    return V4L2_PIX_FMT_RGB24;
+  case PixelFormat::Bgr:
+    return V4L2_PIX_FMT_BGR24;
+  case PixelFormat::Yuyv:
+    return V4L2_PIX_FMT_YUYV;
+  case PixelFormat::I420:
+    return V4L2_PIX_FMT_YUV420;
+  }
+  return 0;
+}
+
+int xioctl(int fd, unsigned long request, void *arg) {
+  int result;
+  do {
+    result = ioctl(fd, request, arg);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+// State shared by the source, its capture thread and the frames handed
+// out, so that the buffers stay mapped until the last frame is released
+struct V4l2State {
+  struct Buffer {
+    void *start = MAP_FAILED;
+    size_t length = 0;
+    size_t bytes_used = 0;
+    bool queued = false;
+    uint32_t readers = 0;
+  };
+
+  int fd = -1;
+  FrameLayout layout;
+  std::vector<Buffer> buffers;
+
+  std::mutex mutex;
+  std::condition_variable frame_ready;
+  bool streaming = false;
+  int latest = -1;
+  uint64_t sequence = 0;
+  uint64_t timestamp_us = 0;
+  std::string error;
+
+  ~V4l2State() {
+    for (auto &buffer : buffers) {
+      if (buffer.start != MAP_FAILED) {
+        munmap(buffer.start, buffer.length);
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  // Hands buffer `index` back to the driver. Called with the mutex held.
+  void queue(int index) {
+    v4l2_buffer buf = {};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+    if (xioctl(fd, VIDIOC_QBUF, &buf) < 0) {
+      error = std::string("Failed to queue V4L2 buffer: ") + strerror(errno);
+      frame_ready.notify_all();
+      return;
+    }
+    buffers[index].queued = true;
+  }
+
+  // Requeues buffer `index` unless it is the newest frame or being read
+  void recycle(int index) {
+    auto &buffer = buffers[index];
+    if (streaming && index != latest && buffer.readers == 0 && !buffer.queued) {
+      queue(index);
+    }
+  }
+};
+
+class V4l2Source : public FrameSource {
+public:
+  V4l2Source(const std::string &path, const V4l2SourceParams &params)
+      : state_(std::make_shared<V4l2State>()) {
+    auto &state = *state_;
+    state.fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (state.fd < 0) {
+      throw Error("Failed to open " + path + ": " + strerror(errno));
+    }
+
+    v4l2_capability capability = {};
+    if (xioctl(state.fd, VIDIOC_QUERYCAP, &capability) < 0 ||
+        !(capability.capabilities & V4L2_CAP_VIDEO_CAPTURE) ||
+        !(capability.capabilities & V4L2_CAP_STREAMING)) {
+      throw Error(path + " is not a V4L2 streaming capture device");
+    }
+
+    v4l2_format format = {};
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    format.fmt.pix.width = params.width;
+    format.fmt.pix.height = params.height;
+    format.fmt.pix.pixelformat = v4l2_pixel_format(params.format);
+    format.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(state.fd, VIDIOC_S_FMT, &format) < 0) {
+      throw Error(std::string("Failed to set the V4L2 format: ") +
+                  strerror(errno));
+    }
+    // The driver answers with the closest format it supports
+    if (format.fmt.pix.pixelformat != v4l2_pixel_format(params.format)) {
+      throw Error(path + " does not support the requested pixel format");
+    }
+    state.layout.width = format.fmt.pix.width;
+    state.layout.height = format.fmt.pix.height;
+    state.layout.format = params.format;
+    state.layout.stride = std::max<size_t>(
+        format.fmt.pix.bytesperline,
+        state.layout.width * bytes_per_pixel(params.format));
+
+    v4l2_requestbuffers request = {};
+    request.count = std::max<uint32_t>(params.buffer_count, 2);
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(state.fd, VIDIOC_REQBUFS, &request) < 0 || request.count < 2) {
+      throw Error(std::string("Failed to allocate V4L2 buffers: ") +
+                  strerror(errno));
+    }
+
+    state.buffers.resize(request.count);
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (uint32_t i = 0; i < request.count; i++) {
+      v4l2_buffer buf = {};
+      buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buf.memory = V4L2_MEMORY_MMAP;
+      buf.index = i;
+      if (xioctl(state.fd, VIDIOC_QUERYBUF, &buf) < 0) {
+        throw Error(std::string("Failed to query V4L2 buffer: ") +
+                    strerror(errno));
+      }
+      auto &buffer = state.buffers[i];
+      buffer.length = buf.length;
+      buffer.start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, state.fd, buf.m.offset);
+      if (buffer.start == MAP_FAILED) {
+        throw Error(std::string("Failed to map V4L2 buffer: ") +
+                    strerror(errno));
+      }
+      state.queue(i);
+    }
+    if (!state.error.empty()) {
+      throw Error(state.error);
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(state.fd, VIDIOC_STREAMON, &type) < 0) {
+      throw Error(std::string("Failed to start V4L2 streaming: ") +
+                  strerror(errno));
+    }
+    state.streaming = true;
+    thread_ = std::thread([this] { capture(); });
+  }
+
+  ~V4l2Source() override {
+    stop_ = true;
+    thread_.join();
+
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->streaming = false;
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    xioctl(state_->fd, VIDIOC_STREAMOFF, &type);
+    if (state_->error.empty()) {
+      state_->error = "Frame source was closed";
+    }
+    state_->frame_ready.notify_all();
+  }
+
+  const FrameLayout &layout() const override { return state_->layout; }
+
+  std::shared_ptr<const SourceFrame> latest(uint64_t after_sequence,
+                                            uint32_t timeout_ms) override {
+    auto state = state_;
+    std::unique_lock<std::mutex> lock(state->mutex);
+    bool ready = state->frame_ready.wait_for(
+        lock, std::chrono::milliseconds(timeout_ms), [&] {
+          return !state->error.empty() ||
+                 (state->latest >= 0 && state->sequence > after_sequence);
+        });
+    if (!state->error.empty()) {
+      throw Error(state->error);
+    }
+    if (!ready) {
+      return nullptr;
+    }
+
+    int index = state->latest;
+    auto &buffer = state->buffers[index];
+    buffer.readers++;
+
+    auto frame = new SourceFrame();
+    frame->frame = Frame{static_cast<const uint8_t *>(buffer.start),
+                         buffer.bytes_used,
+                         state->layout.width,
+                         state->layout.height,
+                         state->layout.stride,
+                         state->layout.format};
+    frame->sequence = state->sequence;
+    frame->timestamp_us = state->timestamp_us;
+
+    // Releasing the frame gives the buffer back to the driver, unless it
+    // is still the newest one
+    return std::shared_ptr<const SourceFrame>(
+        frame, [state, index](const SourceFrame *frame) {
+          delete frame;
+          std::lock_guard<std::mutex> lock(state->mutex);
+          state->buffers[index].readers--;
+          state->recycle(index);
+        });
+  }
+
+private:
+  void capture() {
+    auto &state = *state_;
+    while (!stop_) {
+      pollfd fds = {state.fd, POLLIN, 0};
+      int ready = poll(&fds, 1, 100);
+      if (ready < 0 && errno != EINTR) {
+        fail(std::string("Failed to poll V4L2 device: ") + strerror(errno));
+        return;
+      }
+      if (ready <= 0) {
+        continue;
+      }
+
+      v4l2_buffer buf = {};
+      buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      buf.memory = V4L2_MEMORY_MMAP;
+      if (xioctl(state.fd, VIDIOC_DQBUF, &buf) < 0) {
+        if (errno == EAGAIN) {
+          continue;
+        }
+        fail(std::string("Failed to dequeue V4L2 buffer: ") + strerror(errno));
+        return;
+      }
+
+      std::lock_guard<std::mutex> lock(state.mutex);
+      auto &buffer = state.buffers[buf.index];
+      buffer.queued = false;
+      buffer.bytes_used = buf.bytesused;
+
+      int previous = state.latest;
+      state.latest = buf.index;
+      state.sequence++;
+      state.timestamp_us = buf.timestamp.tv_sec * 1000000ull +
+                           buf.timestamp.tv_usec;
+      if (previous >= 0 && previous != state.latest) {
+        state.recycle(previous);
+      }
+      state.frame_ready.notify_all();
+    }
+  }
+
+  void fail(const std::string &message) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->error = message;
+    state_->frame_ready.notify_all();
+  }
+
+  std::shared_ptr<V4l2State> state_;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+} // namespace
+
+std::unique_ptr<FrameSource> open_v4l2_source(const std::string &path,
+                                              const V4l2SourceParams &params) {
+  return std::make_unique<V4l2Source>(path, params);
+}
+
+#else
+
+std::unique_ptr<FrameSource> open_v4l2_source(const std::string &path,
+                                              const V4l2SourceParams &params) {
+  throw Error("V4L2 capture is only available on Linux");
+}
+
+#endif
+
+namespace {
+
+// Parses the YUV4MPEG2 stream header, e.g.
+// "YUV4MPEG2 W640 H480 F30:1 Ip A1:1 C420jpeg\n", and the frame headers
+// that follow it. Returns the offset of every frame.
+std::vector<size_t> parse_y4m(const uint8_t *data, size_t size,
+                              FrameLayout &layout, double &fps) {
+  auto line_end = [&](size_t from) {
+    const void *end = std::memchr(data + from, '\n', size - from);
+    if (!end) {
+      throw Error("Truncated Y4M header");
+    }
+    return static_cast<size_t>(static_cast<const uint8_t *>(end) - data);
+  };
+
+  size_t header_end = line_end(0);
+  std::string header(reinterpret_cast<const char *>(data), header_end);
+  std::string colorspace = "420jpeg";
+  fps = 0;
+
+  size_t pos = header.find(' ');
+  while (pos != std::string::npos) {
+    size_t next = header.find(' ', pos + 1);
+    std::string token = header.substr(pos + 1, next - pos - 1);
+    pos = next;
+    if (token.empty()) {
+      continue;
+    }
+    switch (token[0]) {
+    case 'W':
+      layout.width = std::stoul(token.substr(1));
+      break;
+    case 'H':
+      layout.height = std::stoul(token.substr(1));
+      break;
+    case 'F': {
+      size_t colon = token.find(':');
+      double denominator =
+          colon == std::string::npos ? 1 : std::stod(token.substr(colon + 1));
+      if (denominator > 0) {
+        fps = std::stod(token.substr(1, colon - 1)) / denominator;
+      }
+      break;
+    }
+    case 'C':
+      colorspace = token.substr(1);
+      break;
+    }
+  }
+
+  if (layout.width == 0 || layout.height == 0) {
+    throw Error("Y4M header is missing the frame size");
+  }
+  if (colorspace.compare(0, 3, "420") != 0) {
+    throw Error("Unsupported Y4M colorspace " + colorspace +
+                ", only 4:2:0 is supported");
+  }
+  layout.format = PixelFormat::I420;
+  layout.stride = layout.width;
+  size_t frame_size =
+      frame_span(layout.format, layout.width, layout.height, layout.stride);
+
+  std::vector<size_t> offsets;
+  size_t pos_in_file = header_end + 1;
+  while (pos_in_file < size) {
+    if (size - pos_in_file < 5 ||
+        std::memcmp(data + pos_in_file, "FRAME", 5) != 0) {
+      throw Error("Invalid Y4M frame header at offset " +
+                  std::to_string(pos_in_file));
+    }
+    size_t frame_start = line_end(pos_in_file) + 1;
+    if (size - frame_start < frame_size) {
+      // A partially written last frame is ignored
+      break;
+    }
+    offsets.push_back(frame_start);
+    pos_in_file = frame_start + frame_size;
+  }
+  return offsets;
+}
+
+bool is_y4m(const MappedFile &file) {
+  return file.size() >= 10 && std::memcmp(file.data(), "YUV4MPEG2 ", 10) == 0;
+}
+
+class FileSource : public FrameSource {
+public:
+  FileSource(const std::string &path, const FileSourceParams &params)
+      : file_(std::make_shared<MappedFile>(path)), loop_(params.loop) {
+    double file_fps = 0;
+    if (is_y4m(*file_)) {
+      offsets_ = parse_y4m(file_->data(), file_->size(), layout_, file_fps);
+    } else {
+      layout_ = params.layout;
+      if (layout_.width == 0 || layout_.height == 0) {
+        throw Error("Raw video files need a width and a height");
+      }
+      if (layout_.stride == 0) {
+        layout_.stride = layout_.width * bytes_per_pixel(layout_.format);
+      }
+      size_t frame_size = frame_span(layout_.format, layout_.width,
+                                     layout_.height, layout_.stride);
+      for (size_t offset = 0; offset + frame_size <= file_->size();
+           offset += frame_size) {
+        offsets_.push_back(offset);
+      }
+    }
+    if (offsets_.empty()) {
+      throw Error(path + " holds no complete frame");
+    }
+    frame_size_ = frame_span(layout_.format, layout_.width, layout_.height,
+                             layout_.stride);
+
+    fps_ = params.fps < 0 ? file_fps : params.fps;
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  const FrameLayout &layout() const override { return layout_; }
+
+  std::shared_ptr<const SourceFrame> latest(uint64_t after_sequence,
+                                            uint32_t timeout_ms) override {
+    uint64_t sequence;
+    if (fps_ == 0) {
+      // Every read gets the next frame
+      std::lock_guard<std::mutex> lock(mutex_);
+      sequence = std::max(after_sequence + 1, next_sequence_);
+      next_sequence_ = sequence + 1;
+    } else {
+      // The frame a camera would be showing now, waiting for the next one
+      // when it was already read
+      auto deadline = std::chrono::steady_clock::now() +
+                      std::chrono::milliseconds(timeout_ms);
+      for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        sequence = sequence_at(now);
+        if (sequence > after_sequence) {
+          break;
+        }
+        auto next = start_ + std::chrono::duration_cast<
+                                 std::chrono::steady_clock::duration>(
+                                 std::chrono::duration<double>(
+                                     after_sequence / fps_));
+        if (next > deadline) {
+          std::this_thread::sleep_until(deadline);
+          if (sequence_at(deadline) <= after_sequence) {
+            return nullptr;
+          }
+          continue;
+        }
+        std::this_thread::sleep_until(next);
+      }
+    }
+
+    uint64_t index = sequence - 1;
+    if (index >= offsets_.size()) {
+      if (!loop_) {
+        throw Error("End of video file");
+      }
+      index %= offsets_.size();
+    }
+
+    auto frame = std::make_shared<OwnedFrame<std::shared_ptr<MappedFile>>>();
+    frame->owner = file_;
+    frame->frame = Frame{file_->data() + offsets_[index],
+                         frame_size_,
+                         layout_.width,
+                         layout_.height,
+                         layout_.stride,
+                         layout_.format};
+    frame->sequence = sequence;
+    frame->timestamp_us =
+        fps_ == 0 ? now_us()
+                  : static_cast<uint64_t>((sequence - 1) * 1e6 / fps_);
+    return frame;
+  }
+
+private:
+  // Sequence of the frame showing at `time`, the first one being 1
+  uint64_t sequence_at(std::chrono::steady_clock::time_point time) const {
+    double elapsed = std::chrono::duration<double>(time - start_).count();
+    return static_cast<uint64_t>(std::floor(elapsed * fps_)) + 1;
+  }
+
+  std::shared_ptr<MappedFile> file_;
+  FrameLayout layout_;
+  std::vector<size_t> offsets_;
+  size_t frame_size_ = 0;
+  double fps_ = 0;
+  bool loop_;
+  std::chrono::steady_clock::time_point start_;
+
+  std::mutex mutex_;
+  uint64_t next_sequence_ = 1;
+};
+
+} // namespace
+
+std::unique_ptr<FrameSource> open_file_source(const std::string &path,
+                                              const FileSourceParams &params) {
+  return std::make_unique<FileSource>(path, params);
+}
+
+} // namespace nx_hailo
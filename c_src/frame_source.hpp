@@ -0,0 +1,82 @@
+#pragma once
+
+#include "preprocess.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace nx_hailo {
+
+// A frame handed out by a FrameSource. `frame.data` points straight into
+// the capture buffer or the mapped file, and stays valid for as long as the
+// SourceFrame is alive.
+struct SourceFrame {
+  Frame frame;
+  // Increases by one for every frame the source produced, including the
+  // ones nobody read
+  uint64_t sequence;
+  uint64_t timestamp_us;
+};
+
+// Layout shared by every frame of a source
+struct FrameLayout {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  PixelFormat format = PixelFormat::Rgb;
+  size_t stride = 0;
+};
+
+// Source of camera-like frames that only ever hands out the newest one.
+// Frames that arrive while nobody is reading are dropped, so readers never
+// fall behind.
+class FrameSource {
+public:
+  virtual ~FrameSource() = default;
+
+  virtual const FrameLayout &layout() const = 0;
+
+  // Waits up to `timeout_ms` for a frame with a sequence above
+  // `after_sequence` and returns the newest one, or nullptr on timeout.
+  // Throws nx_hailo::Error once the source failed or ran out of frames.
+  // Thread-safe.
+  virtual std::shared_ptr<const SourceFrame> latest(uint64_t after_sequence,
+                                                    uint32_t timeout_ms) = 0;
+};
+
+struct V4l2SourceParams {
+  uint32_t width = 640;
+  uint32_t height = 480;
+  PixelFormat format = PixelFormat::Yuyv;
+  // Kernel buffers to capture into. Frames held by readers keep their
+  // buffer, so this bounds how many can be held before capture stalls.
+  uint32_t buffer_count = 4;
+};
+
+// Captures from a V4L2 device such as /dev/video0 into buffers mapped from
+// the kernel. A capture thread requeues every frame but the newest, and the
+// newest once a newer one replaced it and no reader holds it anymore. The
+// driver may pick a different size or stride, see layout().
+std::unique_ptr<FrameSource> open_v4l2_source(const std::string &path,
+                                              const V4l2SourceParams &params);
+
+struct FileSourceParams {
+  // Layout of raw files. Y4M files describe themselves, and only 4:2:0
+  // files are supported, read as I420.
+  FrameLayout layout;
+  // Frames per second the file plays at, as if it was a camera. 0 plays
+  // the file at the rate the frames are read, one new frame per read,
+  // and -1 uses the rate in the Y4M header.
+  double fps = -1;
+  // Starts over at the end of the file instead of failing
+  bool loop = true;
+};
+
+// Plays back a raw or YUV4MPEG2 video file mapped in memory, as a stand-in
+// for a camera in tests and benchmarks. Y4M files are detected by their
+// header.
+std::unique_ptr<FrameSource> open_file_source(const std::string &path,
+                                              const FileSourceParams &params);
+
+} // namespace nx_hailo
@@ -0,0 +1,517 @@
+#include "backend.hpp"
+
+#ifndef NX_HAILO_WITHOUT_HAILORT
+
+#include "hailo/hailort.hpp"
+#include <atomic>
+#include <chrono>
+#include <map>
+
+namespace nx_hailo {
+namespace {
+
+std::string status_message(const std::string &what, hailo_status status) {
+  return what + ": " + std::to_string(status);
+}
+
+FormatType from_hailo(hailo_format_type_t type) {
+  switch (type) {
+  case HAILO_FORMAT_TYPE_AUTO:
+    return FormatType::Auto;
+  case HAILO_FORMAT_TYPE_UINT8:
+    return FormatType::Uint8;
+  case HAILO_FORMAT_TYPE_UINT16:
+    return FormatType::Uint16;
+  case HAILO_FORMAT_TYPE_FLOAT32:
+    return FormatType::Float32;
+  default:
+    return FormatType::Unknown;
+  }
+}
+
+hailo_format_type_t to_hailo(FormatType type) {
+  switch (type) {
+  case FormatType::Uint8:
+    return HAILO_FORMAT_TYPE_UINT8;
+  case FormatType::Uint16:
+    return HAILO_FORMAT_TYPE_UINT16;
+  case FormatType::Float32:
+    return HAILO_FORMAT_TYPE_FLOAT32;
+  default:
+    return HAILO_FORMAT_TYPE_AUTO;
+  }
+}
+
+FormatOrder from_hailo(hailo_format_order_t order) {
+  switch (order) {
+  case HAILO_FORMAT_ORDER_AUTO:
+    return FormatOrder::Auto;
+  case HAILO_FORMAT_ORDER_NHWC:
+    return FormatOrder::Nhwc;
+  case HAILO_FORMAT_ORDER_NHCW:
+    return FormatOrder::Nhcw;
+  case HAILO_FORMAT_ORDER_NCHW:
+    return FormatOrder::Nchw;
+  case HAILO_FORMAT_ORDER_FCR:
+    return FormatOrder::Fcr;
+  case HAILO_FORMAT_ORDER_HAILO_NMS:
+    return FormatOrder::HailoNms;
+  case HAILO_FORMAT_ORDER_HAILO_NMS_WITH_BYTE_MASK:
+    return FormatOrder::HailoNmsWithByteMask;
+  case HAILO_FORMAT_ORDER_HAILO_NMS_BY_CLASS:
+    return FormatOrder::HailoNmsByClass;
+  default:
+    return FormatOrder::Unknown;
+  }
+}
+
+FormatFlags from_hailo(hailo_format_flags_t flags) {
+  if (flags == HAILO_FORMAT_FLAGS_NONE)
+    return FormatFlags::None;
+  if (flags == HAILO_FORMAT_FLAGS_TRANSPOSED)
+    return FormatFlags::Transposed;
+  return FormatFlags::Unknown;
+}
+
+NmsOrder from_hailo(hailo_nms_result_order_type_t order) {
+  switch (order) {
+  case HAILO_NMS_RESULT_ORDER_BY_SCORE:
+    return NmsOrder::ByScore;
+  case HAILO_NMS_RESULT_ORDER_HW:
+    return NmsOrder::Hw;
+  default:
+    return NmsOrder::ByClass;
+  }
+}
+
+VStreamInfo to_vstream_info(const hailo_vstream_info_t &info,
+                            size_t frame_size) {
+  VStreamInfo result;
+  result.name = info.name;
+  result.network_name = info.network_name;
+  result.direction =
+      info.direction == HAILO_D2H_STREAM ? Direction::D2H : Direction::H2D;
+  result.format_type = from_hailo(info.format.type);
+  result.format_order = from_hailo(info.format.order);
+  result.format_flags = from_hailo(info.format.flags);
+
+  if (result.is_nms()) {
+    result.number_of_classes = info.nms_shape.number_of_classes;
+    result.nms_order = from_hailo(info.nms_shape.order_type);
+    result.max_bboxes = result.nms_order == NmsOrder::ByScore
+                            ? info.nms_shape.max_bboxes_total
+                            : info.nms_shape.max_bboxes_per_class;
+  } else {
+    result.height = info.shape.height;
+    result.width = info.shape.width;
+    result.features = info.shape.features;
+  }
+
+  result.qp_zp = info.quant_info.qp_zp;
+  result.qp_scale = info.quant_info.qp_scale;
+  result.frame_size = frame_size;
+  return result;
+}
+
+std::vector<VStreamInfo>
+to_vstream_infos(const std::vector<hailo_vstream_info_t> &infos) {
+  std::vector<VStreamInfo> result;
+  for (const auto &info : infos) {
+    result.push_back(to_vstream_info(
+        info, hailort::HailoRTCommon::get_frame_size(info, info.format)));
+  }
+  return result;
+}
+
+class HailoPipeline : public Pipeline {
+public:
+  HailoPipeline(std::shared_ptr<hailort::ConfiguredNetworkGroup> network_group,
+                hailort::InferVStreams vstreams,
+                std::shared_ptr<WaitEstimator> wait_estimator)
+      : network_group_(std::move(network_group)),
+        vstreams_(std::move(vstreams)),
+        wait_estimator_(std::move(wait_estimator)) {
+    for (const auto &vstream : vstreams_.get_input_vstreams()) {
+      input_infos_.push_back(to_vstream_info(vstream.get().get_info(),
+                                             vstream.get().get_frame_size()));
+    }
+    for (const auto &vstream : vstreams_.get_output_vstreams()) {
+      output_infos_.push_back(to_vstream_info(vstream.get().get_info(),
+                                              vstream.get().get_frame_size()));
+    }
+  }
+
+  const std::vector<VStreamInfo> &input_infos() const override {
+    return input_infos_;
+  }
+
+  const std::vector<VStreamInfo> &output_infos() const override {
+    return output_infos_;
+  }
+
+  void infer(const std::vector<ConstBuffer> &inputs,
+             const std::vector<MutableBuffer> &outputs,
+             size_t frames_count) override {
+    std::map<std::string, hailort::MemoryView> input_views;
+    for (size_t i = 0; i < input_infos_.size(); i++) {
+      input_views.emplace(input_infos_[i].name,
+                          hailort::MemoryView(const_cast<void *>(inputs[i].data),
+                                              inputs[i].size));
+    }
+
+    std::map<std::string, hailort::MemoryView> output_views;
+    for (size_t i = 0; i < output_infos_.size(); i++) {
+      output_views.emplace(
+          output_infos_[i].name,
+          hailort::MemoryView(outputs[i].data, outputs[i].size));
+    }
+
+    auto started_at = std::chrono::steady_clock::now();
+    hailo_status status =
+        vstreams_.infer(input_views, output_views, frames_count);
+    if (status != HAILO_SUCCESS) {
+      throw Error(status_message("Inference failed with status", status));
+    }
+    wait_estimator_->record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started_at)
+            .count(),
+        frames_count);
+  }
+
+private:
+  // Keep a reference to the network group the vstreams were created from
+  std::shared_ptr<hailort::ConfiguredNetworkGroup> network_group_;
+  hailort::InferVStreams vstreams_;
+  std::shared_ptr<WaitEstimator> wait_estimator_;
+  std::vector<VStreamInfo> input_infos_;
+  std::vector<VStreamInfo> output_infos_;
+};
+
+class HailoStreamPipeline : public StreamPipeline {
+public:
+  HailoStreamPipeline(
+      std::shared_ptr<hailort::ConfiguredNetworkGroup> network_group,
+      std::vector<hailort::InputVStream> inputs,
+      std::vector<hailort::OutputVStream> outputs)
+      : network_group_(std::move(network_group)), inputs_(std::move(inputs)),
+        outputs_(std::move(outputs)) {
+    for (const auto &vstream : inputs_) {
+      input_infos_.push_back(
+          to_vstream_info(vstream.get_info(), vstream.get_frame_size()));
+    }
+    for (const auto &vstream : outputs_) {
+      output_infos_.push_back(
+          to_vstream_info(vstream.get_info(), vstream.get_frame_size()));
+    }
+  }
+
+  const std::vector<VStreamInfo> &input_infos() const override {
+    return input_infos_;
+  }
+
+  const std::vector<VStreamInfo> &output_infos() const override {
+    return output_infos_;
+  }
+
+  void write(size_t index, ConstBuffer frame) override {
+    hailo_status status = inputs_.at(index).write(
+        hailort::MemoryView(const_cast<void *>(frame.data), frame.size));
+    check(status, "Failed to write to input vstream");
+  }
+
+  void read(size_t index, MutableBuffer frame) override {
+    hailo_status status = outputs_.at(index).read(
+        hailort::MemoryView(frame.data, frame.size));
+    check(status, "Failed to read from output vstream");
+  }
+
+  void abort() override {
+    aborted_ = true;
+    for (auto &vstream : inputs_) {
+      vstream.abort();
+    }
+    for (auto &vstream : outputs_) {
+      vstream.abort();
+    }
+  }
+
+private:
+  void check(hailo_status status, const std::string &what) const {
+    if (aborted_) {
+      throw Error("Stream pipeline was aborted");
+    }
+    if (status != HAILO_SUCCESS) {
+      throw Error(status_message(what, status));
+    }
+  }
+
+  // Keep a reference to the network group the vstreams were created from
+  std::shared_ptr<hailort::ConfiguredNetworkGroup> network_group_;
+  std::vector<hailort::InputVStream> inputs_;
+  std::vector<hailort::OutputVStream> outputs_;
+  std::vector<VStreamInfo> input_infos_;
+  std::vector<VStreamInfo> output_infos_;
+  std::atomic<bool> aborted_{false};
+};
+
+class HailoNetworkGroup : public NetworkGroup {
+public:
+  HailoNetworkGroup(std::shared_ptr<hailort::VDevice> vdevice,
+                    std::shared_ptr<hailort::ConfiguredNetworkGroup> ng,
+                    uint16_t batch_size)
+      : vdevice_(std::move(vdevice)), network_group_(std::move(ng)),
+        batch_size_(batch_size),
+        stats_(std::make_shared<SchedulerStatsRecorder>()),
+        wait_estimator_(std::make_shared<WaitEstimator>(stats_)) {}
+
+  uint16_t batch_size() const override { return batch_size_; }
+
+  // Only covers transfers of synchronous pipelines. Stream pipelines keep
+  // several frames queued on purpose, so their latency says nothing about
+  // the scheduler.
+  SchedulerStats scheduler_stats() const override { return stats_->snapshot(); }
+
+  std::vector<VStreamInfo> input_infos() const override {
+    auto infos = network_group_->get_input_vstream_infos();
+    if (!infos) {
+      throw Error(status_message(
+          "Failed to get input vstream infos from network group",
+          infos.status()));
+    }
+    return to_vstream_infos(infos.value());
+  }
+
+  std::vector<VStreamInfo> output_infos() const override {
+    auto infos = network_group_->get_output_vstream_infos();
+    if (!infos) {
+      throw Error(status_message(
+          "Failed to get output vstream infos from network group",
+          infos.status()));
+    }
+    return to_vstream_infos(infos.value());
+  }
+
+  std::unique_ptr<Pipeline>
+  create_pipeline(const PipelineParams &params) override {
+    auto vstream_params = make_vstream_params(params);
+    auto vstreams = hailort::InferVStreams::create(
+        *network_group_, vstream_params.first, vstream_params.second);
+    if (!vstreams) {
+      throw Error(status_message("Failed to create inference pipeline",
+                                 vstreams.status()));
+    }
+
+    return std::make_unique<HailoPipeline>(
+        network_group_, std::move(vstreams.value()), wait_estimator_);
+  }
+
+  std::unique_ptr<StreamPipeline>
+  create_stream_pipeline(const PipelineParams &params) override {
+    auto vstream_params = make_vstream_params(params);
+    auto inputs = hailort::VStreamsBuilder::create_input_vstreams(
+        *network_group_, vstream_params.first);
+    if (!inputs) {
+      throw Error(status_message("Failed to create input vstreams",
+                                 inputs.status()));
+    }
+
+    auto outputs = hailort::VStreamsBuilder::create_output_vstreams(
+        *network_group_, vstream_params.second);
+    if (!outputs) {
+      throw Error(status_message("Failed to create output vstreams",
+                                 outputs.status()));
+    }
+
+    return std::make_unique<HailoStreamPipeline>(network_group_,
+                                                 std::move(inputs.value()),
+                                                 std::move(outputs.value()));
+  }
+
+private:
+  using VStreamParams = std::map<std::string, hailo_vstream_params_t>;
+
+  std::pair<VStreamParams, VStreamParams>
+  make_vstream_params(const PipelineParams &params) {
+    auto input_params = network_group_->make_input_vstream_params(
+        {}, to_hailo(params.input_format_type), params.timeout_ms,
+        params.queue_size);
+    if (!input_params) {
+      throw Error(status_message("Failed to create input vstream params",
+                                 input_params.status()));
+    }
+
+    auto output_params = network_group_->make_output_vstream_params(
+        {}, to_hailo(params.output_format_type), params.timeout_ms,
+        params.queue_size);
+    if (!output_params) {
+      throw Error(status_message("Failed to create output vstream params",
+                                 output_params.status()));
+    }
+
+    for (const auto &entry : params.output_format_types) {
+      auto it = output_params->find(entry.first);
+      if (it == output_params->end()) {
+        throw Error("Unknown output vstream: " + entry.first);
+      }
+      it->second.user_buffer_format.type = to_hailo(entry.second);
+    }
+
+    return {std::move(input_params.value()), std::move(output_params.value())};
+  }
+
+  // Keep a reference to the vdevice so it outlives the network group
+  std::shared_ptr<hailort::VDevice> vdevice_;
+  std::shared_ptr<hailort::ConfiguredNetworkGroup> network_group_;
+  uint16_t batch_size_;
+  std::shared_ptr<SchedulerStatsRecorder> stats_;
+  std::shared_ptr<WaitEstimator> wait_estimator_;
+};
+
+FileCache<hailort::Hef> &hef_cache() {
+  static FileCache<hailort::Hef> cache;
+  return cache;
+}
+
+// Parses a HEF straight from its mapping, once per distinct file content
+std::shared_ptr<hailort::Hef> load_hef(const std::string &hef_path) {
+  return hef_cache().get(hef_path, [](const MappedFile &file) {
+    auto hef = hailort::Hef::create(hailort::MemoryView(
+        const_cast<uint8_t *>(file.data()), file.size()));
+    if (!hef) {
+      throw Error(status_message("Failed to load HEF file", hef.status()));
+    }
+    return std::make_shared<hailort::Hef>(std::move(hef.value()));
+  });
+}
+
+class HailoDevice : public Device {
+public:
+  explicit HailoDevice(std::shared_ptr<hailort::VDevice> vdevice)
+      : vdevice_(std::move(vdevice)) {}
+
+  std::shared_ptr<NetworkGroup>
+  configure(const std::string &hef_path,
+            const NetworkGroupParams &params) override {
+    auto hef = load_hef(hef_path);
+
+    auto configure_params = vdevice_->create_configure_params(*hef);
+    if (!configure_params) {
+      throw Error(status_message("Failed to create configure params",
+                                 configure_params.status()));
+    }
+
+    // Apply the batch size to the network group and each of its networks
+    for (auto &entry : configure_params.value()) {
+      auto &ng_params = entry.second;
+      ng_params.batch_size = params.batch_size;
+      for (size_t i = 0; i < ng_params.network_params_by_name_count; i++) {
+        ng_params.network_params_by_name[i].network_params.batch_size =
+            params.batch_size;
+      }
+    }
+
+    auto network_groups =
+        vdevice_->configure(*hef, configure_params.value());
+    if (!network_groups) {
+      throw Error(status_message("Failed to configure network groups",
+                                 network_groups.status()));
+    }
+
+    if (network_groups->size() != 1) {
+      throw Error("Invalid number of network groups: " +
+                  std::to_string(network_groups->size()));
+    }
+
+    auto &network_group = network_groups->at(0);
+    check_scheduler(network_group->set_scheduler_priority(
+                        params.scheduler_priority),
+                    "priority");
+    if (params.scheduler_threshold > 0) {
+      check_scheduler(network_group->set_scheduler_threshold(
+                          params.scheduler_threshold),
+                      "threshold");
+    }
+    if (params.scheduler_timeout_ms > 0) {
+      check_scheduler(network_group->set_scheduler_timeout(
+                          std::chrono::milliseconds(
+                              params.scheduler_timeout_ms)),
+                      "timeout");
+    }
+
+    return std::make_shared<HailoNetworkGroup>(
+        vdevice_, std::move(network_group), params.batch_size);
+  }
+
+private:
+  static void check_scheduler(hailo_status status, const std::string &what) {
+    if (status != HAILO_SUCCESS) {
+      throw Error(status_message("Failed to set scheduler " + what, status));
+    }
+  }
+
+  std::shared_ptr<hailort::VDevice> vdevice_;
+};
+
+} // namespace
+
+std::shared_ptr<Device> create_hailort_device(const DeviceParams &params) {
+  hailo_vdevice_params_t vdevice_params;
+  hailo_status status = hailo_init_vdevice_params(&vdevice_params);
+  if (status != HAILO_SUCCESS) {
+    throw Error(status_message("Failed to init virtual device params", status));
+  }
+  vdevice_params.scheduling_algorithm = HAILO_SCHEDULING_ALGORITHM_ROUND_ROBIN;
+
+  std::vector<hailo_device_id_t> device_ids;
+  for (const auto &id : params.device_ids) {
+    auto device_id = hailort::HailoRTCommon::to_device_id(id);
+    if (!device_id) {
+      throw Error(status_message("Invalid device ID " + id, device_id.status()));
+    }
+    device_ids.push_back(device_id.value());
+  }
+  if (!device_ids.empty()) {
+    vdevice_params.device_ids = device_ids.data();
+    vdevice_params.device_count = static_cast<uint32_t>(device_ids.size());
+  } else if (params.device_count > 0) {
+    vdevice_params.device_count = params.device_count;
+  }
+
+  auto vdevice = hailort::VDevice::create(vdevice_params);
+  if (!vdevice) {
+    throw Error(
+        status_message("Failed to create virtual device", vdevice.status()));
+  }
+  return std::make_shared<HailoDevice>(std::move(vdevice.value()));
+}
+
+FileCacheStats hef_cache_stats() { return hef_cache().stats(); }
+
+std::vector<std::string> scan_hailort_devices() {
+  auto device_ids = hailort::Device::scan();
+  if (!device_ids) {
+    throw Error(status_message("Failed to scan devices", device_ids.status()));
+  }
+  return device_ids.value();
+}
+
+} // namespace nx_hailo
+
+#else
+
+namespace nx_hailo {
+
+std::shared_ptr<Device> create_hailort_device(const DeviceParams &params) {
+  throw Error("NxHailo was built without HailoRT support");
+}
+
+std::vector<std::string> scan_hailort_devices() {
+  throw Error("NxHailo was built without HailoRT support");
+}
+
+FileCacheStats hef_cache_stats() { return FileCacheStats(); }
+
+} // namespace nx_hailo
+
+#endif
@@ -0,0 +1,242 @@
+#include "jpeg.hpp"
+#include "backend.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#ifndef NX_HAILO_WITHOUT_LIBJPEG
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+// jpeglib.h relies on size_t and FILE being declared first
+#include <jpeglib.h>
+#endif
+
+namespace nx_hailo {
+
+uint32_t jpeg_scale_denominator(uint32_t width, uint32_t height,
+                                uint32_t target_width,
+                                uint32_t target_height) {
+  auto geometry =
+      letterbox_geometry(width, height, target_width, target_height);
+  double content_width = width * geometry.scale;
+  double content_height = height * geometry.scale;
+
+  for (uint32_t denominator : {8u, 4u, 2u}) {
+    // libjpeg rounds scaled sizes up
+    uint32_t scaled_width = (width + denominator - 1) / denominator;
+    uint32_t scaled_height = (height + denominator - 1) / denominator;
+    if (scaled_width >= content_width && scaled_height >= content_height) {
+      return denominator;
+    }
+  }
+  return 1;
+}
+
+#ifndef NX_HAILO_WITHOUT_LIBJPEG
+
+namespace {
+
+// libjpeg reports errors through a callback that must not return. It jumps
+// back into decode() instead of exiting the process.
+struct ErrorManager {
+  jpeg_error_mgr base;
+  jmp_buf jump;
+  char message[JMSG_LENGTH_MAX];
+};
+
+void error_exit(j_common_ptr info) {
+  auto *manager = reinterpret_cast<ErrorManager *>(info->err);
+  info->err->format_message(info, manager->message);
+  longjmp(manager->jump, 1);
+}
+
+// Warnings on recoverable corruption, such as truncated scans, are ignored
+// as they would be by image viewers
+void output_message(j_common_ptr info) {}
+
+// Decodes `data` at 1/denominator of the size fitting the target into
+// `pixels`. Kept free of C++ objects with destructors between setjmp and
+// longjmp. Returns false with `message` set on failure.
+bool decode(const uint8_t *data, size_t size, uint32_t target_width,
+            uint32_t target_height, std::vector<uint8_t> &pixels,
+            JpegLetterbox &result, char *message) {
+  jpeg_decompress_struct info;
+  ErrorManager errors;
+  info.err = jpeg_std_error(&errors.base);
+  errors.base.error_exit = error_exit;
+  errors.base.output_message = output_message;
+
+  if (setjmp(errors.jump)) {
+    std::copy(errors.message, errors.message + JMSG_LENGTH_MAX, message);
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+
+  jpeg_create_decompress(&info);
+  jpeg_mem_src(&info, const_cast<unsigned char *>(data), size);
+  jpeg_read_header(&info, TRUE);
+
+  if (info.jpeg_color_space != JCS_GRAYSCALE &&
+      info.jpeg_color_space != JCS_YCbCr && info.jpeg_color_space != JCS_RGB) {
+    std::snprintf(message, JMSG_LENGTH_MAX,
+                  "Unsupported JPEG color space %d, only grayscale and RGB "
+                  "images are supported",
+                  static_cast<int>(info.jpeg_color_space));
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+
+  result.scale_denominator = jpeg_scale_denominator(
+      info.image_width, info.image_height, target_width, target_height);
+  info.scale_num = 1;
+  info.scale_denom = result.scale_denominator;
+  info.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&info);
+
+  result.letterbox.width = info.image_width;
+  result.letterbox.height = info.image_height;
+  result.decoded_width = info.output_width;
+  result.decoded_height = info.output_height;
+
+  size_t stride = static_cast<size_t>(info.output_width) * 3;
+  pixels.resize(stride * info.output_height);
+  while (info.output_scanline < info.output_height) {
+    JSAMPROW row = pixels.data() + stride * info.output_scanline;
+    jpeg_read_scanlines(&info, &row, 1);
+  }
+
+  jpeg_finish_decompress(&info);
+  jpeg_destroy_decompress(&info);
+  return true;
+}
+
+// Compresses the rows of `pixels` into a buffer allocated by libjpeg,
+// returned through `data` and `size` even on failure. Same setjmp rules
+// as decode(). BGR rows are swapped into `row_buffer` first.
+bool encode(const uint8_t *pixels, uint32_t width, uint32_t height,
+            size_t stride, bool bgr, int quality, uint8_t *row_buffer,
+            unsigned char **data, unsigned long *size, char *message) {
+  jpeg_compress_struct info;
+  ErrorManager errors;
+  info.err = jpeg_std_error(&errors.base);
+  errors.base.error_exit = error_exit;
+  errors.base.output_message = output_message;
+
+  if (setjmp(errors.jump)) {
+    std::copy(errors.message, errors.message + JMSG_LENGTH_MAX, message);
+    jpeg_destroy_compress(&info);
+    return false;
+  }
+
+  jpeg_create_compress(&info);
+  jpeg_mem_dest(&info, data, size);
+  info.image_width = width;
+  info.image_height = height;
+  info.input_components = 3;
+  info.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&info);
+  jpeg_set_quality(&info, quality, TRUE);
+  jpeg_start_compress(&info, TRUE);
+
+  while (info.next_scanline < height) {
+    const uint8_t *source = pixels + stride * info.next_scanline;
+    if (bgr) {
+      for (uint32_t x = 0; x < width * 3; x += 3) {
+        row_buffer[x] = source[x + 2];
+        row_buffer[x + 1] = source[x + 1];
+        row_buffer[x + 2] = source[x];
+      }
+      source = row_buffer;
+    }
+    JSAMPROW row = const_cast<JSAMPROW>(source);
+    jpeg_write_scanlines(&info, &row, 1);
+  }
+
+  jpeg_finish_compress(&info);
+  jpeg_destroy_compress(&info);
+  return true;
+}
+
+} // namespace
+
+JpegLetterbox decode_jpeg_letterbox(const uint8_t *data, size_t size,
+                                    uint8_t *out, uint32_t target_width,
+                                    uint32_t target_height,
+                                    uint8_t pad_value) {
+  if (size == 0) {
+    throw Error("JPEG data must not be empty");
+  }
+
+  // Reused across calls on the same scheduler thread
+  static thread_local std::vector<uint8_t> pixels;
+  JpegLetterbox result;
+  char message[JMSG_LENGTH_MAX] = {0};
+  if (!decode(data, size, target_width, target_height, pixels, result,
+              message)) {
+    throw Error(std::string("Failed to decode JPEG: ") + message);
+  }
+
+  Frame decoded{pixels.data(),
+                pixels.size(),
+                result.decoded_width,
+                result.decoded_height,
+                static_cast<size_t>(result.decoded_width) * 3,
+                PixelFormat::Rgb};
+  auto geometry = letterbox(decoded, out, target_width, target_height,
+                            pad_value);
+
+  // Decoded pixel x covers source pixels [x * d, (x + 1) * d), so the
+  // placement carries over with the scale divided by d
+  result.letterbox.target_width = target_width;
+  result.letterbox.target_height = target_height;
+  result.letterbox.scale = geometry.scale / result.scale_denominator;
+  result.letterbox.pad_x = geometry.pad_x;
+  result.letterbox.pad_y = geometry.pad_y;
+  return result;
+}
+
+void encode_jpeg(const uint8_t *pixels, uint32_t width, uint32_t height,
+                 size_t stride, bool bgr, int quality,
+                 std::vector<uint8_t> &out) {
+  if (width == 0 || height == 0) {
+    throw Error("Cannot encode an empty image");
+  }
+  if (quality < 1 || quality > 100) {
+    throw Error("JPEG quality must be between 1 and 100");
+  }
+
+  static thread_local std::vector<uint8_t> row_buffer;
+  row_buffer.resize(static_cast<size_t>(width) * 3);
+  unsigned char *data = nullptr;
+  unsigned long size = 0;
+  char message[JMSG_LENGTH_MAX] = {0};
+  bool ok = encode(pixels, width, height, stride, bgr, quality,
+                   row_buffer.data(), &data, &size, message);
+  if (ok) {
+    out.assign(data, data + size);
+  }
+  std::free(data);
+  if (!ok) {
+    throw Error(std::string("Failed to encode JPEG: ") + message);
+  }
+}
+
+#else
+
+void encode_jpeg(const uint8_t *pixels, uint32_t width, uint32_t height,
+                 size_t stride, bool bgr, int quality,
+                 std::vector<uint8_t> &out) {
+  throw Error("JPEG encoding is not available in this build");
+}
+
+JpegLetterbox decode_jpeg_letterbox(const uint8_t *data, size_t size,
+                                    uint8_t *out, uint32_t target_width,
+                                    uint32_t target_height,
+                                    uint8_t pad_value) {
+  throw Error("JPEG decoding is not available in this build");
+}
+
+#endif
+
+} // namespace nx_hailo
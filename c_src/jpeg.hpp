@@ -0,0 +1,46 @@
+#pragma once
+
+#include "preprocess.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nx_hailo {
+
+// Result of decode_jpeg_letterbox. `letterbox` maps the target back to the
+// full-resolution image: its width, height and scale are those of the JPEG,
+// not of the downscaled decode.
+struct JpegLetterbox {
+  LetterboxGeometry letterbox;
+  // The image was decoded at 1/scale_denominator of its size
+  uint32_t scale_denominator;
+  uint32_t decoded_width;
+  uint32_t decoded_height;
+};
+
+// Largest DCT scaling denominator (1, 2, 4 or 8) at which a `width` x
+// `height` image still covers its letterboxed size in the target, so the
+// letterbox only ever downscales
+uint32_t jpeg_scale_denominator(uint32_t width, uint32_t height,
+                                uint32_t target_width, uint32_t target_height);
+
+// Decodes a baseline or progressive JPEG into a letterboxed RGB uint8 NHWC
+// image of `target_width` x `target_height`, written to `out`. Large images
+// are downscaled in the DCT domain while decoding, see
+// jpeg_scale_denominator, so the full-resolution image is never
+// materialized. Grayscale images are expanded to RGB. Throws
+// nx_hailo::Error on corrupt data and unsupported color spaces.
+JpegLetterbox decode_jpeg_letterbox(const uint8_t *data, size_t size,
+                                    uint8_t *out, uint32_t target_width,
+                                    uint32_t target_height,
+                                    uint8_t pad_value = 114);
+
+// Encodes a packed RGB image of 3 bytes per pixel, or BGR when `bgr` is
+// set, as a baseline JPEG of the given quality (1 to 100) into `out`.
+// Throws nx_hailo::Error.
+void encode_jpeg(const uint8_t *pixels, uint32_t width, uint32_t height,
+                 size_t stride, bool bgr, int quality,
+                 std::vector<uint8_t> &out);
+
+} // namespace nx_hailo
@@ -0,0 +1,95 @@
+#include "latency_histogram.hpp"
+
+#include <vector>
+
+namespace nx_hailo {
+
+namespace {
+
+unsigned highest_bit(uint64_t value) { return 63 - __builtin_clzll(value); }
+
+// Upper bound of the bucket holding the `rank`-th smallest value
+uint64_t value_at_rank(const std::vector<uint64_t> &counts, uint64_t rank) {
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts.size(); i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return LatencyHistogram::bucket_upper_bound(i);
+    }
+  }
+  return LatencyHistogram::bucket_upper_bound(counts.size() - 1);
+}
+
+} // namespace
+
+size_t LatencyHistogram::bucket_index(uint64_t value_ns) {
+  constexpr uint64_t sub_bucket_count = 1ull << kSubBucketBits;
+  if (value_ns < sub_bucket_count) {
+    return value_ns;
+  }
+  if (value_ns >> kMaxValueBits) {
+    return kBucketCount - 1;
+  }
+  unsigned shift = highest_bit(value_ns) - kSubBucketBits;
+  return ((shift + 1) << kSubBucketBits) |
+         ((value_ns >> shift) & (sub_bucket_count - 1));
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index) {
+  constexpr uint64_t sub_bucket_count = 1ull << kSubBucketBits;
+  if (index < sub_bucket_count) {
+    return index;
+  }
+  unsigned shift = (index >> kSubBucketBits) - 1;
+  uint64_t sub_bucket = index & (sub_bucket_count - 1);
+  return ((sub_bucket_count + sub_bucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value_ns) {
+  counts_[bucket_index(value_ns)].fetch_add(1, std::memory_order_relaxed);
+  total_ns_.fetch_add(value_ns, std::memory_order_relaxed);
+
+  uint64_t min = min_ns_.load(std::memory_order_relaxed);
+  while (value_ns < min && !min_ns_.compare_exchange_weak(
+                               min, value_ns, std::memory_order_relaxed)) {
+  }
+  uint64_t max = max_ns_.load(std::memory_order_relaxed);
+  while (value_ns > max && !max_ns_.compare_exchange_weak(
+                               max, value_ns, std::memory_order_relaxed)) {
+  }
+}
+
+LatencySummary LatencyHistogram::summary() const {
+  // Percentiles are computed from one copy of the counts, so that they agree
+  // with each other while recording goes on
+  std::vector<uint64_t> counts(kBucketCount);
+  uint64_t count = 0;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    counts[i] = counts_[i].load(std::memory_order_relaxed);
+    count += counts[i];
+  }
+
+  LatencySummary summary = {};
+  summary.count = count;
+  if (count == 0) {
+    return summary;
+  }
+
+  summary.total_ns = total_ns_.load(std::memory_order_relaxed);
+  summary.min_ns = min_ns_.load(std::memory_order_relaxed);
+  summary.max_ns = max_ns_.load(std::memory_order_relaxed);
+
+  // Ranks are rounded up, so that e.g. p99 of 10 values is the largest one
+  auto at = [&](uint64_t per_mille) {
+    uint64_t rank = (count * per_mille + 999) / 1000;
+    uint64_t value = value_at_rank(counts, rank);
+    return value < summary.max_ns ? value : summary.max_ns;
+  };
+  summary.p50_ns = at(500);
+  summary.p90_ns = at(900);
+  summary.p99_ns = at(990);
+  summary.p999_ns = at(999);
+  return summary;
+}
+
+} // namespace nx_hailo
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace nx_hailo {
+
+struct LatencySummary {
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  uint64_t p50_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t p999_ns;
+};
+
+// Log-linear histogram of durations in nanoseconds, in the spirit of
+// HdrHistogram.
+//
+// Values below 32 ns get a bucket each, and every power of two above that is
+// split into 32 buckets, so percentiles are within about 3% of the recorded
+// values. Durations beyond 2^40 ns (about 18 minutes) land in the last
+// bucket. Recording is a few relaxed atomic operations and never blocks, so
+// any thread can record while another one reads a summary, which is then
+// only approximately consistent.
+class LatencyHistogram {
+public:
+  static constexpr unsigned kSubBucketBits = 5;
+  static constexpr unsigned kMaxValueBits = 40;
+  static constexpr size_t kBucketCount = (kMaxValueBits - kSubBucketBits + 1)
+                                         << kSubBucketBits;
+
+  LatencyHistogram() = default;
+
+  LatencyHistogram(const LatencyHistogram &) = delete;
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+  void record(uint64_t value_ns);
+
+  LatencySummary summary() const;
+
+  // Bucket `value_ns` is counted in, and the largest value of a bucket,
+  // which is what percentiles report
+  static size_t bucket_index(uint64_t value_ns);
+  static uint64_t bucket_upper_bound(size_t index);
+
+private:
+  std::array<std::atomic<uint64_t>, kBucketCount> counts_{};
+  std::atomic<uint64_t> total_ns_{0};
+  std::atomic<uint64_t> min_ns_{UINT64_MAX};
+  std::atomic<uint64_t> max_ns_{0};
+};
+
+} // namespace nx_hailo
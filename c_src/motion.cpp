@@ -0,0 +1,165 @@
+#include "motion.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+
+namespace nx_hailo {
+
+namespace {
+
+// Regions are squares of this many blocks. Scoring regions rather than the
+// whole frame keeps a small moving object from being averaged away, and a
+// row of a region is a single 16-byte SAD.
+constexpr uint32_t kRegionBlocks = 16;
+
+// BT.601 luma in 8-bit fixed point. Luma is linear, so this also turns
+// the channel sums of a block into its luma sum.
+inline uint64_t luma(uint64_t r, uint64_t g, uint64_t b) {
+  return (77 * r + 150 * g + 29 * b) >> 8;
+}
+
+// Adds the channels of packed 3-byte pixels [x0, x1) of a row to `sums`
+void add_channels(const uint8_t *row, uint32_t x0, uint32_t x1,
+                  uint32_t *sums) {
+  uint32_t s0 = 0, s1 = 0, s2 = 0;
+  for (const uint8_t *p = row + 3 * x0, *end = row + 3 * x1; p < end;
+       p += 3) {
+    s0 += p[0];
+    s1 += p[1];
+    s2 += p[2];
+  }
+  sums[0] += s0;
+  sums[1] += s1;
+  sums[2] += s2;
+}
+
+// Adds every `step`-th byte of a row, from pixel x0 to x1, to `sum`
+void add_luma(const uint8_t *row, uint32_t x0, uint32_t x1, size_t step,
+              uint32_t *sum) {
+  uint32_t s = 0;
+  for (uint32_t x = x0; x < x1; x++) {
+    s += row[step * x];
+  }
+  *sum += s;
+}
+
+} // namespace
+
+MotionGate::MotionGate(const MotionGateParams &params) : params_(params) {}
+
+void MotionGate::reset() {
+  has_reference_ = false;
+  unchanged_run_ = 0;
+}
+
+MotionDecision MotionGate::update(const Frame &frame) {
+  check_frame(frame);
+
+  bool same_layout = has_reference_ && frame.width == width_ &&
+                     frame.height == height_ && frame.format == format_;
+  if (!same_layout) {
+    const uint32_t block = params_.block_size;
+    width_ = frame.width;
+    height_ = frame.height;
+    format_ = frame.format;
+    grid_width_ = (width_ + block - 1) / block;
+    grid_height_ = (height_ + block - 1) / block;
+    size_t cells = static_cast<size_t>(grid_width_) * grid_height_;
+    reference_.resize(cells);
+    current_.resize(cells);
+    sums_.resize(3 * static_cast<size_t>(grid_width_));
+  }
+  downsample(frame);
+  stats_.frames++;
+
+  MotionDecision decision;
+  if (!same_layout) {
+    last_score_ = -1;
+    decision = MotionDecision::Changed;
+  } else {
+    last_score_ = score();
+    if (last_score_ >= params_.threshold) {
+      decision = MotionDecision::Changed;
+    } else if (params_.refresh_interval > 0 &&
+               unchanged_run_ >= params_.refresh_interval) {
+      decision = MotionDecision::Refresh;
+    } else {
+      decision = MotionDecision::Unchanged;
+    }
+  }
+
+  switch (decision) {
+  case MotionDecision::Unchanged:
+    unchanged_run_++;
+    stats_.skipped++;
+    return decision;
+  case MotionDecision::Changed:
+    stats_.changed++;
+    break;
+  case MotionDecision::Refresh:
+    stats_.refreshed++;
+    break;
+  }
+  reference_.swap(current_);
+  has_reference_ = true;
+  unchanged_run_ = 0;
+  return decision;
+}
+
+void MotionGate::downsample(const Frame &frame) {
+  const uint32_t block = params_.block_size;
+  const bool packed_rgb = frame.format == PixelFormat::Rgb ||
+                          frame.format == PixelFormat::Bgr;
+  const size_t luma_step = frame.format == PixelFormat::Yuyv ? 2 : 1;
+  for (uint32_t gy = 0; gy < grid_height_; gy++) {
+    std::fill(sums_.begin(), sums_.end(), 0);
+    uint32_t y0 = gy * block;
+    uint32_t y1 = std::min(y0 + block, height_);
+    for (uint32_t y = y0; y < y1; y++) {
+      const uint8_t *row = frame.data + y * frame.stride;
+      for (uint32_t gx = 0; gx < grid_width_; gx++) {
+        uint32_t x0 = gx * block;
+        uint32_t x1 = std::min(x0 + block, width_);
+        if (packed_rgb) {
+          add_channels(row, x0, x1, &sums_[3 * gx]);
+        } else {
+          add_luma(row, x0, x1, luma_step, &sums_[3 * gx]);
+        }
+      }
+    }
+
+    uint8_t *cells = current_.data() + static_cast<size_t>(gy) * grid_width_;
+    for (uint32_t gx = 0; gx < grid_width_; gx++) {
+      uint32_t x0 = gx * block;
+      uint64_t count = (std::min(x0 + block, width_) - x0) * (y1 - y0);
+      const uint32_t *block_sums = &sums_[3 * gx];
+      uint64_t sum = block_sums[0];
+      if (frame.format == PixelFormat::Rgb) {
+        sum = luma(block_sums[0], block_sums[1], block_sums[2]);
+      } else if (frame.format == PixelFormat::Bgr) {
+        sum = luma(block_sums[2], block_sums[1], block_sums[0]);
+      }
+      cells[gx] = static_cast<uint8_t>((sum + count / 2) / count);
+    }
+  }
+}
+
+double MotionGate::score() const {
+  double best = 0;
+  for (uint32_t ry = 0; ry < grid_height_; ry += kRegionBlocks) {
+    uint32_t rows = std::min(kRegionBlocks, grid_height_ - ry);
+    for (uint32_t rx = 0; rx < grid_width_; rx += kRegionBlocks) {
+      uint32_t cols = std::min(kRegionBlocks, grid_width_ - rx);
+      uint64_t sad = 0;
+      for (uint32_t y = ry; y < ry + rows; y++) {
+        size_t offset = static_cast<size_t>(y) * grid_width_ + rx;
+        sad += simd::sad_u8(current_.data() + offset,
+                            reference_.data() + offset, cols);
+      }
+      best = std::max(best, static_cast<double>(sad) / (rows * cols));
+    }
+  }
+  return best;
+}
+
+} // namespace nx_hailo
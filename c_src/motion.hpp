@@ -0,0 +1,84 @@
+#pragma once
+
+#include "preprocess.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nx_hailo {
+
+struct MotionGateParams {
+  // Frames are compared as luma planes averaged over blocks of
+  // `block_size` x `block_size` pixels, which also averages out sensor noise
+  uint32_t block_size = 8;
+  // A frame has changed when the mean absolute difference of the blocks of
+  // any region of 16 x 16 blocks reaches this, in luma levels (0-255)
+  double threshold = 2.0;
+  // After this many unchanged frames in a row the next one is a refresh,
+  // 0 for never
+  uint32_t refresh_interval = 30;
+};
+
+enum class MotionDecision {
+  // The frame differs from the reference, which it replaces
+  Changed,
+  // The frame is unchanged but is due a refresh, and replaces the reference
+  Refresh,
+  // The frame is close enough to the reference to reuse its results
+  Unchanged
+};
+
+struct MotionGateStats {
+  uint64_t frames = 0;
+  uint64_t changed = 0;
+  uint64_t refreshed = 0;
+  uint64_t skipped = 0;
+};
+
+// Change detector for a fixed camera. Each frame is compared against the
+// reference, the last frame that was not skipped, so slow drift adds up
+// until it triggers a change. Frames of a new size or format always count
+// as changed. Not thread-safe.
+class MotionGate {
+public:
+  explicit MotionGate(const MotionGateParams &params);
+
+  // Compares `frame` against the reference. Throws nx_hailo::Error for
+  // frames that do not fit their buffer.
+  MotionDecision update(const Frame &frame);
+
+  // Drops the reference, so that the next frame counts as changed
+  void reset();
+
+  // Score of the last frame, the largest mean absolute difference of a
+  // region, or -1 when it had no reference to compare against
+  double last_score() const { return last_score_; }
+  const MotionGateStats &stats() const { return stats_; }
+
+private:
+  // Averages the luma of `frame` over blocks into `current_`
+  void downsample(const Frame &frame);
+  // Scores `current_` against `reference_`
+  double score() const;
+
+  MotionGateParams params_;
+  // Layout of the reference frame
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  PixelFormat format_ = PixelFormat::Rgb;
+  bool has_reference_ = false;
+  // Size of the block grid
+  uint32_t grid_width_ = 0;
+  uint32_t grid_height_ = 0;
+  std::vector<uint8_t> reference_;
+  std::vector<uint8_t> current_;
+  // Channel sums of a row of blocks, 3 per block, of which planar formats
+  // only use the first
+  std::vector<uint32_t> sums_;
+  uint32_t unchanged_run_ = 0;
+  double last_score_ = -1;
+  MotionGateStats stats_;
+};
+
+} // namespace nx_hailo
@@ -1,28 +1,295 @@
-#include "hailo/hailort.hpp"
+#include "backend.hpp"
+#include "buffer_pool.hpp"
+#include "detections.hpp"
+#include "frame_source.hpp"
+#include "jpeg.hpp"
+#include "latency_histogram.hpp"
+#include "motion.hpp"
+#include "overlay.hpp"
+#include "preprocess.hpp"
+#include "quantization.hpp"
+#include "tracker.hpp"
+#include "worker.hpp"
+#include "yolo_head.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <fine.hpp>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 // Resource type for VDevice
 struct VDeviceResource {
-  std::shared_ptr<hailort::VDevice> vdevice;
+  std::shared_ptr<nx_hailo::Device> vdevice;
 };
 
 // Resource type for ConfiguredNetworkGroup
 struct NetworkGroupResource {
-  std::shared_ptr<hailort::ConfiguredNetworkGroup> network_group;
-  std::shared_ptr<hailort::VDevice>
+  std::shared_ptr<nx_hailo::NetworkGroup> network_group;
+  std::shared_ptr<nx_hailo::Device>
       vdevice; // Keep a reference to vdevice to ensure it lives as long as the
                // network group
 };
 
+// Stages of an inference request, in the order they run
+enum InferStage {
+  // Waiting for the worker thread and for other requests on the pipeline
+  kInferStageWait,
+  // Collecting the input map into device-ready buffers, letterboxing included
+  kInferStageDecode,
+  // Taking the output buffers from their pools
+  kInferStageAcquire,
+  // Running the frames through the device
+  kInferStageDevice,
+  // Encoding the outputs as terms
+  kInferStageEncode,
+  kInferStageCount
+};
+
+const char *const kInferStageNames[kInferStageCount] = {
+    "wait", "decode", "acquire", "device", "encode"};
+
+// Durations of the stages of one request, measured as laps from the time
+// the request reached the NIF
+class InferTimings {
+public:
+  explicit InferTimings(std::chrono::steady_clock::time_point start =
+                            std::chrono::steady_clock::now())
+      : start_(start), last_(start) {}
+
+  // Ends `stage` now, it started where the previous one ended
+  void lap(InferStage stage) {
+    auto now = std::chrono::steady_clock::now();
+    stage_ns_[stage] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           now - last_)
+                           .count();
+    last_ = now;
+  }
+
+  uint64_t stage_ns(size_t stage) const { return stage_ns_[stage]; }
+
+  uint64_t total_ns() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(last_ -
+                                                                start_)
+        .count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_;
+  uint64_t stage_ns_[kInferStageCount] = {};
+};
+
+// Counters and per-stage latency histograms of a pipeline. Every field is
+// updated with relaxed atomics, so recording costs a few dozen nanoseconds
+// per request and stays enabled.
+struct InferPipelineStats {
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> errors{0};
+  // Requests turned away before reaching the device because their deadline
+  // had passed (expired) or was too close to make (dropped), and requests
+  // that completed after their deadline (late)
+  std::atomic<uint64_t> expired{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> late{0};
+  // Moving average of the decode, acquire and device time of recent
+  // requests, which is what a request still has ahead of it once its turn
+  // comes. 0 until a request completed.
+  std::atomic<uint64_t> service_ns{0};
+  nx_hailo::LatencyHistogram stages[kInferStageCount];
+  nx_hailo::LatencyHistogram total;
+
+  // Failed requests are only counted, their partial timings would skew the
+  // histograms
+  void record(const InferTimings &timings, size_t frames_count, bool ok) {
+    requests.fetch_add(1, std::memory_order_relaxed);
+    if (!ok) {
+      errors.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    frames.fetch_add(frames_count, std::memory_order_relaxed);
+    for (size_t stage = 0; stage < kInferStageCount; stage++) {
+      stages[stage].record(timings.stage_ns(stage));
+    }
+    total.record(timings.total_ns());
+
+    // Requests of a pipeline run one at a time, so a plain read-modify-write
+    // is enough
+    int64_t service = timings.stage_ns(kInferStageDecode) +
+                      timings.stage_ns(kInferStageAcquire) +
+                      timings.stage_ns(kInferStageDevice);
+    int64_t average = service_ns.load(std::memory_order_relaxed);
+    average = average == 0 ? service : average + (service - average) / 8;
+    service_ns.store(average, std::memory_order_relaxed);
+  }
+
+  // Decides, right before a request is decoded and sent to the device,
+  // whether it can still complete by `deadline`. Requests that cannot are
+  // counted and not run at all.
+  bool admit(std::chrono::steady_clock::time_point deadline) {
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+      return true;
+    }
+    auto now = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> *counter = nullptr;
+    if (now >= deadline) {
+      counter = &expired;
+    } else if (now + std::chrono::nanoseconds(service_ns.load(
+                         std::memory_order_relaxed)) >
+               deadline) {
+      counter = &dropped;
+    } else {
+      return true;
+    }
+    requests.fetch_add(1, std::memory_order_relaxed);
+    counter->fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  void record_completion(std::chrono::steady_clock::time_point deadline) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      late.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+};
+
 // Resource type for InferVStreams
 struct InferPipelineResource {
-  std::shared_ptr<hailort::InferVStreams> pipeline;
-  std::shared_ptr<hailort::ConfiguredNetworkGroup>
+  std::shared_ptr<nx_hailo::Pipeline> pipeline;
+  std::shared_ptr<nx_hailo::NetworkGroup>
       network_group; // Keep a reference to network_group
+  // Serializes infer calls coming from dirty schedulers and the worker
+  std::mutex infer_mutex;
+  // Views into the current request's input binaries, reused across calls.
+  // Guarded by infer_mutex.
+  std::vector<nx_hailo::ConstBuffer> input_buffers;
+  std::vector<nx_hailo::MutableBuffer> output_buffers;
+  // Contiguous copies of batched input frames and natively letterboxed
+  // inputs, one per input vstream. Guarded by infer_mutex.
+  std::vector<std::vector<uint8_t>> input_staging;
+  // One pool per output vstream, in the order of the pipeline's output infos.
+  // Each buffer holds `frames_per_buffer` frames, so that a batch of up to
+  // the configured batch size fits in a single pooled buffer.
+  std::vector<std::shared_ptr<nx_hailo::BufferPool>> output_pools;
+  size_t frames_per_buffer = 1;
+  InferPipelineStats stats;
+  // Time requests submitted without a timeout of their own have to
+  // complete, the vstream timeout of the pipeline
+  uint32_t timeout_ms = 0;
+  // Runs infer_async requests. Declared last so that it is joined before the
+  // vstreams it uses are released.
+  std::unique_ptr<nx_hailo::Worker> worker;
+};
+
+// Resource type for a FrameSource
+struct FrameSourceResource {
+  std::unique_ptr<nx_hailo::FrameSource> source;
+};
+
+// Resource holding a frame read from a FrameSource. Like
+// OutputBufferResource it backs the binaries handed to Elixir, and releasing
+// it gives a V4L2 buffer back to the driver.
+struct FrameLeaseResource {
+  std::shared_ptr<const nx_hailo::SourceFrame> frame;
+};
+
+// Resource type for a Tracker, updated from any scheduler
+struct TrackerResource {
+  std::mutex mutex;
+  nx_hailo::Tracker tracker;
+  // Aligned copy of the packed detections of the current update. Guarded by
+  // mutex.
+  std::vector<nx_hailo::Detection> detections;
+
+  explicit TrackerResource(const nx_hailo::TrackerParams &params)
+      : tracker(params) {}
+};
+
+// Resource type for a MotionGate, together with a copy of the result of the
+// last frame that was not skipped, handed back for skipped frames
+struct MotionGateResource {
+  std::mutex mutex;
+  nx_hailo::MotionGate gate;
+  // Owns the stored result. Both guarded by mutex, result is 0 until one
+  // is stored.
+  ErlNifEnv *env;
+  ERL_NIF_TERM result = 0;
+
+  explicit MotionGateResource(const nx_hailo::MotionGateParams &params)
+      : gate(params), env(enif_alloc_env()) {}
+
+  ~MotionGateResource() { enif_free_env(env); }
+};
+
+// Resource owning a pooled output buffer. The binaries handed to Elixir
+// point into it, and the buffer goes back to its pool once they are all
+// garbage collected. Buffers too large for the pool have no pool and are
+// freed instead.
+struct OutputBufferResource {
+  std::shared_ptr<nx_hailo::BufferPool> pool;
+  uint8_t *data = nullptr;
+
+  ~OutputBufferResource() {
+    if (data && pool) {
+      pool->release(data);
+    } else {
+      delete[] data;
+    }
+  }
+};
+
+// A request submitted to a stream pipeline. Owns the env holding its inputs
+// and reply ref until the result is sent.
+struct StreamRequest {
+  ErlNifPid caller;
+  ErlNifEnv *env;
+  ERL_NIF_TERM inputs;
+  ERL_NIF_TERM ref;
+  // Set when the request could not be written. The reader replies with it
+  // in turn instead of reading outputs, so replies stay in order.
+  std::string error;
+};
+
+// Resource type for a streaming pipeline over the individual vstreams. A
+// writer thread feeds submitted requests to the input vstreams and a reader
+// thread collects the outputs and replies, with up to `depth` requests
+// written but not yet read. Outputs are paired with requests by order, so
+// once a vstream read or write fails the pipeline is aborted and every
+// later request fails too.
+struct StreamPipelineResource {
+  std::shared_ptr<nx_hailo::StreamPipeline> stream;
+  std::shared_ptr<nx_hailo::NetworkGroup> network_group;
+  std::vector<std::shared_ptr<nx_hailo::BufferPool>> output_pools;
+  size_t depth = 1;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  // Waiting for the writer, then written and waiting for the reader.
+  // Guarded by mutex.
+  std::deque<StreamRequest> submitted;
+  std::deque<StreamRequest> in_flight;
+  bool stopping = false;
+  // The first vstream failure, empty while the vstreams are in step
+  std::string failure;
+
+  // Only touched by the writer thread
+  std::vector<std::vector<uint8_t>> input_staging;
+  std::vector<nx_hailo::ConstBuffer> input_buffers;
+
+  std::thread writer;
+  std::thread reader;
+
+  ~StreamPipelineResource();
 };
 
 // Destructor for VDeviceResource
@@ -52,6 +319,12 @@ void infer_pipeline_resource_dtor(ErlNifEnv *env, void *obj) {
 FINE_RESOURCE(VDeviceResource);
 FINE_RESOURCE(NetworkGroupResource);
 FINE_RESOURCE(InferPipelineResource);
+FINE_RESOURCE(OutputBufferResource);
+FINE_RESOURCE(StreamPipelineResource);
+FINE_RESOURCE(FrameSourceResource);
+FINE_RESOURCE(FrameLeaseResource);
+FINE_RESOURCE(TrackerResource);
+FINE_RESOURCE(MotionGateResource);
 
 fine::Term fine_error_string(ErlNifEnv *env, const std::string &message) {
   std::tuple<fine::Atom, std::string> tagged_result(fine::Atom("error"),
@@ -64,134 +337,334 @@ template <typename T> fine::Term fine_ok(ErlNifEnv *env, T value) {
   return fine::encode(env, tagged_result);
 }
 
-// Helper function to convert hailo_format_type_t to Elixir atom
-fine::Atom format_type_to_atom(hailo_format_type_t type) {
+// Helper function to convert a format type to Elixir atom
+fine::Atom format_type_to_atom(nx_hailo::FormatType type) {
   switch (type) {
-  case HAILO_FORMAT_TYPE_AUTO:
+  case nx_hailo::FormatType::Auto:
     return fine::Atom("auto");
-  case HAILO_FORMAT_TYPE_UINT8:
+  case nx_hailo::FormatType::Uint8:
     return fine::Atom("uint8");
-  case HAILO_FORMAT_TYPE_UINT16:
+  case nx_hailo::FormatType::Uint16:
     return fine::Atom("uint16");
-  case HAILO_FORMAT_TYPE_FLOAT32:
+  case nx_hailo::FormatType::Float32:
     return fine::Atom("float32");
   default:
     return fine::Atom("unknown_type");
   }
 }
 
-// Helper function to convert hailo_format_order_t to Elixir atom
-fine::Atom format_order_to_atom(hailo_format_order_t order) {
+// Helper function to convert a format order to Elixir atom
+fine::Atom format_order_to_atom(nx_hailo::FormatOrder order) {
   switch (order) {
-  case HAILO_FORMAT_ORDER_AUTO:
+  case nx_hailo::FormatOrder::Auto:
     return fine::Atom("auto");
-  case HAILO_FORMAT_ORDER_NHWC:
+  case nx_hailo::FormatOrder::Nhwc:
     return fine::Atom("nhwc");
-  case HAILO_FORMAT_ORDER_NHCW:
+  case nx_hailo::FormatOrder::Nhcw:
     return fine::Atom("nhcw");
-  case HAILO_FORMAT_ORDER_NCHW:
+  case nx_hailo::FormatOrder::Nchw:
     return fine::Atom("nchw");
-  // case HAILO_FORMAT_ORDER_NCWH: return fine::Atom("ncwh"); // This was
-  // causing a compile error
-  case HAILO_FORMAT_ORDER_FCR:
+  case nx_hailo::FormatOrder::Fcr:
     return fine::Atom("fcr");
-  case HAILO_FORMAT_ORDER_HAILO_NMS:
+  case nx_hailo::FormatOrder::HailoNms:
     return fine::Atom("hailo_nms");
-  case HAILO_FORMAT_ORDER_HAILO_NMS_WITH_BYTE_MASK:
+  case nx_hailo::FormatOrder::HailoNmsWithByteMask:
     return fine::Atom("hailo_nms_with_byte_mask");
-  case HAILO_FORMAT_ORDER_HAILO_NMS_BY_CLASS:
+  case nx_hailo::FormatOrder::HailoNmsByClass:
     return fine::Atom("hailo_nms_by_class");
   default:
     return fine::Atom("unknown_order");
   }
 }
 
-// Helper function to convert hailo_format_flags_t to Elixir atom
-fine::Atom format_flags_to_atom(hailo_format_flags_t flags) {
-  if (flags == HAILO_FORMAT_FLAGS_NONE)
+// Helper function to convert format flags to Elixir atom
+fine::Atom format_flags_to_atom(nx_hailo::FormatFlags flags) {
+  switch (flags) {
+  case nx_hailo::FormatFlags::None:
     return fine::Atom("none");
-  if (flags == HAILO_FORMAT_FLAGS_TRANSPOSED)
+  case nx_hailo::FormatFlags::Transposed:
     return fine::Atom("transposed");
-  return fine::Atom(
-      "unknown_flags"); // Default if no specific known flag matches
+  default:
+    return fine::Atom("unknown_flags");
+  }
 }
 
-// NIF function to create a VDevice
-fine::Term create_vdevice(ErlNifEnv *env) {
-  auto vdevice_expected = hailort::VDevice::create();
-  if (!vdevice_expected) {
-    return fine_error_string(env,
-                             "Failed to create virtual device: " +
-                                 std::to_string(vdevice_expected.status()));
+// Reverse of the *_to_atom helpers above, for options coming from Elixir
+template <typename Enum, size_t N>
+Enum atom_to_enum(ErlNifEnv *env, ERL_NIF_TERM term, const Enum (&values)[N],
+                  fine::Atom (*to_atom)(Enum), const std::string &what) {
+  auto name = fine::decode<fine::Atom>(env, term).to_string();
+  for (auto value : values) {
+    if (to_atom(value).to_string() == name) {
+      return value;
+    }
+  }
+  throw nx_hailo::Error("Invalid " + what + ": " + name);
+}
+
+// Looks up an atom key in an Elixir map. Missing keys and nil values are
+// both reported as absent.
+bool get_map_value(ErlNifEnv *env, ERL_NIF_TERM map, const char *key,
+                   ERL_NIF_TERM *value) {
+  return enif_get_map_value(env, map, enif_make_atom(env, key), value) &&
+         !enif_is_identical(*value, enif_make_atom(env, "nil"));
+}
+
+template <typename T>
+T get_map_field(ErlNifEnv *env, ERL_NIF_TERM map, const char *key,
+                T default_value) {
+  ERL_NIF_TERM value;
+  if (!get_map_value(env, map, key, &value)) {
+    return default_value;
+  }
+  return fine::decode<T>(env, value);
+}
+
+// Like get_map_field, for the uint32_t fields of the backend params.
+// Throws nx_hailo::Error rather than wrapping values that do not fit.
+uint32_t get_uint32_field(ErlNifEnv *env, ERL_NIF_TERM map, const char *key,
+                          uint32_t default_value) {
+  uint64_t value = get_map_field<uint64_t>(env, map, key, default_value);
+  if (value > UINT32_MAX) {
+    throw nx_hailo::Error(std::string("Invalid ") + key + ": " +
+                          std::to_string(value));
+  }
+  return static_cast<uint32_t>(value);
+}
+
+// The HailoRT VDevice behind create_vdevice and load_network_group. A
+// physical device backs a single VDevice per process, and network groups
+// configured on the same VDevice share it through the model scheduler, so
+// the device is created once and kept while anything references it.
+std::shared_ptr<nx_hailo::Device> shared_hailort_device() {
+  static std::mutex mutex;
+  static std::weak_ptr<nx_hailo::Device> device;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto shared = device.lock();
+  if (!shared) {
+    shared = nx_hailo::create_hailort_device();
+    device = shared;
+  }
+  return shared;
+}
+
+// NIF function to create a VDevice. Without `device_ids` or `device_count`
+// options this is the shared device, otherwise a new VDevice over exactly
+// those physical devices, e.g. one per device for load balancing.
+fine::Term create_vdevice(ErlNifEnv *env, fine::Term opts_term) {
+  nx_hailo::DeviceParams params;
+  try {
+    params.device_ids = get_map_field<std::vector<std::string>>(
+        env, opts_term, "device_ids", {});
+    params.device_count =
+        get_map_field<uint64_t>(env, opts_term, "device_count", 0);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid VDevice options");
+  }
+
+  std::shared_ptr<nx_hailo::Device> vdevice;
+  try {
+    if (params.device_ids.empty() && params.device_count == 0) {
+      vdevice = shared_hailort_device();
+    } else {
+      vdevice = nx_hailo::create_hailort_device(params);
+    }
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
   }
-  auto vdevice = std::move(vdevice_expected.value());
 
   auto resource = fine::make_resource<VDeviceResource>();
   resource->vdevice = std::move(vdevice);
   return fine_ok(env, resource);
 }
 
-// NIF function to load a network group from a HEF file
-fine::Term load_network_group(ErlNifEnv *env, fine::Term hef_path_term) {
-  // Get HEF file path from the input term
-  std::string hef_path;
+// NIF function to list the IDs of the Hailo devices on the system
+fine::Term scan_devices(ErlNifEnv *env) {
   try {
-    hef_path = fine::decode<std::string>(env, hef_path_term);
-  } catch (const std::exception &e) {
-    return fine_error_string(env, "Invalid HEF file path");
+    return fine_ok(env, nx_hailo::scan_hailort_devices());
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
   }
+}
 
-  // Create a virtual device
-  auto vdevice_expected = hailort::VDevice::create();
-  if (!vdevice_expected) {
-    return fine_error_string(env,
-                             "Failed to create virtual device: " +
-                                 std::to_string(vdevice_expected.status()));
+nx_hailo::FormatType decode_format_type(ErlNifEnv *env, ERL_NIF_TERM term) {
+  static const nx_hailo::FormatType format_types[] = {
+      nx_hailo::FormatType::Auto, nx_hailo::FormatType::Uint8,
+      nx_hailo::FormatType::Uint16, nx_hailo::FormatType::Float32};
+  return atom_to_enum(env, term, format_types, format_type_to_atom,
+                      "format type");
+}
+
+// Decodes a vstream description in the same shape that
+// build_detailed_vstream_info_map produces
+nx_hailo::VStreamInfo decode_vstream_info(ErlNifEnv *env, ERL_NIF_TERM map) {
+  static const nx_hailo::FormatOrder format_orders[] = {
+      nx_hailo::FormatOrder::Auto,     nx_hailo::FormatOrder::Nhwc,
+      nx_hailo::FormatOrder::Nhcw,     nx_hailo::FormatOrder::Nchw,
+      nx_hailo::FormatOrder::Fcr,      nx_hailo::FormatOrder::HailoNms,
+      nx_hailo::FormatOrder::HailoNmsByClass};
+
+  nx_hailo::VStreamInfo info;
+  info.name = get_map_field<std::string>(env, map, "name", "");
+  if (info.name.empty()) {
+    throw nx_hailo::Error("Simulated vstream is missing a name");
+  }
+  info.network_name =
+      get_map_field<std::string>(env, map, "network_name", info.name);
+
+  ERL_NIF_TERM format, value;
+  if (get_map_value(env, map, "format", &format)) {
+    if (get_map_value(env, format, "type", &value)) {
+      info.format_type = decode_format_type(env, value);
+    }
+    if (get_map_value(env, format, "order", &value)) {
+      info.format_order = atom_to_enum(env, value, format_orders,
+                                       format_order_to_atom, "format order");
+    }
   }
-  auto vdevice = std::move(vdevice_expected.value());
 
-  // Load the HEF file
-  auto hef = hailort::Hef::create(hef_path);
-  if (!hef) {
-    return fine_error_string(env, "Failed to load HEF file: " +
-                                      std::to_string(hef.status()));
+  ERL_NIF_TERM shape;
+  if (get_map_value(env, map, "shape", &shape)) {
+    info.height = get_map_field<uint64_t>(env, shape, "height", 0);
+    info.width = get_map_field<uint64_t>(env, shape, "width", 0);
+    info.features = get_map_field<uint64_t>(env, shape, "features", 0);
   }
 
-  // Create configure params
-  auto configure_params = vdevice->create_configure_params(hef.value());
-  if (!configure_params) {
-    return fine_error_string(env,
-                             "Failed to create configure params: " +
-                                 std::to_string(configure_params.status()));
+  ERL_NIF_TERM nms_shape;
+  if (get_map_value(env, map, "nms_shape", &nms_shape)) {
+    if (!info.is_nms()) {
+      info.format_order = nx_hailo::FormatOrder::HailoNms;
+    }
+    info.number_of_classes =
+        get_map_field<uint64_t>(env, nms_shape, "number_of_classes", 0);
+    info.max_bboxes = get_map_field<uint64_t>(
+        env, nms_shape, "max_bboxes_per_class_or_total", 0);
+  }
+
+  ERL_NIF_TERM quant_info;
+  if (get_map_value(env, map, "quant_info", &quant_info)) {
+    info.qp_zp = get_map_field<double>(env, quant_info, "qp_zp", 0.0);
+    info.qp_scale = get_map_field<double>(env, quant_info, "qp_scale", 0.0);
+  }
+
+  return info;
+}
+
+std::vector<nx_hailo::VStreamInfo>
+decode_vstream_infos(ErlNifEnv *env, ERL_NIF_TERM map, const char *key) {
+  std::vector<nx_hailo::VStreamInfo> infos;
+  ERL_NIF_TERM list;
+  if (get_map_value(env, map, key, &list)) {
+    for (auto item : fine::decode<std::vector<fine::Term>>(env, list)) {
+      infos.push_back(decode_vstream_info(env, item));
+    }
+  }
+  return infos;
+}
+
+// NIF function to create a simulated VDevice.
+//
+// The config map describes the vstreams exposed by the network groups
+// configured on the device, by default and per HEF file name under
+// `networks`, plus the latency model used for each transfer.
+fine::Term create_simulated_vdevice(ErlNifEnv *env, fine::Term config_term) {
+  std::shared_ptr<nx_hailo::Device> vdevice;
+  try {
+    nx_hailo::SimulatorConfig config;
+    config.inputs = decode_vstream_infos(env, config_term, "input_vstreams");
+    config.outputs = decode_vstream_infos(env, config_term, "output_vstreams");
+    ERL_NIF_TERM networks;
+    if (get_map_value(env, config_term, "networks", &networks)) {
+      for (auto [name, network] :
+           fine::decode<std::map<std::string, fine::Term>>(env, networks)) {
+        config.networks[name] = {
+            decode_vstream_infos(env, network, "input_vstreams"),
+            decode_vstream_infos(env, network, "output_vstreams")};
+      }
+    }
+    config.latency_us =
+        get_map_field<uint64_t>(env, config_term, "latency_us", 0);
+    config.per_frame_latency_us =
+        get_map_field<uint64_t>(env, config_term, "per_frame_latency_us", 0);
+    config.jitter_us = get_map_field<uint64_t>(env, config_term, "jitter_us", 0);
+    config.estimate_wait =
+        get_map_field<bool>(env, config_term, "estimate_wait", false);
+    config.seed = get_map_field<uint64_t>(env, config_term, "seed", 0);
+    config.detections_per_frame = get_map_field<uint64_t>(
+        env, config_term, "detections_per_frame", config.detections_per_frame);
+
+    vdevice = nx_hailo::create_simulated_device(std::move(config));
+  } catch (const std::exception &e) {
+    return fine_error_string(env, std::string("Invalid simulator config: ") +
+                                      e.what());
   }
 
-  // Configure the network groups
-  auto network_groups =
-      vdevice->configure(hef.value(), configure_params.value());
-  if (!network_groups) {
-    return fine_error_string(env, "Failed to configure network groups: " +
-                                      std::to_string(network_groups.status()));
+  auto resource = fine::make_resource<VDeviceResource>();
+  resource->vdevice = std::move(vdevice);
+  return fine_ok(env, resource);
+}
+
+// NIF function to load a network group from a HEF file
+fine::Term load_network_group(ErlNifEnv *env, fine::Term hef_path_term) {
+  // Get HEF file path from the input term
+  std::string hef_path;
+  try {
+    hef_path = fine::decode<std::string>(env, hef_path_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid HEF file path");
   }
 
-  // Check that we have exactly one network group
-  if (network_groups->size() != 1) {
-    return fine_error_string(env, "Invalid number of network groups: " +
-                                      std::to_string(network_groups->size()));
+  // Configure the HEF's network group on the shared virtual device
+  std::shared_ptr<nx_hailo::Device> vdevice;
+  std::shared_ptr<nx_hailo::NetworkGroup> network_group;
+  try {
+    vdevice = shared_hailort_device();
+    network_group =
+        vdevice->configure(hef_path, nx_hailo::NetworkGroupParams());
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
   }
 
   // Create a new resource for the NetworkGroup
   auto resource = fine::make_resource<NetworkGroupResource>();
-  resource->network_group = std::move(network_groups->at(0));
+  resource->network_group = std::move(network_group);
   resource->vdevice = std::move(vdevice);
 
   // Return the resource term
   return fine_ok(env, resource);
 }
 
+// Decodes the `batch_size` and model scheduler options of a network group
+nx_hailo::NetworkGroupParams decode_network_group_params(ErlNifEnv *env,
+                                                         ERL_NIF_TERM opts) {
+  nx_hailo::NetworkGroupParams params;
+  uint64_t batch_size =
+      get_map_field<uint64_t>(env, opts, "batch_size", params.batch_size);
+  if (batch_size > UINT16_MAX) {
+    throw nx_hailo::Error("Invalid batch size: " + std::to_string(batch_size));
+  }
+  params.batch_size = static_cast<uint16_t>(batch_size);
+
+  uint64_t priority = get_map_field<uint64_t>(env, opts, "scheduler_priority",
+                                              params.scheduler_priority);
+  if (priority > nx_hailo::kMaxSchedulerPriority) {
+    throw nx_hailo::Error("Invalid scheduler priority: " +
+                          std::to_string(priority));
+  }
+  params.scheduler_priority = static_cast<uint8_t>(priority);
+  params.scheduler_threshold = get_uint32_field(
+      env, opts, "scheduler_threshold", params.scheduler_threshold);
+  params.scheduler_timeout_ms = get_uint32_field(
+      env, opts, "scheduler_timeout_ms", params.scheduler_timeout_ms);
+  return params;
+}
+
 // NIF function to configure a network group using an existing VDevice
 fine::Term configure_network_group(ErlNifEnv *env,
                                    fine::Term vdevice_resource_term,
-                                   fine::Term hef_path_term) {
+                                   fine::Term hef_path_term,
+                                   fine::Term opts_term) {
   fine::ResourcePtr<VDeviceResource> vdevice_res;
   try {
     vdevice_res = fine::decode<fine::ResourcePtr<VDeviceResource>>(
@@ -207,41 +680,31 @@ fine::Term configure_network_group(ErlNifEnv *env,
     return fine_error_string(env, "Invalid HEF file path");
   }
 
-  auto hef = hailort::Hef::create(hef_path);
-  if (!hef) {
-    return fine_error_string(env, "Failed to load HEF file: " +
-                                      std::to_string(hef.status()));
-  }
-
-  auto configure_params =
-      vdevice_res->vdevice->create_configure_params(hef.value());
-  if (!configure_params) {
-    return fine_error_string(env,
-                             "Failed to create configure params: " +
-                                 std::to_string(configure_params.status()));
-  }
-
-  auto network_groups =
-      vdevice_res->vdevice->configure(hef.value(), configure_params.value());
-  if (!network_groups) {
-    return fine_error_string(env, "Failed to configure network groups: " +
-                                      std::to_string(network_groups.status()));
+  nx_hailo::NetworkGroupParams params;
+  try {
+    params = decode_network_group_params(env, opts_term);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid network group options");
   }
 
-  if (network_groups->size() != 1) {
-    return fine_error_string(env, "Invalid number of network groups: " +
-                                      std::to_string(network_groups->size()));
+  std::shared_ptr<nx_hailo::NetworkGroup> network_group;
+  try {
+    network_group = vdevice_res->vdevice->configure(hef_path, params);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
   }
 
   auto resource = fine::make_resource<NetworkGroupResource>();
-  resource->network_group = std::move(network_groups->at(0));
+  resource->network_group = std::move(network_group);
   resource->vdevice = vdevice_res->vdevice; // Share the vdevice
   return fine_ok(env, resource);
 }
 
-// NIF function to create an inference pipeline from a network group
-fine::Term create_pipeline(ErlNifEnv *env, fine::Term network_group_term) {
-  // Get the network group resource from the input term
+// NIF function to report how long the transfers of a network group waited
+// for the shared device
+fine::Term get_scheduler_stats(ErlNifEnv *env, fine::Term network_group_term) {
   fine::ResourcePtr<NetworkGroupResource> ng_res;
   try {
     ng_res = fine::decode<fine::ResourcePtr<NetworkGroupResource>>(
@@ -250,59 +713,117 @@ fine::Term create_pipeline(ErlNifEnv *env, fine::Term network_group_term) {
     return fine_error_string(env, "Invalid network group resource");
   }
 
-  // Create input and output vstream params with default settings
-  auto input_params = ng_res->network_group->make_input_vstream_params(
-      {}, HAILO_FORMAT_TYPE_AUTO, HAILO_DEFAULT_VSTREAM_TIMEOUT_MS,
-      HAILO_DEFAULT_VSTREAM_QUEUE_SIZE);
-  if (!input_params) {
-    return fine_error_string(env, "Failed to create input vstream params: " +
-                                      std::to_string(input_params.status()));
+  auto stats = ng_res->network_group->scheduler_stats();
+  ERL_NIF_TERM stats_map = enif_make_new_map(env);
+  std::pair<const char *, uint64_t> fields[] = {
+      {"transfers", stats.transfers},
+      {"frames", stats.frames},
+      {"total_wait_us", stats.total_wait_us},
+      {"max_wait_us", stats.max_wait_us}};
+  for (const auto &field : fields) {
+    enif_make_map_put(env, stats_map, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &stats_map);
+  }
+  return fine_ok(env, fine::Term(stats_map));
+}
+
+// Decodes the vstream options shared by both kinds of pipelines:
+// `input_format_type` and `output_format_type` set the host element type of
+// every input/output, `output_format_types` overrides it per output name
+// (e.g. uint8 to skip dequantization on the host), and `timeout_ms` and
+// `queue_size` configure the vstreams themselves
+void decode_pipeline_params(ErlNifEnv *env, ERL_NIF_TERM opts,
+                            nx_hailo::PipelineParams &params) {
+  ERL_NIF_TERM value;
+  if (get_map_value(env, opts, "input_format_type", &value)) {
+    params.input_format_type = decode_format_type(env, value);
+  }
+  if (get_map_value(env, opts, "output_format_type", &value)) {
+    params.output_format_type = decode_format_type(env, value);
+  }
+  if (get_map_value(env, opts, "output_format_types", &value)) {
+    for (auto [name, type] : fine::decode<std::map<std::string, fine::Term>>(
+             env, value)) {
+      params.output_format_types[name] = decode_format_type(env, type);
+    }
   }
+  params.timeout_ms =
+      get_uint32_field(env, opts, "timeout_ms", params.timeout_ms);
+  params.queue_size =
+      get_uint32_field(env, opts, "queue_size", params.queue_size);
+}
 
-  auto output_params = ng_res->network_group->make_output_vstream_params(
-      {}, HAILO_FORMAT_TYPE_AUTO, HAILO_DEFAULT_VSTREAM_TIMEOUT_MS,
-      HAILO_DEFAULT_VSTREAM_QUEUE_SIZE);
-  if (!output_params) {
-    return fine_error_string(env, "Failed to create output vstream params: " +
-                                      std::to_string(output_params.status()));
+// Creates an inference pipeline resource with `output_pool_size` idle
+// output buffers kept per output vstream. Throws nx_hailo::Error.
+fine::ResourcePtr<InferPipelineResource>
+make_infer_pipeline(std::shared_ptr<nx_hailo::NetworkGroup> network_group,
+                    const nx_hailo::PipelineParams &params,
+                    size_t output_pool_size) {
+  auto resource = fine::make_resource<InferPipelineResource>();
+  resource->pipeline = network_group->create_pipeline(params);
+  resource->frames_per_buffer = std::max<size_t>(1, network_group->batch_size());
+  resource->timeout_ms = params.timeout_ms;
+  resource->network_group = std::move(network_group);
+  for (const auto &info : resource->pipeline->output_infos()) {
+    resource->output_pools.push_back(std::make_shared<nx_hailo::BufferPool>(
+        info.frame_size * resource->frames_per_buffer, output_pool_size));
   }
+  resource->input_buffers.reserve(resource->pipeline->input_infos().size());
+  resource->input_staging.resize(resource->pipeline->input_infos().size());
+  resource->output_buffers.reserve(resource->output_pools.size());
+  resource->worker = std::make_unique<nx_hailo::Worker>();
+  return resource;
+}
 
-  // Create the inference pipeline
-  auto pipeline = hailort::InferVStreams::create(
-      *ng_res->network_group, input_params.value(), output_params.value());
-  if (!pipeline) {
-    return fine_error_string(env, "Failed to create inference pipeline: " +
-                                      std::to_string(pipeline.status()));
+// NIF function to create an inference pipeline from a network group
+fine::Term create_pipeline(ErlNifEnv *env, fine::Term network_group_term,
+                           fine::Term opts_term) {
+  // Get the network group resource from the input term
+  fine::ResourcePtr<NetworkGroupResource> ng_res;
+  try {
+    ng_res = fine::decode<fine::ResourcePtr<NetworkGroupResource>>(
+        env, network_group_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid network group resource");
   }
 
-  // Create a new resource for the InferPipeline
-  auto resource = fine::make_resource<InferPipelineResource>();
-  resource->pipeline =
-      std::make_shared<hailort::InferVStreams>(std::move(pipeline.value()));
-  resource->network_group = ng_res->network_group;
+  // Idle output buffers kept per output vstream
+  uint64_t output_pool_size;
+  nx_hailo::PipelineParams params;
+  try {
+    output_pool_size =
+        get_map_field<uint64_t>(env, opts_term, "output_pool_size", 4);
+    decode_pipeline_params(env, opts_term, params);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid pipeline options");
+  }
 
-  // Return the resource term
-  return fine_ok(env, resource);
+  try {
+    return fine_ok(env, make_infer_pipeline(ng_res->network_group, params,
+                                            output_pool_size));
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
 }
 
-// NEW Helper function to construct the detailed Erlang map for vstream info
+// Helper function to construct the detailed Erlang map for vstream info
 ERL_NIF_TERM
 build_detailed_vstream_info_map(ErlNifEnv *env,
-                                const hailo_vstream_info_t &vstream_info) {
+                                const nx_hailo::VStreamInfo &vstream_info) {
   ERL_NIF_TERM map_term = enif_make_new_map(env);
-  uint32_t calculated_frame_size = 0;
 
   // name
   enif_make_map_put(env, map_term, fine::encode(env, fine::Atom("name")),
-                    fine::encode(env, std::string(vstream_info.name)),
-                    &map_term);
+                    fine::encode(env, vstream_info.name), &map_term);
   // network_name
-  enif_make_map_put(
-      env, map_term, fine::encode(env, fine::Atom("network_name")),
-      fine::encode(env, std::string(vstream_info.network_name)), &map_term);
+  enif_make_map_put(env, map_term,
+                    fine::encode(env, fine::Atom("network_name")),
+                    fine::encode(env, vstream_info.network_name), &map_term);
   // direction
   ERL_NIF_TERM direction_atom_term =
-      (vstream_info.direction == HAILO_D2H_STREAM)
+      (vstream_info.direction == nx_hailo::Direction::D2H)
           ? fine::encode(env, fine::Atom("d2h"))
           : fine::encode(env, fine::Atom("h2d"));
   enif_make_map_put(env, map_term, fine::encode(env, fine::Atom("direction")),
@@ -310,141 +831,78 @@ build_detailed_vstream_info_map(ErlNifEnv *env,
 
   // Format map
   ERL_NIF_TERM format_map_erl = enif_make_new_map(env);
-  hailo_format_order_t actual_format_order = vstream_info.format.order;
   enif_make_map_put(
       env, format_map_erl, fine::encode(env, fine::Atom("type")),
-      fine::encode(env, format_type_to_atom(vstream_info.format.type)),
+      fine::encode(env, format_type_to_atom(vstream_info.format_type)),
       &format_map_erl);
   enif_make_map_put(
       env, format_map_erl, fine::encode(env, fine::Atom("order")),
-      fine::encode(env, format_order_to_atom(actual_format_order)),
+      fine::encode(env, format_order_to_atom(vstream_info.format_order)),
       &format_map_erl);
   enif_make_map_put(
       env, format_map_erl, fine::encode(env, fine::Atom("flags")),
-      fine::encode(env, format_flags_to_atom(vstream_info.format.flags)),
+      fine::encode(env, format_flags_to_atom(vstream_info.format_flags)),
       &format_map_erl);
   enif_make_map_put(env, map_term, fine::encode(env, fine::Atom("format")),
                     format_map_erl, &map_term);
 
-  bool is_nms =
-      (actual_format_order == HAILO_FORMAT_ORDER_HAILO_NMS ||
-       actual_format_order == HAILO_FORMAT_ORDER_HAILO_NMS_WITH_BYTE_MASK ||
-       actual_format_order == HAILO_FORMAT_ORDER_HAILO_NMS_BY_CLASS);
-  // The placeholder '20' is removed. We rely on the actual enum
-  // HAILO_FORMAT_ORDER_HAILO_NMS_BY_CLASS. Ensure this enum is correctly
-  // defined and valued in your HailoRT headers.
-
-  if (is_nms) {
+  if (vstream_info.is_nms()) {
     ERL_NIF_TERM nms_shape_map_erl = enif_make_new_map(env);
     enif_make_map_put(
         env, nms_shape_map_erl,
         fine::encode(env, fine::Atom("number_of_classes")),
-        fine::encode(env, static_cast<uint64_t>(
-                              vstream_info.nms_shape.number_of_classes)),
+        fine::encode(env,
+                     static_cast<uint64_t>(vstream_info.number_of_classes)),
         &nms_shape_map_erl);
 
-    // Use the union members based on nms_shape.order_type
-    // Exposing both might be simplest if Elixir side can pick
+    // Per class, or the total when the results are ordered by score
     enif_make_map_put(
         env, nms_shape_map_erl,
         fine::encode(env, fine::Atom("max_bboxes_per_class_or_total")),
-        (vstream_info.nms_shape.order_type == HAILO_NMS_RESULT_ORDER_BY_SCORE)
-            ? fine::encode(env, static_cast<uint64_t>(
-                                    vstream_info.nms_shape.max_bboxes_total))
-            : fine::encode(env,
-                           static_cast<uint64_t>(
-                               vstream_info.nms_shape.max_bboxes_per_class)),
+        fine::encode(env, static_cast<uint64_t>(vstream_info.max_bboxes)),
         &nms_shape_map_erl);
-    // Also expose order_type itself
-    // You'll need an atom helper for hailo_nms_result_order_type_t
-    // ERL_NIF_TERM nms_order_type_atom = nms_result_order_type_to_atom(env,
-    // vstream_info.nms_shape.order_type); enif_make_map_put(env,
-    // nms_shape_map_erl, fine::encode(env, fine::Atom("nms_result_order")),
-    // nms_order_type_atom, &nms_shape_map_erl);
 
     enif_make_map_put(env, map_term, fine::encode(env, fine::Atom("nms_shape")),
                       nms_shape_map_erl, &map_term);
     enif_make_map_put(env, map_term, fine::encode(env, fine::Atom("shape")),
                       fine::encode(env, fine::Atom("nil")), &map_term);
-
-    // Calculate frame_size for NMS stream
-    uint32_t num_detections_for_size_calc = 0;
-    if (vstream_info.nms_shape.order_type == HAILO_NMS_RESULT_ORDER_BY_CLASS ||
-        vstream_info.nms_shape.order_type == HAILO_NMS_RESULT_ORDER_HW) {
-      num_detections_for_size_calc =
-          vstream_info.nms_shape.number_of_classes *
-          vstream_info.nms_shape.max_bboxes_per_class;
-    } else if (vstream_info.nms_shape.order_type ==
-               HAILO_NMS_RESULT_ORDER_BY_SCORE) {
-      num_detections_for_size_calc = vstream_info.nms_shape.max_bboxes_total;
-    } else {
-      // Default or error: if nms_shape.order_type is unknown, use
-      // max_bboxes_per_class as a common case.
-      num_detections_for_size_calc =
-          vstream_info.nms_shape.number_of_classes *
-          vstream_info.nms_shape.max_bboxes_per_class;
-    }
-
-    // This structure (6 floats: ymin, xmin, ymax, xmax, confidence, class_id)
-    // is common for YOLO NMS outputs. Verify this against your specific model's
-    // NMS configuration.
-    uint32_t elements_per_detection = 6;
-
-    if (vstream_info.format.type == HAILO_FORMAT_TYPE_FLOAT32) {
-      calculated_frame_size =
-          num_detections_for_size_calc * elements_per_detection * sizeof(float);
-    } else if (vstream_info.format.type ==
-               HAILO_FORMAT_TYPE_UINT8) { // Example if NMS output could be
-                                          // uint8
-      calculated_frame_size = num_detections_for_size_calc *
-                              elements_per_detection * sizeof(uint8_t);
-    } else {
-      // Fallback for other types or if type is HAILO_FORMAT_TYPE_AUTO and not
-      // resolved
-      calculated_frame_size = 0;
-    }
-
   } else { // Not NMS
     ERL_NIF_TERM shape_map_erl = enif_make_new_map(env);
     enif_make_map_put(
         env, shape_map_erl, fine::encode(env, fine::Atom("height")),
-        fine::encode(env, static_cast<uint64_t>(vstream_info.shape.height)),
+        fine::encode(env, static_cast<uint64_t>(vstream_info.height)),
         &shape_map_erl);
     enif_make_map_put(
         env, shape_map_erl, fine::encode(env, fine::Atom("width")),
-        fine::encode(env, static_cast<uint64_t>(vstream_info.shape.width)),
+        fine::encode(env, static_cast<uint64_t>(vstream_info.width)),
         &shape_map_erl);
     enif_make_map_put(
         env, shape_map_erl, fine::encode(env, fine::Atom("features")),
-        fine::encode(env, static_cast<uint64_t>(vstream_info.shape.features)),
+        fine::encode(env, static_cast<uint64_t>(vstream_info.features)),
         &shape_map_erl);
     enif_make_map_put(env, map_term, fine::encode(env, fine::Atom("shape")),
                       shape_map_erl, &map_term);
     enif_make_map_put(env, map_term, fine::encode(env, fine::Atom("nms_shape")),
                       fine::encode(env, fine::Atom("nil")), &map_term);
-
-    calculated_frame_size = hailort::HailoRTCommon::get_frame_size(
-        vstream_info.shape, vstream_info.format);
   }
 
-  // frame_size
+  // frame_size, as reported by the backend for the host buffer
   enif_make_map_put(
       env, map_term, fine::encode(env, fine::Atom("frame_size")),
-      fine::encode(env, static_cast<uint64_t>(calculated_frame_size)),
+      fine::encode(env, static_cast<uint64_t>(vstream_info.frame_size)),
       &map_term);
 
   // Optional quant_info map
   ERL_NIF_TERM quant_info_map_erl = enif_make_new_map(env);
   enif_make_map_put(
       env, quant_info_map_erl, fine::encode(env, fine::Atom("qp_zp")),
-      fine::encode(env, static_cast<double>(vstream_info.quant_info.qp_zp)),
+      fine::encode(env, static_cast<double>(vstream_info.qp_zp)),
       &quant_info_map_erl);
   enif_make_map_put(
       env, quant_info_map_erl, fine::encode(env, fine::Atom("qp_scale")),
-      fine::encode(env, static_cast<double>(vstream_info.quant_info.qp_scale)),
+      fine::encode(env, static_cast<double>(vstream_info.qp_scale)),
       &quant_info_map_erl);
-  if (vstream_info.quant_info.qp_zp != 0.0f ||
-      vstream_info.quant_info.qp_scale != 0.0f) {
+  if (vstream_info.qp_zp != 0.0f || vstream_info.qp_scale != 0.0f) {
     enif_make_map_put(env, map_term,
                       fine::encode(env, fine::Atom("quant_info")),
                       quant_info_map_erl, &map_term);
@@ -457,6 +915,17 @@ build_detailed_vstream_info_map(ErlNifEnv *env,
   return map_term;
 }
 
+ERL_NIF_TERM
+build_vstream_info_list(ErlNifEnv *env,
+                        const std::vector<nx_hailo::VStreamInfo> &infos) {
+  std::vector<ERL_NIF_TERM> map_terms_vector;
+  for (const auto &info : infos) {
+    map_terms_vector.push_back(build_detailed_vstream_info_map(env, info));
+  }
+  return enif_make_list_from_array(env, map_terms_vector.data(),
+                                   map_terms_vector.size());
+}
+
 // NIF function to get information about input vstreams from a NetworkGroup
 fine::Term get_input_vstream_infos_from_ng(ErlNifEnv *env,
                                            fine::Term network_group_term) {
@@ -469,21 +938,12 @@ fine::Term get_input_vstream_infos_from_ng(ErlNifEnv *env,
         env, "Invalid network group resource for getting input vstream infos");
   }
 
-  auto vstream_infos_expected =
-      ng_res->network_group->get_input_vstream_infos();
-  if (!vstream_infos_expected) {
-    return fine_error_string(
-        env, "Failed to get input vstream infos from network group: " +
-                 std::to_string(vstream_infos_expected.status()));
-  }
-
-  std::vector<ERL_NIF_TERM> map_terms_vector;
-  for (const auto &info : vstream_infos_expected.value()) {
-    map_terms_vector.push_back(build_detailed_vstream_info_map(env, info));
+  try {
+    auto infos = ng_res->network_group->input_infos();
+    return fine_ok(env, fine::Term(build_vstream_info_list(env, infos)));
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
   }
-  ERL_NIF_TERM list_of_maps_term = enif_make_list_from_array(
-      env, map_terms_vector.data(), map_terms_vector.size());
-  return fine_ok(env, fine::Term(list_of_maps_term));
 }
 
 // NIF function to get information about output vstreams from a NetworkGroup
@@ -498,21 +958,12 @@ fine::Term get_output_vstream_infos_from_ng(ErlNifEnv *env,
         env, "Invalid network group resource for getting output vstream infos");
   }
 
-  auto vstream_infos_expected =
-      ng_res->network_group->get_output_vstream_infos();
-  if (!vstream_infos_expected) {
-    return fine_error_string(
-        env, "Failed to get output vstream infos from network group: " +
-                 std::to_string(vstream_infos_expected.status()));
-  }
-
-  std::vector<ERL_NIF_TERM> map_terms_vector;
-  for (const auto &info : vstream_infos_expected.value()) {
-    map_terms_vector.push_back(build_detailed_vstream_info_map(env, info));
+  try {
+    auto infos = ng_res->network_group->output_infos();
+    return fine_ok(env, fine::Term(build_vstream_info_list(env, infos)));
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
   }
-  ERL_NIF_TERM list_of_maps_term = enif_make_list_from_array(
-      env, map_terms_vector.data(), map_terms_vector.size());
-  return fine_ok(env, fine::Term(list_of_maps_term));
 }
 
 // NIF function to get information about input vstreams from a pipeline
@@ -527,49 +978,8 @@ fine::Term get_input_vstream_infos_from_pipeline(ErlNifEnv *env,
         env, "Invalid pipeline resource for getting input vstream infos");
   }
 
-  // Get all vstream_infos from the underlying network group
-  auto all_ng_input_infos_expected =
-      pipeline_res->network_group->get_input_vstream_infos();
-  if (!all_ng_input_infos_expected) {
-    return fine_error_string(
-        env,
-        "Failed to get input vstream infos from network group for pipeline: " +
-            std::to_string(all_ng_input_infos_expected.status()));
-  }
-  const auto &all_ng_input_infos = all_ng_input_infos_expected.value();
-
-  auto active_pipeline_input_vstreams =
-      pipeline_res->pipeline->get_input_vstreams();
-  std::vector<ERL_NIF_TERM> map_terms_vector;
-
-  for (const auto &active_vstream_ref : active_pipeline_input_vstreams) {
-    std::string active_name = active_vstream_ref.get().name();
-    bool found = false;
-    for (const auto &info_t : all_ng_input_infos) {
-      if (std::string(info_t.name) == active_name) {
-        map_terms_vector.push_back(
-            build_detailed_vstream_info_map(env, info_t));
-        found = true;
-        break;
-      }
-    }
-    if (!found) {
-      // This case should ideally not happen if pipeline streams are a subset of
-      // NG streams Or handle it by creating a minimal map if possible, or error
-      // out For now, let's skip if not found, or add a placeholder error map
-      // entry
-      ERL_NIF_TERM error_map = enif_make_new_map(env);
-      enif_make_map_put(
-          env, error_map, fine::encode(env, fine::Atom("error")),
-          fine::encode(env, "Info not found for active stream: " + active_name),
-          &error_map);
-      map_terms_vector.push_back(error_map);
-    }
-  }
-  ERL_NIF_TERM list_of_maps_term = enif_make_list_from_array(
-      env, map_terms_vector.data(), map_terms_vector.size());
-
-  return fine_ok(env, fine::Term(list_of_maps_term));
+  const auto &infos = pipeline_res->pipeline->input_infos();
+  return fine_ok(env, fine::Term(build_vstream_info_list(env, infos)));
 }
 
 // NIF function to get information about output vstreams
@@ -584,138 +994,2165 @@ fine::Term get_output_vstream_infos_from_pipeline(ErlNifEnv *env,
         env, "Invalid pipeline resource for getting output vstream infos");
   }
 
-  // Get all vstream_infos from the underlying network group
-  auto all_ng_output_infos_expected =
-      pipeline_res->network_group->get_output_vstream_infos();
-  if (!all_ng_output_infos_expected) {
-    return fine_error_string(
-        env,
-        "Failed to get output vstream infos from network group for pipeline: " +
-            std::to_string(all_ng_output_infos_expected.status()));
+  const auto &infos = pipeline_res->pipeline->output_infos();
+  return fine_ok(env, fine::Term(build_vstream_info_list(env, infos)));
+}
+
+// Microseconds elapsed since `start`
+uint64_t elapsed_us(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// NIF function to configure a HEF on a VDevice and create its inference
+// pipeline in a single call. Takes the options of configure_network_group
+// and create_pipeline, and returns both resources together with their
+// vstream infos and the time each step took, so that loading a model is a
+// single round trip.
+fine::Term load(ErlNifEnv *env, fine::Term vdevice_resource_term,
+                fine::Term hef_path_term, fine::Term opts_term) {
+  fine::ResourcePtr<VDeviceResource> vdevice_res;
+  std::string hef_path;
+  try {
+    vdevice_res = fine::decode<fine::ResourcePtr<VDeviceResource>>(
+        env, vdevice_resource_term);
+    hef_path = fine::decode<std::string>(env, hef_path_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid VDevice resource or HEF file path");
   }
-  const auto &all_ng_output_infos = all_ng_output_infos_expected.value();
 
-  auto active_pipeline_output_vstreams =
-      pipeline_res->pipeline->get_output_vstreams();
-  std::vector<ERL_NIF_TERM> map_terms_vector;
+  nx_hailo::NetworkGroupParams ng_params;
+  nx_hailo::PipelineParams pipeline_params;
+  uint64_t output_pool_size;
+  bool raw_outputs;
+  try {
+    ng_params = decode_network_group_params(env, opts_term);
+    decode_pipeline_params(env, opts_term, pipeline_params);
+    output_pool_size =
+        get_map_field<uint64_t>(env, opts_term, "output_pool_size", 4);
+    raw_outputs = get_map_field<bool>(env, opts_term, "raw_outputs", false);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid load options");
+  }
 
-  for (const auto &active_vstream_ref : active_pipeline_output_vstreams) {
-    std::string active_name = active_vstream_ref.get().name();
-    bool found = false;
-    for (const auto &info_t : all_ng_output_infos) {
-      if (std::string(info_t.name) == active_name) {
-        map_terms_vector.push_back(
-            build_detailed_vstream_info_map(env, info_t));
-        found = true;
-        break;
+  auto ng_resource = fine::make_resource<NetworkGroupResource>();
+  fine::ResourcePtr<InferPipelineResource> pipeline_resource;
+  std::vector<nx_hailo::VStreamInfo> ng_input_infos, ng_output_infos;
+  uint64_t configure_us, pipeline_us;
+  try {
+    auto start = std::chrono::steady_clock::now();
+    ng_resource->network_group =
+        vdevice_res->vdevice->configure(hef_path, ng_params);
+    ng_resource->vdevice = vdevice_res->vdevice;
+    ng_input_infos = ng_resource->network_group->input_infos();
+    ng_output_infos = ng_resource->network_group->output_infos();
+    configure_us = elapsed_us(start);
+
+    // Keep the quantized type of non-NMS outputs unless overridden
+    if (raw_outputs) {
+      for (const auto &info : ng_output_infos) {
+        if (!info.is_nms()) {
+          pipeline_params.output_format_types.emplace(info.name,
+                                                      info.format_type);
+        }
       }
     }
-    if (!found) {
-      ERL_NIF_TERM error_map = enif_make_new_map(env);
-      enif_make_map_put(
-          env, error_map, fine::encode(env, fine::Atom("error")),
-          fine::encode(env, "Info not found for active stream: " + active_name),
-          &error_map);
-      map_terms_vector.push_back(error_map);
-    }
+
+    start = std::chrono::steady_clock::now();
+    pipeline_resource = make_infer_pipeline(ng_resource->network_group,
+                                            pipeline_params, output_pool_size);
+    pipeline_us = elapsed_us(start);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
   }
-  ERL_NIF_TERM list_of_maps_term = enif_make_list_from_array(
-      env, map_terms_vector.data(), map_terms_vector.size());
-  return fine_ok(env, fine::Term(list_of_maps_term));
+
+  ERL_NIF_TERM timings = enif_make_new_map(env);
+  enif_make_map_put(env, timings, fine::encode(env, fine::Atom("configure_us")),
+                    fine::encode(env, configure_us), &timings);
+  enif_make_map_put(env, timings, fine::encode(env, fine::Atom("pipeline_us")),
+                    fine::encode(env, pipeline_us), &timings);
+
+  const auto &pipeline = *pipeline_resource->pipeline;
+  std::pair<const char *, ERL_NIF_TERM> fields[] = {
+      {"network_group", fine::encode(env, ng_resource)},
+      {"pipeline", fine::encode(env, pipeline_resource)},
+      {"network_group_input_vstream_infos",
+       build_vstream_info_list(env, ng_input_infos)},
+      {"network_group_output_vstream_infos",
+       build_vstream_info_list(env, ng_output_infos)},
+      {"input_vstream_infos",
+       build_vstream_info_list(env, pipeline.input_infos())},
+      {"output_vstream_infos",
+       build_vstream_info_list(env, pipeline.output_infos())},
+      {"timings", timings}};
+
+  ERL_NIF_TERM result = enif_make_new_map(env);
+  for (const auto &field : fields) {
+    enif_make_map_put(env, result, fine::encode(env, fine::Atom(field.first)),
+                      field.second, &result);
+  }
+  return fine_ok(env, fine::Term(result));
 }
 
-// NIF function to run inference using a pipeline
-fine::Term infer(ErlNifEnv *env, fine::Term pipeline_term,
-                 fine::Term input_data_term) {
-  // Get the pipeline resource from the input term
-  fine::ResourcePtr<InferPipelineResource> pipeline_res;
-  try {
-    pipeline_res = fine::decode<fine::ResourcePtr<InferPipelineResource>>(
-        env, pipeline_term);
-  } catch (const std::exception &e) {
-    return fine_error_string(env, "Invalid pipeline resource");
+// NIF function to report the hits and size of the HEF cache
+fine::Term get_hef_cache_stats(ErlNifEnv *env) {
+  auto stats = nx_hailo::hef_cache_stats();
+  ERL_NIF_TERM stats_map = enif_make_new_map(env);
+  std::pair<const char *, uint64_t> fields[] = {{"hits", stats.hits},
+                                                {"misses", stats.misses},
+                                                {"entries", stats.entries},
+                                                {"bytes", stats.bytes}};
+  for (const auto &field : fields) {
+    enif_make_map_put(env, stats_map, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &stats_map);
   }
+  return fine_ok(env, fine::Term(stats_map));
+}
 
-  // Get the input data map from the input term
-  std::map<std::string, std::string> input_map;
-  try {
-    input_map =
-        fine::decode<std::map<std::string, std::string>>(env, input_data_term);
-  } catch (const std::exception &e) {
-    return fine_error_string(env, "Input data must be a map");
+// Owns an ErlNifMapIterator so that it is released on every exit path
+class MapIterator {
+public:
+  MapIterator(ErlNifEnv *env, ERL_NIF_TERM map) : env_(env) {
+    valid_ = enif_map_iterator_create(env, map, &iter_,
+                                      ERL_NIF_MAP_ITERATOR_FIRST);
+  }
+  ~MapIterator() {
+    if (valid_)
+      enif_map_iterator_destroy(env_, &iter_);
   }
 
-  // Get the input and output vstreams
-  auto input_vstreams = pipeline_res->pipeline->get_input_vstreams();
-  auto output_vstreams = pipeline_res->pipeline->get_output_vstreams();
+  bool next(ERL_NIF_TERM *key, ERL_NIF_TERM *value) {
+    if (!valid_ || !enif_map_iterator_get_pair(env_, &iter_, key, value))
+      return false;
+    enif_map_iterator_next(env_, &iter_);
+    return true;
+  }
 
-  // Set up input data map and memory views
-  std::map<std::string, hailort::MemoryView> input_data_mem_views;
-  const size_t frames_count = 1; // Process one frame at a time
+private:
+  ErlNifEnv *env_;
+  ErlNifMapIterator iter_;
+  bool valid_;
+};
 
-  // Prepare input data for each input vstream
-  for (const auto &input_vstream : input_vstreams) {
-    std::string name = input_vstream.get().name();
-    auto it = input_map.find(name);
-    if (it == input_map.end()) {
-      return fine_error_string(env, "Missing input data for vstream: " + name);
+// Index of the vstream whose name matches the binary `name`, or -1
+int find_vstream(const std::vector<nx_hailo::VStreamInfo> &infos,
+                 const ErlNifBinary &name) {
+  for (size_t i = 0; i < infos.size(); i++) {
+    const auto &info = infos[i];
+    if (info.name.size() == name.size &&
+        info.name.compare(0, name.size,
+                          reinterpret_cast<const char *>(name.data),
+                          name.size) == 0) {
+      return static_cast<int>(i);
     }
-    std::string &binary = it->second;
-    size_t expected_size = input_vstream.get().get_frame_size() * frames_count;
-    if (binary.size() != expected_size) {
-      return fine_error_string(
-          env, "Invalid input data size for vstream " + name +
-                   ". Expected: " + std::to_string(expected_size) +
-                   ", Got: " + std::to_string(binary.size()));
+  }
+  return -1;
+}
+
+void check_frame_size(const nx_hailo::VStreamInfo &info, size_t expected_size,
+                      size_t size) {
+  if (size != expected_size) {
+    throw nx_hailo::Error("Invalid input data size for vstream " + info.name +
+                          ". Expected: " + std::to_string(expected_size) +
+                          ", Got: " + std::to_string(size));
+  }
+}
+
+void check_all_inputs_present(const std::vector<nx_hailo::VStreamInfo> &infos,
+                              const std::vector<nx_hailo::ConstBuffer> &buffers) {
+  for (size_t i = 0; i < infos.size(); i++) {
+    if (buffers[i].data == nullptr) {
+      throw nx_hailo::Error("Missing input data for vstream: " +
+                            infos[i].name);
     }
-    input_data_mem_views.emplace(
-        name, hailort::MemoryView(
-                  const_cast<void *>(static_cast<const void *>(binary.data())),
-                  binary.size()));
   }
+}
+
+nx_hailo::PixelFormat decode_pixel_format(ErlNifEnv *env, ERL_NIF_TERM term) {
+  auto name = fine::decode<fine::Atom>(env, term).to_string();
+  if (name == "rgb") {
+    return nx_hailo::PixelFormat::Rgb;
+  } else if (name == "bgr") {
+    return nx_hailo::PixelFormat::Bgr;
+  } else if (name == "yuyv") {
+    return nx_hailo::PixelFormat::Yuyv;
+  } else if (name == "i420") {
+    return nx_hailo::PixelFormat::I420;
+  }
+  throw nx_hailo::Error("Invalid pixel format: " + name);
+}
+
+// Decodes an `{x, y, width, height}` tuple of frame pixels
+nx_hailo::CropRect decode_crop_rect(ErlNifEnv *env, ERL_NIF_TERM term) {
+  auto [x, y, width, height] =
+      fine::decode<std::tuple<uint64_t, uint64_t, uint64_t, uint64_t>>(env,
+                                                                      term);
+  const uint64_t limit = std::numeric_limits<uint32_t>::max();
+  if (x > limit || y > limit || width > limit || height > limit) {
+    throw nx_hailo::Error("Crop does not fit in the frame");
+  }
+  return {static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+          static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+}
+
+// Describes a packed frame binary using the `:width`, `:height`, `:format`
+// (:rgb, :bgr, :yuyv or :i420, defaults to :rgb) and `:stride` (defaults to
+// tightly packed rows) options. An `{x, y, width, height}` `:crop` narrows
+// it down to a window of the frame. The binary is not copied.
+nx_hailo::Frame decode_frame(ErlNifEnv *env, ERL_NIF_TERM frame_term,
+                             ERL_NIF_TERM opts_term) {
+  ErlNifBinary binary;
+  if (!enif_inspect_binary(env, frame_term, &binary)) {
+    throw nx_hailo::Error("Frame must be a binary");
+  }
+
+  nx_hailo::Frame frame;
+  frame.data = binary.data;
+  frame.size = binary.size;
+  frame.width = get_map_field<uint64_t>(env, opts_term, "width", 0);
+  frame.height = get_map_field<uint64_t>(env, opts_term, "height", 0);
+  frame.format = nx_hailo::PixelFormat::Rgb;
+  ERL_NIF_TERM value;
+  if (get_map_value(env, opts_term, "format", &value)) {
+    frame.format = decode_pixel_format(env, value);
+  }
+  frame.stride = get_map_field<uint64_t>(
+      env, opts_term, "stride",
+      frame.width * nx_hailo::bytes_per_pixel(frame.format));
+  if (get_map_value(env, opts_term, "crop", &value)) {
+    frame = nx_hailo::crop_frame(frame, decode_crop_rect(env, value));
+  }
+  return frame;
+}
+
+ERL_NIF_TERM
+build_letterbox_map(ErlNifEnv *env,
+                    const nx_hailo::LetterboxGeometry &geometry) {
+  ERL_NIF_TERM map = enif_make_new_map(env);
+  std::pair<const char *, uint64_t> sizes[] = {
+      {"width", geometry.width},
+      {"height", geometry.height},
+      {"target_width", geometry.target_width},
+      {"target_height", geometry.target_height}};
+  for (const auto &field : sizes) {
+    enif_make_map_put(env, map, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &map);
+  }
+  std::pair<const char *, double> placement[] = {{"scale", geometry.scale},
+                                                 {"pad_x", geometry.pad_x},
+                                                 {"pad_y", geometry.pad_y}};
+  for (const auto &field : placement) {
+    enif_make_map_put(env, map, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &map);
+  }
+  return map;
+}
 
-  // Prepare output data map and memory views
-  std::map<std::string, std::vector<uint8_t>> output_data;
-  std::map<std::string, hailort::MemoryView> output_data_mem_views;
-  for (const auto &output_vstream : output_vstreams) {
-    std::string name = output_vstream.get().name();
-    size_t frame_size = output_vstream.get().get_frame_size();
-    output_data.emplace(name, std::vector<uint8_t>(frame_size * frames_count));
-    auto &output_buffer = output_data[name];
-    output_data_mem_views.emplace(
-        name, hailort::MemoryView(output_buffer.data(), output_buffer.size()));
+// Matches the `{:letterbox, frame, opts}` input form, which asks for the
+// frame to be letterboxed natively into the input vstream buffer
+bool get_letterbox_input(ErlNifEnv *env, ERL_NIF_TERM term,
+                         ERL_NIF_TERM *frame, ERL_NIF_TERM *opts) {
+  int arity;
+  const ERL_NIF_TERM *elements;
+  if (!enif_get_tuple(env, term, &arity, &elements) || arity != 3 ||
+      !enif_is_identical(elements[0], enif_make_atom(env, "letterbox"))) {
+    return false;
   }
+  *frame = elements[1];
+  *opts = elements[2];
+  return true;
+}
 
-  // Run inference
-  hailo_status status = pipeline_res->pipeline->infer(
-      input_data_mem_views, output_data_mem_views, frames_count);
-  if (status != HAILO_SUCCESS) {
-    return fine_error_string(env, "Inference failed with status: " +
-                                      std::to_string(status));
+// Letterboxes `frame` into `out`, one frame of the uint8 RGB input vstream
+void letterbox_input(ErlNifEnv *env, ERL_NIF_TERM frame_term,
+                     ERL_NIF_TERM opts_term, const nx_hailo::VStreamInfo &info,
+                     uint8_t *out) {
+  if (info.features != 3 || nx_hailo::format_type_size(info.format_type) != 1 ||
+      info.frame_size != static_cast<size_t>(info.height) * info.width * 3) {
+    throw nx_hailo::Error("Input vstream " + info.name +
+                          " is not an uint8 RGB image, cannot letterbox");
   }
 
-  // Prepare output data map to return to Elixir
-  std::map<std::string, std::string> output_map;
-  for (const auto &output_vstream : output_vstreams) {
-    std::string name = output_vstream.get().name();
-    const auto &output_buffer = output_data[name];
-    output_map[name] =
-        std::string(reinterpret_cast<const char *>(output_buffer.data()),
-                    output_buffer.size());
+  nx_hailo::Frame frame;
+  try {
+    frame = decode_frame(env, frame_term, opts_term);
+  } catch (const nx_hailo::Error &) {
+    throw;
+  } catch (const std::exception &e) {
+    throw nx_hailo::Error("Invalid letterbox options for vstream " +
+                          info.name);
+  }
+  nx_hailo::letterbox(frame, out, info.width, info.height);
+}
+
+// Writes one frame of input data for `info` into `out`: either a copy of a
+// binary or a letterboxed `{:letterbox, frame, opts}`
+void write_input_frame(ErlNifEnv *env, ERL_NIF_TERM term,
+                       const nx_hailo::VStreamInfo &info, uint8_t *out) {
+  ERL_NIF_TERM frame, opts;
+  if (get_letterbox_input(env, term, &frame, &opts)) {
+    letterbox_input(env, frame, opts, info, out);
+    return;
+  }
+
+  ErlNifBinary binary;
+  if (!enif_inspect_binary(env, term, &binary)) {
+    throw nx_hailo::Error("Input frames for vstream " + info.name +
+                          " must be binaries");
+  }
+  check_frame_size(info, info.frame_size, binary.size);
+  std::memcpy(out, binary.data, binary.size);
+}
+
+// Points `buffers` at the input binaries of a `%{name => binary}` map, in the
+// order of `infos`. The binaries are inspected in place and their sizes
+// checked against the cached vstream frame sizes, so the only copy a frame
+// goes through is the one into the device buffer. `{:letterbox, frame, opts}`
+// values are letterboxed into `staging` instead.
+void collect_input_buffers(ErlNifEnv *env, ERL_NIF_TERM input_data_term,
+                           const std::vector<nx_hailo::VStreamInfo> &infos,
+                           std::vector<std::vector<uint8_t>> &staging,
+                           std::vector<nx_hailo::ConstBuffer> &buffers) {
+  if (!enif_is_map(env, input_data_term)) {
+    throw nx_hailo::Error("Input data must be a map");
+  }
+
+  buffers.assign(infos.size(), {nullptr, 0});
+
+  MapIterator iter(env, input_data_term);
+  ERL_NIF_TERM key, value;
+  while (iter.next(&key, &value)) {
+    ErlNifBinary name;
+    if (!enif_inspect_binary(env, key, &name)) {
+      continue;
+    }
+    int index = find_vstream(infos, name);
+    if (index < 0) {
+      continue;
+    }
+
+    const auto &info = infos[index];
+    ERL_NIF_TERM frame, opts;
+    if (get_letterbox_input(env, value, &frame, &opts)) {
+      staging[index].resize(info.frame_size);
+      letterbox_input(env, frame, opts, info, staging[index].data());
+      buffers[index] = {staging[index].data(), info.frame_size};
+      continue;
+    }
+
+    ErlNifBinary binary;
+    if (!enif_inspect_binary(env, value, &binary)) {
+      throw nx_hailo::Error("Input data for vstream " + info.name +
+                            " must be a binary");
+    }
+    check_frame_size(info, info.frame_size, binary.size);
+    buffers[index] = {binary.data, binary.size};
+  }
+
+  check_all_inputs_present(infos, buffers);
+}
+
+// Batched counterpart of collect_input_buffers for a `%{name => [frame]}`
+// map. Every vstream must get the same number of frames, which is returned.
+// The device wants the frames of a vstream back to back, so they are
+// gathered into `staging`, except for single binaries which are read in
+// place.
+size_t collect_batch_input_buffers(
+    ErlNifEnv *env, ERL_NIF_TERM input_data_term,
+    const std::vector<nx_hailo::VStreamInfo> &infos,
+    std::vector<std::vector<uint8_t>> &staging,
+    std::vector<nx_hailo::ConstBuffer> &buffers) {
+  if (!enif_is_map(env, input_data_term)) {
+    throw nx_hailo::Error("Input data must be a map");
+  }
+
+  buffers.assign(infos.size(), {nullptr, 0});
+  size_t frames_count = 0;
+
+  MapIterator iter(env, input_data_term);
+  ERL_NIF_TERM key, value;
+  while (iter.next(&key, &value)) {
+    ErlNifBinary name;
+    if (!enif_inspect_binary(env, key, &name)) {
+      continue;
+    }
+    int index = find_vstream(infos, name);
+    if (index < 0) {
+      continue;
+    }
+
+    const auto &info = infos[index];
+    unsigned length;
+    if (!enif_get_list_length(env, value, &length) || length == 0) {
+      throw nx_hailo::Error("Input data for vstream " + info.name +
+                            " must be a non-empty list of frames");
+    }
+    if (frames_count == 0) {
+      frames_count = length;
+    } else if (length != frames_count) {
+      throw nx_hailo::Error(
+          "All input vstreams must have the same number of frames. Expected: " +
+          std::to_string(frames_count) + ", Got: " + std::to_string(length) +
+          " for vstream " + info.name);
+    }
+
+    ERL_NIF_TERM head, tail = value;
+    ErlNifBinary binary;
+    if (length == 1) {
+      enif_get_list_cell(env, tail, &head, &tail);
+      if (enif_inspect_binary(env, head, &binary)) {
+        check_frame_size(info, info.frame_size, binary.size);
+        buffers[index] = {binary.data, binary.size};
+        continue;
+      }
+      tail = value;
+    }
+
+    auto &frames = staging[index];
+    frames.resize(info.frame_size * length);
+    uint8_t *out = frames.data();
+    while (enif_get_list_cell(env, tail, &head, &tail)) {
+      write_input_frame(env, head, info, out);
+      out += info.frame_size;
+    }
+    buffers[index] = {frames.data(), frames.size()};
+  }
+
+  check_all_inputs_present(infos, buffers);
+  return frames_count;
+}
+
+// Takes an output buffer for `frames_count` frames for each output vstream
+// and points `buffers` at them. Buffers come from the pools when
+// `frames_count` fits in them and are allocated otherwise. If anything
+// fails later on, the resources are dropped and the buffers go back.
+std::vector<fine::ResourcePtr<OutputBufferResource>> acquire_output_buffers(
+    const std::vector<nx_hailo::VStreamInfo> &output_infos,
+    const std::vector<std::shared_ptr<nx_hailo::BufferPool>> &pools,
+    size_t frames_per_buffer, size_t frames_count,
+    std::vector<nx_hailo::MutableBuffer> &buffers) {
+  std::vector<fine::ResourcePtr<OutputBufferResource>> outputs;
+  outputs.reserve(output_infos.size());
+  buffers.clear();
+  for (size_t i = 0; i < output_infos.size(); i++) {
+    auto output = fine::make_resource<OutputBufferResource>();
+    if (frames_count <= frames_per_buffer) {
+      output->pool = pools[i];
+      output->data = output->pool->acquire();
+    } else {
+      output->data = new uint8_t[output_infos[i].frame_size * frames_count];
+    }
+    buffers.push_back({output->data, output_infos[i].frame_size * frames_count});
+    outputs.push_back(std::move(output));
+  }
+  return outputs;
+}
+
+// Runs the pipeline on the collected input buffers, into freshly acquired
+// output buffers. Called with infer_mutex held.
+std::vector<fine::ResourcePtr<OutputBufferResource>>
+infer_collected(InferPipelineResource &pipeline_res, size_t frames_count,
+                InferTimings &timings) {
+  auto outputs = acquire_output_buffers(
+      pipeline_res.pipeline->output_infos(), pipeline_res.output_pools,
+      pipeline_res.frames_per_buffer, frames_count,
+      pipeline_res.output_buffers);
+  timings.lap(kInferStageAcquire);
+  pipeline_res.pipeline->infer(pipeline_res.input_buffers,
+                               pipeline_res.output_buffers, frames_count);
+  timings.lap(kInferStageDevice);
+  return outputs;
+}
+
+// Encodes frame `frame` of each output as a `%{name => binary}` map of
+// binaries backed by the output resources
+ERL_NIF_TERM build_output_map(
+    ErlNifEnv *env, const std::vector<nx_hailo::VStreamInfo> &output_infos,
+    const std::vector<fine::ResourcePtr<OutputBufferResource>> &outputs,
+    size_t frame) {
+  ERL_NIF_TERM output_map = enif_make_new_map(env);
+  for (size_t i = 0; i < output_infos.size(); i++) {
+    size_t frame_size = output_infos[i].frame_size;
+    ERL_NIF_TERM binary = enif_make_resource_binary(
+        env, outputs[i].get(), outputs[i]->data + frame * frame_size,
+        frame_size);
+    enif_make_map_put(env, output_map, fine::encode(env, output_infos[i].name),
+                      binary, &output_map);
+  }
+  return output_map;
+}
+
+// The reply to requests that could not make their deadline. An atom rather
+// than a message, so that callers can match on it.
+fine::Term deadline_exceeded_error(ErlNifEnv *env) {
+  return fine::encode(env, std::make_tuple(fine::Atom("error"),
+                                           fine::Atom("deadline_exceeded")));
+}
+
+// Runs a single-frame inference on the pipeline and encodes the outputs in
+// `env`. Shared by the synchronous NIF and the worker thread. Requests that
+// can no longer complete by `deadline` once it is their turn are not run.
+fine::Term run_inference(ErlNifEnv *env, InferPipelineResource &pipeline_res,
+                         fine::Term input_data_term,
+                         std::chrono::steady_clock::time_point deadline,
+                         InferTimings &timings) {
+  const auto &output_infos = pipeline_res.pipeline->output_infos();
+  std::lock_guard<std::mutex> lock(pipeline_res.infer_mutex);
+  timings.lap(kInferStageWait);
+  if (!pipeline_res.stats.admit(deadline)) {
+    return deadline_exceeded_error(env);
+  }
+
+  std::vector<fine::ResourcePtr<OutputBufferResource>> outputs;
+  try {
+    collect_input_buffers(env, input_data_term,
+                          pipeline_res.pipeline->input_infos(),
+                          pipeline_res.input_staging,
+                          pipeline_res.input_buffers);
+    timings.lap(kInferStageDecode);
+    outputs = infer_collected(pipeline_res, 1, timings);
+  } catch (const nx_hailo::Error &e) {
+    pipeline_res.stats.record(timings, 1, false);
+    return fine_error_string(env, e.what());
+  }
+
+  ERL_NIF_TERM output_map = build_output_map(env, output_infos, outputs, 0);
+  timings.lap(kInferStageEncode);
+  pipeline_res.stats.record(timings, 1, true);
+  pipeline_res.stats.record_completion(deadline);
+  return fine_ok(env, fine::Term(output_map));
+}
+
+// Runs all the frames of a batch through a single device transfer and
+// encodes one output map per frame, in input order. The per-frame binaries
+// are slices of one buffer per output vstream.
+fine::Term run_batch_inference(ErlNifEnv *env,
+                               InferPipelineResource &pipeline_res,
+                               fine::Term input_data_term,
+                               std::chrono::steady_clock::time_point deadline,
+                               InferTimings &timings) {
+  const auto &output_infos = pipeline_res.pipeline->output_infos();
+  std::lock_guard<std::mutex> lock(pipeline_res.infer_mutex);
+  timings.lap(kInferStageWait);
+  if (!pipeline_res.stats.admit(deadline)) {
+    return deadline_exceeded_error(env);
+  }
+
+  size_t frames_count;
+  std::vector<fine::ResourcePtr<OutputBufferResource>> outputs;
+  try {
+    frames_count = collect_batch_input_buffers(
+        env, input_data_term, pipeline_res.pipeline->input_infos(),
+        pipeline_res.input_staging, pipeline_res.input_buffers);
+    timings.lap(kInferStageDecode);
+    outputs = infer_collected(pipeline_res, frames_count, timings);
+  } catch (const nx_hailo::Error &e) {
+    pipeline_res.stats.record(timings, 0, false);
+    return fine_error_string(env, e.what());
+  }
+
+  std::vector<ERL_NIF_TERM> frames(frames_count);
+  for (size_t frame = 0; frame < frames_count; frame++) {
+    frames[frame] = build_output_map(env, output_infos, outputs, frame);
+  }
+  ERL_NIF_TERM frames_list =
+      enif_make_list_from_array(env, frames.data(), frames.size());
+  timings.lap(kInferStageEncode);
+  pipeline_res.stats.record(timings, frames_count, true);
+  pipeline_res.stats.record_completion(deadline);
+  return fine_ok(env, fine::Term(frames_list));
+}
+
+// Encodes the occupancy of the pipeline's output buffer pools, keyed by
+// output vstream name
+ERL_NIF_TERM build_output_pool_stats_map(ErlNifEnv *env,
+                                         InferPipelineResource &pipeline_res) {
+  const auto &output_infos = pipeline_res.pipeline->output_infos();
+  ERL_NIF_TERM result = enif_make_new_map(env);
+
+  for (size_t i = 0; i < output_infos.size(); i++) {
+    auto stats = pipeline_res.output_pools[i]->stats();
+
+    ERL_NIF_TERM stats_map = enif_make_new_map(env);
+    std::pair<const char *, uint64_t> fields[] = {
+        {"buffer_size", stats.buffer_size}, {"capacity", stats.capacity},
+        {"idle", stats.idle},               {"in_use", stats.in_use},
+        {"peak_in_use", stats.peak_in_use}, {"acquired", stats.acquired},
+        {"misses", stats.misses}};
+    for (const auto &field : fields) {
+      enif_make_map_put(env, stats_map,
+                        fine::encode(env, fine::Atom(field.first)),
+                        fine::encode(env, field.second), &stats_map);
+    }
+
+    enif_make_map_put(env, result, fine::encode(env, output_infos[i].name),
+                      stats_map, &result);
+  }
+
+  return result;
+}
+
+// NIF function to report the size and occupancy of the output buffer pools
+fine::Term get_output_pool_stats(ErlNifEnv *env, fine::Term pipeline_term) {
+  fine::ResourcePtr<InferPipelineResource> pipeline_res;
+  try {
+    pipeline_res = fine::decode<fine::ResourcePtr<InferPipelineResource>>(
+        env, pipeline_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid pipeline resource");
+  }
+
+  return fine_ok(env,
+                 fine::Term(build_output_pool_stats_map(env, *pipeline_res)));
+}
+
+// NIF function to run inference using a pipeline
+fine::Term infer(ErlNifEnv *env, fine::Term pipeline_term,
+                 fine::Term input_data_term) {
+  InferTimings timings;
+
+  // Get the pipeline resource from the input term
+  fine::ResourcePtr<InferPipelineResource> pipeline_res;
+  try {
+    pipeline_res = fine::decode<fine::ResourcePtr<InferPipelineResource>>(
+        env, pipeline_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid pipeline resource");
+  }
+
+  return run_inference(env, *pipeline_res, input_data_term,
+                       std::chrono::steady_clock::time_point::max(), timings);
+}
+
+// Encodes the stage durations of one request in nanoseconds, keyed by stage
+ERL_NIF_TERM build_timings_map(ErlNifEnv *env, const InferTimings &timings) {
+  ERL_NIF_TERM result = enif_make_new_map(env);
+  for (size_t stage = 0; stage < kInferStageCount; stage++) {
+    enif_make_map_put(env, result,
+                      fine::encode(env, fine::Atom(kInferStageNames[stage])),
+                      fine::encode(env, timings.stage_ns(stage)), &result);
+  }
+  return result;
+}
+
+// Appends the stage timings to an `{:ok, outputs}` result, errors are
+// returned as they are
+ERL_NIF_TERM add_timings(ErlNifEnv *env, ERL_NIF_TERM result,
+                         const InferTimings &timings) {
+  const ERL_NIF_TERM *elements;
+  int arity;
+  if (!enif_get_tuple(env, result, &arity, &elements) || arity != 2 ||
+      !enif_is_identical(elements[0], fine::encode(env, fine::Atom("ok")))) {
+    return result;
+  }
+  return enif_make_tuple3(env, elements[0], elements[1],
+                          build_timings_map(env, timings));
+}
+
+// Encodes a latency summary with durations in microseconds
+ERL_NIF_TERM build_latency_summary_map(ErlNifEnv *env,
+                                       const nx_hailo::LatencySummary &summary) {
+  ERL_NIF_TERM result = enif_make_new_map(env);
+  enif_make_map_put(env, result, fine::encode(env, fine::Atom("count")),
+                    fine::encode(env, summary.count), &result);
+
+  double mean_ns =
+      summary.count == 0 ? 0.0 : double(summary.total_ns) / summary.count;
+  std::pair<const char *, double> fields[] = {
+      {"total_us", summary.total_ns / 1000.0},
+      {"mean_us", mean_ns / 1000.0},
+      {"min_us", summary.min_ns / 1000.0},
+      {"max_us", summary.max_ns / 1000.0},
+      {"p50_us", summary.p50_ns / 1000.0},
+      {"p90_us", summary.p90_ns / 1000.0},
+      {"p99_us", summary.p99_ns / 1000.0},
+      {"p999_us", summary.p999_ns / 1000.0}};
+  for (const auto &field : fields) {
+    enif_make_map_put(env, result, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &result);
+  }
+  return result;
+}
+
+// NIF function to report the request counters and per-stage latency
+// histograms of a pipeline. Only reads atomics, so it is cheap enough to
+// poll.
+fine::Term get_pipeline_stats(ErlNifEnv *env, fine::Term pipeline_term) {
+  fine::ResourcePtr<InferPipelineResource> pipeline_res;
+  try {
+    pipeline_res = fine::decode<fine::ResourcePtr<InferPipelineResource>>(
+        env, pipeline_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid pipeline resource");
+  }
+
+  const auto &stats = pipeline_res->stats;
+  ERL_NIF_TERM stages = enif_make_new_map(env);
+  for (size_t stage = 0; stage < kInferStageCount; stage++) {
+    enif_make_map_put(
+        env, stages, fine::encode(env, fine::Atom(kInferStageNames[stage])),
+        build_latency_summary_map(env, stats.stages[stage].summary()),
+        &stages);
+  }
+
+  ERL_NIF_TERM result = enif_make_new_map(env);
+  std::pair<const char *, ERL_NIF_TERM> fields[] = {
+      {"requests", fine::encode(env, stats.requests.load())},
+      {"frames", fine::encode(env, stats.frames.load())},
+      {"errors", fine::encode(env, stats.errors.load())},
+      {"expired", fine::encode(env, stats.expired.load())},
+      {"dropped", fine::encode(env, stats.dropped.load())},
+      {"late", fine::encode(env, stats.late.load())},
+      {"stages", stages},
+      {"total", build_latency_summary_map(env, stats.total.summary())}};
+  for (const auto &field : fields) {
+    enif_make_map_put(env, result, fine::encode(env, fine::Atom(field.first)),
+                      field.second, &result);
+  }
+  return fine_ok(env, fine::Term(result));
+}
+
+// Decodes the deadline of a request submitted now from the `timeout_ms` in
+// `opts`. Requests without one get the vstream timeout of the pipeline, and
+// `:infinity` means no deadline at all.
+std::chrono::steady_clock::time_point
+decode_deadline(ErlNifEnv *env, fine::Term opts_term,
+                const InferPipelineResource &pipeline_res,
+                std::chrono::steady_clock::time_point submitted_at) {
+  uint64_t timeout_ms = pipeline_res.timeout_ms;
+  ERL_NIF_TERM value;
+  if (get_map_value(env, opts_term, "timeout_ms", &value)) {
+    if (enif_is_identical(value, enif_make_atom(env, "infinity"))) {
+      return std::chrono::steady_clock::time_point::max();
+    }
+    timeout_ms = fine::decode<uint64_t>(env, value);
+  }
+  return submitted_at + std::chrono::milliseconds(timeout_ms);
+}
+
+// Queues `run` on the pipeline's worker thread and returns :ok right away.
+// The caller later receives `{ref, result}` with whatever `run` returned,
+// plus the stage timings of successful requests when `timed` is set.
+fine::Term submit_inference(
+    ErlNifEnv *env, fine::Term pipeline_term, fine::Term input_data_term,
+    fine::Term ref_term, fine::Term opts_term,
+    fine::Term (*run)(ErlNifEnv *, InferPipelineResource &, fine::Term,
+                      std::chrono::steady_clock::time_point, InferTimings &),
+    bool timed = false) {
+  // Time spent queued for the worker counts as waiting, and against the
+  // deadline
+  auto submitted_at = std::chrono::steady_clock::now();
+
+  fine::ResourcePtr<InferPipelineResource> pipeline_res;
+  try {
+    pipeline_res = fine::decode<fine::ResourcePtr<InferPipelineResource>>(
+        env, pipeline_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid pipeline resource");
+  }
+
+  std::chrono::steady_clock::time_point deadline;
+  try {
+    deadline = decode_deadline(env, opts_term, *pipeline_res, submitted_at);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid inference options");
+  }
+
+  ErlNifPid caller;
+  enif_self(env, &caller);
+
+  // The inputs and the reply ref must outlive this call, so they are copied
+  // into an env owned by the job. Refc binaries are shared, not duplicated.
+  ErlNifEnv *msg_env = enif_alloc_env();
+  ERL_NIF_TERM inputs = enif_make_copy(msg_env, input_data_term);
+  ERL_NIF_TERM ref = enif_make_copy(msg_env, ref_term);
+
+  // The worker is owned by the resource and joined in its destructor, so the
+  // raw pointer is valid whenever the job actually runs.
+  InferPipelineResource *res = pipeline_res.get();
+  res->worker->submit([res, caller, msg_env, inputs, ref, run, timed,
+                       submitted_at, deadline](bool cancelled) {
+    ERL_NIF_TERM result;
+    if (cancelled) {
+      result = fine_error_string(msg_env, "Pipeline was released");
+    } else {
+      try {
+        InferTimings timings(submitted_at);
+        result = run(msg_env, *res, fine::Term(inputs), deadline, timings);
+        if (timed) {
+          result = add_timings(msg_env, result, timings);
+        }
+      } catch (const std::exception &e) {
+        result = fine_error_string(msg_env,
+                                   std::string("Inference failed: ") + e.what());
+      }
+    }
+
+    enif_send(nullptr, &caller, msg_env,
+              enif_make_tuple2(msg_env, ref, result));
+    enif_free_env(msg_env);
+  });
+
+  return fine::encode(env, fine::Atom("ok"));
+}
+
+// NIF function to run inference on the pipeline's worker thread.
+// Returns :ok right away; the caller later receives `{ref, result}` where
+// result is the same `{:ok, outputs} | {:error, reason}` returned by infer/2,
+// or `{:error, :deadline_exceeded}` when the request could not complete
+// within the `timeout_ms` of `opts` and was not run.
+fine::Term infer_async(ErlNifEnv *env, fine::Term pipeline_term,
+                       fine::Term input_data_term, fine::Term ref_term,
+                       fine::Term opts_term) {
+  return submit_inference(env, pipeline_term, input_data_term, ref_term,
+                          opts_term, run_inference);
+}
+
+// NIF function to run inference like infer_async/4, except that the reply is
+// `{ref, {:ok, outputs, %{stage => nanoseconds}}}` on success, with the time
+// each stage of the request took
+fine::Term infer_timed_async(ErlNifEnv *env, fine::Term pipeline_term,
+                             fine::Term input_data_term, fine::Term ref_term,
+                             fine::Term opts_term) {
+  return submit_inference(env, pipeline_term, input_data_term, ref_term,
+                          opts_term, run_inference, true);
+}
+
+// NIF function to run a batch of frames on the pipeline's worker thread.
+// The caller later receives `{ref, {:ok, [outputs, ...]} | {:error, reason}}`
+// with one output map per frame, in input order. The deadline applies to
+// the batch as a whole.
+fine::Term infer_batch_async(ErlNifEnv *env, fine::Term pipeline_term,
+                             fine::Term input_data_term, fine::Term ref_term,
+                             fine::Term opts_term) {
+  return submit_inference(env, pipeline_term, input_data_term, ref_term,
+                          opts_term, run_batch_inference);
+}
+
+// Decodes the `%{y_scale:, y_offset:, height:, x_scale:, x_offset:, width:}`
+// map built by NxHailo.Parsers.YoloV8 from a letterboxed input shape
+nx_hailo::BoxRemap decode_box_remap(ErlNifEnv *env, ERL_NIF_TERM map) {
+  nx_hailo::BoxRemap remap;
+  remap.y_scale = get_map_field<double>(env, map, "y_scale", remap.y_scale);
+  remap.y_offset = get_map_field<double>(env, map, "y_offset", remap.y_offset);
+  remap.height = get_map_field<double>(env, map, "height", remap.height);
+  remap.x_scale = get_map_field<double>(env, map, "x_scale", remap.x_scale);
+  remap.x_offset = get_map_field<double>(env, map, "x_offset", remap.x_offset);
+  remap.width = get_map_field<double>(env, map, "width", remap.width);
+  return remap;
+}
+
+// Decodes the `:score_threshold`, `:top_k` and `:class_ids` options of the
+// NMS parsers
+nx_hailo::DetectionFilter decode_detection_filter(ErlNifEnv *env,
+                                                  ERL_NIF_TERM opts_term,
+                                                  uint64_t number_of_classes) {
+  nx_hailo::DetectionFilter filter;
+  filter.score_threshold =
+      get_map_field<double>(env, opts_term, "score_threshold", 0.0);
+  filter.top_k = get_map_field<uint64_t>(env, opts_term, "top_k", 0);
+
+  ERL_NIF_TERM value;
+  if (get_map_value(env, opts_term, "class_ids", &value)) {
+    filter.allowed_classes.assign(number_of_classes, false);
+    for (auto class_id : fine::decode<std::vector<uint64_t>>(env, value)) {
+      if (class_id < number_of_classes) {
+        filter.allowed_classes[class_id] = true;
+      }
+    }
+  }
+  return filter;
+}
+
+// Encodes detections as a binary of packed nx_hailo::Detection records
+ERL_NIF_TERM
+make_detections_binary(ErlNifEnv *env,
+                       const std::vector<nx_hailo::Detection> &detections) {
+  ERL_NIF_TERM binary;
+  size_t size = detections.size() * sizeof(nx_hailo::Detection);
+  auto *data = enif_make_new_binary(env, size, &binary);
+  if (size > 0) {
+    std::memcpy(data, detections.data(), size);
+  }
+  return binary;
+}
+
+// NIF function to parse a float32 HAILO_NMS_BY_CLASS output frame into
+// packed `{class_id, score, ymin, xmin, ymax, xmax}` float32 records, best
+// score first. The frame binary is read in place.
+fine::Term parse_nms_detections(ErlNifEnv *env, fine::Term output_term,
+                                fine::Term opts_term) {
+  ErlNifBinary output;
+  if (!enif_inspect_binary(env, output_term, &output)) {
+    return fine_error_string(env, "NMS output must be a binary");
+  }
+
+  uint64_t number_of_classes;
+  nx_hailo::DetectionFilter filter;
+  bool remap_boxes = false;
+  nx_hailo::BoxRemap remap;
+  try {
+    number_of_classes =
+        get_map_field<uint64_t>(env, opts_term, "number_of_classes", 0);
+    filter = decode_detection_filter(env, opts_term, number_of_classes);
+
+    ERL_NIF_TERM value;
+    if (get_map_value(env, opts_term, "remap", &value)) {
+      remap_boxes = true;
+      remap = decode_box_remap(env, value);
+    }
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid NMS parser options");
+  }
+
+  std::vector<nx_hailo::Detection> detections;
+  try {
+    nx_hailo::parse_nms_by_class(output.data, output.size,
+                                 static_cast<uint32_t>(number_of_classes),
+                                 filter, detections);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+
+  nx_hailo::select_top_k(detections, filter.top_k);
+  if (remap_boxes) {
+    nx_hailo::remap_boxes(detections, remap);
+  }
+
+  return fine_ok(env, fine::Term(make_detections_binary(env, detections)));
+}
+
+// NIF function to cover a frame with overlapping tiles, see
+// nx_hailo::tile_grid. Returns the `{x, y, width, height}` of each tile, row
+// by row. YUYV tiles start on even columns, so that they can be cropped.
+fine::Term get_tile_grid(ErlNifEnv *env, fine::Term opts_term) {
+  uint64_t width, height, tile_width, tile_height;
+  double overlap;
+  nx_hailo::PixelFormat format = nx_hailo::PixelFormat::Rgb;
+  try {
+    width = get_map_field<uint64_t>(env, opts_term, "width", 0);
+    height = get_map_field<uint64_t>(env, opts_term, "height", 0);
+    tile_width = get_map_field<uint64_t>(env, opts_term, "tile_width", 0);
+    tile_height = get_map_field<uint64_t>(env, opts_term, "tile_height", 0);
+    overlap = get_map_field<double>(env, opts_term, "overlap", 0.2);
+    ERL_NIF_TERM value;
+    if (get_map_value(env, opts_term, "format", &value)) {
+      format = decode_pixel_format(env, value);
+    }
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid tile options");
+  }
+
+  std::vector<nx_hailo::CropRect> tiles;
+  try {
+    tiles = nx_hailo::tile_grid(
+        width, height, tile_width, tile_height, overlap,
+        format == nx_hailo::PixelFormat::Yuyv ? 2 : 1);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+
+  std::vector<std::tuple<uint64_t, uint64_t, uint64_t, uint64_t>> rects;
+  rects.reserve(tiles.size());
+  for (const auto &tile : tiles) {
+    rects.emplace_back(tile.x, tile.y, tile.width, tile.height);
+  }
+  return fine_ok(env, rects);
+}
+
+// NIF function to merge the NMS outputs of the tiles of a frame, each
+// letterboxed into the `target_width` x `target_height` model input. The
+// boxes of each tile are parsed like parse_nms_detections does, mapped back
+// into frame pixels and deduplicated across tiles with suppress_overlaps.
+// Returns the packed detections, best first.
+fine::Term merge_tile_detections(ErlNifEnv *env, fine::Term outputs_term,
+                                 fine::Term opts_term) {
+  uint64_t number_of_classes, target_width, target_height;
+  nx_hailo::DetectionFilter filter;
+  std::vector<fine::Term> outputs;
+  std::vector<nx_hailo::CropRect> tiles;
+  double threshold;
+  nx_hailo::OverlapMetric metric = nx_hailo::OverlapMetric::Iou;
+  bool class_aware;
+  try {
+    number_of_classes =
+        get_map_field<uint64_t>(env, opts_term, "number_of_classes", 0);
+    filter = decode_detection_filter(env, opts_term, number_of_classes);
+    target_width = get_map_field<uint64_t>(env, opts_term, "target_width", 0);
+    target_height = get_map_field<uint64_t>(env, opts_term, "target_height", 0);
+    threshold = get_map_field<double>(env, opts_term, "iou_threshold", 0.5);
+    class_aware = get_map_field<bool>(env, opts_term, "class_aware", true);
+
+    ERL_NIF_TERM value;
+    if (get_map_value(env, opts_term, "metric", &value)) {
+      auto name = fine::decode<fine::Atom>(env, value).to_string();
+      if (name == "ios") {
+        metric = nx_hailo::OverlapMetric::Ios;
+      } else if (name != "iou") {
+        throw nx_hailo::Error("Invalid overlap metric: " + name);
+      }
+    }
+    if (get_map_value(env, opts_term, "tiles", &value)) {
+      for (auto tile : fine::decode<std::vector<fine::Term>>(env, value)) {
+        tiles.push_back(decode_crop_rect(env, tile));
+      }
+    }
+    outputs = fine::decode<std::vector<fine::Term>>(env, outputs_term);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid tile merge options");
+  }
+  if (target_width == 0 || target_height == 0) {
+    return fine_error_string(env, "Tile target must not be empty");
+  }
+  if (outputs.size() != tiles.size()) {
+    return fine_error_string(env, "Expected one NMS output per tile");
+  }
+
+  std::vector<nx_hailo::Detection> detections;
+  std::vector<nx_hailo::Detection> tile_detections;
+  for (size_t i = 0; i < tiles.size(); i++) {
+    const auto &tile = tiles[i];
+    ErlNifBinary output;
+    if (!enif_inspect_binary(env, outputs[i], &output)) {
+      return fine_error_string(env, "NMS output must be a binary");
+    }
+    if (tile.width == 0 || tile.height == 0) {
+      return fine_error_string(env, "Tiles must not be empty");
+    }
+
+    tile_detections.clear();
+    try {
+      nx_hailo::parse_nms_by_class(output.data, output.size,
+                                   static_cast<uint32_t>(number_of_classes),
+                                   filter, tile_detections);
+    } catch (const nx_hailo::Error &e) {
+      return fine_error_string(env, e.what());
+    }
+
+    auto geometry = nx_hailo::letterbox_geometry(tile.width, tile.height,
+                                                 target_width, target_height);
+    nx_hailo::BoxRemap remap;
+    remap.y_scale = geometry.target_height / geometry.scale;
+    remap.y_offset = geometry.pad_y / geometry.scale;
+    remap.height = geometry.height;
+    remap.x_scale = geometry.target_width / geometry.scale;
+    remap.x_offset = geometry.pad_x / geometry.scale;
+    remap.width = geometry.width;
+    nx_hailo::remap_boxes(tile_detections, remap);
+    nx_hailo::offset_boxes(tile_detections.data(), tile_detections.size(),
+                           static_cast<float>(tile.x),
+                           static_cast<float>(tile.y));
+    detections.insert(detections.end(), tile_detections.begin(),
+                      tile_detections.end());
+  }
+
+  nx_hailo::suppress_overlaps(detections, static_cast<float>(threshold),
+                              metric, class_aware);
+  if (filter.top_k > 0 && detections.size() > filter.top_k) {
+    detections.resize(filter.top_k);
+  }
+  return fine_ok(env, fine::Term(make_detections_binary(env, detections)));
+}
+
+// NIF function to create a multi-object tracker
+fine::Term create_tracker(ErlNifEnv *env, fine::Term opts_term) {
+  nx_hailo::TrackerParams params;
+  try {
+    std::pair<const char *, float *> thresholds[] = {
+        {"high_threshold", &params.high_threshold},
+        {"low_threshold", &params.low_threshold},
+        {"new_track_threshold", &params.new_track_threshold},
+        {"match_iou", &params.match_iou},
+        {"low_match_iou", &params.low_match_iou}};
+    for (const auto &field : thresholds) {
+      *field.second = get_map_field<double>(env, opts_term, field.first,
+                                            *field.second);
+    }
+    params.max_age =
+        get_map_field<uint64_t>(env, opts_term, "max_age", params.max_age);
+    params.min_hits =
+        get_map_field<uint64_t>(env, opts_term, "min_hits", params.min_hits);
+    params.max_tracks = get_map_field<uint64_t>(env, opts_term, "max_tracks",
+                                                params.max_tracks);
+    params.class_aware = get_map_field<bool>(env, opts_term, "class_aware",
+                                             params.class_aware);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid tracker options");
+  }
+  if (params.max_tracks == 0) {
+    return fine_error_string(env, "Tracker max_tracks must be positive");
+  }
+
+  auto resource = fine::make_resource<TrackerResource>(params);
+  return fine_ok(env, resource);
+}
+
+// NIF function to advance a tracker by one frame of packed detections, as
+// returned by parse_nms_detections. Returns the track ID of each detection
+// as native uint32 values, 0 for untracked ones.
+fine::Term tracker_update(ErlNifEnv *env, fine::Term tracker_term,
+                          fine::Term detections_term) {
+  fine::ResourcePtr<TrackerResource> tracker;
+  ErlNifBinary packed;
+  try {
+    tracker =
+        fine::decode<fine::ResourcePtr<TrackerResource>>(env, tracker_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid tracker");
+  }
+  if (!enif_inspect_binary(env, detections_term, &packed) ||
+      packed.size % sizeof(nx_hailo::Detection) != 0) {
+    return fine_error_string(
+        env, "Detections must be a binary of packed float32 detections");
+  }
+
+  std::vector<uint32_t> track_ids;
+  {
+    std::lock_guard<std::mutex> lock(tracker->mutex);
+    tracker->detections.resize(packed.size / sizeof(nx_hailo::Detection));
+    if (packed.size > 0) {
+      std::memcpy(tracker->detections.data(), packed.data, packed.size);
+    }
+    tracker->tracker.update(tracker->detections, track_ids);
+  }
+
+  ERL_NIF_TERM binary;
+  auto *data = enif_make_new_binary(env, track_ids.size() * sizeof(uint32_t),
+                                    &binary);
+  if (!track_ids.empty()) {
+    std::memcpy(data, track_ids.data(), track_ids.size() * sizeof(uint32_t));
+  }
+  return fine_ok(env, fine::Term(binary));
+}
+
+fine::Term get_tracker_stats(ErlNifEnv *env, fine::Term tracker_term) {
+  fine::ResourcePtr<TrackerResource> tracker;
+  try {
+    tracker =
+        fine::decode<fine::ResourcePtr<TrackerResource>>(env, tracker_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid tracker");
+  }
+
+  std::lock_guard<std::mutex> lock(tracker->mutex);
+  ERL_NIF_TERM stats_map = enif_make_new_map(env);
+  std::pair<const char *, uint64_t> fields[] = {
+      {"tracks", tracker->tracker.track_count()},
+      {"frames", tracker->tracker.frame_count()}};
+  for (const auto &field : fields) {
+    enif_make_map_put(env, stats_map, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &stats_map);
+  }
+  return fine_ok(env, fine::Term(stats_map));
+}
+
+// NIF function to create a motion gate
+fine::Term create_motion_gate(ErlNifEnv *env, fine::Term opts_term) {
+  nx_hailo::MotionGateParams params;
+  try {
+    params.block_size = get_map_field<uint64_t>(env, opts_term, "block_size",
+                                                params.block_size);
+    params.threshold =
+        get_map_field<double>(env, opts_term, "threshold", params.threshold);
+    params.refresh_interval = get_map_field<uint64_t>(
+        env, opts_term, "refresh_interval", params.refresh_interval);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid motion gate options");
+  }
+  // Larger blocks could overflow the 32-bit luma sums
+  if (params.block_size == 0 || params.block_size > 256) {
+    return fine_error_string(env,
+                             "Motion gate block_size must be from 1 to 256");
+  }
+
+  auto resource = fine::make_resource<MotionGateResource>(params);
+  return fine_ok(env, resource);
+}
+
+// NIF function to compare a frame against the reference of a motion gate.
+// Returns :changed or :refresh when the frame should be inferred, or
+// {:unchanged, result} with the stored result of the reference frame. A
+// gate without a stored result treats every frame as changed.
+fine::Term motion_gate_check(ErlNifEnv *env, fine::Term gate_term,
+                             fine::Term frame_term, fine::Term opts_term) {
+  fine::ResourcePtr<MotionGateResource> gate;
+  nx_hailo::Frame frame;
+  try {
+    gate = fine::decode<fine::ResourcePtr<MotionGateResource>>(env, gate_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid motion gate");
+  }
+  try {
+    frame = decode_frame(env, frame_term, opts_term);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid frame options");
+  }
+
+  std::lock_guard<std::mutex> lock(gate->mutex);
+  if (gate->result == 0) {
+    gate->gate.reset();
+  }
+  nx_hailo::MotionDecision decision;
+  try {
+    decision = gate->gate.update(frame);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+
+  switch (decision) {
+  case nx_hailo::MotionDecision::Changed:
+    return fine_ok(env, fine::Atom("changed"));
+  case nx_hailo::MotionDecision::Refresh:
+    return fine_ok(env, fine::Atom("refresh"));
+  case nx_hailo::MotionDecision::Unchanged:
+    break;
+  }
+  return fine_ok(env, fine::Term(enif_make_tuple2(
+                          env, enif_make_atom(env, "unchanged"),
+                          enif_make_copy(env, gate->result))));
+}
+
+// NIF function to store the result of the last checked frame, returned for
+// the frames found unchanged after it
+fine::Term motion_gate_store(ErlNifEnv *env, fine::Term gate_term,
+                             fine::Term result_term) {
+  fine::ResourcePtr<MotionGateResource> gate;
+  try {
+    gate = fine::decode<fine::ResourcePtr<MotionGateResource>>(env, gate_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid motion gate");
+  }
+
+  std::lock_guard<std::mutex> lock(gate->mutex);
+  enif_clear_env(gate->env);
+  gate->result = enif_make_copy(gate->env, result_term);
+  return fine::encode(env, fine::Atom("ok"));
+}
+
+// NIF function to drop the reference frame and the stored result, so that
+// the next frame counts as changed
+fine::Term motion_gate_reset(ErlNifEnv *env, fine::Term gate_term) {
+  fine::ResourcePtr<MotionGateResource> gate;
+  try {
+    gate = fine::decode<fine::ResourcePtr<MotionGateResource>>(env, gate_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid motion gate");
+  }
+
+  std::lock_guard<std::mutex> lock(gate->mutex);
+  gate->gate.reset();
+  enif_clear_env(gate->env);
+  gate->result = 0;
+  return fine::encode(env, fine::Atom("ok"));
+}
+
+fine::Term get_motion_gate_stats(ErlNifEnv *env, fine::Term gate_term) {
+  fine::ResourcePtr<MotionGateResource> gate;
+  try {
+    gate = fine::decode<fine::ResourcePtr<MotionGateResource>>(env, gate_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid motion gate");
+  }
+
+  std::lock_guard<std::mutex> lock(gate->mutex);
+  const auto &stats = gate->gate.stats();
+  ERL_NIF_TERM stats_map = enif_make_new_map(env);
+  std::pair<const char *, uint64_t> counts[] = {
+      {"frames", stats.frames},
+      {"changed", stats.changed},
+      {"refreshed", stats.refreshed},
+      {"skipped", stats.skipped}};
+  for (const auto &field : counts) {
+    enif_make_map_put(env, stats_map, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &stats_map);
+  }
+  std::pair<const char *, double> rates[] = {
+      {"skip_rate", stats.frames > 0 ? static_cast<double>(stats.skipped) /
+                                           stats.frames
+                                     : 0.0},
+      {"last_score", gate->gate.last_score()}};
+  for (const auto &field : rates) {
+    enif_make_map_put(env, stats_map, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &stats_map);
+  }
+  return fine_ok(env, fine::Term(stats_map));
+}
+
+// NIF function to letterbox a packed frame into a new
+// `target_width` x `target_height` RGB binary. Returns the binary together
+// with the geometry needed to map boxes back, see preprocess.hpp.
+fine::Term letterbox(ErlNifEnv *env, fine::Term frame_term,
+                     fine::Term opts_term) {
+  nx_hailo::Frame frame;
+  uint64_t target_width, target_height;
+  try {
+    frame = decode_frame(env, frame_term, opts_term);
+    target_width = get_map_field<uint64_t>(env, opts_term, "target_width", 0);
+    target_height = get_map_field<uint64_t>(env, opts_term, "target_height", 0);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid letterbox options");
+  }
+  if (target_width == 0 || target_height == 0) {
+    return fine_error_string(env, "Letterbox target must not be empty");
+  }
+
+  ERL_NIF_TERM binary;
+  auto *out = enif_make_new_binary(env, target_width * target_height * 3,
+                                   &binary);
+  nx_hailo::LetterboxGeometry geometry;
+  try {
+    geometry = nx_hailo::letterbox(frame, out, target_width, target_height);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+
+  return fine_ok(env, fine::Term(enif_make_tuple2(
+                          env, binary, build_letterbox_map(env, geometry))));
+}
+
+// NIF function to compute the letterbox geometry of a frame size without
+// touching any pixels, for inputs letterboxed inside infer
+fine::Term get_letterbox_geometry(ErlNifEnv *env, fine::Term opts_term) {
+  uint64_t width, height, target_width, target_height;
+  try {
+    width = get_map_field<uint64_t>(env, opts_term, "width", 0);
+    height = get_map_field<uint64_t>(env, opts_term, "height", 0);
+    target_width = get_map_field<uint64_t>(env, opts_term, "target_width", 0);
+    target_height = get_map_field<uint64_t>(env, opts_term, "target_height", 0);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid letterbox options");
+  }
+  if (width == 0 || height == 0 || target_width == 0 || target_height == 0) {
+    return fine_error_string(env, "Letterbox sizes must not be empty");
+  }
+
+  return fine_ok(env, fine::Term(build_letterbox_map(
+                          env, nx_hailo::letterbox_geometry(
+                                   width, height, target_width, target_height))));
+}
+
+// NIF function to decode a JPEG straight into a letterboxed model input.
+// The letterbox map refers to the full-size image, with the DCT scaling
+// the image was decoded at as `decode_scale`.
+fine::Term decode_jpeg(ErlNifEnv *env, fine::Term jpeg_term,
+                       fine::Term opts_term) {
+  ErlNifBinary jpeg;
+  uint64_t target_width, target_height;
+  try {
+    if (!enif_inspect_binary(env, jpeg_term, &jpeg)) {
+      return fine_error_string(env, "JPEG data must be a binary");
+    }
+    target_width = get_map_field<uint64_t>(env, opts_term, "target_width", 0);
+    target_height = get_map_field<uint64_t>(env, opts_term, "target_height", 0);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid JPEG decode options");
+  }
+  if (target_width == 0 || target_height == 0) {
+    return fine_error_string(env, "Letterbox target must not be empty");
+  }
+
+  ERL_NIF_TERM binary;
+  auto *out = enif_make_new_binary(env, target_width * target_height * 3,
+                                   &binary);
+  nx_hailo::JpegLetterbox decoded;
+  try {
+    decoded = nx_hailo::decode_jpeg_letterbox(jpeg.data, jpeg.size, out,
+                                              target_width, target_height);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+
+  ERL_NIF_TERM letterbox = build_letterbox_map(env, decoded.letterbox);
+  enif_make_map_put(env, letterbox,
+                    fine::encode(env, fine::Atom("decode_scale")),
+                    fine::encode(env, 1.0 / decoded.scale_denominator),
+                    &letterbox);
+  return fine_ok(env, fine::Term(enif_make_tuple2(env, binary, letterbox)));
+}
+
+// NIF function to draw packed detections over a copy of a frame: box
+// outlines, labels with the class name from the `labels` map, the track ID
+// from the `track_ids` binary and the score, and an `fps` badge. The copy
+// is packed RGB, or BGR for BGR frames, and is returned as is or, with a
+// `jpeg_quality`, JPEG encoded. Runs on a dirty CPU scheduler.
+fine::Term draw_overlay(ErlNifEnv *env, fine::Term frame_term,
+                        fine::Term detections_term, fine::Term opts_term) {
+  nx_hailo::Frame frame;
+  nx_hailo::OverlayParams params;
+  std::vector<nx_hailo::Detection> detections;
+  std::vector<uint32_t> track_ids;
+  std::vector<std::string> labels;
+  int64_t jpeg_quality;
+  try {
+    frame = decode_frame(env, frame_term, opts_term);
+
+    ErlNifBinary packed;
+    if (!enif_inspect_binary(env, detections_term, &packed) ||
+        packed.size % sizeof(nx_hailo::Detection) != 0) {
+      return fine_error_string(
+          env, "Detections must be a binary of packed float32 detections");
+    }
+    // The binary is not necessarily aligned for floats
+    detections.resize(packed.size / sizeof(nx_hailo::Detection));
+    if (packed.size > 0) {
+      std::memcpy(detections.data(), packed.data, packed.size);
+    }
+
+    ERL_NIF_TERM value;
+    if (get_map_value(env, opts_term, "track_ids", &value)) {
+      ErlNifBinary ids;
+      if (!enif_inspect_binary(env, value, &ids) ||
+          ids.size != detections.size() * sizeof(uint32_t)) {
+        return fine_error_string(
+            env, "Track IDs must be a binary of one uint32 per detection");
+      }
+      track_ids.resize(detections.size());
+      if (ids.size > 0) {
+        std::memcpy(track_ids.data(), ids.data, ids.size);
+      }
+    }
+    if (get_map_value(env, opts_term, "labels", &value)) {
+      for (auto [class_id, name] :
+           fine::decode<std::map<uint64_t, std::string>>(env, value)) {
+        if (class_id >= labels.size()) {
+          labels.resize(class_id + 1);
+        }
+        labels[class_id] = name;
+      }
+    }
+
+    params.thickness =
+        get_map_field<uint64_t>(env, opts_term, "thickness", params.thickness);
+    params.font_scale = get_map_field<uint64_t>(env, opts_term, "font_scale",
+                                                params.font_scale);
+    params.show_scores =
+        get_map_field<bool>(env, opts_term, "show_scores", params.show_scores);
+    params.fps = get_map_field<double>(env, opts_term, "fps", params.fps);
+    jpeg_quality = get_map_field<int64_t>(env, opts_term, "jpeg_quality", -1);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid overlay options");
+  }
+
+  ERL_NIF_TERM binary;
+  try {
+    nx_hailo::check_frame(frame);
+    size_t size = static_cast<size_t>(frame.width) * frame.height * 3;
+
+    // Raw output is drawn straight into the returned binary, JPEG output
+    // into a scratch image reused on the same scheduler thread
+    static thread_local std::vector<uint8_t> scratch;
+    uint8_t *pixels;
+    if (jpeg_quality < 0) {
+      pixels = enif_make_new_binary(env, size, &binary);
+    } else {
+      scratch.resize(size);
+      pixels = scratch.data();
+    }
+
+    nx_hailo::Canvas canvas{pixels, frame.width, frame.height,
+                            static_cast<size_t>(frame.width) * 3};
+    canvas.bgr = nx_hailo::copy_packed(frame, pixels) ==
+                 nx_hailo::PixelFormat::Bgr;
+    nx_hailo::draw_detections(canvas, detections, track_ids, labels, params);
+
+    if (jpeg_quality >= 0) {
+      static thread_local std::vector<uint8_t> jpeg;
+      // Out of range qualities stay out of range once narrowed
+      int quality = static_cast<int>(std::min<int64_t>(jpeg_quality, 101));
+      nx_hailo::encode_jpeg(pixels, canvas.width, canvas.height, canvas.stride,
+                            canvas.bgr, quality, jpeg);
+      std::memcpy(enif_make_new_binary(env, jpeg.size(), &binary), jpeg.data(),
+                  jpeg.size());
+    }
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+
+  return fine_ok(env, fine::Term(binary));
+}
+
+fine::Atom pixel_format_atom(nx_hailo::PixelFormat format) {
+  switch (format) {
+  case nx_hailo::PixelFormat::Rgb:
+    return fine::Atom("rgb");
+  case nx_hailo::PixelFormat::Bgr:
+    return fine::Atom("bgr");
+  case nx_hailo::PixelFormat::Yuyv:
+    return fine::Atom("yuyv");
+  case nx_hailo::PixelFormat::I420:
+    return fine::Atom("i420");
+  }
+  return fine::Atom("rgb");
+}
+
+// The frame options of a frame source layout, as taken by decode_frame
+ERL_NIF_TERM build_layout_map(ErlNifEnv *env,
+                              const nx_hailo::FrameLayout &layout) {
+  ERL_NIF_TERM map = enif_make_new_map(env);
+  std::pair<const char *, uint64_t> fields[] = {{"width", layout.width},
+                                                {"height", layout.height},
+                                                {"stride", layout.stride}};
+  for (const auto &field : fields) {
+    enif_make_map_put(env, map, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &map);
+  }
+  enif_make_map_put(env, map, fine::encode(env, fine::Atom("format")),
+                    fine::encode(env, pixel_format_atom(layout.format)), &map);
+  return map;
+}
+
+fine::Term make_frame_source(ErlNifEnv *env,
+                             std::unique_ptr<nx_hailo::FrameSource> source) {
+  auto resource = fine::make_resource<FrameSourceResource>();
+  resource->source = std::move(source);
+  return fine_ok(env, fine::Term(enif_make_tuple2(
+                          env, fine::encode(env, resource),
+                          build_layout_map(env, resource->source->layout()))));
+}
+
+// NIF function to start capturing from a V4L2 device
+fine::Term open_v4l2_source(ErlNifEnv *env, fine::Term path_term,
+                            fine::Term opts_term) {
+  std::string path;
+  nx_hailo::V4l2SourceParams params;
+  try {
+    path = fine::decode<std::string>(env, path_term);
+    params.width = get_map_field<uint64_t>(env, opts_term, "width",
+                                           params.width);
+    params.height = get_map_field<uint64_t>(env, opts_term, "height",
+                                            params.height);
+    params.buffer_count = get_map_field<uint64_t>(env, opts_term,
+                                                  "buffer_count",
+                                                  params.buffer_count);
+    ERL_NIF_TERM value;
+    if (get_map_value(env, opts_term, "format", &value)) {
+      params.format = decode_pixel_format(env, value);
+    }
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid V4L2 source options");
+  }
+
+  try {
+    return make_frame_source(env, nx_hailo::open_v4l2_source(path, params));
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+}
+
+// NIF function to play back a raw or Y4M video file as a frame source
+fine::Term open_file_source(ErlNifEnv *env, fine::Term path_term,
+                            fine::Term opts_term) {
+  std::string path;
+  nx_hailo::FileSourceParams params;
+  try {
+    path = fine::decode<std::string>(env, path_term);
+    params.layout.width = get_map_field<uint64_t>(env, opts_term, "width", 0);
+    params.layout.height = get_map_field<uint64_t>(env, opts_term, "height", 0);
+    ERL_NIF_TERM value;
+    if (get_map_value(env, opts_term, "format", &value)) {
+      params.layout.format = decode_pixel_format(env, value);
+    }
+    params.layout.stride = get_map_field<uint64_t>(env, opts_term, "stride", 0);
+    params.fps = get_map_field<double>(env, opts_term, "fps", params.fps);
+    params.loop = get_map_field<bool>(env, opts_term, "loop", params.loop);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid file source options");
+  }
+
+  try {
+    return make_frame_source(env, nx_hailo::open_file_source(path, params));
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+}
+
+// NIF function to read the newest frame of a source. The frame binary
+// points into the capture buffer or the mapped file, which is held until
+// the binary is garbage collected.
+fine::Term read_frame(ErlNifEnv *env, fine::Term source_term,
+                      fine::Term opts_term) {
+  fine::ResourcePtr<FrameSourceResource> source;
+  uint64_t after, timeout_ms;
+  try {
+    source = fine::decode<fine::ResourcePtr<FrameSourceResource>>(env,
+                                                                  source_term);
+    after = get_map_field<uint64_t>(env, opts_term, "after", 0);
+    timeout_ms = get_map_field<uint64_t>(env, opts_term, "timeout", 1000);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid frame source or read options");
+  }
+
+  std::shared_ptr<const nx_hailo::SourceFrame> frame;
+  try {
+    frame = source->source->latest(after, timeout_ms);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+  if (!frame) {
+    return fine_error_string(env, "Timed out waiting for a frame");
+  }
+
+  auto lease = fine::make_resource<FrameLeaseResource>();
+  lease->frame = frame;
+  const auto &pixels = frame->frame;
+  ERL_NIF_TERM binary = enif_make_resource_binary(
+      env, lease.get(), pixels.data, pixels.size);
+
+  ERL_NIF_TERM metadata = build_layout_map(
+      env, nx_hailo::FrameLayout{pixels.width, pixels.height, pixels.format,
+                                 pixels.stride});
+  std::pair<const char *, uint64_t> fields[] = {
+      {"sequence", frame->sequence}, {"timestamp_us", frame->timestamp_us}};
+  for (const auto &field : fields) {
+    enif_make_map_put(env, metadata, fine::encode(env, fine::Atom(field.first)),
+                      fine::encode(env, field.second), &metadata);
+  }
+  return fine_ok(env, fine::Term(enif_make_tuple2(env, binary, metadata)));
+}
+
+// Decodes the quantized frame and channel options of the dequantize and
+// threshold_quantized NIFs
+nx_hailo::QuantizedTensor decode_quantized(ErlNifEnv *env,
+                                           const ErlNifBinary &data,
+                                           ERL_NIF_TERM opts,
+                                           nx_hailo::ChannelRange &range) {
+  nx_hailo::QuantizedTensor tensor;
+  tensor.data = data.data;
+  tensor.size = data.size;
+  ERL_NIF_TERM value;
+  tensor.type = get_map_value(env, opts, "format_type", &value)
+                    ? decode_format_type(env, value)
+                    : nx_hailo::FormatType::Uint8;
+  tensor.zero_point = get_map_field<double>(env, opts, "qp_zp", 0.0);
+  tensor.scale = get_map_field<double>(env, opts, "qp_scale", 1.0);
+  tensor.features = get_map_field<uint64_t>(env, opts, "features", 0);
+  if (get_map_value(env, opts, "channels", &value)) {
+    auto [first, count] =
+        fine::decode<std::tuple<uint64_t, uint64_t>>(env, value);
+    range.first = first;
+    range.count = count;
+  }
+  return tensor;
+}
+
+// NIF function to dequantize a raw uint8/uint16 output frame into a float32
+// binary, optionally keeping only a range of channels
+fine::Term dequantize(ErlNifEnv *env, fine::Term data_term,
+                      fine::Term opts_term) {
+  ErlNifBinary data;
+  if (!enif_inspect_binary(env, data_term, &data)) {
+    return fine_error_string(env, "Quantized data must be a binary");
+  }
+
+  nx_hailo::QuantizedTensor tensor;
+  nx_hailo::ChannelRange range;
+  try {
+    tensor = decode_quantized(env, data, opts_term, range);
+    range = nx_hailo::check_quantized(tensor, range);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid dequantize options");
+  }
+
+  ERL_NIF_TERM binary;
+  auto *out = enif_make_new_binary(
+      env, nx_hailo::selected_count(tensor, range) * sizeof(float), &binary);
+  nx_hailo::dequantize(tensor, range, reinterpret_cast<float *>(out));
+  return fine_ok(env, fine::Term(binary));
+}
+
+// NIF function to find the elements of a raw uint8/uint16 output frame whose
+// dequantized value is at least `threshold`, without dequantizing the rest.
+// Returns the flat element indices as uint32 and the values as float32.
+fine::Term threshold_quantized(ErlNifEnv *env, fine::Term data_term,
+                               fine::Term opts_term) {
+  ErlNifBinary data;
+  if (!enif_inspect_binary(env, data_term, &data)) {
+    return fine_error_string(env, "Quantized data must be a binary");
+  }
+
+  nx_hailo::QuantizedTensor tensor;
+  nx_hailo::ChannelRange range;
+  double threshold;
+  try {
+    tensor = decode_quantized(env, data, opts_term, range);
+    range = nx_hailo::check_quantized(tensor, range);
+    threshold = get_map_field<double>(env, opts_term, "threshold", 0.0);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid threshold options");
+  }
+
+  std::vector<uint32_t> indices;
+  std::vector<float> values;
+  nx_hailo::threshold_quantized(tensor, range, static_cast<float>(threshold),
+                                indices, values);
+
+  ERL_NIF_TERM indices_binary, values_binary;
+  auto *indices_data = enif_make_new_binary(
+      env, indices.size() * sizeof(uint32_t), &indices_binary);
+  auto *values_data = enif_make_new_binary(
+      env, values.size() * sizeof(float), &values_binary);
+  if (!indices.empty()) {
+    std::memcpy(indices_data, indices.data(),
+                indices.size() * sizeof(uint32_t));
+    std::memcpy(values_data, values.data(), values.size() * sizeof(float));
+  }
+  return fine_ok(env, fine::Term(enif_make_tuple2(env, indices_binary,
+                                                  values_binary)));
+}
+
+// NIF function to select the `top_k` best classes of a classification
+// output without converting it to floats. Raw uint8/uint16 frames are
+// selected on the integers and only the winners dequantized, float32 frames
+// are scanned as is. With `softmax`, the scores are softmaxed over the
+// selected classes. Returns `[{class_index, score}]`, best first.
+fine::Term classify_top_k(ErlNifEnv *env, fine::Term data_term,
+                          fine::Term opts_term) {
+  ErlNifBinary data;
+  if (!enif_inspect_binary(env, data_term, &data)) {
+    return fine_error_string(env, "Classification output must be a binary");
+  }
+
+  nx_hailo::QuantizedTensor tensor;
+  nx_hailo::ChannelRange range;
+  uint64_t top_k;
+  bool softmax;
+  try {
+    tensor = decode_quantized(env, data, opts_term, range);
+    top_k = get_map_field<uint64_t>(env, opts_term, "top_k", 5);
+    softmax = get_map_field<bool>(env, opts_term, "softmax", false);
+    if (tensor.type != nx_hailo::FormatType::Float32) {
+      nx_hailo::check_quantized(tensor, range);
+    } else if (data.size % sizeof(float) != 0) {
+      throw nx_hailo::Error("Float32 output size " +
+                            std::to_string(data.size) +
+                            " is not a whole number of values");
+    }
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid classification options");
+  }
+
+  std::vector<uint32_t> indices;
+  std::vector<float> values;
+  if (tensor.type == nx_hailo::FormatType::Float32) {
+    nx_hailo::top_k_float(data.data, data.size / sizeof(float), top_k,
+                          indices, values);
+  } else {
+    nx_hailo::top_k_quantized(tensor, top_k, indices, values);
+  }
+
+  if (softmax && !values.empty()) {
+    // Subtracting the largest value keeps the exponentials in range
+    float max_value = values.front();
+    double sum = 0;
+    for (auto &value : values) {
+      value = std::exp(value - max_value);
+      sum += value;
+    }
+    for (auto &value : values) {
+      value /= sum;
+    }
+  }
+
+  std::vector<std::tuple<uint64_t, double>> classes;
+  for (size_t i = 0; i < indices.size(); i++) {
+    classes.emplace_back(indices[i], values[i]);
+  }
+  return fine_ok(env, classes);
+}
+
+// Decodes one `%{data: binary, format_type:, qp_zp:, qp_scale:}` output of a
+// YOLOv8 head scale, read in place
+nx_hailo::QuantizedTensor decode_head_output(ErlNifEnv *env,
+                                             ERL_NIF_TERM scale,
+                                             const char *key) {
+  ERL_NIF_TERM output, data_term;
+  ErlNifBinary data;
+  if (!get_map_value(env, scale, key, &output) ||
+      !get_map_value(env, output, "data", &data_term) ||
+      !enif_inspect_binary(env, data_term, &data)) {
+    throw nx_hailo::Error(std::string("YOLOv8 head scales need ") + key +
+                          " data as a binary");
+  }
+  nx_hailo::ChannelRange range;
+  return decode_quantized(env, data, output, range);
+}
+
+// NIF function to decode the raw box and score outputs of a YOLOv8 head
+// compiled without on-chip NMS, see nx_hailo::decode_yolov8_head. Returns
+// the packed detections of parse_nms_detections, best first, optionally
+// remapped from the model input into frame pixels.
+fine::Term decode_yolov8_head(ErlNifEnv *env, fine::Term scales_term,
+                              fine::Term opts_term) {
+  std::vector<nx_hailo::YoloHeadScale> scales;
+  nx_hailo::YoloHeadParams params;
+  nx_hailo::DetectionFilter filter;
+  bool remap_boxes = false;
+  nx_hailo::BoxRemap remap;
+  try {
+    params.input_width = get_map_field<uint64_t>(env, opts_term, "input_width",
+                                                 params.input_width);
+    params.input_height = get_map_field<uint64_t>(
+        env, opts_term, "input_height", params.input_height);
+    params.number_of_classes = get_map_field<uint64_t>(
+        env, opts_term, "number_of_classes", params.number_of_classes);
+    params.reg_max =
+        get_map_field<uint64_t>(env, opts_term, "reg_max", params.reg_max);
+    params.sigmoid =
+        get_map_field<bool>(env, opts_term, "sigmoid", params.sigmoid);
+    params.iou_threshold = get_map_field<double>(
+        env, opts_term, "iou_threshold", params.iou_threshold);
+    params.max_candidates = get_map_field<uint64_t>(
+        env, opts_term, "max_candidates", params.max_candidates);
+    filter = decode_detection_filter(env, opts_term, params.number_of_classes);
+
+    ERL_NIF_TERM value;
+    if (get_map_value(env, opts_term, "remap", &value)) {
+      remap_boxes = true;
+      remap = decode_box_remap(env, value);
+    }
+
+    for (auto scale : fine::decode<std::vector<fine::Term>>(env, scales_term)) {
+      nx_hailo::YoloHeadScale head_scale;
+      head_scale.boxes = decode_head_output(env, scale, "boxes");
+      head_scale.scores = decode_head_output(env, scale, "scores");
+      head_scale.width = get_map_field<uint64_t>(env, scale, "width", 0);
+      head_scale.height = get_map_field<uint64_t>(env, scale, "height", 0);
+      scales.push_back(head_scale);
+    }
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid YOLOv8 head options");
+  }
+
+  std::vector<nx_hailo::Detection> detections;
+  try {
+    nx_hailo::decode_yolov8_head(scales, params, filter, detections);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+
+  if (remap_boxes) {
+    nx_hailo::remap_boxes(detections, remap);
+  }
+  return fine_ok(env, fine::Term(make_detections_binary(env, detections)));
+}
+
+void send_stream_reply(StreamRequest &request, ERL_NIF_TERM result) {
+  enif_send(nullptr, &request.caller, request.env,
+            enif_make_tuple2(request.env, request.ref, result));
+  enif_free_env(request.env);
+  request.env = nullptr;
+}
+
+// Marks the stream pipeline as failed and aborts it, which unblocks the
+// other thread. Returns the error every request gets from then on.
+std::string fail_stream(StreamPipelineResource *res, const std::string &reason) {
+  std::string failure;
+  {
+    std::lock_guard<std::mutex> lock(res->mutex);
+    if (res->failure.empty()) {
+      res->failure = "Stream pipeline failed: " + reason;
+    }
+    failure = res->failure;
+  }
+  res->stream->abort();
+  return failure;
+}
+
+void run_stream_writer(StreamPipelineResource *res) {
+  const auto &input_infos = res->stream->input_infos();
+
+  std::unique_lock<std::mutex> lock(res->mutex);
+  while (true) {
+    res->cv.wait(lock, [res] {
+      return res->stopping ||
+             (!res->submitted.empty() && res->in_flight.size() < res->depth);
+    });
+    if (res->stopping) {
+      return;
+    }
+
+    StreamRequest request = std::move(res->submitted.front());
+    res->submitted.pop_front();
+    request.error = res->failure;
+    lock.unlock();
+
+    if (request.error.empty()) {
+      bool collected = false;
+      try {
+        collect_input_buffers(request.env, request.inputs, input_infos,
+                              res->input_staging, res->input_buffers);
+        collected = true;
+        for (size_t i = 0; i < input_infos.size(); i++) {
+          res->stream->write(i, res->input_buffers[i]);
+        }
+      } catch (const std::exception &e) {
+        // Invalid inputs fail before anything is written, while a failed
+        // write may leave the other inputs a frame behind
+        request.error = collected ? fail_stream(res, e.what()) : e.what();
+      }
+    }
+
+    lock.lock();
+    res->in_flight.push_back(std::move(request));
+    res->cv.notify_all();
+  }
+}
+
+void run_stream_reader(StreamPipelineResource *res) {
+  const auto &output_infos = res->stream->output_infos();
+  std::vector<nx_hailo::MutableBuffer> output_buffers;
+
+  std::unique_lock<std::mutex> lock(res->mutex);
+  while (true) {
+    res->cv.wait(lock,
+                 [res] { return res->stopping || !res->in_flight.empty(); });
+    if (res->stopping) {
+      return;
+    }
+
+    // References into a deque survive the writer's push_back
+    StreamRequest &request = res->in_flight.front();
+    if (request.error.empty()) {
+      request.error = res->failure;
+    }
+    lock.unlock();
+
+    ERL_NIF_TERM result;
+    if (!request.error.empty()) {
+      result = fine_error_string(request.env, request.error);
+    } else {
+      try {
+        auto outputs = acquire_output_buffers(output_infos, res->output_pools,
+                                              1, 1, output_buffers);
+        for (size_t i = 0; i < output_infos.size(); i++) {
+          res->stream->read(i, output_buffers[i]);
+        }
+        result = fine_ok(request.env,
+                         fine::Term(build_output_map(request.env, output_infos,
+                                                     outputs, 0)));
+      } catch (const std::exception &e) {
+        // The outputs of this frame were not all read, so the next ones
+        // would be paired with the wrong request
+        result = fine_error_string(request.env, fail_stream(res, e.what()));
+      }
+    }
+    send_stream_reply(request, result);
+
+    lock.lock();
+    res->in_flight.pop_front();
+    res->cv.notify_all();
+  }
+}
+
+StreamPipelineResource::~StreamPipelineResource() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  if (stream) {
+    stream->abort();
+  }
+  cv.notify_all();
+  if (writer.joinable()) {
+    writer.join();
+  }
+  if (reader.joinable()) {
+    reader.join();
+  }
+
+  // Whatever was still queued never completed, let the submitters know
+  for (auto *queue : {&in_flight, &submitted}) {
+    for (auto &request : *queue) {
+      send_stream_reply(request,
+                        fine_error_string(request.env, "Pipeline was released"));
+    }
+  }
+}
+
+// NIF function to create a streaming pipeline from a network group
+fine::Term create_stream_pipeline(ErlNifEnv *env, fine::Term network_group_term,
+                                  fine::Term opts_term) {
+  fine::ResourcePtr<NetworkGroupResource> ng_res;
+  try {
+    ng_res = fine::decode<fine::ResourcePtr<NetworkGroupResource>>(
+        env, network_group_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid network group resource");
+  }
+
+  uint64_t depth, output_pool_size;
+  nx_hailo::PipelineParams params;
+  try {
+    depth = get_map_field<uint64_t>(env, opts_term, "depth", 4);
+    params.queue_size = depth;
+    decode_pipeline_params(env, opts_term, params);
+    output_pool_size =
+        get_map_field<uint64_t>(env, opts_term, "output_pool_size", depth);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid stream pipeline options");
+  }
+  if (depth == 0) {
+    return fine_error_string(env, "Stream pipeline depth must be positive");
+  }
+
+  std::unique_ptr<nx_hailo::StreamPipeline> stream;
+  try {
+    stream = ng_res->network_group->create_stream_pipeline(params);
+  } catch (const nx_hailo::Error &e) {
+    return fine_error_string(env, e.what());
+  }
+
+  auto resource = fine::make_resource<StreamPipelineResource>();
+  resource->stream = std::move(stream);
+  resource->network_group = ng_res->network_group;
+  resource->depth = depth;
+  for (const auto &info : resource->stream->output_infos()) {
+    resource->output_pools.push_back(std::make_shared<nx_hailo::BufferPool>(
+        info.frame_size, output_pool_size));
+  }
+  resource->input_staging.resize(resource->stream->input_infos().size());
+
+  // The threads are joined in the resource destructor, so the raw pointer
+  // outlives them
+  StreamPipelineResource *res = resource.get();
+  res->writer = std::thread(run_stream_writer, res);
+  res->reader = std::thread(run_stream_reader, res);
+
+  return fine_ok(env, resource);
+}
+
+// NIF function to queue a request on a stream pipeline. Returns :ok right
+// away; the caller later receives `{ref, {:ok, outputs} | {:error, reason}}`,
+// in submission order.
+fine::Term stream_submit(ErlNifEnv *env, fine::Term stream_term,
+                         fine::Term input_data_term, fine::Term ref_term) {
+  fine::ResourcePtr<StreamPipelineResource> stream_res;
+  try {
+    stream_res = fine::decode<fine::ResourcePtr<StreamPipelineResource>>(
+        env, stream_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid stream pipeline resource");
+  }
+
+  StreamRequest request;
+  enif_self(env, &request.caller);
+  request.env = enif_alloc_env();
+  request.inputs = enif_make_copy(request.env, input_data_term);
+  request.ref = enif_make_copy(request.env, ref_term);
+
+  {
+    std::lock_guard<std::mutex> lock(stream_res->mutex);
+    if (!stream_res->failure.empty()) {
+      enif_free_env(request.env);
+      return fine_error_string(env, stream_res->failure);
+    }
+    stream_res->submitted.push_back(std::move(request));
+  }
+  stream_res->cv.notify_all();
+
+  return fine::encode(env, fine::Atom("ok"));
+}
+
+fine::Term get_input_vstream_infos_from_stream_pipeline(ErlNifEnv *env,
+                                                        fine::Term stream_term) {
+  fine::ResourcePtr<StreamPipelineResource> stream_res;
+  try {
+    stream_res = fine::decode<fine::ResourcePtr<StreamPipelineResource>>(
+        env, stream_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid stream pipeline resource");
+  }
+
+  return fine_ok(env, fine::Term(build_vstream_info_list(
+                          env, stream_res->stream->input_infos())));
+}
+
+fine::Term get_output_vstream_infos_from_stream_pipeline(ErlNifEnv *env,
+                                                         fine::Term stream_term) {
+  fine::ResourcePtr<StreamPipelineResource> stream_res;
+  try {
+    stream_res = fine::decode<fine::ResourcePtr<StreamPipelineResource>>(
+        env, stream_term);
+  } catch (const std::exception &e) {
+    return fine_error_string(env, "Invalid stream pipeline resource");
   }
 
-  return fine_ok(env, output_map);
+  return fine_ok(env, fine::Term(build_vstream_info_list(
+                          env, stream_res->stream->output_infos())));
 }
 
 // Register NIF functions
 FINE_NIF(load_network_group, 1);
 FINE_NIF(create_pipeline, 1);
+FINE_NIF(get_output_pool_stats, 0);
 FINE_NIF(get_output_vstream_infos_from_pipeline, 1);
 FINE_NIF(infer, 2);
+FINE_NIF(infer_timed_async, 0);
+FINE_NIF(get_pipeline_stats, 0);
+FINE_NIF(infer_async, 0);
+FINE_NIF(infer_batch_async, 0);
+FINE_NIF(create_stream_pipeline, 1);
+FINE_NIF(stream_submit, 0);
+FINE_NIF(get_input_vstream_infos_from_stream_pipeline, 0);
+FINE_NIF(get_output_vstream_infos_from_stream_pipeline, 0);
 FINE_NIF(create_vdevice, 0);
+FINE_NIF(scan_devices, 0);
+FINE_NIF(create_simulated_vdevice, 0);
 FINE_NIF(configure_network_group, 2);
+FINE_NIF(load, ERL_NIF_DIRTY_JOB_IO_BOUND);
+FINE_NIF(get_hef_cache_stats, 0);
+FINE_NIF(get_scheduler_stats, 0);
 FINE_NIF(get_input_vstream_infos_from_ng, 1);
 FINE_NIF(get_output_vstream_infos_from_ng, 1);
 FINE_NIF(get_input_vstream_infos_from_pipeline, 1);
+FINE_NIF(parse_nms_detections, 0);
+FINE_NIF(get_tile_grid, 0);
+FINE_NIF(merge_tile_detections, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(create_tracker, 0);
+FINE_NIF(tracker_update, 0);
+FINE_NIF(get_tracker_stats, 0);
+FINE_NIF(create_motion_gate, 0);
+FINE_NIF(motion_gate_check, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(motion_gate_store, 0);
+FINE_NIF(motion_gate_reset, 0);
+FINE_NIF(get_motion_gate_stats, 0);
+FINE_NIF(letterbox, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(get_letterbox_geometry, 0);
+FINE_NIF(decode_jpeg, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(draw_overlay, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(open_v4l2_source, ERL_NIF_DIRTY_JOB_IO_BOUND);
+FINE_NIF(open_file_source, ERL_NIF_DIRTY_JOB_IO_BOUND);
+FINE_NIF(read_frame, ERL_NIF_DIRTY_JOB_IO_BOUND);
+FINE_NIF(dequantize, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(threshold_quantized, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+FINE_NIF(classify_top_k, 0);
+FINE_NIF(decode_yolov8_head, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 
 FINE_INIT("Elixir.NxHailo.NIF");
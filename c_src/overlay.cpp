@@ -0,0 +1,237 @@
+#include "overlay.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace nx_hailo {
+
+namespace {
+
+constexpr int kGlyphWidth = 5;
+constexpr int kGlyphHeight = 7;
+constexpr int kFirstGlyph = ' ';
+constexpr int kGlyphCount = '~' - ' ' + 1;
+
+// The classic 5x7 font for printable ASCII, one byte per column with the
+// top row in the lowest bit
+constexpr uint8_t kFont[kGlyphCount][kGlyphWidth] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00},
+    {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14},
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00},
+    {0x08, 0x2A, 0x1C, 0x2A, 0x08}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08},
+    {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31},
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39},
+    {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E},
+    {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06},
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E},
+    {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41},
+    {0x7F, 0x09, 0x09, 0x09, 0x01}, {0x3E, 0x41, 0x49, 0x49, 0x7A},
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41},
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x0C, 0x02, 0x7F},
+    {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E},
+    {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F},
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x07, 0x08, 0x70, 0x08, 0x07},
+    {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00},
+    {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},
+    {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20},
+    {0x38, 0x44, 0x44, 0x48, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18},
+    {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x0C, 0x52, 0x52, 0x52, 0x3E},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00},
+    {0x20, 0x40, 0x44, 0x3D, 0x00}, {0x7F, 0x10, 0x28, 0x44, 0x00},
+    {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38},
+    {0x7C, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7C},
+    {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C},
+    {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C},
+    {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C},
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00},
+    {0x00, 0x00, 0x7F, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00},
+    {0x08, 0x04, 0x08, 0x10, 0x08}};
+
+// The font transposed into row-major bitmaps at compile time, bit c of
+// `rows[g][r]` being column c of row r of glyph g, so that drawing a glyph
+// scans one byte per row and skips blank rows outright
+struct GlyphAtlas {
+  uint8_t rows[kGlyphCount][kGlyphHeight];
+};
+
+constexpr GlyphAtlas bake_atlas() {
+  GlyphAtlas atlas{};
+  for (int g = 0; g < kGlyphCount; g++) {
+    for (int c = 0; c < kGlyphWidth; c++) {
+      for (int r = 0; r < kGlyphHeight; r++) {
+        if (kFont[g][c] & (1 << r)) {
+          atlas.rows[g][r] |= 1 << c;
+        }
+      }
+    }
+  }
+  return atlas;
+}
+
+constexpr GlyphAtlas kAtlas = bake_atlas();
+
+// Ultralytics palette, distinct enough for neighbouring class ids
+constexpr Color kPalette[] = {
+    {0xFF, 0x38, 0x38}, {0xFF, 0x9D, 0x97}, {0xFF, 0x70, 0x1F},
+    {0xFF, 0xB2, 0x1D}, {0xCF, 0xD2, 0x31}, {0x48, 0xF9, 0x0A},
+    {0x92, 0xCC, 0x17}, {0x3D, 0xDB, 0x86}, {0x1A, 0x93, 0x34},
+    {0x00, 0xD4, 0xBB}, {0x2C, 0x99, 0xA8}, {0x00, 0xC2, 0xFF},
+    {0x34, 0x45, 0x93}, {0x64, 0x73, 0xFF}, {0x00, 0x18, 0xEC},
+    {0x84, 0x38, 0xFF}, {0x52, 0x00, 0x85}, {0xCB, 0x38, 0xFF},
+    {0xFF, 0x95, 0xC8}, {0xFF, 0x37, 0xC7}};
+
+constexpr Color kWhite = {0xFF, 0xFF, 0xFF};
+constexpr Color kBlack = {0x00, 0x00, 0x00};
+constexpr Color kBadgeColor = {0x00, 0x00, 0xFF};
+
+// Black text on light backgrounds, white on dark ones
+Color text_color(Color background) {
+  int luma = 299 * background.r + 587 * background.g + 114 * background.b;
+  return luma > 150 * 1000 ? kBlack : kWhite;
+}
+
+// Text on a filled rectangle padded by `scale` pixels, with its top-left
+// corner at (x, y) moved inside the canvas where possible
+void draw_label(const Canvas &canvas, int64_t x, int64_t y,
+                const std::string &text, uint32_t scale, Color background) {
+  int64_t width = text_width(text, scale) + 2 * scale;
+  int64_t height = text_height(scale) + 2 * scale;
+  x = std::max<int64_t>(0, std::min<int64_t>(x, int64_t(canvas.width) - width));
+  y = std::max<int64_t>(0,
+                        std::min<int64_t>(y, int64_t(canvas.height) - height));
+  fill_rect(canvas, x, y, x + width, y + height, background);
+  draw_text(canvas, x + scale, y + scale, text, scale, text_color(background));
+}
+
+} // namespace
+
+Color class_color(uint32_t class_id) {
+  return kPalette[class_id % (sizeof(kPalette) / sizeof(kPalette[0]))];
+}
+
+void fill_rect(const Canvas &canvas, int64_t x0, int64_t y0, int64_t x1,
+               int64_t y1, Color color) {
+  x0 = std::max<int64_t>(x0, 0);
+  y0 = std::max<int64_t>(y0, 0);
+  x1 = std::min<int64_t>(x1, canvas.width);
+  y1 = std::min<int64_t>(y1, canvas.height);
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  const uint8_t pixel[3] = {canvas.bgr ? color.b : color.r, color.g,
+                            canvas.bgr ? color.r : color.b};
+  for (int64_t y = y0; y < y1; y++) {
+    uint8_t *out = canvas.data + canvas.stride * y + x0 * 3;
+    for (int64_t x = x0; x < x1; x++, out += 3) {
+      out[0] = pixel[0];
+      out[1] = pixel[1];
+      out[2] = pixel[2];
+    }
+  }
+}
+
+uint32_t text_width(const std::string &text, uint32_t scale) {
+  // One blank column between glyphs
+  return text.empty() ? 0 : (text.size() * (kGlyphWidth + 1) - 1) * scale;
+}
+
+uint32_t text_height(uint32_t scale) { return kGlyphHeight * scale; }
+
+void draw_text(const Canvas &canvas, int64_t x, int64_t y,
+               const std::string &text, uint32_t scale, Color color) {
+  for (unsigned char ch : text) {
+    int glyph = ch >= kFirstGlyph && ch < kFirstGlyph + kGlyphCount
+                    ? ch - kFirstGlyph
+                    : '?' - kFirstGlyph;
+    for (int r = 0; r < kGlyphHeight; r++) {
+      uint8_t bits = kAtlas.rows[glyph][r];
+      for (int c = 0; bits != 0; c++, bits >>= 1) {
+        if (bits & 1) {
+          int64_t px = x + c * scale, py = y + r * scale;
+          fill_rect(canvas, px, py, px + scale, py + scale, color);
+        }
+      }
+    }
+    x += (kGlyphWidth + 1) * scale;
+  }
+}
+
+void draw_detections(const Canvas &canvas,
+                     const std::vector<Detection> &detections,
+                     const std::vector<uint32_t> &track_ids,
+                     const std::vector<std::string> &labels,
+                     const OverlayParams &params) {
+  const int64_t t = params.thickness;
+  const uint32_t scale = std::max<uint32_t>(params.font_scale, 1);
+  char buffer[32];
+
+  for (size_t i = detections.size(); i-- > 0;) {
+    const auto &detection = detections[i];
+    auto class_id = static_cast<uint32_t>(std::max(detection.class_id, 0.0f));
+    Color color = class_color(class_id);
+
+    if (!std::isfinite(detection.xmin) || !std::isfinite(detection.ymin) ||
+        !std::isfinite(detection.xmax) || !std::isfinite(detection.ymax)) {
+      continue;
+    }
+    int64_t x0 = std::llround(detection.xmin);
+    int64_t y0 = std::llround(detection.ymin);
+    int64_t x1 = std::llround(detection.xmax);
+    int64_t y1 = std::llround(detection.ymax);
+    if (x1 <= x0 || y1 <= y0) {
+      continue;
+    }
+    fill_rect(canvas, x0, y0, x1, y0 + t, color);
+    fill_rect(canvas, x0, y1 - t, x1, y1, color);
+    fill_rect(canvas, x0, y0, x0 + t, y1, color);
+    fill_rect(canvas, x1 - t, y0, x1, y1, color);
+
+    std::string label;
+    if (!track_ids.empty() && track_ids[i] != 0) {
+      std::snprintf(buffer, sizeof(buffer), "#%u ", track_ids[i]);
+      label += buffer;
+    }
+    if (class_id < labels.size() && !labels[class_id].empty()) {
+      label += labels[class_id];
+    } else {
+      label += std::to_string(class_id);
+    }
+    if (params.show_scores) {
+      std::snprintf(buffer, sizeof(buffer), " %d%%",
+                    static_cast<int>(std::lround(detection.score * 100)));
+      label += buffer;
+    }
+
+    // Above the box, or inside it when the box touches the top edge
+    int64_t label_height = text_height(scale) + 2 * scale;
+    int64_t label_y = y0 >= label_height ? y0 - label_height : y0;
+    draw_label(canvas, x0, label_y, label, scale, color);
+  }
+
+  if (params.fps >= 0) {
+    std::snprintf(buffer, sizeof(buffer), "%.1f FPS", params.fps);
+    std::string text = buffer;
+    draw_label(canvas, canvas.width, canvas.height, text, scale, kBadgeColor);
+  }
+}
+
+} // namespace nx_hailo
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "detections.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nx_hailo {
+
+struct Color {
+  uint8_t r, g, b;
+};
+
+// A packed image of 3 bytes per pixel, drawn on in place
+struct Canvas {
+  uint8_t *data;
+  uint32_t width;
+  uint32_t height;
+  size_t stride;
+  // Channel order of the pixels, RGB unless set
+  bool bgr = false;
+};
+
+struct OverlayParams {
+  // Width of the box outlines in pixels
+  uint32_t thickness = 2;
+  // Glyphs are 5x7 pixels, drawn `font_scale` times larger
+  uint32_t font_scale = 2;
+  // Appends the score in percent to the labels
+  bool show_scores = true;
+  // Frames per second shown in a badge in the bottom-right corner, none
+  // when negative
+  double fps = -1;
+};
+
+// Colour of the boxes of a class, from a fixed palette
+Color class_color(uint32_t class_id);
+
+// Fills the pixels in [x0, x1) x [y0, y1), clipped to the canvas
+void fill_rect(const Canvas &canvas, int64_t x0, int64_t y0, int64_t x1,
+               int64_t y1, Color color);
+
+// Size in pixels of `text` drawn by draw_text
+uint32_t text_width(const std::string &text, uint32_t scale);
+uint32_t text_height(uint32_t scale);
+
+// Draws `text` with its top-left corner at (x, y) in the built-in 5x7
+// font, clipped to the canvas. Characters outside printable ASCII are drawn
+// as '?'.
+void draw_text(const Canvas &canvas, int64_t x, int64_t y,
+               const std::string &text, uint32_t scale, Color color);
+
+// Draws the outline of each detection with a label of its track ID, class
+// and score, plus the FPS badge. Coordinates are canvas pixels, as returned
+// by the YoloV8 parser with a letterbox or input shape. `labels` holds the
+// class names by class id, missing ones are labelled with the id, and
+// `track_ids` is empty or holds one ID per detection, 0 for none.
+// Detections come best first, so they are drawn in reverse and the best
+// ones end up on top.
+void draw_detections(const Canvas &canvas,
+                     const std::vector<Detection> &detections,
+                     const std::vector<uint32_t> &track_ids,
+                     const std::vector<std::string> &labels,
+                     const OverlayParams &params);
+
+} // namespace nx_hailo
@@ -0,0 +1,345 @@
+#include "preprocess.hpp"
+#include "backend.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace nx_hailo {
+
+size_t bytes_per_pixel(PixelFormat format) {
+  switch (format) {
+  case PixelFormat::Yuyv:
+    return 2;
+  case PixelFormat::I420:
+    return 1;
+  default:
+    return 3;
+  }
+}
+
+size_t frame_span(PixelFormat format, uint32_t width, uint32_t height,
+                  size_t stride) {
+  if (format == PixelFormat::I420) {
+    size_t chroma_stride = (stride + 1) / 2;
+    size_t chroma_height = (height + 1) / 2;
+    return stride * height + 2 * chroma_stride * chroma_height;
+  }
+  return stride * (height - 1) + width * bytes_per_pixel(format);
+}
+
+void check_frame(const Frame &frame) {
+  if (frame.width == 0 || frame.height == 0) {
+    throw Error("Frame must not be empty");
+  }
+  if (frame.format == PixelFormat::Yuyv && frame.width % 2 != 0) {
+    throw Error("YUYV frames must have an even width");
+  }
+  size_t row_size = frame.width * bytes_per_pixel(frame.format);
+  if (frame.stride < row_size) {
+    throw Error("Frame stride " + std::to_string(frame.stride) +
+                " is smaller than a row of " + std::to_string(row_size) +
+                " bytes");
+  }
+  size_t expected =
+      frame_span(frame.format, frame.width, frame.height, frame.stride);
+  if (frame.size < expected) {
+    throw Error("Frame is too small. Expected at least: " +
+                std::to_string(expected) +
+                ", Got: " + std::to_string(frame.size));
+  }
+}
+
+Frame crop_frame(const Frame &frame, const CropRect &rect) {
+  check_frame(frame);
+  if (rect.width == 0 || rect.height == 0 || rect.x >= frame.width ||
+      rect.y >= frame.height || rect.width > frame.width - rect.x ||
+      rect.height > frame.height - rect.y) {
+    throw Error("Crop " + std::to_string(rect.width) + "x" +
+                std::to_string(rect.height) + " at (" +
+                std::to_string(rect.x) + ", " + std::to_string(rect.y) +
+                ") does not fit in the " + std::to_string(frame.width) + "x" +
+                std::to_string(frame.height) + " frame");
+  }
+  if (frame.format == PixelFormat::I420) {
+    throw Error("I420 frames cannot be cropped");
+  }
+  if (frame.format == PixelFormat::Yuyv &&
+      (rect.x % 2 != 0 || rect.width % 2 != 0)) {
+    throw Error("YUYV crops must start and end on even columns");
+  }
+
+  size_t offset = rect.y * frame.stride + rect.x * bytes_per_pixel(frame.format);
+  Frame crop = frame;
+  crop.data = frame.data + offset;
+  crop.size = frame.size - offset;
+  crop.width = rect.width;
+  crop.height = rect.height;
+  return crop;
+}
+
+namespace {
+
+// Origins of the tiles along one axis, see tile_grid
+std::vector<uint32_t> tile_origins(uint32_t size, uint32_t tile,
+                                   double overlap, uint32_t alignment) {
+  if (tile >= size) {
+    return {0};
+  }
+  uint32_t step = std::max<uint32_t>(
+      1, static_cast<uint32_t>(std::floor(tile * (1.0 - overlap))));
+  uint32_t count = (size - tile + step - 1) / step + 1;
+
+  std::vector<uint32_t> origins(count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t origin = static_cast<uint64_t>(size - tile) * i / (count - 1);
+    origins[i] = static_cast<uint32_t>(origin - origin % alignment);
+  }
+  // Rounding the last origin down would leave a strip at the frame edge
+  // uncovered, so it is rounded up instead and tile_grid shrinks its tile
+  uint32_t last = size - tile;
+  if (last % alignment != 0) {
+    uint64_t aligned = static_cast<uint64_t>(last) + alignment -
+                       last % alignment;
+    origins.back() = aligned < size ? static_cast<uint32_t>(aligned) : last;
+  }
+  return origins;
+}
+
+} // namespace
+
+std::vector<CropRect> tile_grid(uint32_t width, uint32_t height,
+                                uint32_t tile_width, uint32_t tile_height,
+                                double overlap, uint32_t alignment) {
+  if (width == 0 || height == 0 || tile_width == 0 || tile_height == 0) {
+    throw Error("Tiled frames and tiles must not be empty");
+  }
+  if (!(overlap >= 0.0 && overlap < 1.0)) {
+    throw Error("Tile overlap must be at least 0 and below 1");
+  }
+  alignment = std::max<uint32_t>(alignment, 1);
+  tile_width = std::min(tile_width, width);
+  tile_height = std::min(tile_height, height);
+
+  auto xs = tile_origins(width, tile_width, overlap, alignment);
+  auto ys = tile_origins(height, tile_height, overlap, 1);
+  std::vector<CropRect> tiles;
+  tiles.reserve(xs.size() * ys.size());
+  for (uint32_t y : ys) {
+    for (uint32_t x : xs) {
+      tiles.push_back({x, y, std::min(tile_width, width - x), tile_height});
+    }
+  }
+  return tiles;
+}
+
+LetterboxGeometry letterbox_geometry(uint32_t width, uint32_t height,
+                                     uint32_t target_width,
+                                     uint32_t target_height) {
+  LetterboxGeometry geometry;
+  geometry.width = width;
+  geometry.height = height;
+  geometry.target_width = target_width;
+  geometry.target_height = target_height;
+  geometry.scale = std::min(static_cast<double>(target_width) / width,
+                            static_cast<double>(target_height) / height);
+
+  // Whole source pixels of padding on the top/left of the padded canvas. The
+  // epsilon absorbs the rounding of target / scale on the fitted axis.
+  double canvas_width = target_width / geometry.scale;
+  double canvas_height = target_height / geometry.scale;
+  double source_pad_x = std::floor((canvas_width - width) / 2 + 1e-6);
+  double source_pad_y = std::floor((canvas_height - height) / 2 + 1e-6);
+
+  geometry.pad_x = source_pad_x * geometry.scale;
+  geometry.pad_y = source_pad_y * geometry.scale;
+  return geometry;
+}
+
+namespace {
+
+uint8_t clamp_u8(int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// BT.601 limited range, two pixels per Y0 U Y1 V quadruple
+void yuyv_row_to_rgb(const uint8_t *in, uint32_t width, uint8_t *out) {
+  for (uint32_t x = 0; x < width; x += 2, in += 4, out += 6) {
+    int d = in[1] - 128;
+    int e = in[3] - 128;
+    int r = 409 * e + 128;
+    int g = -100 * d - 208 * e + 128;
+    int b = 516 * d + 128;
+    for (int k = 0; k < 2; k++) {
+      int c = 298 * (in[2 * k] - 16);
+      out[3 * k] = clamp_u8((c + r) >> 8);
+      out[3 * k + 1] = clamp_u8((c + g) >> 8);
+      out[3 * k + 2] = clamp_u8((c + b) >> 8);
+    }
+  }
+}
+
+// Same conversion for row `y` of a planar I420 frame
+void i420_row_to_rgb(const Frame &frame, uint32_t y, uint8_t *out) {
+  size_t chroma_stride = (frame.stride + 1) / 2;
+  size_t chroma_plane = chroma_stride * ((frame.height + 1) / 2);
+  const uint8_t *luma = frame.data + frame.stride * y;
+  const uint8_t *u = frame.data + frame.stride * frame.height +
+                     chroma_stride * (y / 2);
+  const uint8_t *v = u + chroma_plane;
+
+  for (uint32_t x = 0; x < frame.width; x++, out += 3) {
+    int d = u[x / 2] - 128;
+    int e = v[x / 2] - 128;
+    int c = 298 * (luma[x] - 16);
+    out[0] = clamp_u8((c + 409 * e + 128) >> 8);
+    out[1] = clamp_u8((c - 100 * d - 208 * e + 128) >> 8);
+    out[2] = clamp_u8((c + 516 * d + 128) >> 8);
+  }
+}
+
+// Source sample positions and weights along one axis, for the target
+// pixels in [begin, end)
+struct AxisMap {
+  uint32_t begin;
+  uint32_t end;
+  std::vector<uint32_t> index0;
+  std::vector<uint32_t> index1;
+  std::vector<uint16_t> weight1;
+};
+
+AxisMap map_axis(uint32_t size, uint32_t target_size, double scale,
+                 double pad) {
+  // Target pixels whose centre falls on the scaled frame
+  auto bound = [&](double edge) {
+    double value = std::ceil(edge - 0.5);
+    return static_cast<uint32_t>(
+        std::min(std::max(value, 0.0), static_cast<double>(target_size)));
+  };
+
+  AxisMap map;
+  map.begin = bound(pad);
+  map.end = bound(pad + size * scale);
+
+  for (uint32_t t = map.begin; t < map.end; t++) {
+    double source = (t + 0.5 - pad) / scale - 0.5;
+    source = std::min(std::max(source, 0.0), static_cast<double>(size - 1));
+    uint32_t i0 = static_cast<uint32_t>(source);
+    uint32_t i1 = std::min(i0 + 1, size - 1);
+    auto w1 = static_cast<uint16_t>(std::lround((source - i0) * simd::kWeightOne));
+    map.index0.push_back(i0);
+    map.index1.push_back(i1);
+    map.weight1.push_back(w1);
+  }
+  return map;
+}
+
+} // namespace
+
+LetterboxGeometry letterbox(const Frame &frame, uint8_t *out,
+                            uint32_t target_width, uint32_t target_height,
+                            uint8_t pad_value) {
+  check_frame(frame);
+  auto geometry = letterbox_geometry(frame.width, frame.height, target_width,
+                                     target_height);
+
+  const size_t out_stride = static_cast<size_t>(target_width) * 3;
+  AxisMap xs = map_axis(frame.width, target_width, geometry.scale,
+                        geometry.pad_x);
+  AxisMap ys = map_axis(frame.height, target_height, geometry.scale,
+                        geometry.pad_y);
+
+  // Channel of the source pixel that lands in each RGB output channel
+  const int channel[3] = {frame.format == PixelFormat::Bgr ? 2 : 0, 1,
+                          frame.format == PixelFormat::Bgr ? 0 : 2};
+
+  const size_t content_width = xs.end - xs.begin;
+  bool yuv = frame.format == PixelFormat::Yuyv ||
+             frame.format == PixelFormat::I420;
+  std::vector<uint8_t> rgb_row(yuv ? frame.width * 3 : 0);
+
+  // Horizontally interpolated source rows. Consecutive target rows mostly
+  // share their source rows, so the last two are kept around.
+  std::vector<uint16_t> rows[2] = {std::vector<uint16_t>(content_width * 3),
+                                   std::vector<uint16_t>(content_width * 3)};
+  int64_t row_source[2] = {-1, -1};
+
+  auto interpolated_row = [&](uint32_t y) -> const uint16_t * {
+    for (int k = 0; k < 2; k++) {
+      if (row_source[k] == y) {
+        return rows[k].data();
+      }
+    }
+    // Replace the row that is not the other input of the current blend
+    int slot = row_source[0] < row_source[1] ? 0 : 1;
+    row_source[slot] = y;
+
+    const uint8_t *source = frame.data + frame.stride * y;
+    if (frame.format == PixelFormat::Yuyv) {
+      yuyv_row_to_rgb(source, frame.width, rgb_row.data());
+      source = rgb_row.data();
+    } else if (frame.format == PixelFormat::I420) {
+      i420_row_to_rgb(frame, y, rgb_row.data());
+      source = rgb_row.data();
+    }
+
+    uint16_t *row = rows[slot].data();
+    for (size_t i = 0; i < content_width; i++) {
+      const uint8_t *p0 = source + xs.index0[i] * 3;
+      const uint8_t *p1 = source + xs.index1[i] * 3;
+      uint16_t w1 = xs.weight1[i];
+      uint16_t w0 = simd::kWeightOne - w1;
+      for (int c = 0; c < 3; c++) {
+        row[i * 3 + c] = p0[channel[c]] * w0 + p1[channel[c]] * w1;
+      }
+    }
+    return row;
+  };
+
+  for (uint32_t y = 0; y < target_height; y++) {
+    uint8_t *out_row = out + out_stride * y;
+    if (y < ys.begin || y >= ys.end || content_width == 0) {
+      std::memset(out_row, pad_value, out_stride);
+      continue;
+    }
+
+    size_t i = y - ys.begin;
+    const uint16_t *top = interpolated_row(ys.index0[i]);
+    const uint16_t *bottom = interpolated_row(ys.index1[i]);
+    uint16_t w1 = ys.weight1[i];
+
+    std::memset(out_row, pad_value, xs.begin * 3);
+    simd::blend_rows(top, bottom, simd::kWeightOne - w1, w1,
+                     out_row + xs.begin * 3, content_width * 3);
+    std::memset(out_row + xs.end * 3, pad_value,
+                out_stride - xs.end * 3);
+  }
+
+  return geometry;
+}
+
+PixelFormat copy_packed(const Frame &frame, uint8_t *out) {
+  check_frame(frame);
+  const size_t out_stride = static_cast<size_t>(frame.width) * 3;
+  for (uint32_t y = 0; y < frame.height; y++, out += out_stride) {
+    const uint8_t *row = frame.data + frame.stride * y;
+    switch (frame.format) {
+    case PixelFormat::Rgb:
+    case PixelFormat::Bgr:
+      std::memcpy(out, row, out_stride);
+      break;
+    case PixelFormat::Yuyv:
+      yuyv_row_to_rgb(row, frame.width, out);
+      break;
+    case PixelFormat::I420:
+      i420_row_to_rgb(frame, y, out);
+      break;
+    }
+  }
+  return frame.format == PixelFormat::Bgr ? PixelFormat::Bgr : PixelFormat::Rgb;
+}
+
+} // namespace nx_hailo
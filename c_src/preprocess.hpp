@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nx_hailo {
+
+enum class PixelFormat { Rgb, Bgr, Yuyv, I420 };
+
+// Bytes per pixel of a packed frame in the given format, or of the luma
+// plane of a planar one
+size_t bytes_per_pixel(PixelFormat format);
+
+// A packed camera or decoder frame. `stride` is the distance in bytes
+// between the start of two rows.
+//
+// I420 frames are planar: the full-resolution Y plane is followed by the
+// U and V planes at half resolution in both directions, with rows of
+// (stride + 1) / 2 bytes.
+struct Frame {
+  const uint8_t *data;
+  size_t size;
+  uint32_t width;
+  uint32_t height;
+  size_t stride;
+  PixelFormat format;
+};
+
+// Bytes a frame of the given layout spans, from its first byte to the end
+// of its last row (or chroma plane)
+size_t frame_span(PixelFormat format, uint32_t width, uint32_t height,
+                  size_t stride);
+
+// Throws nx_hailo::Error when the frame does not fit in its buffer
+void check_frame(const Frame &frame);
+
+// A window of a frame, in frame pixels
+struct CropRect {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+};
+
+// Returns the view of `rect` within `frame`, sharing its pixels. Throws
+// nx_hailo::Error when the rect does not fit in the frame, for I420 frames,
+// whose chroma planes cannot be windowed in place, and for YUYV rects that
+// do not start and end on even columns.
+Frame crop_frame(const Frame &frame, const CropRect &rect);
+
+// Covers a `width` x `height` frame with tiles of `tile_width` x
+// `tile_height`, row by row. Neighbouring tiles overlap by at least
+// `overlap` (0 to 1) of the tile size and the last tile of each row and
+// column ends on the frame edge, with the spare pixels spread evenly
+// between tiles. Tile origins are rounded down to multiples of `alignment`,
+// except the last of each row, which is rounded up and its tile narrowed to
+// still end on the frame edge. A tile larger than the frame is shrunk to it.
+std::vector<CropRect> tile_grid(uint32_t width, uint32_t height,
+                                uint32_t tile_width, uint32_t tile_height,
+                                double overlap, uint32_t alignment = 1);
+
+// Placement of a frame letterboxed into a `target_width` x `target_height`
+// image. The frame is scaled by `scale` and centred, and whatever it does
+// not cover is padding. `pad_x`/`pad_y` are in target pixels. Within the
+// padded canvas the left/top padding is a whole number of source pixels, as
+// when padding the source to the target aspect ratio first.
+struct LetterboxGeometry {
+  uint32_t width;
+  uint32_t height;
+  uint32_t target_width;
+  uint32_t target_height;
+  double scale;
+  double pad_x;
+  double pad_y;
+};
+
+LetterboxGeometry letterbox_geometry(uint32_t width, uint32_t height,
+                                     uint32_t target_width,
+                                     uint32_t target_height);
+
+// Bilinearly resizes `frame` into a letterboxed RGB uint8 NHWC image of
+// `target_width` x `target_height`, written to `out`, with `pad_value`
+// padding. BGR, YUYV and I420 (BT.601) frames are converted on the fly, so the
+// only full-size write is the one into `out`.
+LetterboxGeometry letterbox(const Frame &frame, uint8_t *out,
+                            uint32_t target_width, uint32_t target_height,
+                            uint8_t pad_value = 114);
+
+// Copies `frame` into a tightly packed image of 3 bytes per pixel at `out`.
+// RGB and BGR frames keep their channel order, YUYV and I420 frames are
+// converted to RGB. Returns the format of the copy.
+PixelFormat copy_packed(const Frame &frame, uint8_t *out);
+
+} // namespace nx_hailo
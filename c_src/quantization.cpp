@@ -0,0 +1,264 @@
+#include "quantization.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace nx_hailo {
+
+namespace {
+
+size_t element_count(const QuantizedTensor &tensor) {
+  return tensor.size / format_type_size(tensor.type);
+}
+
+uint32_t channels(const QuantizedTensor &tensor) {
+  return tensor.features > 0 ? tensor.features : 1;
+}
+
+// The data may come straight from a binary, which is not necessarily
+// aligned for uint16 loads
+const uint16_t *as_u16(const uint8_t *data, std::vector<uint16_t> &copy,
+                       size_t count) {
+  if (reinterpret_cast<uintptr_t>(data) % alignof(uint16_t) == 0) {
+    return reinterpret_cast<const uint16_t *>(data);
+  }
+  copy.resize(count);
+  std::memcpy(copy.data(), data, count * sizeof(uint16_t));
+  return copy.data();
+}
+
+// Smallest raw value that may dequantize to at least `threshold`, or -1 when
+// none can. Rounded down so that float error never drops a candidate; the
+// exact check happens on the dequantized value.
+int64_t quantized_threshold(const QuantizedTensor &tensor, float threshold,
+                            int64_t max_value) {
+  double q = static_cast<double>(threshold) / tensor.scale + tensor.zero_point;
+  if (!(q <= static_cast<double>(max_value) + 1)) {
+    return -1;
+  }
+  return std::max<int64_t>(0, static_cast<int64_t>(std::floor(q)) - 1);
+}
+
+template <typename T>
+void scan(const T *data, size_t count, T threshold,
+          size_t (*find)(const T *, size_t, T), size_t base,
+          const QuantizedTensor &tensor, float real_threshold,
+          std::vector<uint32_t> &indices, std::vector<float> &values) {
+  size_t i = 0;
+  while ((i += find(data + i, count - i, threshold)) < count) {
+    float value =
+        (static_cast<float>(data[i]) - tensor.zero_point) * tensor.scale;
+    if (value >= real_threshold) {
+      indices.push_back(static_cast<uint32_t>(base + i));
+      values.push_back(value);
+    }
+    i++;
+  }
+}
+
+template <typename T>
+void threshold_typed(const T *data, const QuantizedTensor &tensor,
+                     const ChannelRange &range, float threshold,
+                     size_t (*find)(const T *, size_t, T),
+                     std::vector<uint32_t> &indices,
+                     std::vector<float> &values) {
+  int64_t q = quantized_threshold(tensor, threshold,
+                                  std::numeric_limits<T>::max());
+  if (q < 0) {
+    return;
+  }
+  auto q_threshold = static_cast<T>(q);
+
+  size_t count = element_count(tensor);
+  uint32_t features = channels(tensor);
+  if (range.count == features) {
+    scan(data, count, q_threshold, find, 0, tensor, threshold, indices,
+         values);
+    return;
+  }
+  for (size_t base = range.first; base < count; base += features) {
+    scan(data + base, range.count, q_threshold, find, base, tensor, threshold,
+         indices, values);
+  }
+}
+
+// A top-k candidate. Ordered so that the heap top is the worst one held.
+template <typename T> struct Candidate {
+  T value;
+  uint32_t index;
+
+  bool operator<(const Candidate &other) const {
+    return value != other.value ? value > other.value : index < other.index;
+  }
+};
+
+template <typename T>
+std::vector<Candidate<T>> top_k_typed(const T *data, size_t count, uint32_t k,
+                                      size_t (*find)(const T *, size_t, T)) {
+  std::vector<Candidate<T>> heap;
+  heap.reserve(k);
+  // Smallest value that can still get in. Elements equal to the worst
+  // candidate come later, so they lose the tie.
+  T threshold = 0;
+  size_t i = 0;
+  while ((i += find(data + i, count - i, threshold)) < count) {
+    Candidate<T> candidate{data[i], static_cast<uint32_t>(i)};
+    if (heap.size() < k) {
+      heap.push_back(candidate);
+      std::push_heap(heap.begin(), heap.end());
+    } else {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.back() = candidate;
+      std::push_heap(heap.begin(), heap.end());
+    }
+    if (heap.size() == k) {
+      if (heap.front().value == std::numeric_limits<T>::max()) {
+        break;
+      }
+      threshold = heap.front().value + 1;
+    }
+    i++;
+  }
+  std::sort_heap(heap.begin(), heap.end());
+  return heap;
+}
+
+} // namespace
+
+ChannelRange check_quantized(const QuantizedTensor &tensor,
+                             const ChannelRange &range) {
+  if (tensor.type != FormatType::Uint8 && tensor.type != FormatType::Uint16) {
+    throw Error("Quantized data must be uint8 or uint16");
+  }
+  if (!(tensor.scale > 0.0f)) {
+    throw Error("Quantization scale must be positive");
+  }
+  size_t element_size = format_type_size(tensor.type);
+  if (tensor.size % element_size != 0 ||
+      element_count(tensor) % channels(tensor) != 0) {
+    throw Error("Quantized data size " + std::to_string(tensor.size) +
+                " is not a whole number of positions");
+  }
+  if (element_count(tensor) > std::numeric_limits<uint32_t>::max()) {
+    throw Error("Quantized data is too large");
+  }
+
+  uint32_t features = channels(tensor);
+  ChannelRange resolved = range;
+  if (resolved.first >= features) {
+    throw Error("Channel range starts past the " + std::to_string(features) +
+                " channels");
+  }
+  if (resolved.count == 0) {
+    resolved.count = features - resolved.first;
+  }
+  if (resolved.count > features - resolved.first) {
+    throw Error("Channel range ends past the " + std::to_string(features) +
+                " channels");
+  }
+  return resolved;
+}
+
+size_t selected_count(const QuantizedTensor &tensor,
+                      const ChannelRange &range) {
+  return element_count(tensor) / channels(tensor) * range.count;
+}
+
+void dequantize(const QuantizedTensor &tensor, const ChannelRange &range,
+                float *out) {
+  size_t count = element_count(tensor);
+  uint32_t features = channels(tensor);
+  // Whole frames are a single run, channel ranges one run per position
+  size_t run = range.count == features ? count : range.count;
+  size_t step = range.count == features ? count : features;
+
+  if (tensor.type == FormatType::Uint8) {
+    for (size_t base = range.first; base < count; base += step, out += run) {
+      simd::dequantize_u8(tensor.data + base, tensor.zero_point, tensor.scale,
+                          out, run);
+    }
+  } else {
+    std::vector<uint16_t> copy;
+    const uint16_t *data = as_u16(tensor.data, copy, count);
+    for (size_t base = range.first; base < count; base += step, out += run) {
+      simd::dequantize_u16(data + base, tensor.zero_point, tensor.scale, out,
+                           run);
+    }
+  }
+}
+
+void threshold_quantized(const QuantizedTensor &tensor,
+                         const ChannelRange &range, float threshold,
+                         std::vector<uint32_t> &indices,
+                         std::vector<float> &values) {
+  if (tensor.type == FormatType::Uint8) {
+    threshold_typed<uint8_t>(tensor.data, tensor, range, threshold,
+                             simd::find_at_least_u8, indices, values);
+  } else {
+    std::vector<uint16_t> copy;
+    const uint16_t *data = as_u16(tensor.data, copy, element_count(tensor));
+    threshold_typed<uint16_t>(data, tensor, range, threshold,
+                              simd::find_at_least_u16, indices, values);
+  }
+}
+
+void top_k_quantized(const QuantizedTensor &tensor, uint32_t k,
+                     std::vector<uint32_t> &indices,
+                     std::vector<float> &values) {
+  if (k == 0) {
+    return;
+  }
+  auto collect = [&](const auto &winners) {
+    for (const auto &winner : winners) {
+      indices.push_back(winner.index);
+      values.push_back((static_cast<float>(winner.value) - tensor.zero_point) *
+                       tensor.scale);
+    }
+  };
+
+  size_t count = element_count(tensor);
+  if (tensor.type == FormatType::Uint8) {
+    collect(top_k_typed<uint8_t>(tensor.data, count, k,
+                                 simd::find_at_least_u8));
+  } else {
+    std::vector<uint16_t> copy;
+    const uint16_t *data = as_u16(tensor.data, copy, count);
+    collect(top_k_typed<uint16_t>(data, count, k, simd::find_at_least_u16));
+  }
+}
+
+void top_k_float(const uint8_t *data, size_t count, uint32_t k,
+                 std::vector<uint32_t> &indices, std::vector<float> &values) {
+  if (k == 0) {
+    return;
+  }
+  std::vector<Candidate<float>> heap;
+  heap.reserve(k);
+  for (size_t i = 0; i < count; i++) {
+    float value;
+    std::memcpy(&value, data + i * sizeof(float), sizeof(float));
+    Candidate<float> candidate{value, static_cast<uint32_t>(i)};
+    if (std::isnan(value)) {
+      continue;
+    }
+    if (heap.size() < k) {
+      heap.push_back(candidate);
+      std::push_heap(heap.begin(), heap.end());
+    } else if (value > heap.front().value) {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.back() = candidate;
+      std::push_heap(heap.begin(), heap.end());
+    }
+  }
+  std::sort_heap(heap.begin(), heap.end());
+  for (const auto &winner : heap) {
+    indices.push_back(winner.index);
+    values.push_back(winner.value);
+  }
+}
+
+} // namespace nx_hailo
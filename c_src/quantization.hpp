@@ -0,0 +1,69 @@
+#pragma once
+
+#include "backend.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nx_hailo {
+
+// A uint8 or uint16 output frame as produced by the device, before
+// dequantization. Real values are `(q - zero_point) * scale`.
+struct QuantizedTensor {
+  const uint8_t *data;
+  size_t size;
+  FormatType type;
+  float zero_point;
+  float scale;
+  // Innermost (channel) dimension, with the elements of one position
+  // stored contiguously as in NHWC. 0 treats the whole frame as a single
+  // channel.
+  uint32_t features = 0;
+};
+
+// Channels [first, first + count) of every position. A count of 0 selects
+// every channel from `first` on.
+struct ChannelRange {
+  uint32_t first = 0;
+  uint32_t count = 0;
+};
+
+// Throws nx_hailo::Error unless the tensor and range are consistent, and
+// returns the range with its count resolved
+ChannelRange check_quantized(const QuantizedTensor &tensor,
+                             const ChannelRange &range);
+
+// Number of elements selected by `range`, which must have been checked
+size_t selected_count(const QuantizedTensor &tensor, const ChannelRange &range);
+
+// Dequantizes the selected channels into `out`, position by position
+void dequantize(const QuantizedTensor &tensor, const ChannelRange &range,
+                float *out);
+
+// Collects the selected elements whose dequantized value is at least
+// `threshold`, as flat element indices into the frame and their values.
+// The scan compares the raw integers against the threshold quantized
+// conservatively, so only candidates are dequantized. The result is the
+// same as filtering the output of dequantize.
+void threshold_quantized(const QuantizedTensor &tensor,
+                         const ChannelRange &range, float threshold,
+                         std::vector<uint32_t> &indices,
+                         std::vector<float> &values);
+
+// Collects the `k` largest elements of the frame, best first and ties by
+// lowest index, as flat element indices and dequantized values. Dequantizing
+// is monotonic, so the selection runs on the raw integers: once `k`
+// candidates are held, blocks with nothing above the worst of them are
+// skipped with a single vector compare, and only the winners are
+// dequantized.
+void top_k_quantized(const QuantizedTensor &tensor, uint32_t k,
+                     std::vector<uint32_t> &indices,
+                     std::vector<float> &values);
+
+// Same as top_k_quantized, for `count` float32 values that may not be
+// aligned. NaNs are never selected.
+void top_k_float(const uint8_t *data, size_t count, uint32_t k,
+                 std::vector<uint32_t> &indices, std::vector<float> &values);
+
+} // namespace nx_hailo
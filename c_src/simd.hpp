@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Small vector kernels shared by the native pre- and postprocessing code.
+//
+// Each kernel has a NEON path (the Raspberry Pi 5 target), an SSE2 path
+// (x86-64 hosts running the simulator) and a scalar fallback that also
+// handles the tail. The paths are selected at compile time and produce
+// identical results.
+
+namespace nx_hailo {
+namespace simd {
+
+// Bilinear weights are fixed point with this many fractional bits, so a
+// horizontally interpolated uint8 sample fits in 15 bits and the vertical
+// blend of two of them in 32.
+constexpr int kWeightBits = 7;
+constexpr uint16_t kWeightOne = 1 << kWeightBits;
+
+// out[i] = round((top[i] * top_weight + bottom[i] * bottom_weight) / 2^14)
+//
+// `top` and `bottom` hold horizontally interpolated samples scaled by
+// kWeightOne, and the two weights add up to kWeightOne.
+inline void blend_rows(const uint16_t *top, const uint16_t *bottom,
+                       uint16_t top_weight, uint16_t bottom_weight,
+                       uint8_t *out, size_t count) {
+  constexpr int shift = 2 * kWeightBits;
+  size_t i = 0;
+
+#if defined(__ARM_NEON)
+  uint16x4_t wt = vdup_n_u16(top_weight);
+  uint16x4_t wb = vdup_n_u16(bottom_weight);
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t t = vld1q_u16(top + i);
+    uint16x8_t b = vld1q_u16(bottom + i);
+    uint32x4_t lo = vmull_u16(vget_low_u16(t), wt);
+    uint32x4_t hi = vmull_u16(vget_high_u16(t), wt);
+    lo = vmlal_u16(lo, vget_low_u16(b), wb);
+    hi = vmlal_u16(hi, vget_high_u16(b), wb);
+    uint16x8_t sum =
+        vcombine_u16(vrshrn_n_u32(lo, shift), vrshrn_n_u32(hi, shift));
+    vst1_u8(out + i, vqmovn_u16(sum));
+  }
+#elif defined(__SSE2__)
+  // Interleave top and bottom so that madd computes t * wt + b * wb per lane.
+  // Samples stay below 2^15, so the signed multiply is exact.
+  __m128i weights = _mm_set1_epi32(static_cast<int32_t>(
+      static_cast<uint32_t>(top_weight) |
+      (static_cast<uint32_t>(bottom_weight) << 16)));
+  __m128i rounding = _mm_set1_epi32(1 << (shift - 1));
+  for (; i + 8 <= count; i += 8) {
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + i));
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(t, b), weights);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(t, b), weights);
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, rounding), shift);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, rounding), shift);
+    __m128i sum = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i),
+                     _mm_packus_epi16(sum, sum));
+  }
+#endif
+
+  for (; i < count; i++) {
+    uint32_t sum = static_cast<uint32_t>(top[i]) * top_weight +
+                   static_cast<uint32_t>(bottom[i]) * bottom_weight;
+    out[i] = static_cast<uint8_t>((sum + (1u << (shift - 1))) >> shift);
+  }
+}
+
+// out[i] = (in[i] - zero_point) * scale
+inline void dequantize_u8(const uint8_t *in, float zero_point, float scale,
+                          float *out, size_t count) {
+  size_t i = 0;
+
+#if defined(__ARM_NEON)
+  float32x4_t zp = vdupq_n_f32(zero_point);
+  float32x4_t sc = vdupq_n_f32(scale);
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t q = vld1q_u8(in + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(q));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(q));
+    uint32x4_t words[4] = {vmovl_u16(vget_low_u16(lo)),
+                           vmovl_u16(vget_high_u16(lo)),
+                           vmovl_u16(vget_low_u16(hi)),
+                           vmovl_u16(vget_high_u16(hi))};
+    for (int k = 0; k < 4; k++) {
+      float32x4_t value = vsubq_f32(vcvtq_f32_u32(words[k]), zp);
+      vst1q_f32(out + i + 4 * k, vmulq_f32(value, sc));
+    }
+  }
+#elif defined(__SSE2__)
+  __m128 zp = _mm_set1_ps(zero_point);
+  __m128 sc = _mm_set1_ps(scale);
+  __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    __m128i lo = _mm_unpacklo_epi8(q, zero);
+    __m128i hi = _mm_unpackhi_epi8(q, zero);
+    __m128i words[4] = {_mm_unpacklo_epi16(lo, zero),
+                        _mm_unpackhi_epi16(lo, zero),
+                        _mm_unpacklo_epi16(hi, zero),
+                        _mm_unpackhi_epi16(hi, zero)};
+    for (int k = 0; k < 4; k++) {
+      __m128 value = _mm_sub_ps(_mm_cvtepi32_ps(words[k]), zp);
+      _mm_storeu_ps(out + i + 4 * k, _mm_mul_ps(value, sc));
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    out[i] = (static_cast<float>(in[i]) - zero_point) * scale;
+  }
+}
+
+// out[i] = (in[i] - zero_point) * scale
+inline void dequantize_u16(const uint16_t *in, float zero_point, float scale,
+                           float *out, size_t count) {
+  size_t i = 0;
+
+#if defined(__ARM_NEON)
+  float32x4_t zp = vdupq_n_f32(zero_point);
+  float32x4_t sc = vdupq_n_f32(scale);
+  for (; i + 8 <= count; i += 8) {
+    uint16x8_t q = vld1q_u16(in + i);
+    float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(q)));
+    float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(q)));
+    vst1q_f32(out + i, vmulq_f32(vsubq_f32(lo, zp), sc));
+    vst1q_f32(out + i + 4, vmulq_f32(vsubq_f32(hi, zp), sc));
+  }
+#elif defined(__SSE2__)
+  __m128 zp = _mm_set1_ps(zero_point);
+  __m128 sc = _mm_set1_ps(scale);
+  __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= count; i += 8) {
+    __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(q, zero));
+    __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(q, zero));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_sub_ps(lo, zp), sc));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_sub_ps(hi, zp), sc));
+  }
+#endif
+
+  for (; i < count; i++) {
+    out[i] = (static_cast<float>(in[i]) - zero_point) * scale;
+  }
+}
+
+// Index of the first element that is at least `threshold`, or `count` when
+// there is none. Meant for sparse scans, where most 16 byte blocks hold no
+// candidate and are skipped with a single compare.
+inline size_t find_at_least_u8(const uint8_t *data, size_t count,
+                               uint8_t threshold) {
+  size_t i = 0;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  uint8x16_t t = vdupq_n_u8(threshold);
+  for (; i + 16 <= count; i += 16) {
+    if (vmaxvq_u8(vcgeq_u8(vld1q_u8(data + i), t)) != 0) {
+      break;
+    }
+  }
+#elif defined(__SSE2__)
+  // threshold - value saturates to zero exactly when value >= threshold
+  __m128i t = _mm_set1_epi8(static_cast<char>(threshold));
+  __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(t, v), zero)) != 0) {
+      break;
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    if (data[i] >= threshold) {
+      return i;
+    }
+  }
+  return count;
+}
+
+// Same as find_at_least_u8, for uint16 elements
+inline size_t find_at_least_u16(const uint16_t *data, size_t count,
+                                uint16_t threshold) {
+  size_t i = 0;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  uint16x8_t t = vdupq_n_u16(threshold);
+  for (; i + 8 <= count; i += 8) {
+    if (vmaxvq_u16(vcgeq_u16(vld1q_u16(data + i), t)) != 0) {
+      break;
+    }
+  }
+#elif defined(__SSE2__)
+  __m128i t = _mm_set1_epi16(static_cast<short>(threshold));
+  __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(t, v), zero)) != 0) {
+      break;
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    if (data[i] >= threshold) {
+      return i;
+    }
+  }
+  return count;
+}
+
+// Sum of the absolute differences between `a[i]` and `b[i]`
+inline uint64_t sad_u8(const uint8_t *a, const uint8_t *b, size_t count) {
+  size_t i = 0;
+  uint64_t sum = 0;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  while (i + 16 <= count) {
+    // Each uint16 lane gains up to 2 * 255 per block, so it is flushed
+    // every 128 blocks before it can overflow
+    size_t end = count - i > 16 * 128 ? i + 16 * 128 : count;
+    uint16x8_t partial = vdupq_n_u16(0);
+    for (; i + 16 <= end; i += 16) {
+      partial = vpadalq_u8(partial,
+                           vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    sum += vaddlvq_u16(partial);
+  }
+#elif defined(__SSE2__)
+  // psadbw sums each half of the block into a 64-bit lane
+  __m128i acc = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+  }
+  alignas(16) uint64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+  sum = lanes[0] + lanes[1];
+#endif
+
+  for (; i < count; i++) {
+    sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+  }
+  return sum;
+}
+
+} // namespace simd
+} // namespace nx_hailo
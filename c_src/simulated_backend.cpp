@@ -0,0 +1,600 @@
+#include "backend.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace nx_hailo {
+namespace {
+
+// splitmix64, small and good enough to make reproducible test data
+uint64_t next_random(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+float next_unit(uint64_t &state) {
+  return static_cast<float>(next_random(state) >> 40) /
+         static_cast<float>(1ULL << 24);
+}
+
+// FNV-1a over a bounded sample of the frame, so that equal inputs produce
+// equal outputs without hashing megabytes per frame.
+uint64_t fingerprint(const uint8_t *data, size_t size) {
+  const size_t max_samples = 4096;
+  size_t stride = std::max<size_t>(1, size / max_samples);
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (size_t i = 0; i < size; i += stride) {
+    hash ^= data[i];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+// Resolves Auto formats the way HailoRT does for the common models and fills
+// in the host frame size.
+VStreamInfo normalize(VStreamInfo info, Direction direction) {
+  info.direction = direction;
+
+  if (info.is_nms()) {
+    if (info.format_type == FormatType::Auto) {
+      info.format_type = FormatType::Float32;
+    }
+    if (info.format_type != FormatType::Float32 ||
+        info.nms_order != NmsOrder::ByClass) {
+      throw Error("Simulated NMS vstream " + info.name +
+                  " must be float32 ordered by class");
+    }
+    // Per class: a float count followed by up to max_bboxes boxes of
+    // (ymin, xmin, ymax, xmax, score)
+    info.frame_size = static_cast<size_t>(info.number_of_classes) *
+                      (1 + static_cast<size_t>(info.max_bboxes) * 5) *
+                      sizeof(float);
+  } else {
+    if (info.format_type == FormatType::Auto) {
+      info.format_type = FormatType::Uint8;
+    }
+    if (info.format_order == FormatOrder::Auto) {
+      info.format_order = FormatOrder::Nhwc;
+    }
+    info.frame_size = static_cast<size_t>(info.height) * info.width *
+                      info.features * format_type_size(info.format_type);
+  }
+
+  if (info.frame_size == 0) {
+    throw Error("Simulated vstream " + info.name + " has an empty frame");
+  }
+  return info;
+}
+
+void write_nms_frame(const VStreamInfo &info, uint32_t detections,
+                     uint64_t &rng, uint8_t *frame) {
+  struct Box {
+    float ymin, xmin, ymax, xmax, score;
+  };
+
+  uint32_t classes = info.number_of_classes;
+  std::vector<std::vector<Box>> by_class(classes);
+
+  for (uint32_t i = 0; i < detections; i++) {
+    uint32_t class_id = static_cast<uint32_t>(next_random(rng) % classes);
+    if (by_class[class_id].size() >= info.max_bboxes) {
+      continue;
+    }
+
+    float cy = 0.1f + 0.8f * next_unit(rng);
+    float cx = 0.1f + 0.8f * next_unit(rng);
+    float h = 0.05f + 0.35f * next_unit(rng);
+    float w = 0.05f + 0.35f * next_unit(rng);
+    float score = 0.25f + 0.75f * next_unit(rng);
+
+    by_class[class_id].push_back(
+        {std::max(0.0f, cy - h / 2), std::max(0.0f, cx - w / 2),
+         std::min(1.0f, cy + h / 2), std::min(1.0f, cx + w / 2), score});
+  }
+
+  float *out = reinterpret_cast<float *>(frame);
+  for (const auto &boxes : by_class) {
+    *out++ = static_cast<float>(boxes.size());
+    for (const auto &box : boxes) {
+      std::memcpy(out, &box, sizeof(Box));
+      out += 5;
+    }
+  }
+
+  // Whatever is left of the frame is padding
+  uint8_t *end = reinterpret_cast<uint8_t *>(out);
+  std::memset(end, 0, info.frame_size - (end - frame));
+}
+
+void fill_random(uint8_t *data, size_t size, uint64_t &rng) {
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t value = next_random(rng);
+    std::memcpy(data + i, &value, sizeof(uint64_t));
+  }
+  for (; i < size; i++) {
+    data[i] = static_cast<uint8_t>(next_random(rng));
+  }
+}
+
+// Fills a tensor frame with random values of the device type, converted to
+// the host type the way HailoRT would. A raw and a dequantized pipeline
+// thus see the same values for the same input.
+void write_tensor_frame(const VStreamInfo &device_info,
+                        const VStreamInfo &host_info, uint64_t &rng,
+                        uint8_t *frame, std::vector<uint8_t> &scratch) {
+  if (host_info.format_type == device_info.format_type) {
+    fill_random(frame, host_info.frame_size, rng);
+    return;
+  }
+
+  scratch.resize(device_info.frame_size);
+  fill_random(scratch.data(), scratch.size(), rng);
+
+  size_t count = static_cast<size_t>(device_info.height) * device_info.width *
+                 device_info.features;
+  float scale = device_info.qp_scale != 0.0f ? device_info.qp_scale : 1.0f;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t q;
+    if (device_info.format_type == FormatType::Uint16) {
+      uint16_t value;
+      std::memcpy(&value, scratch.data() + 2 * i, sizeof(value));
+      q = value;
+    } else {
+      q = scratch[i];
+    }
+
+    if (host_info.format_type == FormatType::Float32) {
+      float value = (static_cast<float>(q) - device_info.qp_zp) * scale;
+      std::memcpy(frame + 4 * i, &value, sizeof(value));
+    } else {
+      auto value = static_cast<uint16_t>(q);
+      std::memcpy(frame + 2 * i, &value, sizeof(value));
+    }
+  }
+}
+
+// One network group configured on a simulated device
+struct NetworkState {
+  // Device-side vstreams
+  std::vector<VStreamInfo> inputs;
+  std::vector<VStreamInfo> outputs;
+  uint16_t batch_size;
+  uint8_t priority;
+  std::shared_ptr<SchedulerStatsRecorder> stats =
+      std::make_shared<SchedulerStatsRecorder>();
+  // Only used with SimulatorConfig::estimate_wait
+  WaitEstimator wait_estimator{stats};
+};
+
+// Host-side vstreams of one pipeline: the device vstreams of its network
+// group with the element types requested in the pipeline params
+struct HostLayout {
+  std::shared_ptr<NetworkState> network;
+  std::vector<VStreamInfo> inputs;
+  std::vector<VStreamInfo> outputs;
+};
+
+VStreamInfo with_host_type(const VStreamInfo &device_info, FormatType type) {
+  if (type == FormatType::Auto || type == device_info.format_type) {
+    return device_info;
+  }
+  if (device_info.is_nms()) {
+    throw Error("Simulated NMS vstream " + device_info.name +
+                " only supports float32");
+  }
+  bool convertible =
+      device_info.direction == Direction::H2D ||
+      type == FormatType::Float32 ||
+      (type == FormatType::Uint16 && device_info.format_type == FormatType::Uint8);
+  if (!convertible) {
+    throw Error("Simulated vstream " + device_info.name +
+                " cannot be converted to the requested format type");
+  }
+
+  VStreamInfo info = device_info;
+  info.format_type = type;
+  info.frame_size = device_info.frame_size /
+                    format_type_size(device_info.format_type) *
+                    format_type_size(type);
+  return info;
+}
+
+HostLayout host_layout(std::shared_ptr<NetworkState> network,
+                       const PipelineParams &params) {
+  HostLayout layout;
+  for (const auto &info : network->inputs) {
+    layout.inputs.push_back(with_host_type(info, params.input_format_type));
+  }
+  for (const auto &entry : params.output_format_types) {
+    bool known = std::any_of(
+        network->outputs.begin(), network->outputs.end(),
+        [&](const VStreamInfo &info) { return info.name == entry.first; });
+    if (!known) {
+      throw Error("Unknown output vstream: " + entry.first);
+    }
+  }
+  for (const auto &info : network->outputs) {
+    layout.outputs.push_back(
+        with_host_type(info, params.output_format_type_for(info.name)));
+  }
+  layout.network = std::move(network);
+  return layout;
+}
+
+// State shared by everything configured on one simulated device. Only one
+// transfer is on the device at a time; waiting transfers of the highest
+// priority go next, in no particular order within a priority.
+struct DeviceState {
+  SimulatorConfig config;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool busy = false;
+  // Priorities of the transfers waiting for the device
+  std::multiset<uint8_t> waiting;
+  uint64_t jitter_rng;
+};
+
+template <typename SizeOf>
+void check_buffers(const std::vector<VStreamInfo> &infos, size_t count,
+                   size_t frames_count, SizeOf size_of) {
+  if (count != infos.size()) {
+    throw Error("Expected " + std::to_string(infos.size()) +
+                " buffers, got " + std::to_string(count));
+  }
+  for (size_t i = 0; i < count; i++) {
+    size_t expected = infos[i].frame_size * frames_count;
+    if (size_of(i) != expected) {
+      throw Error("Invalid buffer size for vstream " + infos[i].name +
+                  ". Expected: " + std::to_string(expected) +
+                  ", Got: " + std::to_string(size_of(i)));
+    }
+  }
+}
+
+// Occupies the device for one transfer of `frames_count` frames and fills
+// the outputs. Buffers have already been checked against `layout`.
+void run_transfer(DeviceState &device, const HostLayout &layout,
+                  const std::vector<ConstBuffer> &inputs,
+                  const std::vector<MutableBuffer> &outputs,
+                  size_t frames_count) {
+  const auto &config = device.config;
+  auto &network = *layout.network;
+
+  auto queued_at = std::chrono::steady_clock::now();
+  int64_t busy_us;
+  {
+    std::unique_lock<std::mutex> lock(device.mutex);
+    auto waiting = device.waiting.insert(network.priority);
+    device.cv.wait(lock, [&] {
+      return !device.busy && *device.waiting.rbegin() == network.priority;
+    });
+    device.waiting.erase(waiting);
+    device.busy = true;
+
+    busy_us = config.latency_us +
+              static_cast<int64_t>(config.per_frame_latency_us) *
+                  static_cast<int64_t>(frames_count);
+    if (config.jitter_us > 0) {
+      uint64_t span = 2 * static_cast<uint64_t>(config.jitter_us) + 1;
+      busy_us +=
+          static_cast<int64_t>(next_random(device.jitter_rng) % span) -
+          config.jitter_us;
+    }
+  }
+
+  auto wait = std::chrono::steady_clock::now() - queued_at;
+  if (busy_us > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(busy_us));
+  }
+  if (config.estimate_wait) {
+    network.wait_estimator.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - queued_at)
+            .count(),
+        frames_count);
+  } else {
+    network.stats->record(
+        std::chrono::duration_cast<std::chrono::microseconds>(wait).count(),
+        frames_count);
+  }
+  {
+    std::lock_guard<std::mutex> lock(device.mutex);
+    device.busy = false;
+  }
+  device.cv.notify_all();
+
+  std::vector<uint8_t> scratch;
+  for (size_t frame = 0; frame < frames_count; frame++) {
+    uint64_t rng = config.seed;
+    for (size_t i = 0; i < inputs.size(); i++) {
+      size_t frame_size = layout.inputs[i].frame_size;
+      rng ^= fingerprint(static_cast<const uint8_t *>(inputs[i].data) +
+                             frame * frame_size,
+                         frame_size);
+    }
+
+    for (size_t i = 0; i < outputs.size(); i++) {
+      const auto &info = layout.outputs[i];
+      uint8_t *out =
+          static_cast<uint8_t *>(outputs[i].data) + frame * info.frame_size;
+      if (info.is_nms()) {
+        write_nms_frame(info, config.detections_per_frame, rng, out);
+      } else {
+        write_tensor_frame(network.outputs[i], info, rng, out, scratch);
+      }
+    }
+  }
+}
+
+class SimulatedPipeline : public Pipeline {
+public:
+  SimulatedPipeline(std::shared_ptr<DeviceState> device, HostLayout layout)
+      : device_(std::move(device)), layout_(std::move(layout)) {}
+
+  const std::vector<VStreamInfo> &input_infos() const override {
+    return layout_.inputs;
+  }
+
+  const std::vector<VStreamInfo> &output_infos() const override {
+    return layout_.outputs;
+  }
+
+  void infer(const std::vector<ConstBuffer> &inputs,
+             const std::vector<MutableBuffer> &outputs,
+             size_t frames_count) override {
+    check_buffers(layout_.inputs, inputs.size(), frames_count,
+                  [&](size_t i) { return inputs[i].size; });
+    check_buffers(layout_.outputs, outputs.size(), frames_count,
+                  [&](size_t i) { return outputs[i].size; });
+
+    run_transfer(*device_, layout_, inputs, outputs, frames_count);
+  }
+
+private:
+  std::shared_ptr<DeviceState> device_;
+  HostLayout layout_;
+};
+
+// Streams frames through a device thread of its own. Each input and output
+// vstream has a queue of `queue_size` frames, like HailoRT's, and the
+// device thread takes a frame once every input has one and every output
+// has room for the result.
+class SimulatedStreamPipeline : public StreamPipeline {
+public:
+  SimulatedStreamPipeline(std::shared_ptr<DeviceState> device,
+                          HostLayout layout, size_t queue_size)
+      : device_(std::move(device)), layout_(std::move(layout)),
+        queue_size_(std::max<size_t>(1, queue_size)),
+        inputs_(layout_.inputs.size()), outputs_(layout_.outputs.size()),
+        thread_([this] { run(); }) {}
+
+  ~SimulatedStreamPipeline() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+      aborted_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  const std::vector<VStreamInfo> &input_infos() const override {
+    return layout_.inputs;
+  }
+
+  const std::vector<VStreamInfo> &output_infos() const override {
+    return layout_.outputs;
+  }
+
+  void write(size_t index, ConstBuffer frame) override {
+    check_frame_size(layout_.inputs.at(index), frame.size);
+
+    const auto *data = static_cast<const uint8_t *>(frame.data);
+    std::vector<uint8_t> copy(data, data + frame.size);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock,
+             [&] { return aborted_ || inputs_[index].size() < queue_size_; });
+    if (aborted_) {
+      throw Error("Stream pipeline was aborted");
+    }
+    inputs_[index].push_back(std::move(copy));
+    lock.unlock();
+    cv_.notify_all();
+  }
+
+  void read(size_t index, MutableBuffer frame) override {
+    check_frame_size(layout_.outputs.at(index), frame.size);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return aborted_ || !outputs_[index].empty(); });
+    if (aborted_) {
+      throw Error("Stream pipeline was aborted");
+    }
+    std::memcpy(frame.data, outputs_[index].front().data(), frame.size);
+    outputs_[index].pop_front();
+    lock.unlock();
+    cv_.notify_all();
+  }
+
+  void abort() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      aborted_ = true;
+    }
+    cv_.notify_all();
+  }
+
+private:
+  static void check_frame_size(const VStreamInfo &info, size_t size) {
+    if (size != info.frame_size) {
+      throw Error("Invalid buffer size for vstream " + info.name +
+                  ". Expected: " + std::to_string(info.frame_size) +
+                  ", Got: " + std::to_string(size));
+    }
+  }
+
+  bool frame_ready() const {
+    for (const auto &queue : inputs_) {
+      if (queue.empty()) {
+        return false;
+      }
+    }
+    for (const auto &queue : outputs_) {
+      if (queue.size() >= queue_size_) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void run() {
+    std::vector<std::vector<uint8_t>> frame_inputs(inputs_.size());
+    std::vector<ConstBuffer> input_buffers(inputs_.size());
+    std::vector<MutableBuffer> output_buffers(outputs_.size());
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [&] { return stopping_ || frame_ready(); });
+      if (stopping_) {
+        return;
+      }
+
+      for (size_t i = 0; i < inputs_.size(); i++) {
+        frame_inputs[i] = std::move(inputs_[i].front());
+        inputs_[i].pop_front();
+        input_buffers[i] = {frame_inputs[i].data(), frame_inputs[i].size()};
+      }
+      lock.unlock();
+      cv_.notify_all();
+
+      std::vector<std::vector<uint8_t>> frame_outputs(outputs_.size());
+      for (size_t i = 0; i < outputs_.size(); i++) {
+        frame_outputs[i].resize(layout_.outputs[i].frame_size);
+        output_buffers[i] = {frame_outputs[i].data(), frame_outputs[i].size()};
+      }
+      run_transfer(*device_, layout_, input_buffers, output_buffers, 1);
+
+      lock.lock();
+      for (size_t i = 0; i < outputs_.size(); i++) {
+        outputs_[i].push_back(std::move(frame_outputs[i]));
+      }
+      cv_.notify_all();
+    }
+  }
+
+  std::shared_ptr<DeviceState> device_;
+  HostLayout layout_;
+  size_t queue_size_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::deque<std::vector<uint8_t>>> inputs_;
+  std::vector<std::deque<std::vector<uint8_t>>> outputs_;
+  bool aborted_ = false;
+  bool stopping_ = false;
+  // Declared last so that everything it uses exists before it starts
+  std::thread thread_;
+};
+
+class SimulatedNetworkGroup : public NetworkGroup {
+public:
+  SimulatedNetworkGroup(std::shared_ptr<DeviceState> device,
+                        std::shared_ptr<NetworkState> network)
+      : device_(std::move(device)), network_(std::move(network)) {}
+
+  uint16_t batch_size() const override { return network_->batch_size; }
+
+  SchedulerStats scheduler_stats() const override {
+    return network_->stats->snapshot();
+  }
+
+  std::vector<VStreamInfo> input_infos() const override {
+    return network_->inputs;
+  }
+
+  std::vector<VStreamInfo> output_infos() const override {
+    return network_->outputs;
+  }
+
+  std::unique_ptr<Pipeline>
+  create_pipeline(const PipelineParams &params) override {
+    return std::make_unique<SimulatedPipeline>(device_,
+                                               host_layout(network_, params));
+  }
+
+  std::unique_ptr<StreamPipeline>
+  create_stream_pipeline(const PipelineParams &params) override {
+    return std::make_unique<SimulatedStreamPipeline>(
+        device_, host_layout(network_, params), params.queue_size);
+  }
+
+private:
+  std::shared_ptr<DeviceState> device_;
+  std::shared_ptr<NetworkState> network_;
+};
+
+class SimulatedDevice : public Device {
+public:
+  explicit SimulatedDevice(std::shared_ptr<DeviceState> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<NetworkGroup>
+  configure(const std::string &hef_path,
+            const NetworkGroupParams &params) override {
+    const auto &config = state_->config;
+    auto network = std::make_shared<NetworkState>();
+    auto it = config.networks.find(
+        hef_path.substr(hef_path.find_last_of('/') + 1));
+    network->inputs = it == config.networks.end() ? config.inputs
+                                                   : it->second.inputs;
+    network->outputs = it == config.networks.end() ? config.outputs
+                                                    : it->second.outputs;
+    network->batch_size = params.batch_size;
+    network->priority = params.scheduler_priority;
+    return std::make_shared<SimulatedNetworkGroup>(state_, std::move(network));
+  }
+
+private:
+  std::shared_ptr<DeviceState> state_;
+};
+
+} // namespace
+
+std::shared_ptr<Device> create_simulated_device(SimulatorConfig config) {
+  auto normalize_network = [](std::vector<VStreamInfo> &inputs,
+                              std::vector<VStreamInfo> &outputs) {
+    if (inputs.empty() || outputs.empty()) {
+      throw Error("Simulated networks need at least one input and one output");
+    }
+    for (auto &info : inputs) {
+      if (info.is_nms()) {
+        throw Error("Simulated input vstream " + info.name + " cannot be NMS");
+      }
+      info = normalize(info, Direction::H2D);
+    }
+    for (auto &info : outputs) {
+      info = normalize(info, Direction::D2H);
+    }
+  };
+
+  normalize_network(config.inputs, config.outputs);
+  for (auto &entry : config.networks) {
+    normalize_network(entry.second.inputs, entry.second.outputs);
+  }
+
+  auto state = std::make_shared<DeviceState>();
+  state->jitter_rng = config.seed;
+  state->config = std::move(config);
+  return std::make_shared<SimulatedDevice>(std::move(state));
+}
+
+} // namespace nx_hailo
@@ -0,0 +1,349 @@
+#include "tracker.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace nx_hailo {
+
+namespace {
+
+// Noise of the box coordinates, relative to the box size, as in ByteTrack
+constexpr float kPositionWeight = 1.0f / 20;
+constexpr float kVelocityWeight = 1.0f / 160;
+
+float square(float value) { return value * value; }
+
+} // namespace
+
+void Tracker::Axis::init(float value, float position_std, float velocity_std) {
+  position = value;
+  velocity = 0.0f;
+  pp = square(position_std);
+  pv = 0.0f;
+  vv = square(velocity_std);
+}
+
+void Tracker::Axis::predict(float position_noise, float velocity_noise) {
+  position += velocity;
+  pp += 2 * pv + vv + position_noise;
+  pv += vv;
+  vv += velocity_noise;
+}
+
+void Tracker::Axis::correct(float measurement, float measurement_noise) {
+  float innovation = measurement - position;
+  float s = pp + measurement_noise;
+  float position_gain = pp / s;
+  float velocity_gain = pv / s;
+  position += position_gain * innovation;
+  velocity += velocity_gain * innovation;
+  vv -= velocity_gain * pv;
+  pv -= position_gain * pv;
+  pp -= position_gain * pp;
+}
+
+void Tracker::Boxes::clear() {
+  ymin.clear();
+  xmin.clear();
+  ymax.clear();
+  xmax.clear();
+  area.clear();
+}
+
+void Tracker::Boxes::push(float y0, float x0, float y1, float x1) {
+  ymin.push_back(y0);
+  xmin.push_back(x0);
+  ymax.push_back(y1);
+  xmax.push_back(x1);
+  area.push_back((y1 - y0) * (x1 - x0));
+}
+
+Tracker::Tracker(const TrackerParams &params) : params_(params) {
+  tracks_.reserve(params_.max_tracks);
+}
+
+void Tracker::predict() {
+  predicted_.clear();
+  for (auto &track : tracks_) {
+    float width = std::max(track.axes[2].position, 0.0f);
+    float height = std::max(track.axes[3].position, 0.0f);
+    const float sizes[4] = {width, height, width, height};
+    for (int i = 0; i < 4; i++) {
+      track.axes[i].predict(square(kPositionWeight * sizes[i]),
+                            square(kVelocityWeight * sizes[i]));
+    }
+    // A shrinking box must not turn inside out
+    for (int i = 2; i < 4; i++) {
+      if (track.axes[i].position < 0.0f) {
+        track.axes[i].position = 0.0f;
+        track.axes[i].velocity = 0.0f;
+      }
+    }
+    track.time_since_update++;
+
+    float cx = track.axes[0].position, cy = track.axes[1].position;
+    float half_width = track.axes[2].position / 2;
+    float half_height = track.axes[3].position / 2;
+    predicted_.push(cy - half_height, cx - half_width, cy + half_height,
+                    cx + half_width);
+  }
+}
+
+const Tracker::Track *Tracker::start_track(const Detection &detection) {
+  if (tracks_.size() >= params_.max_tracks) {
+    // Make room by dropping the track unmatched for longest, if any missed
+    // this frame
+    auto stalest = std::max_element(
+        tracks_.begin(), tracks_.end(), [](const Track &a, const Track &b) {
+          return a.time_since_update < b.time_since_update;
+        });
+    if (stalest == tracks_.end() || stalest->time_since_update == 0) {
+      return nullptr;
+    }
+    *stalest = tracks_.back();
+    tracks_.pop_back();
+  }
+
+  Track track;
+  track.id = next_id_++;
+  if (next_id_ == 0) {
+    next_id_ = 1;
+  }
+  track.class_id = detection.class_id;
+  float width = detection.xmax - detection.xmin;
+  float height = detection.ymax - detection.ymin;
+  const float values[4] = {(detection.xmin + detection.xmax) / 2,
+                           (detection.ymin + detection.ymax) / 2, width,
+                           height};
+  const float sizes[4] = {width, height, width, height};
+  for (int i = 0; i < 4; i++) {
+    track.axes[i].init(values[i], 2 * kPositionWeight * sizes[i],
+                       10 * kVelocityWeight * sizes[i]);
+  }
+  track.hits = 1;
+  track.time_since_update = 0;
+  // Tracks seen from the first frames are reported right away, as in SORT
+  track.confirmed = params_.min_hits <= 1 || frames_ <= params_.min_hits;
+  tracks_.push_back(track);
+  return &tracks_.back();
+}
+
+void Tracker::correct(Track &track, const Detection &detection) {
+  float width = detection.xmax - detection.xmin;
+  float height = detection.ymax - detection.ymin;
+  const float values[4] = {(detection.xmin + detection.xmax) / 2,
+                           (detection.ymin + detection.ymax) / 2, width,
+                           height};
+  const float sizes[4] = {width, height, width, height};
+  for (int i = 0; i < 4; i++) {
+    track.axes[i].correct(values[i], square(kPositionWeight * sizes[i]));
+  }
+  track.hits++;
+  track.time_since_update = 0;
+  if (track.hits >= params_.min_hits || frames_ <= params_.min_hits) {
+    track.confirmed = true;
+  }
+}
+
+void Tracker::match(const std::vector<Detection> &detections,
+                    std::vector<uint32_t> &candidates,
+                    std::vector<uint32_t> &track_candidates, float min_iou,
+                    std::vector<uint32_t> &track_ids) {
+  if (candidates.empty() || track_candidates.empty()) {
+    return;
+  }
+
+  // Cost is 1 - IoU, computed against every predicted box at once and then
+  // gathered for the candidate tracks
+  size_t rows = candidates.size(), cols = track_candidates.size();
+  size_t track_count = tracks_.size();
+  ious_.resize(track_count);
+  cost_.resize(rows * cols);
+  for (size_t row = 0; row < rows; row++) {
+    const auto &detection = detections[candidates[row]];
+    float area = (detection.ymax - detection.ymin) *
+                 (detection.xmax - detection.xmin);
+    const float *ymin = predicted_.ymin.data(), *xmin = predicted_.xmin.data();
+    const float *ymax = predicted_.ymax.data(), *xmax = predicted_.xmax.data();
+    const float *areas = predicted_.area.data();
+    float *iou = ious_.data();
+    for (size_t t = 0; t < track_count; t++) {
+      float h = std::max(0.0f, std::min(ymax[t], detection.ymax) -
+                                   std::max(ymin[t], detection.ymin));
+      float w = std::max(0.0f, std::min(xmax[t], detection.xmax) -
+                                   std::max(xmin[t], detection.xmin));
+      float intersection = h * w;
+      float union_area = areas[t] + area - intersection;
+      iou[t] = union_area > 0.0f ? intersection / union_area : 0.0f;
+    }
+
+    for (size_t col = 0; col < cols; col++) {
+      const auto &track = tracks_[track_candidates[col]];
+      bool same_class =
+          !params_.class_aware || track.class_id == detection.class_id;
+      cost_[row * cols + col] =
+          same_class ? 1.0f - ious_[track_candidates[col]] : 1.0f;
+    }
+  }
+
+  solve_assignment(cost_, rows, cols, assignment_);
+
+  matched_.assign(cols, false);
+  size_t kept = 0;
+  for (size_t row = 0; row < rows; row++) {
+    int col = assignment_[row];
+    if (col >= 0 && 1.0f - cost_[row * cols + col] >= min_iou) {
+      auto &track = tracks_[track_candidates[col]];
+      correct(track, detections[candidates[row]]);
+      if (track.confirmed) {
+        track_ids[candidates[row]] = track.id;
+      }
+      matched_[col] = true;
+    } else {
+      candidates[kept++] = candidates[row];
+    }
+  }
+  candidates.resize(kept);
+
+  kept = 0;
+  for (size_t col = 0; col < cols; col++) {
+    if (!matched_[col]) {
+      track_candidates[kept++] = track_candidates[col];
+    }
+  }
+  track_candidates.resize(kept);
+}
+
+void Tracker::update(const std::vector<Detection> &detections,
+                     std::vector<uint32_t> &track_ids) {
+  frames_++;
+  track_ids.assign(detections.size(), 0);
+  predict();
+
+  std::vector<uint32_t> high, low;
+  for (size_t i = 0; i < detections.size(); i++) {
+    const auto &detection = detections[i];
+    if (!(detection.xmax > detection.xmin && detection.ymax > detection.ymin)) {
+      continue;
+    }
+    if (detection.score >= params_.high_threshold) {
+      high.push_back(i);
+    } else if (detection.score >= params_.low_threshold) {
+      low.push_back(i);
+    }
+  }
+
+  // Confident detections against every track, then the remaining
+  // detections against the tracks that were matched on the previous frame
+  std::vector<uint32_t> unmatched_tracks(tracks_.size());
+  for (size_t t = 0; t < tracks_.size(); t++) {
+    unmatched_tracks[t] = t;
+  }
+  match(detections, high, unmatched_tracks, params_.match_iou, track_ids);
+
+  std::vector<uint32_t> recent_tracks;
+  for (uint32_t t : unmatched_tracks) {
+    if (tracks_[t].time_since_update == 1) {
+      recent_tracks.push_back(t);
+    }
+  }
+  match(detections, low, recent_tracks, params_.low_match_iou, track_ids);
+
+  // Tentative tracks are dropped on their first miss, as in SORT, so that
+  // spurious detections do not linger for max_age frames
+  tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+                               [&](const Track &track) {
+                                 return track.time_since_update >
+                                            params_.max_age ||
+                                        (!track.confirmed &&
+                                         track.time_since_update > 0);
+                               }),
+                tracks_.end());
+
+  for (uint32_t i : high) {
+    if (detections[i].score < params_.new_track_threshold) {
+      continue;
+    }
+    const Track *track = start_track(detections[i]);
+    if (track && track->confirmed) {
+      track_ids[i] = track->id;
+    }
+  }
+}
+
+void solve_assignment(const std::vector<float> &cost, size_t rows,
+                      size_t cols, std::vector<int> &assignment) {
+  assignment.assign(rows, -1);
+  if (rows == 0 || cols == 0) {
+    return;
+  }
+
+  // Hungarian algorithm with potentials, O(n^2 m) for n <= m. More rows
+  // than columns are solved on the transposed matrix.
+  bool transposed = rows > cols;
+  size_t n = transposed ? cols : rows;
+  size_t m = transposed ? rows : cols;
+  auto at = [&](size_t i, size_t j) {
+    return static_cast<double>(transposed ? cost[j * cols + i]
+                                          : cost[i * cols + j]);
+  };
+
+  const double infinity = std::numeric_limits<double>::infinity();
+  std::vector<double> u(n + 1, 0.0), v(m + 1, 0.0), min_slack(m + 1);
+  // `owner[j]` is the 1-based row assigned to column j, 0 when free
+  std::vector<size_t> owner(m + 1, 0), previous(m + 1, 0);
+  std::vector<bool> visited(m + 1);
+
+  for (size_t i = 1; i <= n; i++) {
+    owner[0] = i;
+    size_t j0 = 0;
+    std::fill(min_slack.begin(), min_slack.end(), infinity);
+    std::fill(visited.begin(), visited.end(), false);
+    do {
+      visited[j0] = true;
+      size_t i0 = owner[j0], j1 = 0;
+      double delta = infinity;
+      for (size_t j = 1; j <= m; j++) {
+        if (visited[j]) {
+          continue;
+        }
+        double slack = at(i0 - 1, j - 1) - u[i0] - v[j];
+        if (slack < min_slack[j]) {
+          min_slack[j] = slack;
+          previous[j] = j0;
+        }
+        if (min_slack[j] < delta) {
+          delta = min_slack[j];
+          j1 = j;
+        }
+      }
+      for (size_t j = 0; j <= m; j++) {
+        if (visited[j]) {
+          u[owner[j]] += delta;
+          v[j] -= delta;
+        } else {
+          min_slack[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (owner[j0] != 0);
+    do {
+      size_t j1 = previous[j0];
+      owner[j0] = owner[j1];
+      j0 = j1;
+    } while (j0 != 0);
+  }
+
+  for (size_t j = 1; j <= m; j++) {
+    if (owner[j] == 0) {
+      continue;
+    }
+    if (transposed) {
+      assignment[j - 1] = static_cast<int>(owner[j] - 1);
+    } else {
+      assignment[owner[j] - 1] = static_cast<int>(j - 1);
+    }
+  }
+}
+
+} // namespace nx_hailo
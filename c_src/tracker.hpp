@@ -0,0 +1,117 @@
+#pragma once
+
+#include "detections.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nx_hailo {
+
+struct TrackerParams {
+  // Detections scoring at least this are matched first and may start
+  // tracks. Lower ones down to `low_threshold` only extend existing tracks,
+  // which keeps objects tracked through partial occlusion (ByteTrack).
+  float high_threshold = 0.5f;
+  float low_threshold = 0.1f;
+  // Detections scoring at least this start a track when unmatched
+  float new_track_threshold = 0.6f;
+  // Minimum IoU between a predicted track and a detection to match them,
+  // for the high and the low score detections
+  float match_iou = 0.2f;
+  float low_match_iou = 0.5f;
+  // Frames a confirmed track survives without a match before it is dropped
+  uint32_t max_age = 30;
+  // Matches a track needs before its ID is reported
+  uint32_t min_hits = 3;
+  // Tracks kept at most. When full, the track unmatched for longest makes
+  // room for a new one, or the detection stays untracked.
+  uint32_t max_tracks = 256;
+  // Only match tracks and detections of the same class
+  bool class_aware = true;
+};
+
+// SORT/ByteTrack-style multi-object tracker. Each track predicts its box
+// with a constant velocity Kalman filter on the box centre and size, and
+// tracks are matched to detections by IoU with an optimal assignment.
+// Not thread-safe.
+class Tracker {
+public:
+  explicit Tracker(const TrackerParams &params);
+
+  // Advances the tracker by one frame. Writes the track ID of each
+  // detection to `track_ids`, in the order of `detections`, or 0 for
+  // detections not (yet) part of a confirmed track.
+  void update(const std::vector<Detection> &detections,
+              std::vector<uint32_t> &track_ids);
+
+  size_t track_count() const { return tracks_.size(); }
+  uint64_t frame_count() const { return frames_; }
+
+private:
+  // A Kalman filter over one coordinate and its velocity
+  struct Axis {
+    float position, velocity;
+    // Covariance [[pp, pv], [pv, vv]]
+    float pp, pv, vv;
+
+    void init(float value, float position_std, float velocity_std);
+    void predict(float position_noise, float velocity_noise);
+    void correct(float measurement, float measurement_noise);
+  };
+
+  struct Track {
+    uint32_t id;
+    float class_id;
+    // Centre x/y, width and height
+    Axis axes[4];
+    uint32_t hits;
+    uint32_t time_since_update;
+    // Whether the ID has been reported, which keeps it reported through
+    // later misses
+    bool confirmed;
+  };
+
+  // Predicted boxes of the tracks in structure-of-arrays form, so that the
+  // IoU loops vectorize
+  struct Boxes {
+    std::vector<float> ymin, xmin, ymax, xmax, area;
+
+    void clear();
+    void push(float ymin, float xmin, float ymax, float xmax);
+  };
+
+  void predict();
+  // Returns the new track, or nullptr when there is no room for it
+  const Track *start_track(const Detection &detection);
+  void correct(Track &track, const Detection &detection);
+
+  // Matches `detections[candidates]` to `tracks_[track_candidates]` and
+  // removes the matched ones from both lists, recording matches in
+  // `track_ids`
+  void match(const std::vector<Detection> &detections,
+             std::vector<uint32_t> &candidates,
+             std::vector<uint32_t> &track_candidates, float min_iou,
+             std::vector<uint32_t> &track_ids);
+
+  TrackerParams params_;
+  std::vector<Track> tracks_;
+  uint32_t next_id_ = 1;
+  uint64_t frames_ = 0;
+
+  // Scratch space reused across frames
+  Boxes predicted_;
+  std::vector<float> ious_;
+  std::vector<float> cost_;
+  std::vector<int> assignment_;
+  std::vector<bool> matched_;
+};
+
+// Solves the rectangular assignment problem for a `rows` x `cols` cost
+// matrix in row-major order, minimizing the total cost. Writes the column
+// assigned to each row to `assignment`, or -1 when rows outnumber columns
+// and the row is left out.
+void solve_assignment(const std::vector<float> &cost, size_t rows,
+                      size_t cols, std::vector<int> &assignment);
+
+} // namespace nx_hailo
@@ -0,0 +1,62 @@
+#include "worker.hpp"
+
+namespace nx_hailo {
+
+Worker::Worker() : thread_([this] { run(); }) {}
+
+Worker::~Worker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+
+  // Whatever was still queued never ran, let the submitters know
+  for (auto &job : jobs_) {
+    job(true);
+  }
+}
+
+void Worker::submit(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!stopping_) {
+      jobs_.push_back(std::move(job));
+      job = nullptr;
+    }
+  }
+
+  if (job) {
+    job(true);
+    return;
+  }
+  cv_.notify_one();
+}
+
+size_t Worker::pending() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_.size() + running_;
+}
+
+void Worker::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+    if (stopping_) {
+      return;
+    }
+
+    Job job = std::move(jobs_.front());
+    jobs_.pop_front();
+    running_++;
+
+    lock.unlock();
+    job(false);
+    lock.lock();
+
+    running_--;
+  }
+}
+
+} // namespace nx_hailo
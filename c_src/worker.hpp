@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace nx_hailo {
+
+// Single native thread that runs submitted jobs in FIFO order.
+//
+// Each inference pipeline owns one of these so that device round trips happen
+// off the BEAM schedulers. Jobs receive `cancelled == true` when the worker is
+// being torn down before they got a chance to run, so that they can still
+// notify whoever is waiting on them.
+class Worker {
+public:
+  using Job = std::function<void(bool cancelled)>;
+
+  Worker();
+  ~Worker();
+
+  Worker(const Worker &) = delete;
+  Worker &operator=(const Worker &) = delete;
+
+  void submit(Job job);
+
+  // Number of jobs queued or currently running
+  size_t pending() const;
+
+private:
+  void run();
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> jobs_;
+  size_t running_ = 0;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+} // namespace nx_hailo
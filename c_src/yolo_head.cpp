@@ -0,0 +1,217 @@
+#include "yolo_head.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace nx_hailo {
+
+namespace {
+
+float sigmoid(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+
+void check_tensor(const QuantizedTensor &tensor, size_t elements,
+                  const char *what) {
+  if (tensor.type != FormatType::Uint8 && tensor.type != FormatType::Uint16 &&
+      tensor.type != FormatType::Float32) {
+    throw Error(std::string(what) +
+                " outputs must be uint8, uint16 or float32");
+  }
+  size_t expected = elements * format_type_size(tensor.type);
+  if (tensor.size != expected) {
+    throw Error(std::string(what) + " output has " +
+                std::to_string(tensor.size) + " bytes, expected " +
+                std::to_string(expected));
+  }
+  if (tensor.type != FormatType::Float32 && !(tensor.scale > 0.0f)) {
+    throw Error("Quantization scale must be positive");
+  }
+}
+
+// Collects the scores of at least `threshold`, before any sigmoid, as flat
+// indices and values
+void score_candidates(const QuantizedTensor &scores, float threshold,
+                      std::vector<uint32_t> &indices,
+                      std::vector<float> &values) {
+  if (scores.type == FormatType::Float32) {
+    const size_t count = scores.size / sizeof(float);
+    for (size_t i = 0; i < count; i++) {
+      float value;
+      std::memcpy(&value, scores.data + i * sizeof(float), sizeof(float));
+      if (value >= threshold) {
+        indices.push_back(static_cast<uint32_t>(i));
+        values.push_back(value);
+      }
+    }
+    return;
+  }
+
+  // Nothing dequantizes below the zero point, and clamping keeps the
+  // quantized threshold in range
+  threshold = std::max(threshold, -scores.zero_point * scores.scale);
+  threshold_quantized(scores, check_quantized(scores, ChannelRange{}),
+                      threshold, indices, values);
+}
+
+// Turns the DFL bins of one edge into the expected distance, the softmax
+// weighted mean of the bin indices. `bins` holds the real bin values.
+float expected_distance(const float *bins, uint32_t reg_max) {
+  float max_value = *std::max_element(bins, bins + reg_max);
+  float sum = 0.0f, weighted = 0.0f;
+  for (uint32_t i = 0; i < reg_max; i++) {
+    float weight = std::exp(bins[i] - max_value);
+    sum += weight;
+    weighted += weight * i;
+  }
+  return weighted / sum;
+}
+
+// Decodes the distances from the centre of `cell` to its box edges, in
+// strides. For uint8 boxes `exp_table[d]` holds exp(-scale * d), so the
+// softmax of a bin only depends on its distance to the largest raw value
+// and needs no exp of its own.
+void decode_distances(const QuantizedTensor &boxes, size_t cell,
+                      uint32_t reg_max, const std::vector<float> &exp_table,
+                      std::vector<float> &bins, float distances[4]) {
+  const size_t first = cell * 4 * reg_max;
+
+  if (boxes.type == FormatType::Uint8) {
+    for (int side = 0; side < 4; side++) {
+      const uint8_t *q = boxes.data + first + side * reg_max;
+      uint8_t max_value = *std::max_element(q, q + reg_max);
+      float sum = 0.0f, weighted = 0.0f;
+      for (uint32_t i = 0; i < reg_max; i++) {
+        float weight = exp_table[max_value - q[i]];
+        sum += weight;
+        weighted += weight * i;
+      }
+      distances[side] = weighted / sum;
+    }
+    return;
+  }
+
+  const size_t count = 4 * static_cast<size_t>(reg_max);
+  if (boxes.type == FormatType::Uint16) {
+    for (size_t i = 0; i < count; i++) {
+      uint16_t q;
+      std::memcpy(&q, boxes.data + (first + i) * sizeof(uint16_t),
+                  sizeof(uint16_t));
+      bins[i] = (static_cast<float>(q) - boxes.zero_point) * boxes.scale;
+    }
+  } else {
+    std::memcpy(bins.data(), boxes.data + first * sizeof(float),
+                count * sizeof(float));
+  }
+  for (int side = 0; side < 4; side++) {
+    distances[side] = expected_distance(bins.data() + side * reg_max, reg_max);
+  }
+}
+
+} // namespace
+
+void decode_yolov8_head(const std::vector<YoloHeadScale> &scales,
+                        const YoloHeadParams &params,
+                        const DetectionFilter &filter,
+                        std::vector<Detection> &detections) {
+  if (params.input_width == 0 || params.input_height == 0) {
+    throw Error("YOLOv8 input size must not be empty");
+  }
+  if (params.number_of_classes == 0 || params.reg_max == 0) {
+    throw Error("YOLOv8 heads need at least one class and one DFL bin");
+  }
+  const uint32_t classes = params.number_of_classes;
+  const uint32_t reg_max = params.reg_max;
+
+  // With a sigmoid still to apply, the threshold is compared as a logit,
+  // lowered a little so that rounding never drops a candidate. The exact
+  // check happens on the final score.
+  float threshold = filter.score_threshold;
+  if (params.sigmoid) {
+    float t = filter.score_threshold;
+    threshold = t <= 0.0f   ? -std::numeric_limits<float>::infinity()
+                : t >= 1.0f ? std::numeric_limits<float>::infinity()
+                            : std::log(t / (1.0f - t)) - 1e-4f;
+  }
+
+  detections.clear();
+  std::vector<uint32_t> indices;
+  std::vector<float> values;
+  std::vector<float> exp_table(256);
+  std::vector<float> bins(4 * static_cast<size_t>(reg_max));
+
+  for (const auto &scale : scales) {
+    if (scale.width == 0 || scale.height == 0) {
+      throw Error("YOLOv8 head grids must not be empty");
+    }
+    const size_t cells = static_cast<size_t>(scale.width) * scale.height;
+    QuantizedTensor scores = scale.scores;
+    scores.features = classes;
+    QuantizedTensor boxes = scale.boxes;
+    boxes.features = 4 * reg_max;
+    check_tensor(scores, cells * classes, "Score");
+    check_tensor(boxes, cells * boxes.features, "Box");
+
+    indices.clear();
+    values.clear();
+    score_candidates(scores, threshold, indices, values);
+    if (indices.empty()) {
+      continue;
+    }
+
+    if (boxes.type == FormatType::Uint8) {
+      for (size_t d = 0; d < exp_table.size(); d++) {
+        exp_table[d] = std::exp(-boxes.scale * static_cast<float>(d));
+      }
+    }
+    const float stride_x = static_cast<float>(params.input_width) / scale.width;
+    const float stride_y =
+        static_cast<float>(params.input_height) / scale.height;
+
+    // Candidates come in index order, so the classes of a cell are next to
+    // each other and its box is decoded once
+    size_t decoded_cell = cells;
+    float distances[4];
+    for (size_t k = 0; k < indices.size(); k++) {
+      const size_t cell = indices[k] / classes;
+      const uint32_t class_id = indices[k] % classes;
+      const float score = params.sigmoid ? sigmoid(values[k]) : values[k];
+      if (score < filter.score_threshold || !filter.allows(class_id)) {
+        continue;
+      }
+      if (cell != decoded_cell) {
+        decode_distances(boxes, cell, reg_max, exp_table, bins, distances);
+        decoded_cell = cell;
+      }
+
+      const float cx = (static_cast<float>(cell % scale.width) + 0.5f) *
+                       stride_x;
+      const float cy = (static_cast<float>(cell / scale.width) + 0.5f) *
+                       stride_y;
+      auto normalize = [](float value, float size) {
+        return std::min(std::max(value / size, 0.0f), 1.0f);
+      };
+      const float width = static_cast<float>(params.input_width);
+      const float height = static_cast<float>(params.input_height);
+      detections.push_back(
+          {static_cast<float>(class_id), score,
+           normalize(cy - distances[1] * stride_y, height),
+           normalize(cx - distances[0] * stride_x, width),
+           normalize(cy + distances[3] * stride_y, height),
+           normalize(cx + distances[2] * stride_x, width)});
+    }
+  }
+
+  if (params.max_candidates > 0 &&
+      detections.size() > params.max_candidates) {
+    select_top_k(detections, params.max_candidates);
+  }
+  suppress_overlaps(detections, params.iou_threshold, OverlapMetric::Iou,
+                    true);
+  if (filter.top_k > 0 && detections.size() > filter.top_k) {
+    detections.resize(filter.top_k);
+  }
+}
+
+} // namespace nx_hailo
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "detections.hpp"
+#include "quantization.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nx_hailo {
+
+// One scale of a YOLOv8 head compiled without on-chip NMS, both outputs
+// NHWC over the same `width` x `height` grid. Quantized tensors are uint8
+// or uint16, others float32 with their type set to Float32.
+struct YoloHeadScale {
+  // 4 * reg_max channels per cell: for the left, top, right and bottom
+  // edge in turn, a distribution over reg_max bins of the distance from the
+  // cell centre to the edge, in strides (distribution focal loss, DFL)
+  QuantizedTensor boxes;
+  // One score per class and cell
+  QuantizedTensor scores;
+  uint32_t width;
+  uint32_t height;
+};
+
+struct YoloHeadParams {
+  // Size of the model input, which the grids divide into cells
+  uint32_t input_width = 640;
+  uint32_t input_height = 640;
+  uint32_t number_of_classes = 80;
+  uint32_t reg_max = 16;
+  // Whether scores are logits that still need a sigmoid
+  bool sigmoid = false;
+  // Boxes of a class overlapping a better one by this IoU are dropped
+  float iou_threshold = 0.7f;
+  // Best candidates kept for NMS, 0 for all of them
+  size_t max_candidates = 1000;
+};
+
+// Decodes the raw outputs of a YOLOv8 head into detections normalized to
+// the model input, best first, as parse_nms_by_class returns them after
+// select_top_k. Scores are thresholded before anything else: quantized ones
+// as raw integers against the quantized (and, with `sigmoid`, inverted)
+// threshold, so only the candidate cells are dequantized and have their box
+// decoded. The candidates then go through class-aware NMS. Throws
+// nx_hailo::Error when the tensors do not match the grid.
+void decode_yolov8_head(const std::vector<YoloHeadScale> &scales,
+                        const YoloHeadParams &params,
+                        const DetectionFilter &filter,
+                        std::vector<Detection> &detections);
+
+} // namespace nx_hailo
@@ -0,0 +1,229 @@
+defmodule NxHailo.Cascade do
+  @moduledoc """
+  Two-stage inference: detect objects in a frame, then classify each of
+  them with a second model.
+
+  `classify/4` takes a frame and the detections of the first model, and
+  crops and letterboxes every detected box natively, straight into one
+  contiguous batch for the input vstream of the classifier. All boxes then
+  go through the device in a single `NxHailo.Hailo.API.infer_batch/3` call,
+  without any crop or resize in the BEAM. `run/4` does both stages:
+
+      {:ok, results, stats} =
+        NxHailo.Cascade.run(detector, classifier, frame,
+          width: 1280,
+          height: 720,
+          detector: [key: "yolov8m/yolov8_nms_postprocess", classes: coco, score_threshold: 0.4],
+          classifier: [key: "resnet_v1_50/softmax1", classes: imagenet, top_k: 1]
+        )
+
+      for {%DetectedObject{class_name: "car"}, [%Prediction{class_name: model}]} <- results do
+        model
+      end
+
+  Both models can share a VDevice, whose scheduler then interleaves the
+  transfers of the two stages.
+  """
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Model
+  alias NxHailo.Parsers.Classification
+  alias NxHailo.Parsers.YoloV8
+  alias NxHailo.Preprocess
+
+  @frame_opts [:width, :height, format: :rgb, stride: nil]
+  @roi_opts [padding: 0.1, min_size: 8, max_rois: nil]
+  @request_opts [:timeout, :deadline]
+
+  @doc """
+  Detects objects with a YoloV8 model and classifies each of them.
+
+  Takes the frame options of `NxHailo.Preprocess`, the options of
+  `classify/4`, plus:
+    - `:detector` - options of `NxHailo.Parsers.YoloV8.parse/2` for the
+      detector output, without `:letterbox` or `:input_shape`, as boxes are
+      always mapped back into the frame. Required.
+
+  The frame is letterboxed natively into the detector input.
+
+  Returns `{:ok, [{%DetectedObject{}, [%Prediction{}]}], stats}` like
+  `classify/4`, with the time spent in `:detect` added to `stats`, or
+  `{:error, reason}`. Each call is wrapped in a `[:nx_hailo, :cascade]`
+  telemetry span, whose `:stop` event carries the stats of a successful
+  call.
+  """
+  def run(
+        %Model{name: detector_name, pipeline: %API.Pipeline{input_vstream_infos: [input_info]}} =
+          detector,
+        %Model{name: classifier_name} = classifier,
+        frame,
+        opts
+      )
+      when is_binary(frame) do
+    opts =
+      Keyword.validate!(
+        opts,
+        [:detector, :classifier | @request_opts] ++ @roi_opts ++ @frame_opts
+      )
+
+    frame_opts = Keyword.take(opts, [:width, :height, :format, :stride])
+    metadata = %{detector: detector_name, classifier: classifier_name}
+
+    :telemetry.span([:nx_hailo, :cascade], metadata, fn ->
+      start = System.monotonic_time()
+
+      with {:ok, {input, letterbox}} <- Preprocess.letterbox_input(frame, input_info, frame_opts),
+           {:ok, outputs} <-
+             API.infer(
+               detector.pipeline,
+               %{input_info.name => input},
+               Keyword.take(opts, @request_opts)
+             ),
+           {:ok, objects} <-
+             YoloV8.parse(outputs, Keyword.fetch!(opts, :detector) ++ [letterbox: letterbox]),
+           detect = System.monotonic_time() - start,
+           {:ok, results, stats} <-
+             classify(classifier, frame, objects, Keyword.delete(opts, :detector)) do
+        stats = Map.put(stats, :detect, detect)
+        {{:ok, results, stats}, stats, Map.put(metadata, :result, :ok)}
+      else
+        error -> {error, %{}, Map.put(metadata, :result, error)}
+      end
+    end)
+  end
+
+  @doc """
+  Classifies the detected objects of a frame with one batched inference.
+
+  `objects` are `%DetectedObject{}` structs or any maps with `:xmin`,
+  `:ymin`, `:xmax` and `:ymax` in frame pixels, such as the tracked
+  objects of `NxHailo.Tracker`. Each box is cropped out of the frame and
+  letterboxed into the uint8 RGB input of `classifier`.
+
+  Takes the frame options of `NxHailo.Preprocess`, the `:timeout` and
+  `:deadline` options of `NxHailo.Hailo.API.infer/3`, plus:
+    - `:classifier` - options of `NxHailo.Parsers.Classification.parse/2`
+      for the classifier output, without `:info`, which is taken from the
+      pipeline. `:key` defaults to the only output of the classifier.
+    - `:padding` - fraction of the box size added on each side of the crop,
+      as context for the classifier. Defaults to 0.1.
+    - `:min_size` - boxes narrower or shorter than this many pixels are not
+      classified. Defaults to 8.
+    - `:max_rois` - classifies at most this many boxes, the first ones in
+      `objects`, which the parsers return best score first. Defaults to
+      all of them.
+
+  The frame must be RGB, BGR or YUYV, as I420 frames cannot be cropped.
+
+  Returns `{:ok, [{object, [%Prediction{}]}], stats}` in the order of
+  `objects`, where objects that were not classified get no predictions,
+  or `{:error, reason}`. `stats` has the number of `:rois` classified and
+  the time spent in each step in `:native` time units: `:prepare` for
+  laying out the crops, `:infer` for the batch, including the native
+  cropping and letterboxing, and `:parse` for parsing the outputs.
+  """
+  def classify(
+        %Model{
+          pipeline:
+            %API.Pipeline{input_vstream_infos: [input_info], output_vstream_infos: output_infos} =
+              pipeline
+        },
+        frame,
+        objects,
+        opts
+      )
+      when is_binary(frame) and is_list(objects) do
+    opts = Keyword.validate!(opts, [:classifier | @request_opts] ++ @roi_opts ++ @frame_opts)
+    frame_opts = Map.new(Keyword.take(opts, [:width, :height, :format, :stride]))
+    start = System.monotonic_time()
+
+    rois =
+      objects
+      |> Enum.with_index()
+      |> Enum.flat_map(fn {object, index} ->
+        case roi(object, opts) do
+          nil -> []
+          roi -> [{index, roi}]
+        end
+      end)
+      |> then(&if opts[:max_rois], do: Enum.take(&1, opts[:max_rois]), else: &1)
+
+    with {:ok, parser_opts} <- parser_opts(opts[:classifier] || [], output_infos),
+         infer_start = System.monotonic_time(),
+         {:ok, outputs} <- infer_rois(pipeline, input_info, frame, frame_opts, rois, opts),
+         parse_start = System.monotonic_time(),
+         {:ok, predictions} <- parse_outputs(outputs, parser_opts) do
+      by_index = Map.new(Enum.zip(Enum.map(rois, &elem(&1, 0)), predictions))
+      results = Enum.with_index(objects, fn object, index -> {object, by_index[index] || []} end)
+      stop = System.monotonic_time()
+
+      {:ok, results,
+       %{
+         rois: length(rois),
+         prepare: infer_start - start,
+         infer: parse_start - infer_start,
+         parse: stop - parse_start
+       }}
+    end
+  end
+
+  defp infer_rois(_pipeline, _input_info, _frame, _frame_opts, [], _opts), do: {:ok, []}
+
+  defp infer_rois(pipeline, input_info, frame, frame_opts, rois, opts) do
+    inputs = for {_index, roi} <- rois, do: {:letterbox, frame, Map.put(frame_opts, :crop, roi)}
+    API.infer_batch(pipeline, %{input_info.name => inputs}, Keyword.take(opts, @request_opts))
+  end
+
+  defp parser_opts(opts, output_infos) do
+    key =
+      case {opts[:key], output_infos} do
+        {nil, [%{name: name}]} -> name
+        {key, _} -> key
+      end
+
+    case Enum.find(output_infos, &(&1.name == key)) do
+      nil -> {:error, "Classifier output #{inspect(key)} not found"}
+      info -> {:ok, Keyword.merge(opts, key: key, info: info)}
+    end
+  end
+
+  defp parse_outputs(outputs, parser_opts) do
+    Enum.reduce_while(outputs, {:ok, []}, fn output_map, {:ok, acc} ->
+      case Classification.parse(output_map, parser_opts) do
+        {:ok, predictions} -> {:cont, {:ok, [predictions | acc]}}
+        error -> {:halt, error}
+      end
+    end)
+    |> case do
+      {:ok, predictions} -> {:ok, Enum.reverse(predictions)}
+      error -> error
+    end
+  end
+
+  # The box grown by `:padding` on each side and clipped to the frame, in
+  # whole pixels. YUYV crops start and end on even columns.
+  defp roi(%{xmin: xmin, ymin: ymin, xmax: xmax, ymax: ymax}, opts) do
+    {width, height} = {xmax - xmin, ymax - ymin}
+
+    if width < opts[:min_size] or height < opts[:min_size] do
+      nil
+    else
+      pad_x = width * opts[:padding]
+      pad_y = height * opts[:padding]
+      x0 = max(floor(xmin - pad_x), 0)
+      y0 = max(floor(ymin - pad_y), 0)
+      x1 = min(ceil(xmax + pad_x), opts[:width])
+      y1 = min(ceil(ymax + pad_y), opts[:height])
+
+      {x0, x1} =
+        if opts[:format] == :yuyv do
+          x0 = x0 - rem(x0, 2)
+          {x0, x1 - rem(x1 - x0, 2)}
+        else
+          {x0, x1}
+        end
+
+      if x1 > x0 and y1 > y0, do: {x0, y0, x1 - x0, y1 - y0}
+    end
+  end
+end
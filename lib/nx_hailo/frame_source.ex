@@ -0,0 +1,109 @@
+defmodule NxHailo.FrameSource do
+  @moduledoc """
+  Native frame sources: V4L2 cameras and video files.
+
+  A source captures into native buffers and only ever hands out its newest
+  frame, so a reader that falls behind skips frames instead of working
+  through a backlog. Frames come back as binaries pointing straight into
+  the capture buffer (or the mapped file), together with their metadata,
+  and can be letterboxed natively into the model input without being
+  copied on the way:
+
+      {:ok, camera} = NxHailo.FrameSource.open_v4l2("/dev/video0", width: 1280, height: 720)
+      {:ok, frame, metadata} = NxHailo.FrameSource.read(camera)
+
+      {:ok, {input, letterbox}} = NxHailo.FrameSource.letterbox_input(frame, metadata, input_info)
+      {:ok, outputs} = NxHailo.Hailo.API.infer(pipeline, %{input_info.name => input})
+
+  A V4L2 buffer goes back to the driver once the frame binary is garbage
+  collected, so holding on to frames holds capture buffers: with all of
+  them held, capture stalls until one is released.
+
+  The metadata has the `:sequence` of the frame, increasing by one for
+  every frame the source produced, its `:timestamp_us`, and the frame
+  options of `NxHailo.Preprocess`: `:width`, `:height`, `:format` and
+  `:stride`.
+  """
+
+  alias NxHailo.NIF
+  alias NxHailo.Preprocess
+
+  defstruct [:ref, :width, :height, :format, :stride]
+
+  @type t :: %__MODULE__{
+          ref: reference(),
+          width: pos_integer(),
+          height: pos_integer(),
+          format: :rgb | :bgr | :yuyv | :i420,
+          stride: pos_integer()
+        }
+
+  @doc """
+  Starts capturing from a V4L2 device through memory-mapped kernel buffers.
+
+  Options:
+    - `:width` / `:height` - requested frame size. Defaults to 640x480. The
+      driver may pick the closest size it supports, see the returned struct.
+    - `:format` - `:yuyv`, `:rgb`, `:bgr` or `:i420`. Defaults to `:yuyv`.
+    - `:buffer_count` - kernel buffers to capture into. Defaults to 4.
+  """
+  @spec open_v4l2(String.t(), keyword()) :: {:ok, t()} | {:error, String.t()}
+  def open_v4l2(path, opts \\ []) do
+    opts = Keyword.validate!(opts, [:width, :height, :format, :buffer_count])
+    path |> NIF.open_v4l2_source(Map.new(opts)) |> to_source()
+  end
+
+  @doc """
+  Plays back a video file as if it was a camera, for tests, benchmarks and
+  development machines without one.
+
+  YUV4MPEG2 (`.y4m`) files with 4:2:0 frames are read as `:i420` and
+  describe their own size and frame rate. Any other file is raw frames back
+  to back, described by the frame options of `NxHailo.Preprocess`.
+
+  Options:
+    - `:width`, `:height`, `:format` and `:stride` - layout of raw files.
+    - `:fps` - frames per second to play at. With `0` every read returns the
+      next frame. Defaults to the Y4M frame rate, and to `0` for raw files.
+    - `:loop` - start over at the end of the file instead of returning an
+      error. Defaults to `true`.
+  """
+  @spec open_file(String.t(), keyword()) :: {:ok, t()} | {:error, String.t()}
+  def open_file(path, opts \\ []) do
+    opts = Keyword.validate!(opts, [:width, :height, :format, :stride, :fps, loop: true])
+    opts = Keyword.update(opts, :fps, nil, &(&1 && &1 / 1))
+    path |> NIF.open_file_source(Map.new(opts)) |> to_source()
+  end
+
+  defp to_source({:ok, {ref, layout}}), do: {:ok, struct!(__MODULE__, Map.put(layout, :ref, ref))}
+  defp to_source({:error, _} = error), do: error
+
+  @doc """
+  Reads the newest frame.
+
+  Options:
+    - `:after` - only return a frame with a sequence above this one, usually
+      the sequence of the previous frame read. Defaults to `0`.
+    - `:timeout` - milliseconds to wait for such a frame. Defaults to 1000.
+
+  Returns `{:ok, frame, metadata}`, or `{:error, reason}` on timeout, on
+  capture errors and at the end of a file that does not loop.
+  """
+  @spec read(t(), keyword()) :: {:ok, binary(), map()} | {:error, String.t()}
+  def read(%__MODULE__{ref: ref}, opts \\ []) do
+    opts = Keyword.validate!(opts, after: 0, timeout: 1000)
+
+    with {:ok, {frame, metadata}} <- NIF.read_frame(ref, Map.new(opts)) do
+      {:ok, frame, metadata}
+    end
+  end
+
+  @doc """
+  Wraps a frame read from a source to be letterboxed into the given input
+  vstream during inference, see `NxHailo.Preprocess.letterbox_input/3`.
+  """
+  def letterbox_input(frame, metadata, input_info) do
+    opts = metadata |> Map.take([:width, :height, :format, :stride]) |> Keyword.new()
+    Preprocess.letterbox_input(frame, input_info, opts)
+  end
+end
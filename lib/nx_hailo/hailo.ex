@@ -18,20 +18,71 @@ defmodule NxHailo.Hailo do
 
   Parameters:
     - `hef_path`: The path to the .hef model file.
-    - `model_name` (optional): A name to associate with the loaded model.
+    - `opts`:
+      - `:vdevice` - the `%API.VDevice{}` to configure the model on. Defaults
+        to the shared device from `API.create_vdevice/0`. Pass a device from
+        `NxHailo.Hailo.Simulator.create_vdevice/1` to run without hardware.
+      - `:batch_size` - frames per device transfer, see
+        `API.configure_network_group/3`. Defaults to 0, which lets HailoRT pick.
+      - `:scheduler_priority`, `:scheduler_threshold` and
+        `:scheduler_timeout_ms` - model scheduler settings for models sharing
+        the device, see `API.configure_network_group/3` and
+        `NxHailo.Hailo.ModelRegistry`.
+      - `:raw_outputs` - keep the uint8/uint16 values the device produces
+        for non-NMS outputs, see `API.create_pipeline/2`. Defaults to `false`.
+
+  The network group and pipeline are created in one native call, see
+  `API.load/3`. The call is wrapped in a `[:nx_hailo, :load]` telemetry
+  span whose `:stop` event carries the `:vdevice_us`, `:configure_us` and
+  `:pipeline_us` spent in each step of a successful load, next to the
+  usual `:duration`. The metadata holds the `:hef_path`, the model `:name`
+  and the `:result`.
 
   Returns `{:ok, %NxHailo.Model{}}` or `{:error, reason}`.
   """
-  def load(hef_path) when is_binary(hef_path) do
-    with {:ok, vdevice} <- API.create_vdevice(),
-         {:ok, ng} <- API.configure_network_group(vdevice, hef_path),
-         {:ok, pipeline_struct} <- API.create_pipeline(ng) do
-      model = %NxHailo.Hailo.Model{
-        pipeline: pipeline_struct,
-        name: Path.basename(hef_path)
-      }
-
-      {:ok, model}
+  def load(hef_path, opts \\ []) when is_binary(hef_path) do
+    opts =
+      Keyword.validate!(opts, [
+        :vdevice,
+        :scheduler_priority,
+        :scheduler_threshold,
+        :scheduler_timeout_ms,
+        batch_size: 0,
+        raw_outputs: false
+      ])
+
+    {vdevice_opts, load_opts} = Keyword.split(opts, [:vdevice])
+    name = Path.basename(hef_path)
+
+    :telemetry.span([:nx_hailo, :load], %{hef_path: hef_path, name: name}, fn ->
+      start = System.monotonic_time()
+
+      with {:ok, vdevice} <- fetch_vdevice(vdevice_opts),
+           vdevice_time = System.monotonic_time() - start,
+           {:ok, ng, pipeline_struct, timings} <- API.load(vdevice, hef_path, load_opts) do
+        model = %NxHailo.Hailo.Model{
+          pipeline: pipeline_struct,
+          network_group: ng,
+          name: name
+        }
+
+        measurements = %{
+          vdevice_us: System.convert_time_unit(vdevice_time, :native, :microsecond),
+          configure_us: timings.configure_us,
+          pipeline_us: timings.pipeline_us
+        }
+
+        {{:ok, model}, measurements, %{hef_path: hef_path, name: name, result: :ok}}
+      else
+        error -> {error, %{}, %{hef_path: hef_path, name: name, result: error}}
+      end
+    end)
+  end
+
+  defp fetch_vdevice(opts) do
+    case opts[:vdevice] do
+      nil -> API.create_vdevice()
+      %API.VDevice{} = vdevice -> {:ok, vdevice}
     end
   end
 
@@ -40,16 +91,32 @@ defmodule NxHailo.Hailo do
 
   Parameters:
     - `model`: The `%NxHailo.Model{}` struct obtained from `load/1`.
-    - `inputs`: A map where keys correspond to the input vstream names, and the values are `Nx.Tensor`s.
+    - `inputs`: A map where keys correspond to the input vstream names, and the values are `Nx.Tensor`s
+      or inputs from `NxHailo.Preprocess.letterbox_input/3`.
       Example: `%{ "input_layer_name" => #Nx.Tensor<...> }`
     - `output_parser`: The module that implements the `NxHailo.Hailo.OutputParser` behaviour
     - `output_parser_opts`: A keyword list of options to pass to the output parser.
+      The `:timeout` and `:deadline` options of `NxHailo.Hailo.API.infer/3`
+      are taken out and applied to the request instead, e.g.
+      `deadline: captured_at + 50` to skip frames the device can no longer
+      process in time, which return `{:error, :deadline_exceeded}`.
 
   Returns `{:ok, output_data_map}` or `{:error, reason}`.
   The `output_data_map` will have string keys for output vstream names.
+
+  Each call is wrapped in a `[:nx_hailo, :infer]` telemetry span. Next to
+  the `:duration`, the `:stop` event of a successful call measures the
+  time spent in each stage, in `:native` time units: `:prepare` for
+  turning the inputs into binaries, the native stages of
+  `NxHailo.Hailo.API.infer_timed/3` (`:wait`, `:decode`, `:acquire`,
+  `:device` and `:encode`), and `:parse` for the output parser. The
+  metadata holds the model `:name`, the `:output_parser` and the
+  `:result`. Aggregated latencies are available from
+  `NxHailo.Hailo.API.pipeline_stats/1`.
   """
   def infer(
         %Model{
+          name: name,
           pipeline:
             %API.Pipeline{
               input_vstream_infos: input_vstream_infos
@@ -60,14 +127,33 @@ defmodule NxHailo.Hailo do
         output_parser_opts \\ []
       )
       when is_map(inputs) and is_atom(output_parser) do
-    # The API.infer function expects string keys for input map.
-    # We can be flexible and convert atom keys here if necessary,
-    # or enforce string keys in the doc/spec for this top-level infer.
-    # For now, assume API.infer's validation handles it or user provides string keys.
-    with {:ok, inputs} <- encode_inputs(input_vstream_infos, inputs),
-         {:ok, results} <- API.infer(pipeline, inputs) do
-      output_parser.parse(results, output_parser_opts)
-    end
+    metadata = %{name: name, output_parser: output_parser}
+    {request_opts, output_parser_opts} = Keyword.split(output_parser_opts, [:timeout, :deadline])
+
+    :telemetry.span([:nx_hailo, :infer], metadata, fn ->
+      # The API.infer function expects string keys for input map.
+      # We can be flexible and convert atom keys here if necessary,
+      # or enforce string keys in the doc/spec for this top-level infer.
+      # For now, assume API.infer's validation handles it or user provides string keys.
+      start = System.monotonic_time()
+
+      with {:ok, inputs} <- encode_inputs(input_vstream_infos, inputs),
+           prepare_time = System.monotonic_time(),
+           {:ok, results, timings} <- API.infer_timed(pipeline, inputs, request_opts),
+           parse_start = System.monotonic_time(),
+           result = output_parser.parse(results, output_parser_opts) do
+        measurements =
+          Map.merge(timings, %{
+            prepare: prepare_time - start,
+            parse: System.monotonic_time() - parse_start
+          })
+
+        status = if match?({:error, _}, result), do: result, else: :ok
+        {result, measurements, Map.put(metadata, :result, status)}
+      else
+        error -> {error, %{}, Map.put(metadata, :result, error)}
+      end
+    end)
   end
 
   defp encode_inputs(input_vstream_infos, inputs) do
@@ -85,6 +171,10 @@ defmodule NxHailo.Hailo do
             is_nil(input) ->
               {:halt, {:error, "Input #{key} not found in inputs"}}
 
+            # Letterboxed natively, see NxHailo.Preprocess.letterbox_input/3
+            match?({:letterbox, _, _}, input) ->
+              {:cont, {[{key, input} | acc], index + 1}}
+
             shape_size != Nx.size(input) ->
               {:halt,
                {:error,
@@ -6,26 +6,84 @@ defmodule NxHailo.Hailo.API do
   alias NxHailo.Hailo.API.VDevice
   alias NxHailo.Hailo.API.NetworkGroup
   alias NxHailo.Hailo.API.Pipeline
+  alias NxHailo.Hailo.API.StreamPipeline
   alias NxHailo.Hailo.API.VStreamInfo
 
+  @vstream_opts [
+    :input_format_type,
+    :output_format_type,
+    :timeout_ms,
+    :queue_size,
+    output_format_types: %{},
+    raw_outputs: false
+  ]
+
   @doc """
   Creates a new Hailo Virtual Device.
 
+  Without options this returns the shared VDevice, created on first use,
+  which all models loaded without an explicit device are configured on.
+
+  Options:
+    - `:device_ids` - IDs of the physical devices the VDevice spans, as
+      returned by `scan_devices/0`.
+    - `:device_count` - number of physical devices the VDevice spans,
+      picked by HailoRT.
+
+  With either option a new VDevice is created on every call. To balance
+  load yourself, create one VDevice per device ID and dispatch between them
+  with `NxHailo.Hailo.Dispatcher`.
+
   Returns `{:ok, %VDevice{}}` or `{:error, reason}`.
   """
-  def create_vdevice() do
-    if dev = :persistent_term.get({__MODULE__, :vdevice}, nil) do
-      {:ok, dev}
-    else
-      case NIF.create_vdevice() do
-        {:ok, ref} ->
-          dev = %VDevice{ref: ref}
-          :persistent_term.put({__MODULE__, :vdevice}, dev)
-          {:ok, dev}
-
-        error ->
-          error
-      end
+  def create_vdevice(opts \\ []) do
+    opts = Keyword.validate!(opts, [:device_ids, :device_count])
+
+    cond do
+      opts != [] ->
+        with {:ok, ref} <- NIF.create_vdevice(Map.new(opts)) do
+          {:ok, %VDevice{ref: ref}}
+        end
+
+      dev = :persistent_term.get({__MODULE__, :vdevice}, nil) ->
+        {:ok, dev}
+
+      true ->
+        case NIF.create_vdevice(%{}) do
+          {:ok, ref} ->
+            dev = %VDevice{ref: ref}
+            :persistent_term.put({__MODULE__, :vdevice}, dev)
+            {:ok, dev}
+
+          error ->
+            error
+        end
+    end
+  end
+
+  @doc """
+  Lists the IDs of the Hailo devices on the system, e.g. their PCIe
+  addresses.
+
+  Returns `{:ok, [device_id]}` or `{:error, reason}`.
+  """
+  def scan_devices do
+    NIF.scan_devices()
+  end
+
+  @doc """
+  Creates a simulated VDevice that runs entirely on the CPU.
+
+  Unlike `create_vdevice/0`, the device is not cached, so that several
+  simulated devices with different configurations can coexist.
+  See `NxHailo.Hailo.Simulator` for the accepted configuration.
+
+  Returns `{:ok, %VDevice{}}` or `{:error, reason}`.
+  """
+  def create_simulated_vdevice(config) when is_map(config) do
+    case NIF.create_simulated_vdevice(config) do
+      {:ok, ref} -> {:ok, %VDevice{ref: ref}}
+      error -> error
     end
   end
 
@@ -35,12 +93,33 @@ defmodule NxHailo.Hailo.API do
   Parameters:
     - `vdevice`: The `%VDevice{}` struct.
     - `hef_path`: The path to the HEF file (string).
+    - `opts`:
+      - `:batch_size` - number of frames the device processes per transfer.
+        Batches passed to `infer_batch/3` up to this size also reuse pooled
+        output buffers. Defaults to 0, which lets HailoRT pick.
+      - `:scheduler_priority` - model scheduler priority, from 0 to 31.
+        When several network groups share the device, pending frames of
+        higher priorities run first. Defaults to 16.
+      - `:scheduler_threshold` - frames that must be pending before the
+        scheduler switches to this network group. Defaults to the HailoRT
+        default.
+      - `:scheduler_timeout_ms` - time after which the scheduler switches to
+        this network group even below the threshold. Defaults to the
+        HailoRT default.
 
   Returns `{:ok, %NetworkGroup{}}` or `{:error, reason}`.
   """
-  def configure_network_group(%VDevice{ref: vdevice_ref} = _vdevice, hef_path)
+  def configure_network_group(%VDevice{ref: vdevice_ref} = _vdevice, hef_path, opts \\ [])
       when is_binary(hef_path) do
-    with {:ok, ng_ref} <- NIF.configure_network_group(vdevice_ref, hef_path),
+    opts =
+      Keyword.validate!(opts, [
+        :scheduler_priority,
+        :scheduler_threshold,
+        :scheduler_timeout_ms,
+        batch_size: 0
+      ])
+
+    with {:ok, ng_ref} <- NIF.configure_network_group(vdevice_ref, hef_path, Map.new(opts)),
          {:ok, raw_input_infos} <- NIF.get_input_vstream_infos_from_ng(ng_ref),
          {:ok, raw_output_infos} <- NIF.get_output_vstream_infos_from_ng(ng_ref) do
       input_infos = Enum.map(raw_input_infos, &VStreamInfo.from_map/1)
@@ -58,16 +137,108 @@ defmodule NxHailo.Hailo.API do
     end
   end
 
+  @doc """
+  Configures a network group and creates its inference pipeline in a
+  single native call.
+
+  Takes the options of `configure_network_group/3` and `create_pipeline/2`.
+  On real devices the HEF file is memory-mapped and parsed once per
+  content, so loading the same model again, even from another path, skips
+  reading and parsing it. See `hef_cache_stats/0`.
+
+  Returns `{:ok, %NetworkGroup{}, %Pipeline{}, timings}` or
+  `{:error, reason}`, where `timings` holds the `:configure_us` and
+  `:pipeline_us` spent in each step.
+  """
+  def load(%VDevice{ref: vdevice_ref}, hef_path, opts \\ []) when is_binary(hef_path) do
+    opts =
+      Keyword.validate!(
+        opts,
+        [
+          :scheduler_priority,
+          :scheduler_threshold,
+          :scheduler_timeout_ms,
+          batch_size: 0,
+          output_pool_size: 4
+        ] ++ @vstream_opts
+      )
+
+    with {:ok, result} <- NIF.load(vdevice_ref, hef_path, Map.new(opts)) do
+      ng_ref = result.network_group
+
+      network_group = %NetworkGroup{
+        ref: ng_ref,
+        vdevice_ref: vdevice_ref,
+        input_vstream_infos:
+          Enum.map(result.network_group_input_vstream_infos, &VStreamInfo.from_map/1),
+        output_vstream_infos:
+          Enum.map(result.network_group_output_vstream_infos, &VStreamInfo.from_map/1)
+      }
+
+      pipeline = %Pipeline{
+        ref: result.pipeline,
+        network_group_ref: ng_ref,
+        input_vstream_infos: Enum.map(result.input_vstream_infos, &VStreamInfo.from_map/1),
+        output_vstream_infos: Enum.map(result.output_vstream_infos, &VStreamInfo.from_map/1)
+      }
+
+      {:ok, network_group, pipeline, result.timings}
+    end
+  end
+
+  @doc """
+  Returns the `:hits`, `:misses`, `:entries` and `:bytes` of the
+  process-wide cache of parsed HEF files used by `load/3`.
+  """
+  def hef_cache_stats do
+    NIF.get_hef_cache_stats()
+  end
+
+  @doc """
+  Returns how long the transfers of a network group waited for the device
+  while other network groups used it.
+
+  Returns `{:ok, stats}` with the number of `:transfers` and `:frames`, and
+  the `:total_wait_us` and `:max_wait_us` wait. On a real device the wait is
+  estimated from the transfer latency above the fastest transfer of as many
+  frames seen, and only covers pipelines from `create_pipeline/2`.
+  """
+  def scheduler_stats(%NetworkGroup{ref: ng_ref}) do
+    NIF.get_scheduler_stats(ng_ref)
+  end
+
   @doc """
   Creates an inference pipeline from a configured network group.
 
   Parameters:
     - `network_group`: The `%NetworkGroup{}` struct.
+    - `opts`:
+      - `:output_pool_size` - number of idle output buffers kept per output
+        vstream. Output binaries point straight into these buffers, which
+        return to the pool once the binaries are garbage collected. Size it
+        after the number of results held at the same time, see
+        `output_pool_stats/1`. Defaults to 4.
+      - `:input_format_type` - host element type of the inputs, one of
+        `:auto`, `:uint8`, `:uint16` or `:float32`. Defaults to `:auto`.
+      - `:output_format_type` - host element type of the outputs. With
+        `:float32` HailoRT dequantizes on the host. Defaults to `:auto`.
+      - `:output_format_types` - map of output vstream names to the
+        element type of that output, overriding `:output_format_type`.
+      - `:raw_outputs` - when `true`, every non-NMS output keeps the
+        quantized type the device produces, so that the host does not spend
+        time dequantizing it. Use the `:quant_info` of the pipeline output
+        infos with `NxHailo.Quantization` to get real values. Defaults to
+        `false`.
+      - `:timeout_ms` - vstream read/write timeout. Defaults to 10000.
+      - `:queue_size` - vstream queue size. Defaults to 2.
 
   Returns `{:ok, %Pipeline{}}` or `{:error, reason}`.
   """
-  def create_pipeline(%NetworkGroup{ref: ng_ref} = _network_group) do
-    with {:ok, pipeline_ref} <- NIF.create_pipeline(ng_ref),
+  def create_pipeline(%NetworkGroup{ref: ng_ref} = network_group, opts \\ []) do
+    opts = Keyword.validate!(opts, [output_pool_size: 4] ++ @vstream_opts)
+
+    with {:ok, pipeline_ref} <-
+           NIF.create_pipeline(ng_ref, vstream_opts(network_group, opts)),
          {:ok, raw_input_infos} <- NIF.get_input_vstream_infos_from_pipeline(pipeline_ref),
          {:ok, raw_output_infos} <- NIF.get_output_vstream_infos_from_pipeline(pipeline_ref) do
       input_infos = Enum.map(raw_input_infos, &VStreamInfo.from_map/1)
@@ -86,29 +257,303 @@ defmodule NxHailo.Hailo.API do
   @doc """
   Runs inference on the given pipeline with the provided input data.
 
+  The work is handed to the pipeline's native worker thread through
+  `infer_async/3` and this function awaits the reply, so the calling
+  process does not occupy a scheduler while the device is busy.
+
   Parameters:
     - `pipeline`: The `%Pipeline{}` struct.
     - `input_data`: A map where keys are input vstream names (strings)
       and values are binaries containing the input data.
       Example: `%{ "input_layer1" => <<...>> }`
+      The binaries are read in place by the device, without being copied.
+      Values can also be inputs from `NxHailo.Preprocess.letterbox_input/3`,
+      which are letterboxed natively into the input buffer.
+    - `opts`:
+      - `:timeout` - milliseconds the request has to complete, counted
+        from the call. Defaults to the `:timeout_ms` of the pipeline, and
+        `:infinity` disables the deadline.
+      - `:deadline` - time by which the request has to complete, in
+        `System.monotonic_time(:millisecond)` units, e.g. the capture time
+        of a camera frame plus the latency budget. The earlier of
+        `:timeout` and `:deadline` applies.
+
+  When the request's turn comes, it is only decoded and sent to the device
+  if it can still complete by its deadline, judging by the service time of
+  recent requests. Otherwise it returns `{:error, :deadline_exceeded}`
+  without touching the device, so that a device that falls behind sheds
+  stale frames instead of queueing them. A request already on the device
+  runs to completion, bounded by the vstream timeout. See the `:expired`,
+  `:dropped` and `:late` counters of `pipeline_stats/1`.
 
   Returns `{:ok, output_data_map}` or `{:error, reason}`.
   The `output_data_map` is a map of output vstream names (strings) to binaries.
   """
-  def infer(
+  def infer(%Pipeline{} = pipeline, input_data, opts \\ []) when is_map(input_data) do
+    with {:ok, ref} <- infer_async(pipeline, input_data, opts) do
+      await(ref)
+    end
+  end
+
+  @doc """
+  Runs inference like `infer/3`, also reporting where the time went.
+
+  Returns `{:ok, output_data_map, timings}` or `{:error, reason}`, where
+  `timings` maps each native stage of the request to its duration in
+  `:native` time units:
+
+    - `:wait` - queued for the worker thread and behind other requests
+    - `:decode` - collecting the input map into device buffers, including
+      native letterboxing
+    - `:acquire` - taking output buffers from their pools
+    - `:device` - running the frame through the device
+    - `:encode` - building the output terms
+
+  Every request also feeds the histograms of `pipeline_stats/1`, timed or
+  not. Takes the `:timeout` and `:deadline` options of `infer/3`.
+  """
+  def infer_timed(
         %Pipeline{ref: pipeline_ref, input_vstream_infos: expected_infos} = _pipeline,
+        input_data,
+        opts \\ []
+      )
+      when is_map(input_data) do
+    request_opts = request_opts(opts)
+    ref = make_ref()
+
+    with :ok <- validate_input_data(expected_infos, input_data),
+         :ok <- NIF.infer_timed_async(pipeline_ref, input_data, ref, request_opts),
+         {:ok, outputs, timings} <- await(ref) do
+      {:ok, outputs, Map.new(timings, fn {stage, ns} -> {stage, to_native(ns)} end)}
+    end
+  end
+
+  defp to_native(ns), do: System.convert_time_unit(ns, :nanosecond, :native)
+
+  @doc """
+  Submits an inference request without waiting for it to complete.
+
+  Takes the `:timeout` and `:deadline` options of `infer/3`, with the
+  timeout counted from this call. Returns `{:ok, ref}` right away. The
+  result is later delivered to the calling process as
+  `{ref, {:ok, output_data_map} | {:error, reason}}`, which can be received
+  with `await/2`.
+  """
+  def infer_async(
+        %Pipeline{ref: pipeline_ref, input_vstream_infos: expected_infos} = _pipeline,
+        input_data,
+        opts \\ []
+      )
+      when is_map(input_data) do
+    request_opts = request_opts(opts)
+
+    with :ok <- validate_input_data(expected_infos, input_data) do
+      ref = make_ref()
+
+      case NIF.infer_async(pipeline_ref, input_data, ref, request_opts) do
+        :ok -> {:ok, ref}
+        {:error, reason} -> {:error, reason}
+      end
+    end
+  end
+
+  @doc """
+  Runs a batch of frames through the pipeline in a single device transfer.
+
+  Parameters:
+    - `pipeline`: The `%Pipeline{}` struct.
+    - `input_data`: A map where keys are input vstream names (strings) and
+      values are lists of frame binaries or letterbox inputs. Every vstream
+      must get the same number of frames.
+      Example: `%{"input_layer1" => [frame1, frame2, frame3]}`
+    - `opts`: the `:timeout` and `:deadline` of `infer/3`, which apply to
+      the batch as a whole.
+
+  Returns `{:ok, [output_data_map, ...]}` with one map per frame, in input
+  order, or `{:error, reason}`. The per-frame binaries of an output vstream
+  share one buffer, which is released once all of them are garbage
+  collected.
+  """
+  def infer_batch(%Pipeline{} = pipeline, input_data, opts \\ []) when is_map(input_data) do
+    with {:ok, ref} <- infer_batch_async(pipeline, input_data, opts) do
+      await(ref)
+    end
+  end
+
+  @doc """
+  Submits a batch without waiting for it to complete, see `infer_batch/3`.
+
+  Returns `{:ok, ref}` right away. The result is later delivered to the
+  calling process as `{ref, {:ok, [output_data_map, ...]} | {:error, reason}}`,
+  which can be received with `await/2`.
+  """
+  def infer_batch_async(
+        %Pipeline{ref: pipeline_ref, input_vstream_infos: expected_infos} = _pipeline,
+        input_data,
+        opts \\ []
+      )
+      when is_map(input_data) do
+    request_opts = request_opts(opts)
+
+    with :ok <- validate_input_names(expected_infos, input_data) do
+      ref = make_ref()
+
+      case NIF.infer_batch_async(pipeline_ref, input_data, ref, request_opts) do
+        :ok -> {:ok, ref}
+        {:error, reason} -> {:error, reason}
+      end
+    end
+  end
+
+  @doc """
+  Creates a streaming pipeline from a configured network group.
+
+  Unlike `create_pipeline/2`, which runs one synchronous round trip per
+  request, a streaming pipeline drives the input and output vstreams from
+  separate native writer and reader threads. The next frames are written
+  while the device works and earlier outputs are read, so the device is
+  not left idle during host-side copies and parsing.
+
+  Parameters:
+    - `network_group`: The `%NetworkGroup{}` struct.
+    - `opts`:
+      - `:depth` - maximum number of requests written to the device but
+        not read back yet. Defaults to 4.
+      - `:queue_size` - HailoRT vstream queue size. Defaults to `:depth`.
+      - `:output_pool_size` - idle output buffers kept per output vstream.
+        Defaults to `:depth`.
+      - `:input_format_type`, `:output_format_type`, `:output_format_types`,
+        `:raw_outputs` and `:timeout_ms` - as in `create_pipeline/2`.
+
+  Returns `{:ok, %StreamPipeline{}}` or `{:error, reason}`.
+  """
+  def create_stream_pipeline(%NetworkGroup{ref: ng_ref} = network_group, opts \\ []) do
+    opts = Keyword.validate!(opts, [:output_pool_size, depth: 4] ++ @vstream_opts)
+
+    with {:ok, ref} <-
+           NIF.create_stream_pipeline(ng_ref, vstream_opts(network_group, opts)),
+         {:ok, raw_input_infos} <- NIF.get_input_vstream_infos_from_stream_pipeline(ref),
+         {:ok, raw_output_infos} <- NIF.get_output_vstream_infos_from_stream_pipeline(ref) do
+      {:ok,
+       %StreamPipeline{
+         ref: ref,
+         network_group_ref: ng_ref,
+         depth: opts[:depth],
+         input_vstream_infos: Enum.map(raw_input_infos, &VStreamInfo.from_map/1),
+         output_vstream_infos: Enum.map(raw_output_infos, &VStreamInfo.from_map/1)
+       }}
+    end
+  end
+
+  @doc """
+  Queues a request on a streaming pipeline.
+
+  Takes the same input data as `infer/3`. Returns `{:ok, ref}` right away.
+  Results are delivered to the calling process in submission order as
+  `{ref, {:ok, output_data_map} | {:error, reason}}`, see `await/2`.
+  Requests beyond the pipeline depth wait natively for their turn.
+
+  Once reading or writing a vstream fails, the pipeline is aborted: the
+  requests still queued fail with the same reason, as does any later
+  `stream_submit/2`.
+  """
+  def stream_submit(
+        %StreamPipeline{ref: stream_ref, input_vstream_infos: expected_infos},
         input_data
       )
       when is_map(input_data) do
-    case validate_input_data(expected_infos, input_data) do
-      :ok ->
-        NIF.infer(pipeline_ref, input_data)
+    with :ok <- validate_input_data(expected_infos, input_data) do
+      ref = make_ref()
 
-      {:error, reason} ->
-        {:error, reason}
+      case NIF.stream_submit(stream_ref, input_data, ref) do
+        :ok -> {:ok, ref}
+        {:error, reason} -> {:error, reason}
+      end
     end
   end
 
+  @doc """
+  Lazily runs an enumerable of input data maps through a streaming
+  pipeline, keeping up to the pipeline depth requests in flight.
+
+  Returns a stream of `{:ok, output_data_map} | {:error, reason}` results,
+  in input order.
+  """
+  def stream(%StreamPipeline{depth: depth} = stream_pipeline, inputs) do
+    Stream.transform(
+      inputs,
+      fn -> :queue.new() end,
+      fn input_data, refs ->
+        refs =
+          case stream_submit(stream_pipeline, input_data) do
+            {:ok, ref} -> :queue.in({:ref, ref}, refs)
+            error -> :queue.in({:done, error}, refs)
+          end
+
+        if :queue.len(refs) >= depth do
+          {{:value, entry}, refs} = :queue.out(refs)
+          {[await_entry(entry)], refs}
+        else
+          {[], refs}
+        end
+      end,
+      fn refs -> {Enum.map(:queue.to_list(refs), &await_entry/1), :queue.new()} end,
+      fn _refs -> :ok end
+    )
+  end
+
+  defp await_entry({:ref, ref}), do: await(ref)
+  defp await_entry({:done, result}), do: result
+
+  @doc """
+  Waits for the result of a request submitted with `infer_async/3`,
+  `infer_batch_async/3` or `stream_submit/2`.
+
+  Returns `{:error, :timeout}` if nothing arrives within `timeout`.
+  In that case the late reply, if any, is left in the mailbox.
+  """
+  def await(ref, timeout \\ :infinity) when is_reference(ref) do
+    receive do
+      {^ref, result} -> result
+    after
+      timeout -> {:error, :timeout}
+    end
+  end
+
+  @doc """
+  Reports the request counters and latency histograms of a pipeline.
+
+  Returns `{:ok, stats}` where `stats` has the number of `:requests`,
+  successful `:frames` and failed requests (`:errors`), the requests not
+  run because their deadline had passed (`:expired`) or could not be made
+  (`:dropped`), the requests that completed after their deadline
+  (`:late`), the latency of
+  each stage of `infer_timed/3` under `:stages`, and the end-to-end native
+  latency under `:total`. Each latency has the `:count` of requests, and
+  the `:total_us`, `:mean_us`, `:min_us`, `:max_us`, `:p50_us`, `:p90_us`,
+  `:p99_us` and `:p999_us` in microseconds. Percentiles come from
+  log-linear histograms and are accurate to about 3%.
+
+  Every `infer/3`, `infer_async/3` and `infer_batch/3` request on the
+  pipeline is recorded, and reading the stats does not stop recording.
+  """
+  def pipeline_stats(%Pipeline{ref: pipeline_ref}) do
+    NIF.get_pipeline_stats(pipeline_ref)
+  end
+
+  @doc """
+  Reports the output buffer pools of a pipeline, keyed by output vstream name.
+
+  Each entry has the `:buffer_size` and `:capacity` of the pool, the number of
+  `:idle` and `:in_use` buffers, the `:peak_in_use`, and how many buffers were
+  `:acquired` in total. `:misses` counts the times no idle buffer was
+  available and one had to be allocated, a sign that `:output_pool_size` is
+  too small for the workload.
+  """
+  def output_pool_stats(%Pipeline{ref: pipeline_ref}) do
+    NIF.get_output_pool_stats(pipeline_ref)
+  end
+
   @doc """
   Retrieves input vstream information for a configured resource.
   Accepts either a `%NetworkGroup{}` or an `%Pipeline{}` struct.
@@ -145,7 +590,46 @@ defmodule NxHailo.Hailo.API do
     end
   end
 
-  defp validate_input_data(expected_infos, input_data) do
+  # Native request options, with the time left until the earlier of the
+  # `:timeout` and `:deadline`. Without either the pipeline default applies.
+  defp request_opts(opts) do
+    opts = Keyword.validate!(opts, [:timeout, :deadline])
+
+    remaining =
+      case opts[:deadline] do
+        nil -> nil
+        deadline -> max(deadline - System.monotonic_time(:millisecond), 0)
+      end
+
+    case {opts[:timeout], remaining} do
+      {nil, nil} -> %{}
+      {timeout, nil} -> %{timeout_ms: timeout}
+      {timeout, remaining} when timeout in [nil, :infinity] -> %{timeout_ms: remaining}
+      {timeout, remaining} -> %{timeout_ms: min(timeout, remaining)}
+    end
+  end
+
+  # Resolves `:raw_outputs` into per-output format types, taken from the
+  # network group infos, which describe what the device produces
+  defp vstream_opts(%NetworkGroup{output_vstream_infos: output_infos}, opts) do
+    {raw_outputs, opts} = Keyword.pop!(opts, :raw_outputs)
+
+    raw_types =
+      if raw_outputs do
+        for %{nms_shape: nil, name: name, format: %{type: type}} <- output_infos,
+            into: %{},
+            do: {name, type}
+      else
+        %{}
+      end
+
+    opts
+    |> Keyword.update!(:output_format_types, &Map.merge(raw_types, &1))
+    |> Map.new()
+  end
+
+  # Frame sizes of batches are checked natively while the frames are gathered
+  defp validate_input_names(expected_infos, input_data) do
     expected_names = Enum.map(expected_infos, & &1.name)
     provided_names = Map.keys(input_data)
 
@@ -163,23 +647,35 @@ defmodule NxHailo.Hailo.API do
         {:error, "Extra input for vstreams: #{inspect(extra_streams)}"}
 
       true ->
-        Enum.reduce_while(expected_infos, :ok, fn expected_info, _acc ->
-          stream_name = expected_info.name
-          expected_size = expected_info.frame_size
-          actual_data = input_data[stream_name]
-
-          unless is_binary(actual_data) do
-            {:stop, {:error, "Input data for vstream '#{stream_name}' must be a binary."}}
-          else
+        :ok
+    end
+  end
+
+  defp validate_input_data(expected_infos, input_data) do
+    with :ok <- validate_input_names(expected_infos, input_data) do
+      Enum.reduce_while(expected_infos, :ok, fn expected_info, _acc ->
+        stream_name = expected_info.name
+        expected_size = expected_info.frame_size
+        actual_data = input_data[stream_name]
+
+        case actual_data do
+          # Letterboxed natively, see NxHailo.Preprocess.letterbox_input/3
+          {:letterbox, frame, opts} when is_binary(frame) and is_map(opts) ->
+            {:cont, :ok}
+
+          actual_data when not is_binary(actual_data) ->
+            {:halt, {:error, "Input data for vstream '#{stream_name}' must be a binary."}}
+
+          actual_data ->
             if byte_size(actual_data) != expected_size do
-              {:stop,
+              {:halt,
                {:error,
                 "Invalid input data size for vstream '#{stream_name}'. Expected: #{expected_size}, Got: #{byte_size(actual_data)}"}}
             else
               {:cont, :ok}
             end
-          end
-        end)
+        end
+      end)
     end
   end
 end
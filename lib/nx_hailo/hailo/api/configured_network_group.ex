@@ -8,4 +8,12 @@ defmodule NxHailo.Hailo.API.NetworkGroup do
             name: nil,
             input_vstream_infos: [],
             output_vstream_infos: []
+
+  @type t :: %__MODULE__{
+          ref: reference(),
+          vdevice_ref: reference(),
+          name: String.t() | nil,
+          input_vstream_infos: [NxHailo.Hailo.API.VStreamInfo.t()],
+          output_vstream_infos: [NxHailo.Hailo.API.VStreamInfo.t()]
+        }
 end
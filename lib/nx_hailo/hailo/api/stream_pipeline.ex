@@ -0,0 +1,19 @@
+defmodule NxHailo.Hailo.API.StreamPipeline do
+  @moduledoc """
+  Represents a streaming inference pipeline, see
+  `NxHailo.Hailo.API.create_stream_pipeline/2`.
+  """
+  defstruct ref: nil,
+            network_group_ref: nil,
+            depth: 1,
+            input_vstream_infos: [],
+            output_vstream_infos: []
+
+  @type t :: %__MODULE__{
+          ref: reference(),
+          network_group_ref: reference(),
+          depth: pos_integer(),
+          input_vstream_infos: [NxHailo.Hailo.API.VStreamInfo.t()],
+          output_vstream_infos: [NxHailo.Hailo.API.VStreamInfo.t()]
+        }
+end
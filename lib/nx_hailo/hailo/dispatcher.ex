@@ -0,0 +1,180 @@
+defmodule NxHailo.Hailo.Dispatcher do
+  @moduledoc """
+  Spreads inference requests over the same model loaded on several devices.
+
+  Each request goes to the pipeline with the fewest outstanding requests,
+  so a device that falls behind, e.g. because another model shares it,
+  automatically gets less work:
+
+      {:ok, device_ids} = NxHailo.Hailo.API.scan_devices()
+
+      models =
+        for device_id <- device_ids do
+          {:ok, vdevice} = NxHailo.Hailo.API.create_vdevice(device_ids: [device_id])
+          {:ok, model} = NxHailo.Hailo.load("/data/yolov8m.hef", vdevice: vdevice)
+          model
+        end
+
+      {:ok, dispatcher} = NxHailo.Hailo.Dispatcher.start_link(models: models)
+      {:ok, outputs} = NxHailo.Hailo.Dispatcher.infer(dispatcher, %{input_name => frame})
+
+  Devices from `NxHailo.Hailo.Simulator.create_vdevice/1` are independent
+  of each other, so the same setup runs without hardware.
+
+  ## Options
+
+    - `:name` - registered name of the dispatcher.
+    - `:models` - the `%NxHailo.Hailo.Model{}` structs to dispatch to, one
+      per device. Their inputs and outputs must match.
+  """
+
+  use GenServer
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Model
+
+  def start_link(opts) do
+    opts = Keyword.validate!(opts, [:name, :models])
+    GenServer.start_link(__MODULE__, opts, Keyword.take(opts, [:name]))
+  end
+
+  @doc """
+  Runs inference on the least busy device. Takes the same input data as
+  `NxHailo.Hailo.API.infer/3`.
+
+  Options:
+    - `:timeout` - how long to wait for the result. Defaults to `:infinity`.
+
+  Returns `{:ok, output_data_map}` or `{:error, reason}`.
+  """
+  def infer(dispatcher, input_data, opts \\ []) when is_map(input_data) do
+    opts = Keyword.validate!(opts, timeout: :infinity)
+    GenServer.call(dispatcher, {:infer, input_data}, opts[:timeout])
+  end
+
+  @doc """
+  Returns per-device statistics, in the order of the `:models` option.
+
+  For each device: the `:outstanding` requests, the `:completed` and
+  `:failed` ones, the `:busy_us` time spent with at least one request
+  outstanding and the resulting `:utilization`, the fraction of the
+  dispatcher's lifetime the device was busy.
+  """
+  def stats(dispatcher) do
+    GenServer.call(dispatcher, :stats)
+  end
+
+  @impl true
+  def init(opts) do
+    case opts[:models] do
+      [_ | _] = models ->
+        devices =
+          models
+          |> Enum.map(fn %Model{pipeline: pipeline} ->
+            %{
+              pipeline: pipeline,
+              outstanding: 0,
+              completed: 0,
+              failed: 0,
+              busy_us: 0,
+              busy_since: nil
+            }
+          end)
+          |> List.to_tuple()
+
+        {:ok, %{devices: devices, pending: %{}, started_at: now()}}
+
+      _ ->
+        {:stop, "Dispatcher needs at least one model"}
+    end
+  end
+
+  @impl true
+  def handle_call({:infer, input_data}, from, state) do
+    index = least_outstanding(state.devices)
+    device = elem(state.devices, index)
+
+    case API.infer_async(device.pipeline, input_data) do
+      {:ok, ref} ->
+        device = %{
+          device
+          | outstanding: device.outstanding + 1,
+            busy_since: device.busy_since || now()
+        }
+
+        state = %{
+          state
+          | devices: put_elem(state.devices, index, device),
+            pending: Map.put(state.pending, ref, {from, index})
+        }
+
+        {:noreply, state}
+
+      {:error, reason} ->
+        {:reply, {:error, reason}, state}
+    end
+  end
+
+  def handle_call(:stats, _from, state) do
+    current = now()
+    elapsed_us = max(current - state.started_at, 1)
+
+    stats =
+      for device <- Tuple.to_list(state.devices) do
+        busy_us =
+          if device.busy_since,
+            do: device.busy_us + current - device.busy_since,
+            else: device.busy_us
+
+        %{
+          outstanding: device.outstanding,
+          completed: device.completed,
+          failed: device.failed,
+          busy_us: busy_us,
+          utilization: busy_us / elapsed_us
+        }
+      end
+
+    {:reply, stats, state}
+  end
+
+  @impl true
+  def handle_info({ref, result}, state) when is_map_key(state.pending, ref) do
+    {{from, index}, pending} = Map.pop(state.pending, ref)
+    GenServer.reply(from, result)
+
+    device = elem(state.devices, index)
+    outstanding = device.outstanding - 1
+
+    device = %{
+      device
+      | outstanding: outstanding,
+        completed: device.completed + if(match?({:ok, _}, result), do: 1, else: 0),
+        failed: device.failed + if(match?({:ok, _}, result), do: 0, else: 1)
+    }
+
+    device =
+      if outstanding == 0 do
+        %{device | busy_us: device.busy_us + now() - device.busy_since, busy_since: nil}
+      else
+        device
+      end
+
+    {:noreply, %{state | devices: put_elem(state.devices, index, device), pending: pending}}
+  end
+
+  # Replies to requests that were already answered, and anything else
+  def handle_info(_msg, state), do: {:noreply, state}
+
+  # Ties go to the device that completed the least so far, so an idle
+  # system still spreads requests over every device
+  defp least_outstanding(devices) do
+    0..(tuple_size(devices) - 1)
+    |> Enum.min_by(fn index ->
+      device = elem(devices, index)
+      {device.outstanding, device.completed + device.failed}
+    end)
+  end
+
+  defp now, do: System.monotonic_time(:microsecond)
+end
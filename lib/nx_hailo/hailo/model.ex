@@ -4,11 +4,13 @@ defmodule NxHailo.Hailo.Model do
   This struct encapsulates the inference pipeline and associated metadata.
   """
   defstruct pipeline: nil,
+            network_group: nil,
             # e.g., HEF filename or a custom model name
             name: nil
 
   @type t :: %__MODULE__{
           pipeline: NxHailo.Hailo.API.Pipeline.t(),
+          network_group: NxHailo.Hailo.API.NetworkGroup.t(),
           name: String.t()
         }
 end
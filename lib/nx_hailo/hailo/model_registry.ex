@@ -0,0 +1,128 @@
+defmodule NxHailo.Hailo.ModelRegistry do
+  @moduledoc """
+  Keeps several models configured on one shared VDevice.
+
+  HailoRT's model scheduler switches the device between the network groups
+  configured on it, so a detector and a secondary classifier can run side by
+  side without activating them by hand. Each model gets its own scheduler
+  priority, threshold and timeout:
+
+      children = [
+        {NxHailo.Hailo.ModelRegistry,
+         name: MyApp.Models,
+         models: [
+           detector: {"/data/yolov8m.hef", scheduler_priority: 20},
+           classifier:
+             {"/data/resnet_v1_18.hef",
+              scheduler_priority: 10, scheduler_threshold: 4, scheduler_timeout_ms: 50}
+         ]}
+      ]
+
+      {:ok, detector} = NxHailo.Hailo.ModelRegistry.fetch(MyApp.Models, :detector)
+      NxHailo.Hailo.infer(detector, inputs, NxHailo.Parsers.YoloV8, opts)
+
+  Model options are those of `NxHailo.Hailo.load/2`, except `:vdevice`.
+  Models are configured when the registry starts, or later with
+  `register/4`, and handed out as `%NxHailo.Hailo.Model{}` structs that are
+  used without going through the registry again.
+
+  ## Options
+
+    - `:name` - registered name of the registry.
+    - `:vdevice` - the shared device. Defaults to `API.create_vdevice/0`.
+    - `:models` - keyword list of `name: {hef_path, opts}` to configure at
+      start.
+  """
+
+  use GenServer
+
+  alias NxHailo.Hailo
+  alias NxHailo.Hailo.API
+
+  def start_link(opts) do
+    opts = Keyword.validate!(opts, [:name, :vdevice, models: []])
+    GenServer.start_link(__MODULE__, opts, Keyword.take(opts, [:name]))
+  end
+
+  @doc """
+  Configures another model on the shared device under `name`.
+
+  Returns `{:ok, %NxHailo.Hailo.Model{}}` or `{:error, reason}`.
+  """
+  def register(registry, name, hef_path, opts \\ []) when is_binary(hef_path) do
+    GenServer.call(registry, {:register, name, hef_path, opts}, :infinity)
+  end
+
+  @doc """
+  Returns `{:ok, %NxHailo.Hailo.Model{}}` for a registered model, or
+  `{:error, reason}`.
+  """
+  def fetch(registry, name) do
+    GenServer.call(registry, {:fetch, name})
+  end
+
+  @doc """
+  Returns the scheduler statistics of every registered model, see
+  `NxHailo.Hailo.API.scheduler_stats/1`.
+  """
+  def stats(registry) do
+    models = GenServer.call(registry, :models)
+
+    Map.new(models, fn {name, model} ->
+      {:ok, stats} = API.scheduler_stats(model.network_group)
+      {name, stats}
+    end)
+  end
+
+  @impl true
+  def init(opts) do
+    with {:ok, vdevice} <- fetch_vdevice(opts[:vdevice]),
+         {:ok, models} <- load_models(vdevice, opts[:models]) do
+      {:ok, %{vdevice: vdevice, models: models}}
+    else
+      {:error, reason} -> {:stop, reason}
+    end
+  end
+
+  @impl true
+  def handle_call({:register, name, hef_path, opts}, _from, state) do
+    if Map.has_key?(state.models, name) do
+      {:reply, {:error, "Model #{inspect(name)} is already registered"}, state}
+    else
+      case load(state.vdevice, hef_path, opts) do
+        {:ok, model} ->
+          {:reply, {:ok, model}, put_in(state.models[name], model)}
+
+        {:error, reason} ->
+          {:reply, {:error, reason}, state}
+      end
+    end
+  end
+
+  def handle_call({:fetch, name}, _from, state) do
+    case Map.fetch(state.models, name) do
+      {:ok, model} -> {:reply, {:ok, model}, state}
+      :error -> {:reply, {:error, "Unknown model #{inspect(name)}"}, state}
+    end
+  end
+
+  def handle_call(:models, _from, state) do
+    {:reply, state.models, state}
+  end
+
+  defp fetch_vdevice(nil), do: API.create_vdevice()
+  defp fetch_vdevice(%API.VDevice{} = vdevice), do: {:ok, vdevice}
+
+  defp load_models(vdevice, models) do
+    Enum.reduce_while(models, {:ok, %{}}, fn {name, {hef_path, opts}}, {:ok, acc} ->
+      case load(vdevice, hef_path, opts) do
+        {:ok, model} -> {:cont, {:ok, Map.put(acc, name, model)}}
+        {:error, reason} -> {:halt, {:error, "Failed to load #{inspect(name)}: #{reason}"}}
+      end
+    end)
+  end
+
+  defp load(vdevice, hef_path, opts) do
+    Hailo.load(hef_path, Keyword.put(opts, :vdevice, vdevice))
+  end
+end
@@ -0,0 +1,212 @@
+defmodule NxHailo.Hailo.Serving do
+  @moduledoc """
+  `Nx.Serving` for a loaded `%NxHailo.Hailo.Model{}`.
+
+  Requests from concurrent callers are merged into batches of up to
+  `:batch_size` frames, or whatever arrived within the `:batch_timeout` of
+  the serving process, and each batch runs through the device in a single
+  `NxHailo.Hailo.API.infer_batch/3` transfer. The outputs are split back to
+  their callers, which run the output parser in their own process:
+
+      {:ok, model} = NxHailo.Hailo.load("/data/yolov8m.hef", batch_size: 8)
+
+      serving =
+        NxHailo.Hailo.Serving.new(model, NxHailo.Parsers.YoloV8,
+          parser_opts: [key: output_key, classes: classes],
+          batch_size: 8
+        )
+
+      children = [
+        {Nx.Serving, serving: serving, name: MyApp.Detector, batch_timeout: 10}
+      ]
+
+      {:ok, objects} = Nx.Serving.batched_run(MyApp.Detector, %{input_name => frame})
+
+  Configure the network group with the same `:batch_size`, so that a full
+  batch is a single device transfer.
+
+  ## Inputs
+
+  An input is a map of input vstream names to frames, as accepted by
+  `NxHailo.Hailo.infer/4`: tensors or binaries with one frame each, or
+  `{:letterbox, frame, opts}` from `NxHailo.Preprocess.letterbox_input/3`.
+  Letterbox inputs are letterboxed in the calling process and their
+  letterbox map is passed on to the parser as `:letterbox`, so boxes come
+  back in frame coordinates. A list of input maps is answered with a list
+  of results, in order.
+
+  Each result is whatever the parser returns, e.g. `{:ok, objects}`, or
+  `{:error, reason}` for every request of a batch the device failed.
+
+  ## Telemetry
+
+    - `[:nx_hailo, :serving, :batch]` - once per batch, from the serving.
+      Measurements: the batch `:size`, its `:fill` (size over
+      `:batch_size`) and the `:duration` of its
+      `NxHailo.Hailo.API.infer_batch/3` call in `:native` units. Metadata:
+      the model `:name`.
+    - `[:nx_hailo, :serving, :request]` - once per request, from the
+      caller. Measurements: the `:queue_wait` between the request being
+      submitted and its batch starting, in `:native` units, and the
+      `:batch_size` of the batch it ran in. Metadata: the model `:name`.
+
+  `Nx.Serving` emits its own `[:nx, :serving, ...]` events as well.
+  """
+
+  @behaviour Nx.Serving
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Model
+  alias NxHailo.Preprocess
+
+  @doc """
+  Builds the serving.
+
+  Options:
+    - `:parser_opts` - options of the output parser. Defaults to `[]`.
+    - `:batch_size` - frames per batch. Defaults to 4.
+  """
+  def new(%Model{} = model, output_parser, opts \\ []) when is_atom(output_parser) do
+    opts = Keyword.validate!(opts, parser_opts: [], batch_size: 4)
+    name = model.name
+
+    Nx.Serving.new(__MODULE__, %{model: model, batch_size: opts[:batch_size]})
+    |> Nx.Serving.batch_size(opts[:batch_size])
+    |> Nx.Serving.client_preprocessing(&preprocess(model, &1))
+    |> Nx.Serving.client_postprocessing(&postprocess(name, output_parser, opts[:parser_opts], &1, &2))
+  end
+
+  @impl true
+  def init(_type, arg, _defn_options) do
+    {:ok, arg}
+  end
+
+  @impl true
+  def handle_batch(%Nx.Batch{size: size} = batch, _partition, state) do
+    %{model: %Model{name: name, pipeline: pipeline}, batch_size: batch_size} = state
+
+    run = fn ->
+      started_at = System.monotonic_time()
+      inputs = Nx.Defn.jit_apply(&Function.identity/1, [batch], compiler: Nx.Defn.Evaluator)
+      frames = Map.new(inputs, fn {key, tensor} -> {key, split_frames(tensor, size)} end)
+      infer_start = System.monotonic_time()
+      result = API.infer_batch(pipeline, frames)
+
+      :telemetry.execute(
+        [:nx_hailo, :serving, :batch],
+        %{size: size, fill: size / batch_size, duration: System.monotonic_time() - infer_start},
+        %{name: name}
+      )
+
+      metadata = %{started_at: started_at, batch_size: size}
+
+      # A failed batch fails each of its requests instead of the serving
+      case result do
+        {:ok, outputs} -> {stack_outputs(pipeline.output_vstream_infos, outputs, size), metadata}
+        {:error, reason} -> {%{}, Map.put(metadata, :error, reason)}
+      end
+    end
+
+    {:execute, run, state}
+  end
+
+  # Frames of one input as sub-binaries of the stacked tensor
+  defp split_frames(tensor, size) do
+    binary = Nx.to_binary(tensor)
+    frame_size = div(byte_size(binary), size)
+    for i <- 0..(size - 1), do: binary_part(binary, i * frame_size, frame_size)
+  end
+
+  # Outputs as `{size, frame_size}` u8 tensors, so that Nx.Serving can slice
+  # each caller's frames out of the batch
+  defp stack_outputs(output_infos, outputs, size) do
+    Map.new(output_infos, fn %{name: name, frame_size: frame_size} ->
+      binary = IO.iodata_to_binary(Enum.map(outputs, & &1[name]))
+      {name, binary |> Nx.from_binary(:u8) |> Nx.reshape({size, frame_size})}
+    end)
+  end
+
+  defp preprocess(%Model{pipeline: pipeline}, input) do
+    {inputs, batched?} =
+      case input do
+        inputs when is_list(inputs) -> {inputs, true}
+        inputs when is_map(inputs) -> {[inputs], false}
+      end
+
+    {tensors, letterboxes} =
+      inputs
+      |> Enum.map(&encode_input(pipeline.input_vstream_infos, &1))
+      |> Enum.unzip()
+
+    info = %{
+      batched?: batched?,
+      letterboxes: letterboxes,
+      enqueued_at: System.monotonic_time()
+    }
+
+    {Nx.Batch.stack(tensors), info}
+  end
+
+  # One input map as a map of tensors shaped like the input vstreams, and
+  # the letterbox map of its letterboxed input if any
+  defp encode_input(input_infos, input) when is_map(input) do
+    Enum.map_reduce(input_infos, nil, fn info, letterbox ->
+      case Map.fetch(input, info.name) do
+        {:ok, {:letterbox, frame, opts}} ->
+          {:ok, {binary, letterbox}} =
+            Preprocess.letterbox(
+              frame,
+              [target_width: info.shape.width, target_height: info.shape.height] ++
+                Keyword.new(opts)
+            )
+
+          {{info.name, to_tensor(binary, info)}, letterbox}
+
+        {:ok, frame} ->
+          {{info.name, to_tensor(frame, info)}, letterbox}
+
+        :error ->
+          raise ArgumentError, "missing input #{inspect(info.name)}"
+      end
+    end)
+    |> then(fn {tensors, letterbox} -> {Map.new(tensors), letterbox} end)
+  end
+
+  defp to_tensor(frame, %{format: %{type: type}, shape: shape}) do
+    frame = if is_binary(frame), do: Nx.from_binary(frame, nx_type(type)), else: frame
+    Nx.reshape(frame, {shape.height, shape.width, shape.features})
+  end
+
+  defp nx_type(:uint16), do: :u16
+  defp nx_type(:float32), do: :f32
+  defp nx_type(_), do: :u8
+
+  defp postprocess(name, output_parser, parser_opts, {outputs, metadata}, info) do
+    :telemetry.execute(
+      [:nx_hailo, :serving, :request],
+      %{queue_wait: metadata.started_at - info.enqueued_at, batch_size: metadata.batch_size},
+      %{name: name}
+    )
+
+    results =
+      case metadata do
+        %{error: reason} ->
+          Enum.map(info.letterboxes, fn _ -> {:error, reason} end)
+
+        _ ->
+          info.letterboxes
+          |> Enum.with_index()
+          |> Enum.map(fn {letterbox, i} ->
+            parse_frame(output_parser, parser_opts, outputs, letterbox, i)
+          end)
+      end
+
+    if info.batched?, do: results, else: hd(results)
+  end
+
+  defp parse_frame(output_parser, parser_opts, outputs, letterbox, i) do
+    output_map = Map.new(outputs, fn {key, tensor} -> {key, Nx.to_binary(tensor[i])} end)
+    opts = if letterbox, do: Keyword.put(parser_opts, :letterbox, letterbox), else: parser_opts
+    output_parser.parse(output_map, opts)
+  end
+end
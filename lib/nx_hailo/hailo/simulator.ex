@@ -0,0 +1,78 @@
+defmodule NxHailo.Hailo.Simulator do
+  @moduledoc """
+  Software stand-in for a Hailo accelerator.
+
+  A simulated VDevice exposes the vstreams it was configured with for every
+  HEF configured on it (the HEF file itself is never read), sleeps for a
+  configurable latency on each transfer and fills the outputs with
+  deterministic data. Transfers of network groups configured on the same
+  device take turns, highest scheduler priority first. NMS outputs follow the same run-length layout as the
+  Hailo YoloV8 model, so `NxHailo.Parsers.YoloV8` can parse them.
+
+  This allows the whole pipeline to be built, tested and benchmarked on a
+  machine without a Hailo device:
+
+      {:ok, vdevice} = NxHailo.Hailo.Simulator.create_vdevice(NxHailo.Hailo.Simulator.yolov8())
+      {:ok, model} = NxHailo.Hailo.load("yolov8m.hef", vdevice: vdevice)
+
+  ## Configuration
+
+    - `:input_vstreams` / `:output_vstreams` - lists of maps shaped like
+      `NxHailo.Hailo.API.VStreamInfo` (`:name`, `:format`, `:shape`,
+      `:nms_shape`, `:quant_info`). `:frame_size` is computed.
+    - `:networks` - map of HEF file names (without directory) to maps with
+      their own `:input_vstreams` / `:output_vstreams`, for several models
+      on one device. Other HEF files get the vstreams above.
+    - `:latency_us` - fixed cost of each device transfer.
+    - `:per_frame_latency_us` - additional cost of each frame in a transfer.
+    - `:jitter_us` - uniform jitter applied to each transfer.
+    - `:estimate_wait` - report the scheduler wait of
+      `NxHailo.Hailo.API.scheduler_stats/1` estimated from the transfer
+      latencies, as on a real device, instead of measuring it.
+    - `:seed` - seed for the generated outputs. Equal inputs and seeds
+      always produce equal outputs.
+    - `:detections_per_frame` - boxes written to each NMS output frame.
+  """
+
+  alias NxHailo.Hailo.API
+
+  @doc """
+  Creates a simulated VDevice from the given configuration.
+  """
+  def create_vdevice(config) when is_map(config) do
+    API.create_simulated_vdevice(config)
+  end
+
+  @doc """
+  Configuration that mimics the `yolov8m.hef` model from the Hailo model zoo:
+  a single 640x640x3 uint8 input and an NMS output with 80 classes.
+
+  Any configuration key can be overridden through `opts`. The default latency
+  is roughly what the real device takes per frame.
+  """
+  def yolov8(opts \\ []) do
+    defaults = %{
+      latency_us: 20_000,
+      per_frame_latency_us: 0,
+      jitter_us: 0,
+      seed: 0,
+      detections_per_frame: 5,
+      input_vstreams: [
+        %{
+          name: "yolov8m/input_layer1",
+          format: %{type: :uint8, order: :nhwc},
+          shape: %{height: 640, width: 640, features: 3}
+        }
+      ],
+      output_vstreams: [
+        %{
+          name: "yolov8m/yolov8_nms_postprocess",
+          format: %{type: :float32, order: :hailo_nms},
+          nms_shape: %{number_of_classes: 80, max_bboxes_per_class_or_total: 100}
+        }
+      ]
+    }
+
+    Map.merge(defaults, Map.new(opts))
+  end
+end
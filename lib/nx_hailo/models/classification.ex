@@ -0,0 +1,73 @@
+defmodule NxHailo.Parsers.Classification do
+  @moduledoc """
+  Parser for classification heads, such as ResNet or MobileNet HEFs, whose
+  output is one score (logit) per class.
+
+  The top-k selection runs natively on the output binary, so the full
+  tensor is never built in the BEAM. With raw outputs (see `:raw_outputs`
+  in `NxHailo.Hailo.API.create_pipeline/2`) it even runs on the uint8/uint16
+  values the device produces, and only the winners are dequantized:
+
+      {:ok, model} = NxHailo.Hailo.load("/data/resnet_v1_50.hef", raw_outputs: true)
+      [info] = model.pipeline.output_vstream_infos
+
+      {:ok, [%{class_name: name, score: score} | _]} =
+        NxHailo.Hailo.infer(model, inputs, NxHailo.Parsers.Classification,
+          key: info.name,
+          info: info,
+          classes: classes,
+          softmax: true
+        )
+  """
+
+  @behaviour NxHailo.Hailo.OutputParser
+
+  defmodule Prediction do
+    @moduledoc """
+    A class and its score, the dequantized logit or its softmax probability.
+    """
+
+    defstruct [:class_id, :class_name, :score]
+  end
+
+  @doc """
+  Parses a classification output into `%Prediction{}` structs, best score
+  first.
+
+  ## Options
+
+  - `:key` - output vstream name holding the scores. Required.
+  - `:classes` - map of class id to class name. Defaults to no names.
+  - `:info` - output vstream info, for the element type and quantization
+    parameters of raw outputs. Without it, the output is read as float32.
+  - `:top_k` - number of classes to return. Defaults to 5.
+  - `:softmax` - when `true`, scores are the softmax over the returned
+    classes rather than the logits. Defaults to `false`.
+  """
+  @impl NxHailo.Hailo.OutputParser
+  def parse(output_map, opts) when is_list(opts) do
+    opts = Keyword.validate!(opts, [:key, :info, classes: %{}, top_k: 5, softmax: false])
+    output = Map.fetch!(output_map, Keyword.fetch!(opts, :key))
+    classes = opts[:classes]
+
+    nif_opts =
+      opts[:info]
+      |> format_opts()
+      |> Map.merge(%{top_k: opts[:top_k], softmax: opts[:softmax]})
+
+    with {:ok, top_k} <- NxHailo.NIF.classify_top_k(output, nif_opts) do
+      {:ok,
+       for {class_id, score} <- top_k do
+         %Prediction{class_id: class_id, class_name: classes[class_id], score: score}
+       end}
+    end
+  end
+
+  defp format_opts(nil), do: %{format_type: :float32}
+
+  defp format_opts(%{format: %{type: :float32}}), do: %{format_type: :float32}
+
+  defp format_opts(%{format: %{type: type}, quant_info: quant_info}) do
+    %{format_type: type, qp_zp: quant_info.qp_zp / 1, qp_scale: quant_info.qp_scale / 1}
+  end
+end
@@ -7,14 +7,18 @@ defmodule NxHailo.Parsers.YoloV8 do
 
   @behaviour NxHailo.Hailo.OutputParser
 
+  @native_opts [:score_threshold, :class_ids, :top_k, :input_shape, :letterbox]
+
   defmodule RawDetectedObject do
     @moduledoc """
     Raw detected object with the normalized coordinates in the padded image space.
 
     ((0, 0) is top-left corner and (1, 1) is bottom-right corner)
+
+    `:track_id` is set by `NxHailo.Tracker.update/2`.
     """
 
-    defstruct [:ymin, :ymax, :xmin, :xmax, :score, :class_name, :class_id]
+    defstruct [:ymin, :ymax, :xmin, :xmax, :score, :class_name, :class_id, :track_id]
   end
 
   defmodule DetectedObject do
@@ -23,21 +27,138 @@ defmodule NxHailo.Parsers.YoloV8 do
 
     ((0, 0) is top-left corner and (height, width) is bottom-right corner)
     """
-    defstruct [:ymin, :ymax, :xmin, :xmax, :score, :class_name, :class_id]
+    defstruct [:ymin, :ymax, :xmin, :xmax, :score, :class_name, :class_id, :track_id]
   end
 
+  @doc """
+  Parses the NMS output natively into `%RawDetectedObject{}` structs, best
+  score first.
+
+  ## Options
+
+  - `:key` - output vstream name holding the NMS output. Required.
+  - `:classes` - map of class id to class name. Required.
+  - `:number_of_classes` - classes in the NMS output. Defaults to the size
+    of `:classes`.
+  - `:score_threshold` - boxes scoring below this are dropped. Defaults to 0.
+  - `:class_ids` - only keep boxes of these class ids. Defaults to all.
+  - `:top_k` - only keep the `top_k` best boxes. Defaults to all.
+  - `:input_shape` - `{height, width}` of the original image. When given,
+    `%DetectedObject{}` structs in that image space are returned instead,
+    as `postprocess/2` would.
+  - `:letterbox` - the letterbox map from `NxHailo.Preprocess`. Like
+    `:input_shape`, but for frames letterboxed natively.
+  """
   @impl NxHailo.Hailo.OutputParser
   def parse(output_map, opts) when is_list(opts) do
-    opts = Keyword.validate!(opts, [:classes, :key])
-    key = Keyword.fetch!(opts, :key)
+    opts = Keyword.validate!(opts, [:classes, :key | @native_opts])
     classes = Keyword.fetch!(opts, :classes)
+    opts = Keyword.put_new(opts, :number_of_classes, map_size(classes))
+
+    with {:ok, packed} <- parse_packed(output_map, Keyword.delete(opts, :classes)) do
+      {:ok, to_objects(packed, classes, opts)}
+    end
+  end
+
+  # Shared with the other parsers returning packed detections. Objects are
+  # `%DetectedObject{}` structs when `opts` remap them into the image space.
+  @doc false
+  def to_objects(packed, classes, opts) do
+    struct_module = if remapped?(opts), do: DetectedObject, else: RawDetectedObject
+
+    for <<class_id::float-32-native, score::float-32-native, ymin::float-32-native,
+          xmin::float-32-native, ymax::float-32-native, xmax::float-32-native <- packed>> do
+      class_id = trunc(class_id)
+
+      struct!(struct_module,
+        ymin: maybe_trunc(ymin, opts),
+        xmin: maybe_trunc(xmin, opts),
+        ymax: maybe_trunc(ymax, opts),
+        xmax: maybe_trunc(xmax, opts),
+        score: score,
+        class_id: class_id,
+        class_name: classes[class_id]
+      )
+    end
+  end
 
-    floats_list =
-      for <<x::float-32-little <- Map.fetch!(output_map, key)>> do
-        x
-      end
+  @doc """
+  Parses the NMS output natively into a packed binary of detections.
+
+  Each detection is six native-endian float32 values,
+  `class_id, score, ymin, xmin, ymax, xmax`, best score first. Only the
+  surviving boxes ever reach Elixir. Use `to_tensor/1` to get an `{n, 6}`
+  tensor out of it.
 
-    parse_list(floats_list, 0, classes, [])
+  Takes `:key` and `:number_of_classes` (both required) and the same
+  filtering and remapping options as `parse/2`.
+  """
+  def parse_packed(output_map, opts) when is_list(opts) do
+    opts = Keyword.validate!(opts, [:key, :number_of_classes | @native_opts])
+    output = Map.fetch!(output_map, Keyword.fetch!(opts, :key))
+
+    nif_opts = %{
+      number_of_classes: Keyword.fetch!(opts, :number_of_classes),
+      score_threshold: (opts[:score_threshold] || 0) / 1,
+      top_k: opts[:top_k] || 0,
+      class_ids: opts[:class_ids],
+      remap: remap(opts)
+    }
+
+    NxHailo.NIF.parse_nms_detections(output, nif_opts)
+  end
+
+  @doc """
+  Wraps a binary from `parse_packed/2` into an `{n, 6}` f32 tensor.
+  """
+  def to_tensor(packed) when is_binary(packed) do
+    packed
+    |> Nx.from_binary(:f32)
+    |> Nx.reshape({div(byte_size(packed), 24), 6})
+  end
+
+  defp remapped?(opts), do: opts[:input_shape] != nil or opts[:letterbox] != nil
+
+  # Builds the `:remap` NIF option from `:letterbox` or `:input_shape`
+  @doc false
+  def remap(opts) do
+    cond do
+      letterbox = opts[:letterbox] -> letterbox_remap(letterbox)
+      input_shape = opts[:input_shape] -> input_shape_remap(input_shape)
+      true -> nil
+    end
+  end
+
+  # Normalized coordinates span the target, which covers target / scale
+  # frame pixels starting pad / scale pixels before the frame
+  defp letterbox_remap(%{scale: scale, pad_x: pad_x, pad_y: pad_y} = letterbox) do
+    %{
+      y_scale: letterbox.target_height / scale,
+      y_offset: pad_y / scale,
+      height: letterbox.height / 1,
+      x_scale: letterbox.target_width / scale,
+      x_offset: pad_x / scale,
+      width: letterbox.width / 1
+    }
+  end
+
+  # The padded square is `max_dim` pixels wide, see postprocess/2
+  defp input_shape_remap({input_height, input_width}) do
+    max_dim = max(input_height, input_width)
+
+    %{
+      y_scale: max_dim / 1,
+      y_offset: div(max_dim - input_height, 2) / 1,
+      height: input_height / 1,
+      x_scale: max_dim / 1,
+      x_offset: div(max_dim - input_width, 2) / 1,
+      width: input_width / 1
+    }
+  end
+
+  # Remapped coordinates are whole pixels, as returned by postprocess/2
+  defp maybe_trunc(coordinate, opts) do
+    if remapped?(opts), do: trunc(coordinate), else: coordinate
   end
 
   @doc """
@@ -85,32 +206,4 @@ defmodule NxHailo.Parsers.YoloV8 do
     |> max(0)
     |> min(max_size)
   end
-
-  defp parse_list([], _, _, acc), do: {:ok, acc}
-
-  defp parse_list([count | items], current_class, classes, acc) when count == 0 do
-    parse_list(items, current_class + 1, classes, acc)
-  end
-
-  defp parse_list([count | items], current_class, classes, acc) do
-    count = trunc(count)
-    {class_items, rest} = Enum.split(items, count * 5)
-
-    class_items =
-      class_items
-      |> Enum.chunk_every(5)
-      |> Enum.map(fn [ymin, xmin, ymax, xmax, score] ->
-        %RawDetectedObject{
-          xmin: xmin,
-          ymin: ymin,
-          xmax: xmax,
-          ymax: ymax,
-          score: score,
-          class_id: current_class,
-          class_name: classes[current_class]
-        }
-      end)
-
-    parse_list(rest, current_class + 1, classes, class_items ++ acc)
-  end
 end
@@ -0,0 +1,158 @@
+defmodule NxHailo.Parsers.YoloV8Head do
+  @moduledoc """
+  Parser for YoloV8 HEFs compiled without on-chip NMS, whose outputs are
+  the raw head of the model: for each of its scales (strides 8, 16 and 32
+  for a 640x640 input), one box output with `4 * reg_max` DFL bins and one
+  score output with a score per class, over the same grid.
+
+  Decoding and NMS run natively on the output binaries. With raw outputs
+  (see `:raw_outputs` in `NxHailo.Hailo.API.create_pipeline/2`) the scores
+  are thresholded on the uint8/uint16 values the device produces, so only
+  the candidate cells are ever dequantized and have their box decoded:
+
+      {:ok, model} = NxHailo.Hailo.load("/data/yolov8n_no_nms.hef", raw_outputs: true)
+
+      {:ok, objects} =
+        NxHailo.Hailo.infer(model, inputs, NxHailo.Parsers.YoloV8Head,
+          output_infos: model.pipeline.output_vstream_infos,
+          input_size: {640, 640},
+          classes: classes,
+          score_threshold: 0.3
+        )
+
+  Detections are the `RawDetectedObject` and `DetectedObject` structs of
+  `NxHailo.Parsers.YoloV8`, and the packed binary of `parse_packed/2` has
+  the same layout, so both models feed the tracker and overlays alike.
+  """
+
+  @behaviour NxHailo.Hailo.OutputParser
+
+  alias NxHailo.Parsers.YoloV8
+
+  @native_opts [
+    :class_ids,
+    :top_k,
+    :input_shape,
+    :letterbox,
+    score_threshold: 0.25,
+    input_size: {640, 640},
+    reg_max: 16,
+    sigmoid: false,
+    iou_threshold: 0.7,
+    max_candidates: 1000
+  ]
+
+  @doc """
+  Decodes the head outputs into `%RawDetectedObject{}` structs, best score
+  first.
+
+  ## Options
+
+  - `:output_infos` - output vstream infos of the pipeline, for the grid
+    size, element type and quantization parameters of each output. Outputs
+    are paired by grid size, and told apart by their number of features.
+    Required.
+  - `:classes` - map of class id to class name. Required.
+  - `:number_of_classes` - channels of the score outputs. Defaults to the
+    size of `:classes`.
+  - `:input_size` - `{width, height}` of the model input. Defaults to
+    `{640, 640}`.
+  - `:reg_max` - DFL bins per box edge. Defaults to 16.
+  - `:sigmoid` - when `true`, scores are logits and go through a sigmoid.
+    HEFs from the Hailo model zoo apply it on the device. Defaults to
+    `false`.
+  - `:score_threshold` - cells scoring below this for a class are dropped
+    before their box is decoded. Every cell of every scale is a candidate,
+    so keep it well above 0. Defaults to 0.25.
+  - `:iou_threshold` - boxes of a class overlapping a better one by at
+    least this are dropped. Defaults to 0.7.
+  - `:max_candidates` - best candidates kept for NMS, `0` for all of them.
+    Defaults to 1000.
+  - `:class_ids`, `:top_k`, `:input_shape` and
+    `:letterbox` - as in `NxHailo.Parsers.YoloV8.parse/2`.
+  """
+  @impl NxHailo.Hailo.OutputParser
+  def parse(output_map, opts) when is_list(opts) do
+    opts = Keyword.validate!(opts, [:output_infos, :classes, :number_of_classes | @native_opts])
+    classes = Keyword.fetch!(opts, :classes)
+    opts = Keyword.put_new_lazy(opts, :number_of_classes, fn -> map_size(classes) end)
+
+    with {:ok, packed} <- parse_packed(output_map, Keyword.delete(opts, :classes)) do
+      {:ok, YoloV8.to_objects(packed, classes, opts)}
+    end
+  end
+
+  @doc """
+  Decodes the head outputs into a packed binary of detections, as
+  `NxHailo.Parsers.YoloV8.parse_packed/2` returns them.
+
+  Takes `:output_infos` and `:number_of_classes` (both required) and the
+  same options as `parse/2`. Runs on a dirty CPU scheduler.
+  """
+  def parse_packed(output_map, opts) when is_list(opts) do
+    opts = Keyword.validate!(opts, [:output_infos, :number_of_classes | @native_opts])
+    number_of_classes = Keyword.fetch!(opts, :number_of_classes)
+    reg_max = opts[:reg_max]
+    {input_width, input_height} = opts[:input_size]
+
+    with {:ok, scales} <-
+           scales(output_map, Keyword.fetch!(opts, :output_infos), number_of_classes, reg_max) do
+      NxHailo.NIF.decode_yolov8_head(scales, %{
+        input_width: input_width,
+        input_height: input_height,
+        number_of_classes: number_of_classes,
+        reg_max: reg_max,
+        sigmoid: opts[:sigmoid],
+        iou_threshold: opts[:iou_threshold] / 1,
+        max_candidates: opts[:max_candidates],
+        score_threshold: opts[:score_threshold] / 1,
+        top_k: opts[:top_k] || 0,
+        class_ids: opts[:class_ids],
+        remap: YoloV8.remap(opts)
+      })
+    end
+  end
+
+  # Pairs the box and score outputs of each grid, largest grid first
+  defp scales(output_map, output_infos, number_of_classes, reg_max) do
+    box_features = 4 * reg_max
+
+    output_infos
+    |> Enum.filter(&(&1.shape && &1.shape.features in [box_features, number_of_classes]))
+    |> Enum.group_by(&{&1.shape.height, &1.shape.width})
+    |> Enum.sort_by(fn {{height, width}, _} -> -height * width end)
+    |> Enum.reduce_while({:ok, []}, fn {{height, width}, infos}, {:ok, scales} ->
+      with [boxes] <- Enum.filter(infos, &(&1.shape.features == box_features)),
+           [scores] <- Enum.filter(infos, &(&1.shape.features == number_of_classes)) do
+        scale = %{
+          boxes: output(output_map, boxes),
+          scores: output(output_map, scores),
+          width: width,
+          height: height
+        }
+
+        {:cont, {:ok, scales ++ [scale]}}
+      else
+        _ ->
+          {:halt,
+           {:error, "Expected one box and one score output on the #{width}x#{height} grid"}}
+      end
+    end)
+    |> case do
+      {:ok, []} -> {:error, "No YOLOv8 head outputs found"}
+      result -> result
+    end
+  end
+
+  defp output(output_map, %{name: name} = info) do
+    info
+    |> format_opts()
+    |> Map.put(:data, Map.fetch!(output_map, name))
+  end
+
+  defp format_opts(%{format: %{type: :float32}}), do: %{format_type: :float32}
+
+  defp format_opts(%{format: %{type: type}, quant_info: quant_info}) do
+    %{format_type: type, qp_zp: quant_info.qp_zp / 1, qp_scale: quant_info.qp_scale / 1}
+  end
+end
@@ -0,0 +1,137 @@
+defmodule NxHailo.MotionGate do
+  @moduledoc """
+  Native change detector that skips inference on frames of a static scene.
+
+  Each frame is averaged into a luma plane of pixel blocks and compared
+  against a reference frame with a SIMD sum of absolute differences. While
+  no region of the frame has changed by more than `:threshold`, the result
+  of the reference frame is reused instead of running inference again, so
+  a fixed camera watching an idle scene leaves the accelerator idle too.
+  A refresh is forced every `:refresh_interval` skipped frames, so that the
+  results never go stale for long.
+
+      {:ok, gate} = NxHailo.MotionGate.new()
+      capture = NxHailo.Video.get_video_capture(device)
+
+      mat = NxHailo.Video.get_realtime_frame(capture)
+      {height, width, 3} = mat.shape
+      frame = Evision.Mat.to_binary(mat)
+
+      {:ok, objects} =
+        NxHailo.MotionGate.run(gate, frame, [width: width, height: height, format: :bgr], fn ->
+          NxHailo.Hailo.infer(model, inputs(frame), YoloV8, parser_opts)
+        end)
+
+  The reference is the last frame that was inferred, not the previous
+  frame, so a slow change adds up until it triggers inference. Changes in
+  the frame size or format always trigger it. A gate is meant to follow
+  one video stream, one frame at a time.
+  """
+
+  alias NxHailo.NIF
+
+  defstruct [:ref]
+
+  @frame_opts [:width, :height, format: :rgb, stride: nil]
+
+  @type t :: %__MODULE__{ref: reference()}
+
+  @doc """
+  Creates a motion gate.
+
+  Options:
+    - `:threshold` - mean absolute luma difference, from 0 to 255, within
+      any region of 16x16 blocks at which a frame counts as changed.
+      Defaults to 2.0.
+    - `:block_size` - frames are averaged over blocks of this many pixels
+      squared before they are compared, which also smooths out sensor
+      noise. From 1 to 256, defaults to 8.
+    - `:refresh_interval` - after this many skipped frames in a row, the
+      next frame is inferred regardless. `0` never forces a refresh.
+      Defaults to 30.
+  """
+  @spec new(keyword()) :: {:ok, t()} | {:error, String.t()}
+  def new(opts \\ []) do
+    opts =
+      opts
+      |> Keyword.validate!([:threshold, :block_size, :refresh_interval])
+      |> Keyword.replace_lazy(:threshold, &(&1 / 1))
+
+    with {:ok, ref} <- NIF.create_motion_gate(Map.new(opts)) do
+      {:ok, %__MODULE__{ref: ref}}
+    end
+  end
+
+  @doc """
+  Runs `fun` on frames that have changed and reuses its last result on the
+  others.
+
+  `fun` takes no arguments and returns `{:ok, result}` or
+  `{:error, reason}`. Results are stored for the following frames, while an
+  error makes the next frame run `fun` again. Takes the frame options of
+  `NxHailo.Preprocess`.
+
+  Returns the result of `fun`, or `{:ok, result}` with the stored result for
+  unchanged frames.
+  """
+  @spec run(t(), binary(), keyword(), (-> {:ok, term()} | {:error, term()})) ::
+          {:ok, term()} | {:error, term()}
+  def run(%__MODULE__{} = gate, frame, frame_opts, fun) when is_function(fun, 0) do
+    case check(gate, frame, frame_opts) do
+      {:ok, {:unchanged, result}} ->
+        {:ok, result}
+
+      {:ok, _changed_or_refresh} ->
+        case fun.() do
+          {:ok, result} ->
+            :ok = store(gate, result)
+            {:ok, result}
+
+          {:error, _} = error ->
+            :ok = reset(gate)
+            error
+        end
+
+      {:error, _} = error ->
+        error
+    end
+  end
+
+  @doc """
+  Compares a frame against the reference.
+
+  Returns `{:ok, :changed}` or `{:ok, :refresh}` when the frame should be
+  inferred, in which case it becomes the reference and its result should be
+  passed to `store/2`, or `{:ok, {:unchanged, result}}` with the stored
+  result. Every frame counts as changed until a result is stored. Runs on a
+  dirty CPU scheduler.
+  """
+  @spec check(t(), binary(), keyword()) ::
+          {:ok, :changed | :refresh | {:unchanged, term()}} | {:error, String.t()}
+  def check(%__MODULE__{ref: ref}, frame, frame_opts) when is_binary(frame) do
+    frame_opts = Keyword.validate!(frame_opts, @frame_opts)
+    NIF.motion_gate_check(ref, frame, Map.new(frame_opts))
+  end
+
+  @doc """
+  Stores the result of the frame last checked as changed, to be returned
+  for the unchanged frames after it. The result is copied into the gate.
+  """
+  @spec store(t(), term()) :: :ok | {:error, String.t()}
+  def store(%__MODULE__{ref: ref}, result), do: NIF.motion_gate_store(ref, result)
+
+  @doc """
+  Drops the reference frame and the stored result, so that the next frame
+  is inferred.
+  """
+  @spec reset(t()) :: :ok | {:error, String.t()}
+  def reset(%__MODULE__{ref: ref}), do: NIF.motion_gate_reset(ref)
+
+  @doc """
+  Returns the number of `:frames` checked, of which `:changed`,
+  `:refreshed` and `:skipped`, the `:skip_rate` and the `:last_score`, the
+  largest region difference of the last frame, or `-1.0` when it had no
+  reference.
+  """
+  def stats(%__MODULE__{ref: ref}), do: NIF.get_motion_gate_stats(ref)
+end
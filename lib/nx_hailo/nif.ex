@@ -23,13 +23,49 @@ defmodule NxHailo.NIF do
   end
 
   # NIF functions
-  defnif create_vdevice()
+  defnif create_vdevice(_opts)
+  defnif scan_devices()
+  defnif create_simulated_vdevice(_config)
   defnif load_network_group(_hef_path)
-  defnif configure_network_group(_vdevice_ref, _hef_path)
-  defnif create_pipeline(_network_group_ref)
+  defnif configure_network_group(_vdevice_ref, _hef_path, _opts)
+  defnif load(_vdevice_ref, _hef_path, _opts)
+  defnif get_hef_cache_stats()
+  defnif get_scheduler_stats(_network_group_ref)
+  defnif create_pipeline(_network_group_ref, _opts)
+  defnif get_output_pool_stats(_pipeline_ref)
   defnif get_input_vstream_infos_from_ng(_network_group_ref)
   defnif get_output_vstream_infos_from_ng(_network_group_ref)
   defnif get_input_vstream_infos_from_pipeline(_pipeline_ref)
   defnif get_output_vstream_infos_from_pipeline(_pipeline_ref)
   defnif infer(_pipeline_ref, _input_data)
+  defnif infer_async(_pipeline_ref, _input_data, _ref, _opts)
+  defnif infer_timed_async(_pipeline_ref, _input_data, _ref, _opts)
+  defnif get_pipeline_stats(_pipeline_ref)
+  defnif infer_batch_async(_pipeline_ref, _input_data, _ref, _opts)
+  defnif create_stream_pipeline(_network_group_ref, _opts)
+  defnif stream_submit(_stream_pipeline_ref, _input_data, _ref)
+  defnif get_input_vstream_infos_from_stream_pipeline(_stream_pipeline_ref)
+  defnif get_output_vstream_infos_from_stream_pipeline(_stream_pipeline_ref)
+  defnif parse_nms_detections(_output, _opts)
+  defnif get_tile_grid(_opts)
+  defnif merge_tile_detections(_outputs, _opts)
+  defnif create_tracker(_opts)
+  defnif tracker_update(_tracker_ref, _detections)
+  defnif get_tracker_stats(_tracker_ref)
+  defnif create_motion_gate(_opts)
+  defnif motion_gate_check(_gate_ref, _frame, _opts)
+  defnif motion_gate_store(_gate_ref, _result)
+  defnif motion_gate_reset(_gate_ref)
+  defnif get_motion_gate_stats(_gate_ref)
+  defnif letterbox(_frame, _opts)
+  defnif get_letterbox_geometry(_opts)
+  defnif decode_jpeg(_jpeg, _opts)
+  defnif draw_overlay(_frame, _detections, _opts)
+  defnif open_v4l2_source(_path, _opts)
+  defnif open_file_source(_path, _opts)
+  defnif read_frame(_source_ref, _opts)
+  defnif dequantize(_data, _opts)
+  defnif threshold_quantized(_data, _opts)
+  defnif classify_top_k(_data, _opts)
+  defnif decode_yolov8_head(_scales, _opts)
 end
@@ -0,0 +1,105 @@
+defmodule NxHailo.Overlay do
+  @moduledoc """
+  Native rendering of detections for live previews.
+
+  `draw/3` copies a frame, draws the box of every detection with a label
+  of its track ID, class name and score, and optionally an FPS badge, and
+  returns the result either as raw pixels or JPEG encoded, all in a single
+  native call:
+
+      {:ok, frame, metadata} = NxHailo.FrameSource.read(camera)
+      frame_opts = Map.take(metadata, [:width, :height, :format, :stride])
+      # ... inference on the letterboxed frame, parsed with its :letterbox
+      {:ok, jpeg} =
+        NxHailo.Overlay.draw(frame, objects,
+          Keyword.new(frame_opts) ++ [classes: classes, fps: fps, encode: :jpeg]
+        )
+
+  Frames take the frame options of `NxHailo.Preprocess`. Box coordinates
+  must be in frame pixels, as returned by `NxHailo.Parsers.YoloV8` with the
+  `:letterbox` or `:input_shape` option. Labels use a built-in 5x7 pixel
+  font, so only printable ASCII is drawn.
+  """
+
+  alias NxHailo.NIF
+
+  @frame_opts [:width, :height, format: :rgb, stride: nil]
+
+  @doc """
+  Draws detections over a copy of `frame`.
+
+  Detections are either the structs returned by
+  `NxHailo.Parsers.YoloV8.parse/2`, labelled with their `:track_id` when
+  set, or a packed binary from `NxHailo.Parsers.YoloV8.parse_packed/2`.
+
+  Takes the frame options plus:
+    - `:classes` - map of class id to class name. Classes without a name
+      are labelled with their id.
+    - `:track_ids` - for packed detections, the track IDs returned by
+      `NxHailo.Tracker.update/2`.
+    - `:fps` - frames per second shown in a badge in the bottom-right
+      corner. Defaults to none.
+    - `:thickness` - width of the box outlines in pixels. Defaults to 2.
+    - `:font_scale` - size of the label glyphs, in multiples of 5x7
+      pixels. Defaults to 2.
+    - `:show_scores` - appends the score in percent to the labels.
+      Defaults to `true`.
+    - `:encode` - `:raw` returns the pixels, tightly packed in RGB, or in
+      BGR for `:bgr` frames, and `:jpeg` returns a JPEG. Defaults to `:raw`.
+    - `:quality` - JPEG quality, from 1 to 100. Defaults to 80.
+
+  Returns `{:ok, binary}` or `{:error, reason}`. Runs on a dirty CPU
+  scheduler.
+  """
+  def draw(frame, detections, opts) when is_binary(frame) do
+    opts =
+      Keyword.validate!(
+        opts,
+        [
+          :classes,
+          :track_ids,
+          :fps,
+          :thickness,
+          :font_scale,
+          :show_scores,
+          encode: :raw,
+          quality: 80
+        ] ++ @frame_opts
+      )
+
+    {packed, track_ids} = pack(detections, opts[:track_ids])
+    {encode, opts} = Keyword.pop!(opts, :encode)
+    {quality, opts} = Keyword.pop!(opts, :quality)
+
+    nif_opts =
+      opts
+      |> Keyword.drop([:classes, :track_ids, :fps])
+      |> Map.new()
+      |> Map.merge(%{
+        labels: opts[:classes],
+        track_ids: track_ids,
+        fps: opts[:fps] && opts[:fps] / 1,
+        jpeg_quality: if(encode == :jpeg, do: quality)
+      })
+
+    NIF.draw_overlay(frame, packed, nif_opts)
+  end
+
+  defp pack(packed, track_ids) when is_binary(packed), do: {packed, track_ids}
+
+  defp pack(objects, nil) when is_list(objects) do
+    packed =
+      for object <- objects, into: <<>> do
+        <<object.class_id / 1::float-32-native, object.score / 1::float-32-native,
+          object.ymin / 1::float-32-native, object.xmin / 1::float-32-native,
+          object.ymax / 1::float-32-native, object.xmax / 1::float-32-native>>
+      end
+
+    track_ids =
+      for object <- objects, into: <<>> do
+        <<(Map.get(object, :track_id) || 0)::native-unsigned-32>>
+      end
+
+    {packed, track_ids}
+  end
+end
@@ -0,0 +1,111 @@
+defmodule NxHailo.Preprocess do
+  @moduledoc """
+  Native preprocessing of camera and decoder frames.
+
+  Frames are packed binaries described by:
+
+    - `:width` / `:height` - frame size in pixels. Required.
+    - `:format` - `:rgb`, `:bgr`, `:yuyv` or planar `:i420`, whose half
+      resolution U and V planes follow the Y plane. YUV frames are BT.601.
+      Defaults to `:rgb`.
+    - `:stride` - bytes between the start of two rows (of the Y plane for
+      `:i420`). Defaults to tightly packed rows.
+
+  ## Letterbox
+
+  YOLO models expect the frame scaled to fit the model input, centred and
+  padded with grey (114). `letterbox_input/3` wraps a frame so that
+  `NxHailo.Hailo.API.infer/3` letterboxes it natively, with a bilinear
+  kernel, straight into the input vstream buffer:
+
+      {:ok, {input, letterbox}} =
+        NxHailo.Preprocess.letterbox_input(frame, input_info, width: 1280, height: 720)
+
+      {:ok, outputs} = NxHailo.Hailo.API.infer(pipeline, %{input_info.name => input})
+      NxHailo.Parsers.YoloV8.parse(outputs, key: key, classes: classes, letterbox: letterbox)
+
+  The returned letterbox map has the frame `:width` and `:height`, the
+  `:target_width` and `:target_height`, the `:scale` applied to the frame
+  and the `:pad_x`/`:pad_y` padding in target pixels.
+
+  ## JPEG
+
+  Still images are usually much larger than the model input, and decoding
+  them at full resolution only to downscale them wastes most of the work.
+  `decode_jpeg/2` decodes at 1/2, 1/4 or 1/8 of the size in the DCT domain,
+  whichever is the smallest that still covers the model input, and
+  letterboxes the result into a model-ready binary:
+
+      {:ok, {input, letterbox}} =
+        NxHailo.Preprocess.decode_jpeg(File.read!("photo.jpg"), target_width: 640, target_height: 640)
+
+  The letterbox map refers to the full-size image, so boxes map back to it.
+  """
+
+  alias NxHailo.NIF
+
+  @frame_opts [:width, :height, format: :rgb, stride: nil]
+
+  @doc """
+  Letterboxes a frame into a new RGB binary of `:target_width` x
+  `:target_height`, together with the letterbox map.
+
+  Takes the frame options plus `:target_width` and `:target_height`, and
+  optionally a `:crop` of `{x, y, width, height}` frame pixels to letterbox
+  only that window of an RGB, BGR or YUYV frame. The letterbox map then
+  refers to the window.
+  """
+  def letterbox(frame, opts) when is_binary(frame) do
+    opts = Keyword.validate!(opts, [:target_width, :target_height, :crop | @frame_opts])
+    NIF.letterbox(frame, Map.new(opts))
+  end
+
+  @doc """
+  Decodes a JPEG into a new letterboxed RGB binary of `:target_width` x
+  `:target_height`, together with the letterbox map.
+
+  The map has the `:width` and `:height` of the JPEG itself, and the
+  `:decode_scale` it was decoded at, one of `1.0`, `0.5`, `0.25` and
+  `0.125`. Grayscale images are expanded to RGB. Runs on a dirty CPU
+  scheduler.
+  """
+  def decode_jpeg(jpeg, opts) when is_binary(jpeg) do
+    opts = Keyword.validate!(opts, [:target_width, :target_height])
+    NIF.decode_jpeg(jpeg, Map.new(opts))
+  end
+
+  @doc """
+  Decodes a JPEG into a frame of the given uint8 RGB input vstream, see
+  `decode_jpeg/2`.
+
+  Returns `{:ok, {input, letterbox}}` like `letterbox_input/3`.
+  """
+  def decode_jpeg_input(jpeg, %{shape: %{height: target_height, width: target_width}})
+      when is_binary(jpeg) do
+    decode_jpeg(jpeg, target_width: target_width, target_height: target_height)
+  end
+
+  @doc """
+  Wraps a frame to be letterboxed into the given uint8 RGB input vstream
+  during inference.
+
+  Returns `{:ok, {input, letterbox}}`, where `input` goes in the input map
+  of `NxHailo.Hailo.API.infer/3` or `NxHailo.Hailo.API.infer_batch/3` and
+  `letterbox` describes where the frame ends up, see the module docs.
+  """
+  def letterbox_input(frame, %{shape: %{height: target_height, width: target_width}}, opts)
+      when is_binary(frame) do
+    opts = Keyword.validate!(opts, @frame_opts)
+
+    geometry_opts = %{
+      width: opts[:width],
+      height: opts[:height],
+      target_width: target_width,
+      target_height: target_height
+    }
+
+    with {:ok, letterbox} <- NIF.get_letterbox_geometry(geometry_opts) do
+      {:ok, {{:letterbox, frame, Map.new(opts)}, letterbox}}
+    end
+  end
+end
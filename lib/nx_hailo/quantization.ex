@@ -0,0 +1,73 @@
+defmodule NxHailo.Quantization do
+  @moduledoc """
+  Native helpers for raw quantized outputs.
+
+  Pipelines created with `raw_outputs: true` (see
+  `NxHailo.Hailo.API.create_pipeline/2`) return the uint8/uint16 values the
+  device produces instead of float32 ones. Real values are
+  `(q - qp_zp) * qp_scale`, with the quantization parameters found in the
+  `:quant_info` of the output vstream info.
+
+  Postprocessing usually only cares about the few values above a score
+  threshold, so `threshold/4` finds them by comparing the raw integers
+  against a quantized threshold and only dequantizes the candidates:
+
+      info = Enum.find(pipeline.output_vstream_infos, &(&1.name == name))
+      {:ok, {indices, scores}} = NxHailo.Quantization.threshold(outputs[name], info, 0.25)
+
+  Both functions take a vstream info map for the element type, quantization
+  parameters and number of channels, and accept:
+
+    - `:channels` - `{first, count}` to only look at `count` channels from
+      `first` on, at every position. Defaults to all channels.
+  """
+
+  alias NxHailo.NIF
+
+  @doc """
+  Dequantizes a raw output frame into a float32 binary.
+
+  With `:channels`, only the selected channels are returned, position by
+  position.
+  """
+  def dequantize(data, info, opts \\ []) when is_binary(data) do
+    opts = Keyword.validate!(opts, channels: nil)
+    NIF.dequantize(data, nif_opts(info, opts))
+  end
+
+  @doc """
+  Finds the elements of a raw output frame whose dequantized value is at
+  least `threshold`.
+
+  Returns `{:ok, {indices, values}}`, where `indices` is a binary of native
+  uint32 element indices into the frame, in increasing order, and `values`
+  a binary of the matching float32 values.
+  """
+  def threshold(data, info, threshold, opts \\ [])
+      when is_binary(data) and is_number(threshold) do
+    opts = Keyword.validate!(opts, channels: nil)
+
+    NIF.threshold_quantized(data, Map.put(nif_opts(info, opts), :threshold, threshold / 1))
+  end
+
+  @doc """
+  Converts the result of `threshold/4` into lists of indices and values.
+  """
+  def to_lists({indices, values}) do
+    {for(<<index::native-unsigned-32 <- indices>>, do: index),
+     for(<<value::native-float-32 <- values>>, do: value)}
+  end
+
+  defp nif_opts(info, opts) do
+    %{
+      format_type: info.format.type,
+      qp_zp: info.quant_info.qp_zp / 1,
+      qp_scale: info.quant_info.qp_scale / 1,
+      features: features(info),
+      channels: opts[:channels]
+    }
+  end
+
+  defp features(%{shape: %{features: features}}), do: features
+  defp features(_info), do: 0
+end
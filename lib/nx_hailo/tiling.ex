@@ -0,0 +1,228 @@
+defmodule NxHailo.Tiling do
+  @moduledoc """
+  Tiled inference for frames much larger than the model input.
+
+  Letterboxing a 4K frame into a 640x640 input shrinks it six times, and
+  small objects vanish. `infer/3` instead covers the frame with
+  overlapping tiles, crops and letterboxes every tile natively into one
+  batch for the device, maps the boxes of each tile back into frame pixels
+  and merges the duplicates found in neighbouring tiles with class-aware
+  NMS, all in native code:
+
+      {:ok, objects, stats} =
+        NxHailo.Tiling.infer(model, frame,
+          width: 3840,
+          height: 2160,
+          key: "yolov8m/yolov8_nms_postprocess",
+          classes: classes,
+          score_threshold: 0.3
+        )
+
+  Every tile costs a device frame, so the cost of a frame grows with its
+  megapixels divided by the tile area, and with the overlap. `stats`
+  reports the tiles used and the time spent per megapixel, to tune
+  `:tile_size` and `:overlap` against the detection rate.
+  """
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Model
+  alias NxHailo.NIF
+  alias NxHailo.Parsers.YoloV8.DetectedObject
+
+  @frame_opts [:width, :height, format: :rgb, stride: nil]
+  @merge_opts [:score_threshold, :class_ids, :top_k, iou_threshold: 0.5, match: :iou, class_aware: true]
+  @merge_keys [:score_threshold, :class_ids, :top_k, :iou_threshold, :match, :class_aware]
+
+  @doc """
+  Covers a frame with overlapping tiles.
+
+  Takes the frame options of `NxHailo.Preprocess` plus:
+    - `:tile_size` - `{width, height}` of the tiles in frame pixels.
+      Required.
+    - `:overlap` - fraction of the tile size neighbouring tiles overlap by,
+      at least. Objects smaller than the overlap are seen whole by some
+      tile. Defaults to 0.2.
+
+  Returns `{:ok, [{x, y, width, height}, ...]}`, row by row. The last tiles
+  of each row and column end on the frame edge, so all tiles have the same
+  size, unless the frame is smaller than a tile. YUYV tiles start on even
+  columns, so the last tile of each row is narrower when that column would
+  be odd.
+  """
+  def tiles(opts) do
+    opts = Keyword.validate!(opts, [:tile_size, overlap: 0.2] ++ @frame_opts)
+    {tile_width, tile_height} = Keyword.fetch!(opts, :tile_size)
+
+    NIF.get_tile_grid(%{
+      width: opts[:width],
+      height: opts[:height],
+      format: opts[:format],
+      tile_width: tile_width,
+      tile_height: tile_height,
+      overlap: opts[:overlap] / 1
+    })
+  end
+
+  @doc """
+  Runs a frame through a YoloV8 model tile by tile, as a single batch.
+
+  Takes the frame options of `NxHailo.Preprocess`, the `:key`, `:classes`,
+  `:number_of_classes`, `:score_threshold`, `:class_ids` and `:top_k`
+  options of `NxHailo.Parsers.YoloV8.parse/2`, the `:timeout` and
+  `:deadline` options of `NxHailo.Hailo.API.infer/3`, plus:
+    - `:tile_size` - `{width, height}` of the tiles in frame pixels, scaled
+      to the model input when they differ. Defaults to the input size.
+    - `:overlap` - see `tiles/1`. Defaults to 0.2.
+    - `:full_frame` - also runs the whole frame, letterboxed, so that
+      objects larger than a tile are found in one piece. Defaults to `true`.
+    - `:iou_threshold` - boxes overlapping a better one by at least this
+      are merged into it. Defaults to 0.5.
+    - `:match` - `:iou` compares boxes by intersection over union, `:ios`
+      by intersection over the smaller box, which also merges the part of
+      an object cut off by a tile edge into the whole object, but also
+      overlapping objects of the same class. Defaults to `:iou`.
+    - `:class_aware` - only merge boxes of the same class. Defaults to
+      `true`.
+
+  The frame must be RGB, BGR or YUYV, as I420 frames cannot be cropped.
+
+  Returns `{:ok, [%DetectedObject{}], stats}` in frame pixels, best score
+  first, or `{:error, reason}`. `stats` has the number of `:tiles` run, the
+  frame `:megapixels`, the `:us_per_megapixel` of the whole call, and the
+  time spent in each step in `:native` time units: `:prepare` for laying
+  out the tiles, `:infer` for the batch, including the native cropping and
+  letterboxing, and `:merge` for parsing and merging the tile outputs.
+
+  Each call is wrapped in a `[:nx_hailo, :tiled_infer]` telemetry span,
+  whose `:stop` event carries the stats of a successful call.
+  """
+  def infer(
+        %Model{name: name, pipeline: %API.Pipeline{input_vstream_infos: [input_info]} = pipeline},
+        frame,
+        opts
+      )
+      when is_binary(frame) do
+    opts =
+      Keyword.validate!(
+        opts,
+        [
+          :key,
+          :classes,
+          :number_of_classes,
+          :tile_size,
+          :timeout,
+          :deadline,
+          overlap: 0.2,
+          full_frame: true
+        ] ++ @merge_opts ++ @frame_opts
+      )
+
+    %{width: target_width, height: target_height} = input_info.shape
+    frame_opts = Keyword.take(opts, [:width, :height, :format, :stride])
+    tile_size = opts[:tile_size] || {target_width, target_height}
+    classes = Keyword.fetch!(opts, :classes)
+    key = Keyword.fetch!(opts, :key)
+
+    :telemetry.span([:nx_hailo, :tiled_infer], %{name: name}, fn ->
+      start = System.monotonic_time()
+
+      with {:ok, tiles} <- tiles([tile_size: tile_size, overlap: opts[:overlap]] ++ frame_opts),
+           tiles = maybe_add_full_frame(tiles, opts),
+           inputs = tile_inputs(frame, frame_opts, tiles),
+           infer_start = System.monotonic_time(),
+           {:ok, outputs} <-
+             API.infer_batch(
+               pipeline,
+               %{input_info.name => inputs},
+               Keyword.take(opts, [:timeout, :deadline])
+             ),
+           merge_start = System.monotonic_time(),
+           {:ok, packed} <-
+             merge(
+               Enum.map(outputs, &Map.fetch!(&1, key)),
+               tiles,
+               [
+                 target_size: {target_width, target_height},
+                 number_of_classes: opts[:number_of_classes] || map_size(classes)
+               ] ++ Keyword.take(opts, @merge_keys)
+             ) do
+        objects = to_objects(packed, classes)
+        stop = System.monotonic_time()
+        megapixels = opts[:width] * opts[:height] / 1.0e6
+
+        stats = %{
+          tiles: length(tiles),
+          megapixels: megapixels,
+          us_per_megapixel:
+            System.convert_time_unit(stop - start, :native, :microsecond) / megapixels,
+          prepare: infer_start - start,
+          infer: merge_start - infer_start,
+          merge: stop - merge_start
+        }
+
+        {{:ok, objects, stats}, stats, %{name: name, result: :ok}}
+      else
+        error -> {error, %{}, %{name: name, result: error}}
+      end
+    end)
+  end
+
+  defp maybe_add_full_frame([_single] = tiles, _opts), do: tiles
+
+  defp maybe_add_full_frame(tiles, opts) do
+    if opts[:full_frame], do: tiles ++ [{0, 0, opts[:width], opts[:height]}], else: tiles
+  end
+
+  defp tile_inputs(frame, frame_opts, tiles) do
+    frame_opts = Map.new(frame_opts)
+    for tile <- tiles, do: {:letterbox, frame, Map.put(frame_opts, :crop, tile)}
+  end
+
+  @doc """
+  Merges the NMS outputs of the tiles of a frame into packed detections in
+  frame pixels, see `NxHailo.Parsers.YoloV8.parse_packed/2`.
+
+  `outputs` holds the NMS output binary of each of `tiles`, as returned by
+  `tiles/1`, in the same order. Every tile is taken to have been
+  letterboxed into the model input.
+
+  Takes `:target_size`, the `{width, height}` of the model input, and
+  `:number_of_classes` (both required), the filtering options of
+  `NxHailo.Parsers.YoloV8.parse/2`, and `:iou_threshold`, `:match` and
+  `:class_aware` as in `infer/3`. Runs on a dirty CPU scheduler.
+  """
+  def merge(outputs, tiles, opts) when is_list(outputs) and is_list(tiles) do
+    opts = Keyword.validate!(opts, [:target_size, :number_of_classes | @merge_opts])
+    {target_width, target_height} = Keyword.fetch!(opts, :target_size)
+
+    NIF.merge_tile_detections(outputs, %{
+      tiles: tiles,
+      target_width: target_width,
+      target_height: target_height,
+      number_of_classes: Keyword.fetch!(opts, :number_of_classes),
+      score_threshold: (opts[:score_threshold] || 0) / 1,
+      top_k: opts[:top_k] || 0,
+      class_ids: opts[:class_ids],
+      iou_threshold: opts[:iou_threshold] / 1,
+      metric: opts[:match],
+      class_aware: opts[:class_aware]
+    })
+  end
+
+  defp to_objects(packed, classes) do
+    for <<class_id::float-32-native, score::float-32-native, ymin::float-32-native,
+          xmin::float-32-native, ymax::float-32-native, xmax::float-32-native <- packed>> do
+      class_id = trunc(class_id)
+
+      %DetectedObject{
+        ymin: trunc(ymin),
+        xmin: trunc(xmin),
+        ymax: trunc(ymax),
+        xmax: trunc(xmax),
+        score: score,
+        class_id: class_id,
+        class_name: classes[class_id]
+      }
+    end
+  end
+end
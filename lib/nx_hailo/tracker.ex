@@ -0,0 +1,115 @@
+defmodule NxHailo.Tracker do
+  @moduledoc """
+  Native multi-object tracker giving detections stable IDs across frames.
+
+  SORT/ByteTrack style: every track predicts where its box moves with a
+  Kalman filter, and the predicted boxes are matched to the new detections
+  by IoU with an optimal assignment. Confident detections are matched
+  first and may start new tracks, then low-score detections extend tracks
+  that were just seen, which keeps objects tracked through partial
+  occlusion.
+
+      {:ok, tracker} = NxHailo.Tracker.new()
+
+      for frame <- frames do
+        {:ok, objects} = NxHailo.Hailo.infer(model, inputs(frame), YoloV8, parser_opts)
+        {:ok, objects} = NxHailo.Tracker.update(tracker, objects)
+        # objects now have a :track_id, nil until their track is confirmed
+      end
+
+  Each tracker holds at most `:max_tracks` tracks, so its memory stays
+  bounded however long it runs. A tracker is meant to follow one video
+  stream, one frame at a time.
+  """
+
+  alias NxHailo.NIF
+
+  defstruct [:ref]
+
+  @threshold_opts [:high_threshold, :low_threshold, :new_track_threshold, :match_iou, :low_match_iou]
+
+  @type t :: %__MODULE__{ref: reference()}
+
+  @doc """
+  Creates a tracker.
+
+  Options:
+    - `:high_threshold` - detections scoring at least this are matched
+      first. Defaults to 0.5.
+    - `:low_threshold` - detections scoring below this are ignored. Defaults
+      to 0.1.
+    - `:new_track_threshold` - unmatched detections scoring at least this
+      start a new track. Defaults to 0.6.
+    - `:match_iou` / `:low_match_iou` - minimum IoU between a predicted
+      track and a high/low score detection to match them. Default to 0.2
+      and 0.5.
+    - `:max_age` - frames a confirmed track survives without a match.
+      Tentative tracks are dropped on their first miss. Defaults to 30.
+    - `:min_hits` - matches a track needs before its ID is reported, except
+      during the first frames. Defaults to 3.
+    - `:max_tracks` - tracks kept at most. Defaults to 256.
+    - `:class_aware` - only match detections of the track's class. Defaults
+      to `true`.
+  """
+  @spec new(keyword()) :: {:ok, t()} | {:error, String.t()}
+  def new(opts \\ []) do
+    opts =
+      Keyword.validate!(opts, [:max_age, :min_hits, :max_tracks, :class_aware | @threshold_opts])
+
+    opts =
+      Map.new(opts, fn
+        {key, value} when key in @threshold_opts -> {key, value / 1}
+        {key, value} -> {key, value}
+      end)
+
+    with {:ok, ref} <- NIF.create_tracker(opts) do
+      {:ok, %__MODULE__{ref: ref}}
+    end
+  end
+
+  @doc """
+  Advances the tracker by one frame of detections.
+
+  Takes either the objects returned by `NxHailo.Parsers.YoloV8.parse/2`,
+  returned with their `:track_id` set, or a packed binary from
+  `NxHailo.Parsers.YoloV8.parse_packed/2`, for which a binary of native
+  uint32 track IDs is returned, one per detection. Detections that are not
+  part of a confirmed track get `nil`, or `0` in the packed form.
+
+  Box coordinates may be normalized or in pixels, as long as they are
+  consistent from frame to frame.
+  """
+  @spec update(t(), [struct()] | binary()) ::
+          {:ok, [struct()] | binary()} | {:error, String.t()}
+  def update(%__MODULE__{ref: ref}, packed) when is_binary(packed) do
+    NIF.tracker_update(ref, packed)
+  end
+
+  def update(%__MODULE__{ref: ref}, objects) when is_list(objects) do
+    packed =
+      for object <- objects, into: <<>> do
+        <<object.class_id / 1::float-32-native, object.score / 1::float-32-native,
+          object.ymin / 1::float-32-native, object.xmin / 1::float-32-native,
+          object.ymax / 1::float-32-native, object.xmax / 1::float-32-native>>
+      end
+
+    with {:ok, track_ids} <- NIF.tracker_update(ref, packed) do
+      {:ok,
+       Enum.zip_with(objects, to_list(track_ids), fn object, track_id ->
+         %{object | track_id: if(track_id > 0, do: track_id)}
+       end)}
+    end
+  end
+
+  @doc """
+  Converts the track IDs returned for packed detections into a list.
+  """
+  def to_list(track_ids) when is_binary(track_ids) do
+    for <<track_id::native-unsigned-32 <- track_ids>>, do: track_id
+  end
+
+  @doc """
+  Returns the number of live `:tracks` and of `:frames` seen so far.
+  """
+  def stats(%__MODULE__{ref: ref}), do: NIF.get_tracker_stats(ref)
+end
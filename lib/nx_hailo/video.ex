@@ -1,6 +1,10 @@
 defmodule NxHailo.Video do
   @moduledoc """
   Video capture utilities using Evision.
+
+  For capture without Evision, straight into native buffers that can be
+  letterboxed into the model input without copies, see
+  `NxHailo.FrameSource`.
   """
 
   @doc """
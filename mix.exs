@@ -20,12 +20,19 @@ defmodule NxHailo.MixProject do
       make_env: fn ->
         %{
           "MIX_BUILD_EMBEDDED" => "#{Mix.Project.config()[:build_embedded]}",
-          "FINE_INCLUDE_DIR" => Fine.include_dir()
+          "FINE_INCLUDE_DIR" => Fine.include_dir(),
+          "NX_HAILO_WITH_HAILORT" => System.get_env("NX_HAILO_WITH_HAILORT", hailort_default()),
+          "NX_HAILO_WITH_LIBJPEG" => System.get_env("NX_HAILO_WITH_LIBJPEG", "1")
         }
       end
     ]
   end
 
+  # HailoRT ships with the Nerves system, host builds only get the simulator
+  defp hailort_default do
+    if Mix.target() == :host, do: "0", else: "1"
+  end
+
   # Run "mix help compile.app" to learn about applications.
   def application do
     [
@@ -59,13 +66,18 @@ defmodule NxHailo.MixProject do
       {:exla, "~> 0.10.0"},
       {:bandit, "~> 1.5"},
       {:nx, "~> 0.6"},
+      {:telemetry, "~> 1.0"},
       {:elixir_make, "~> 0.6", runtime: false},
       {:fine, "~> 0.1.0", runtime: false},
       {:req, "~> 0.5.10", runtime: false, optional: true},
       {:yaml_elixir, "~> 2.10"},
 
       # Deps for running the livebook demo
-      {:kino, "~> 0.14"}
+      {:kino, "~> 0.14"},
+
+      # Benchmarks under bench/
+      {:benchee, "~> 1.3", only: :dev, runtime: false},
+      {:jason, "~> 1.4", only: :dev, runtime: false}
     ]
   end
 
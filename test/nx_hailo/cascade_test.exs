@@ -0,0 +1,138 @@
+defmodule NxHailo.CascadeTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Cascade
+  alias NxHailo.Hailo
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Simulator
+  alias NxHailo.Parsers.Classification
+  alias NxHailo.Parsers.Classification.Prediction
+  alias NxHailo.Parsers.YoloV8.DetectedObject
+  alias NxHailo.Preprocess
+
+  @classifier_input "resnet_v1_18/input_layer1"
+  @classifier_output "resnet_v1_18/fc1"
+
+  setup do
+    config =
+      Simulator.yolov8(
+        latency_us: 0,
+        networks: %{
+          "resnet_v1_18.hef" => %{
+            input_vstreams: [
+              %{
+                name: @classifier_input,
+                format: %{type: :uint8, order: :nhwc},
+                shape: %{height: 224, width: 224, features: 3}
+              }
+            ],
+            output_vstreams: [
+              %{
+                name: @classifier_output,
+                format: %{type: :uint8, order: :nhwc},
+                shape: %{height: 1, width: 1, features: 1000},
+                quant_info: %{qp_zp: 0.0, qp_scale: 0.1}
+              }
+            ]
+          }
+        }
+      )
+
+    {:ok, vdevice} = Simulator.create_vdevice(config)
+    {:ok, detector} = Hailo.load("yolov8m.hef", vdevice: vdevice)
+    {:ok, classifier} = Hailo.load("resnet_v1_18.hef", vdevice: vdevice)
+    %{detector: detector, classifier: classifier}
+  end
+
+  defp frame(width, height, bytes_per_pixel) do
+    for i <- 0..(width * height * bytes_per_pixel - 1), into: <<>>, do: <<rem(i * 7, 251)>>
+  end
+
+  defp box(xmin, ymin, xmax, ymax) do
+    %DetectedObject{xmin: xmin, ymin: ymin, xmax: xmax, ymax: ymax, score: 0.9, class_id: 0}
+  end
+
+  test "classify/4 classifies every box in one batch, as single crops would",
+       %{classifier: classifier} do
+    frame = frame(320, 240, 3)
+    objects = [box(10, 20, 110, 140), box(200, 100, 204, 104), box(150, 60, 300, 230)]
+
+    assert {:ok, [{first, first_predictions}, {_, []}, {_, last_predictions}], stats} =
+             Cascade.classify(classifier, frame, objects,
+               width: 320,
+               height: 240,
+               classifier: [top_k: 3]
+             )
+
+    # The 4x4 box is below :min_size
+    assert %{rois: 2, prepare: _, infer: _, parse: _} = stats
+    assert first == hd(objects)
+    assert [%Prediction{}, %Prediction{}, %Prediction{}] = last_predictions
+
+    # The first box grown by 10% on each side: x 0..120, y 8..152
+    {:ok, {crop, _letterbox}} =
+      Preprocess.letterbox(frame,
+        width: 320,
+        height: 240,
+        target_width: 224,
+        target_height: 224,
+        crop: {0, 8, 120, 144}
+      )
+
+    {:ok, outputs} = API.infer(classifier.pipeline, %{@classifier_input => crop})
+    [info] = classifier.pipeline.output_vstream_infos
+
+    assert {:ok, first_predictions} ==
+             Classification.parse(outputs, key: @classifier_output, info: info, top_k: 3)
+  end
+
+  test "classify/4 limits the batch and handles frames without boxes",
+       %{classifier: classifier} do
+    frame = frame(320, 240, 3)
+    opts = [width: 320, height: 240, max_rois: 1]
+    objects = [box(10, 20, 110, 140), box(150, 60, 300, 230)]
+
+    assert {:ok, [{_, [_ | _]}, {_, []}], %{rois: 1}} =
+             Cascade.classify(classifier, frame, objects, opts)
+
+    assert {:ok, [], %{rois: 0}} = Cascade.classify(classifier, frame, [], opts)
+
+    assert {:error, "Classifier output \"missing\" not found"} =
+             Cascade.classify(classifier, frame, objects, [classifier: [key: "missing"]] ++ opts)
+  end
+
+  test "classify/4 crops YUYV frames on even columns", %{classifier: classifier} do
+    frame = frame(320, 240, 2)
+
+    # Grown by 8 pixels to x 7..103, which starts and ends on odd columns
+    assert {:ok, [{_, [_ | _]}], %{rois: 1}} =
+             Cascade.classify(classifier, frame, [box(15, 21, 95, 131)],
+               width: 320,
+               height: 240,
+               format: :yuyv
+             )
+  end
+
+  test "run/4 detects and then classifies the detections",
+       %{detector: detector, classifier: classifier} do
+    frame = frame(640, 480, 3)
+
+    assert {:ok, results, stats} =
+             Cascade.run(detector, classifier, frame,
+               width: 640,
+               height: 480,
+               detector: [
+                 key: "yolov8m/yolov8_nms_postprocess",
+                 classes: Map.new(0..79, &{&1, "class #{&1}"})
+               ],
+               classifier: [top_k: 1]
+             )
+
+    assert %{detect: _, prepare: _, infer: _, parse: _, rois: rois} = stats
+    assert rois == Enum.count(results, &match?({_, [_]}, &1))
+
+    assert Enum.all?(results, fn {%DetectedObject{} = object, predictions} ->
+             object.xmax <= 640 and object.ymax <= 480 and length(predictions) <= 1
+           end)
+  end
+end
@@ -0,0 +1,90 @@
+defmodule NxHailo.FrameSourceTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.FrameSource
+  alias NxHailo.Preprocess
+
+  @moduletag :tmp_dir
+
+  # A 4x2 4:2:0 video whose frame `i` is filled with `i`
+  defp write_y4m(dir, frames, header \\ "YUV4MPEG2 W4 H2 F10:1 Ip A1:1 C420jpeg") do
+    path = Path.join(dir, "video.y4m")
+    body = for i <- 0..(frames - 1), into: <<>>, do: "FRAME\n" <> :binary.copy(<<i>>, 4 * 2 + 2 * 2 * 1)
+    File.write!(path, header <> "\n" <> body)
+    path
+  end
+
+  test "open_file/2 reads the layout from the Y4M header", %{tmp_dir: dir} do
+    assert {:ok, %FrameSource{width: 4, height: 2, format: :i420, stride: 4}} =
+             FrameSource.open_file(write_y4m(dir, 1))
+  end
+
+  test "read/2 returns successive frames when playing at fps 0", %{tmp_dir: dir} do
+    {:ok, source} = FrameSource.open_file(write_y4m(dir, 3), fps: 0, loop: false)
+
+    for i <- 0..2 do
+      assert {:ok, frame, %{sequence: sequence}} = FrameSource.read(source)
+      assert sequence == i + 1
+      assert frame == :binary.copy(<<i>>, 12)
+    end
+
+    assert {:error, "End of video file"} = FrameSource.read(source)
+  end
+
+  test "read/2 loops over the file", %{tmp_dir: dir} do
+    {:ok, source} = FrameSource.open_file(write_y4m(dir, 2), fps: 0)
+
+    frames =
+      for _ <- 1..4 do
+        {:ok, frame, _} = FrameSource.read(source)
+        :binary.first(frame)
+      end
+
+    assert frames == [0, 1, 0, 1]
+  end
+
+  test "read/2 waits for a frame newer than :after", %{tmp_dir: dir} do
+    {:ok, source} = FrameSource.open_file(write_y4m(dir, 10), fps: 20)
+
+    assert {:ok, _, %{sequence: first}} = FrameSource.read(source)
+    assert {:error, "Timed out" <> _} = FrameSource.read(source, after: first + 10, timeout: 10)
+    assert {:ok, _, %{sequence: next}} = FrameSource.read(source, after: first, timeout: 500)
+    assert next > first
+  end
+
+  test "open_file/2 reads raw frames with the given layout", %{tmp_dir: dir} do
+    path = Path.join(dir, "video.rgb")
+    File.write!(path, :binary.copy(<<1>>, 12) <> :binary.copy(<<2>>, 12) <> <<3>>)
+
+    {:ok, source} = FrameSource.open_file(path, width: 2, height: 2, format: :rgb, loop: false)
+    assert {:ok, <<1, _::binary>>, %{width: 2, height: 2, format: :rgb}} = FrameSource.read(source)
+    assert {:ok, <<2, _::binary>>, _} = FrameSource.read(source)
+    # The trailing partial frame is ignored
+    assert {:error, "End of video file"} = FrameSource.read(source)
+  end
+
+  test "open_file/2 rejects unsupported Y4M colorspaces", %{tmp_dir: dir} do
+    path = write_y4m(dir, 1, "YUV4MPEG2 W4 H2 F10:1 C444")
+    assert {:error, "Unsupported Y4M colorspace" <> _} = FrameSource.open_file(path)
+  end
+
+  test "letterbox_input/3 converts I420 frames", %{tmp_dir: dir} do
+    # Mid grey luma with neutral chroma
+    path = Path.join(dir, "grey.y4m")
+    File.write!(path, "YUV4MPEG2 W4 H2 F10:1\nFRAME\n" <> :binary.copy(<<126>>, 8) <> :binary.copy(<<128>>, 4))
+    {:ok, source} = FrameSource.open_file(path)
+    {:ok, frame, metadata} = FrameSource.read(source)
+
+    info = %{shape: %{height: 2, width: 4}}
+    assert {:ok, {{:letterbox, ^frame, _}, %{scale: 1.0}}} = FrameSource.letterbox_input(frame, metadata, info)
+
+    opts = metadata |> Map.take([:width, :height, :format, :stride]) |> Keyword.new()
+    {:ok, {rgb, _}} = Preprocess.letterbox(frame, [target_width: 4, target_height: 2] ++ opts)
+
+    for <<value <- rgb>>, do: assert(abs(value - 128) <= 1)
+  end
+
+  test "open_v4l2/2 fails on a missing device" do
+    assert {:error, _} = FrameSource.open_v4l2("/dev/nx_hailo_missing_video")
+  end
+end
@@ -0,0 +1,248 @@
+defmodule NxHailo.Hailo.APITest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Simulator
+
+  @input "yolov8m/input_layer1"
+  @output "yolov8m/yolov8_nms_postprocess"
+
+  setup do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 1_000))
+    {:ok, ng} = API.configure_network_group(vdevice, "yolov8m.hef")
+    {:ok, pipeline} = API.create_pipeline(ng)
+    %{pipeline: pipeline}
+  end
+
+  defp frame(byte), do: :binary.copy(<<byte>>, 640 * 640 * 3)
+
+  test "reports the simulated vstreams", %{pipeline: pipeline} do
+    assert [%{name: @input, frame_size: 1_228_800, shape: %{height: 640}}] =
+             pipeline.input_vstream_infos
+
+    assert [%{name: @output, nms_shape: %{number_of_classes: 80}, frame_size: frame_size}] =
+             pipeline.output_vstream_infos
+
+    assert frame_size == 80 * (1 + 100 * 5) * 4
+  end
+
+  test "infer/2 is deterministic", %{pipeline: pipeline} do
+    assert {:ok, %{@output => first}} = API.infer(pipeline, %{@input => frame(1)})
+    assert {:ok, %{@output => ^first}} = API.infer(pipeline, %{@input => frame(1)})
+    assert {:ok, %{@output => other}} = API.infer(pipeline, %{@input => frame(2)})
+    assert other != first
+  end
+
+  test "infer_async/2 returns before the device is done", %{pipeline: pipeline} do
+    refs =
+      for byte <- 1..4 do
+        assert {:ok, ref} = API.infer_async(pipeline, %{@input => frame(byte)})
+        ref
+      end
+
+    for ref <- refs do
+      assert_receive {^ref, {:ok, %{@output => output}}}, 1_000
+      assert byte_size(output) == 80 * (1 + 100 * 5) * 4
+    end
+  end
+
+  test "output buffers return to the pool once released", %{pipeline: pipeline} do
+    {:ok, %{@output => %{capacity: 4, in_use: 0}}} = API.output_pool_stats(pipeline)
+
+    parent = self()
+
+    {pid, monitor_ref} =
+      spawn_monitor(fn ->
+        {:ok, outputs} = API.infer(pipeline, %{@input => frame(1)})
+        {:ok, stats} = API.output_pool_stats(pipeline)
+        send(parent, {byte_size(outputs[@output]), stats})
+      end)
+
+    assert_receive {160_320, %{@output => %{in_use: 1, acquired: 1}}}, 1_000
+    assert_receive {:DOWN, ^monitor_ref, :process, ^pid, :normal}
+
+    # The process heap holding the binary is gone, so the buffer is idle again
+    assert {:ok, %{@output => %{in_use: 0, idle: 4, misses: 0}}} =
+             API.output_pool_stats(pipeline)
+  end
+
+  test "infer_batch/3 returns one output map per frame", %{pipeline: pipeline} do
+    frames = [frame(1), frame(2), frame(3)]
+
+    assert {:ok, [%{@output => first}, %{@output => second}, %{@output => third}]} =
+             API.infer_batch(pipeline, %{@input => frames})
+
+    # Each frame gets the same result it would get on its own
+    assert {:ok, %{@output => ^first}} = API.infer(pipeline, %{@input => frame(1)})
+    assert {:ok, %{@output => ^second}} = API.infer(pipeline, %{@input => frame(2)})
+    assert {:ok, %{@output => ^third}} = API.infer(pipeline, %{@input => frame(3)})
+
+    assert {:error, "Input data for vstream" <> _} =
+             API.infer_batch(pipeline, %{@input => []})
+
+    assert {:error, "Invalid input data size" <> _} =
+             API.infer_batch(pipeline, %{@input => [frame(1), <<0>>]})
+  end
+
+  test "batched transfers are not counted as scheduler wait" do
+    config = Simulator.yolov8(latency_us: 1_000, per_frame_latency_us: 5_000, estimate_wait: true)
+    {:ok, vdevice} = Simulator.create_vdevice(config)
+    {:ok, ng} = API.configure_network_group(vdevice, "yolov8m.hef")
+    {:ok, pipeline} = API.create_pipeline(ng)
+    frames = List.duplicate(frame(1), 8)
+
+    # A single frame transfer is much faster than a batch, yet nothing else
+    # competes for the device
+    assert {:ok, _} = API.infer(pipeline, %{@input => frame(1)})
+    assert {:ok, _} = API.infer_batch(pipeline, %{@input => frames})
+    assert {:ok, _} = API.infer_batch(pipeline, %{@input => frames})
+
+    assert {:ok, %{transfers: 3, frames: 17, total_wait_us: wait}} = API.scheduler_stats(ng)
+    assert wait < 5_000
+  end
+
+  test "stream pipelines reply in submission order", %{pipeline: pipeline} do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 1_000))
+    {:ok, ng} = API.configure_network_group(vdevice, "yolov8m.hef")
+    {:ok, stream_pipeline} = API.create_stream_pipeline(ng, depth: 3)
+
+    inputs = for byte <- 1..6, do: %{@input => frame(byte)}
+
+    expected =
+      for input <- inputs do
+        {:ok, outputs} = API.infer(pipeline, input)
+        {:ok, outputs}
+      end
+
+    assert Enum.to_list(API.stream(stream_pipeline, inputs)) == expected
+
+    # Errors keep their place in the order
+    assert {:ok, first} = API.stream_submit(stream_pipeline, %{@input => frame(1)})
+
+    assert {:ok, second} =
+             API.stream_submit(stream_pipeline, %{@input => {:letterbox, <<0>>, %{width: 8}}})
+
+    assert {:ok, third} = API.stream_submit(stream_pipeline, %{@input => frame(2)})
+    assert_receive {^first, {:ok, _}}, 1_000
+    assert_receive {^second, {:error, _}}, 1_000
+    assert_receive {^third, {:ok, _}}, 1_000
+  end
+
+  test "infer_timed/2 reports the stages that pipeline_stats/1 aggregates", %{
+    pipeline: pipeline
+  } do
+    assert {:ok, %{@output => _}, timings} = API.infer_timed(pipeline, %{@input => frame(1)})
+
+    assert Enum.sort(Map.keys(timings)) == [:acquire, :decode, :device, :encode, :wait]
+    # The simulated device takes 1ms per transfer
+    assert timings.device >= System.convert_time_unit(1, :millisecond, :native)
+
+    {:ok, _} = API.infer(pipeline, %{@input => frame(2)})
+    {:error, _} = API.infer(pipeline, %{@input => {:letterbox, <<0>>, %{width: 8}}})
+
+    assert {:ok, %{requests: 3, frames: 2, errors: 1, stages: stages, total: total}} =
+             API.pipeline_stats(pipeline)
+
+    assert %{count: 2, min_us: min, p50_us: p50, max_us: max} = stages.device
+    assert min >= 1_000.0 and min <= p50 and p50 <= max
+    assert total.count == 2 and total.min_us >= stages.device.min_us
+  end
+
+  describe "deadlines" do
+    test "requests past their deadline never reach the device", %{pipeline: pipeline} do
+      assert {:error, :deadline_exceeded} = API.infer(pipeline, %{@input => frame(1)}, timeout: 0)
+
+      past = System.monotonic_time(:millisecond) - 10
+
+      assert {:error, :deadline_exceeded} =
+               API.infer_batch(pipeline, %{@input => [frame(1), frame(2)]}, deadline: past)
+
+      assert {:ok, %{requests: 2, frames: 0, errors: 0, expired: 2, dropped: 0}} =
+               API.pipeline_stats(pipeline)
+    end
+
+    test "a backlog sheds the frames that cannot make their deadline" do
+      {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 60_000))
+      {:ok, ng} = API.configure_network_group(vdevice, "yolov8m.hef")
+      {:ok, pipeline} = API.create_pipeline(ng)
+
+      refs =
+        for byte <- 1..4 do
+          {:ok, ref} = API.infer_async(pipeline, %{@input => frame(byte)}, timeout: 100)
+          ref
+        end
+
+      # The first frame runs, the others would only finish 60ms after
+      # their turn comes, which is past their deadline
+      assert [{:ok, _} | rest] = Enum.map(refs, &API.await/1)
+      assert Enum.all?(rest, &(&1 == {:error, :deadline_exceeded}))
+
+      assert {:ok, %{requests: 4, frames: 1, errors: 0} = stats} = API.pipeline_stats(pipeline)
+      assert stats.expired + stats.dropped == 3
+      assert stats.dropped >= 1
+
+      # Without a deadline nothing is shed
+      assert {:ok, _} = API.infer(pipeline, %{@input => frame(1)}, timeout: :infinity)
+    end
+
+    test "late completions are counted" do
+      {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 20_000))
+      {:ok, ng} = API.configure_network_group(vdevice, "yolov8m.hef")
+      {:ok, pipeline} = API.create_pipeline(ng)
+
+      # No service time is known yet, so the request is run and overruns
+      assert {:ok, _} = API.infer(pipeline, %{@input => frame(1)}, timeout: 5)
+      assert {:ok, %{frames: 1, late: 1, expired: 0, dropped: 0}} = API.pipeline_stats(pipeline)
+    end
+  end
+
+  test "load/3 configures and creates the pipeline in one call", %{pipeline: pipeline} do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8())
+
+    assert {:ok, ng, loaded, %{configure_us: _, pipeline_us: _}} =
+             API.load(vdevice, "yolov8m.hef", batch_size: 2)
+
+    assert loaded.network_group_ref == ng.ref
+    assert loaded.input_vstream_infos == pipeline.input_vstream_infos
+    assert loaded.output_vstream_infos == pipeline.output_vstream_infos
+
+    assert {:ok, expected} = API.infer(pipeline, %{@input => frame(1)})
+    assert {:ok, ^expected} = API.infer(loaded, %{@input => frame(1)})
+
+    assert {:error, "Invalid batch size" <> _} = API.load(vdevice, "yolov8m.hef", batch_size: 70_000)
+  end
+
+  test "Hailo.load/2 reports its startup time through telemetry" do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8())
+    event = [:nx_hailo, :load, :stop]
+    ref = :telemetry_test.attach_event_handlers(self(), [event])
+
+    assert {:ok, %{name: "yolov8m.hef"}} = NxHailo.Hailo.load("yolov8m.hef", vdevice: vdevice)
+
+    assert_receive {^event, ^ref, %{duration: _, configure_us: _, pipeline_us: _},
+                    %{name: "yolov8m.hef", result: :ok}}
+
+    :telemetry.detach(ref)
+  end
+
+  test "invalid inputs are rejected before reaching the device", %{pipeline: pipeline} do
+    assert {:error, "Invalid input data size" <> _} = API.infer(pipeline, %{@input => <<0>>})
+    assert {:error, "Missing input" <> _} = API.infer(pipeline, %{})
+  end
+
+  test "options beyond 32 bits are rejected rather than wrapped" do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 0))
+
+    assert {:error, "Invalid scheduler_timeout_ms: 4294967296"} =
+             API.configure_network_group(vdevice, "yolov8m.hef",
+               scheduler_timeout_ms: 4_294_967_296
+             )
+
+    {:ok, ng} = API.configure_network_group(vdevice, "yolov8m.hef")
+
+    assert {:error, "Invalid timeout_ms: 4294967296"} =
+             API.create_pipeline(ng, timeout_ms: 4_294_967_296)
+
+    assert {:ok, _} = API.create_pipeline(ng, timeout_ms: 4_294_967_295)
+  end
+end
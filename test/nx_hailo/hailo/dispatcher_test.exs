@@ -0,0 +1,59 @@
+defmodule NxHailo.Hailo.DispatcherTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Hailo
+  alias NxHailo.Hailo.Dispatcher
+  alias NxHailo.Hailo.Simulator
+
+  @input "yolov8m/input_layer1"
+  @output "yolov8m/yolov8_nms_postprocess"
+
+  defp model(latency_us) do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: latency_us))
+    {:ok, model} = Hailo.load("yolov8m.hef", vdevice: vdevice)
+    model
+  end
+
+  defp frame(byte), do: :binary.copy(<<byte>>, 640 * 640 * 3)
+
+  test "spreads requests over every device" do
+    dispatcher = start_supervised!({Dispatcher, models: [model(2_000), model(2_000)]})
+
+    results =
+      1..8
+      |> Enum.map(fn byte -> Task.async(fn -> Dispatcher.infer(dispatcher, %{@input => frame(byte)}) end) end)
+      |> Task.await_many()
+
+    assert Enum.all?(results, &match?({:ok, %{@output => _}}, &1))
+
+    assert [%{completed: 4, outstanding: 0}, %{completed: 4, outstanding: 0}] =
+             Dispatcher.stats(dispatcher)
+  end
+
+  test "faster devices take more of a sustained load" do
+    dispatcher = start_supervised!({Dispatcher, models: [model(20_000), model(2_000)]})
+
+    1..3
+    |> Enum.map(fn client ->
+      Task.async(fn ->
+        for _ <- 1..10, do: {:ok, _} = Dispatcher.infer(dispatcher, %{@input => frame(client)})
+      end)
+    end)
+    |> Task.await_many(10_000)
+
+    assert [slow, fast] = Dispatcher.stats(dispatcher)
+    assert slow.completed + fast.completed == 30
+    assert fast.completed > slow.completed
+    assert slow.utilization > 0 and slow.utilization <= 1
+    assert fast.busy_us > 0
+  end
+
+  test "invalid inputs are rejected without reaching a device" do
+    dispatcher = start_supervised!({Dispatcher, models: [model(0)]})
+
+    assert {:error, "Invalid input data size" <> _} =
+             Dispatcher.infer(dispatcher, %{@input => <<0>>})
+
+    assert [%{completed: 0, failed: 0}] = Dispatcher.stats(dispatcher)
+  end
+end
@@ -0,0 +1,92 @@
+defmodule NxHailo.Hailo.ModelRegistryTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.ModelRegistry
+  alias NxHailo.Hailo.Simulator
+
+  @classifier_input "resnet_v1_18/input_layer1"
+  @classifier_output "resnet_v1_18/fc1"
+
+  setup do
+    config =
+      Simulator.yolov8(
+        latency_us: 2_000,
+        networks: %{
+          "resnet_v1_18.hef" => %{
+            input_vstreams: [
+              %{
+                name: @classifier_input,
+                format: %{type: :uint8, order: :nhwc},
+                shape: %{height: 224, width: 224, features: 3}
+              }
+            ],
+            output_vstreams: [
+              %{
+                name: @classifier_output,
+                format: %{type: :uint8, order: :nhwc},
+                shape: %{height: 1, width: 1, features: 1000},
+                quant_info: %{qp_zp: 0.0, qp_scale: 0.1}
+              }
+            ]
+          }
+        }
+      )
+
+    {:ok, vdevice} = Simulator.create_vdevice(config)
+
+    registry =
+      start_supervised!(
+        {ModelRegistry,
+         vdevice: vdevice,
+         models: [
+           detector: {"/data/yolov8m.hef", scheduler_priority: 20},
+           classifier: {"/data/resnet_v1_18.hef", scheduler_priority: 10, scheduler_threshold: 2}
+         ]}
+      )
+
+    %{registry: registry}
+  end
+
+  defp input(%{pipeline: pipeline}) do
+    for info <- pipeline.input_vstream_infos,
+        into: %{},
+        do: {info.name, :binary.copy(<<1>>, info.frame_size)}
+  end
+
+  test "models share the device and keep their own vstreams", %{registry: registry} do
+    assert {:ok, detector} = ModelRegistry.fetch(registry, :detector)
+    assert {:ok, classifier} = ModelRegistry.fetch(registry, :classifier)
+    assert {:error, "Unknown model" <> _} = ModelRegistry.fetch(registry, :other)
+
+    assert [%{name: "yolov8m/input_layer1"}] = detector.pipeline.input_vstream_infos
+    assert [%{name: @classifier_input}] = classifier.pipeline.input_vstream_infos
+    assert [%{name: @classifier_output, frame_size: 1000}] = classifier.pipeline.output_vstream_infos
+
+    tasks =
+      for model <- [detector, classifier], _ <- 1..5 do
+        Task.async(fn -> API.infer(model.pipeline, input(model)) end)
+      end
+
+    assert Enum.all?(Task.await_many(tasks), &match?({:ok, _}, &1))
+
+    assert %{
+             detector: %{transfers: 5, frames: 5, total_wait_us: detector_wait},
+             classifier: %{transfers: 5, frames: 5, total_wait_us: classifier_wait}
+           } = ModelRegistry.stats(registry)
+
+    # The two pipelines competed for the one simulated device
+    assert detector_wait + classifier_wait > 0
+  end
+
+  test "models can be registered later", %{registry: registry} do
+    assert {:ok, model} = ModelRegistry.register(registry, :second_detector, "yolov8m.hef")
+    assert {:ok, ^model} = ModelRegistry.fetch(registry, :second_detector)
+
+    assert {:error, "Model :second_detector is already registered"} =
+             ModelRegistry.register(registry, :second_detector, "yolov8m.hef")
+
+    assert {:error, "Invalid scheduler priority" <> _} =
+             ModelRegistry.register(registry, :bad, "yolov8m.hef", scheduler_priority: 40)
+  end
+end
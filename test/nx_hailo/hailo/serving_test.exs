@@ -0,0 +1,104 @@
+defmodule NxHailo.Hailo.ServingTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Hailo
+  alias NxHailo.Hailo.Simulator
+  alias NxHailo.Parsers.YoloV8
+  alias NxHailo.Preprocess
+
+  @input "yolov8m/input_layer1"
+  @output "yolov8m/yolov8_nms_postprocess"
+  @parser_opts [key: @output, classes: Map.new(0..79, &{&1, "class_#{&1}"})]
+
+  setup do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 5_000))
+    {:ok, model} = Hailo.load("yolov8m.hef", vdevice: vdevice, batch_size: 4)
+
+    serving = Hailo.Serving.new(model, YoloV8, parser_opts: @parser_opts, batch_size: 4)
+    name = :"#{__MODULE__}.#{System.unique_integer([:positive])}"
+    start_supervised!({Nx.Serving, serving: serving, name: name, batch_timeout: 50})
+
+    %{model: model, name: name}
+  end
+
+  defp frame(byte), do: Nx.broadcast(Nx.tensor(byte, type: :u8), {640, 640, 3})
+
+  test "batches concurrent callers and returns each its own result", %{model: model, name: name} do
+    ref = :telemetry_test.attach_event_handlers(self(), [[:nx_hailo, :serving, :batch]])
+
+    results =
+      1..8
+      |> Task.async_stream(&Nx.Serving.batched_run(name, %{@input => frame(&1)}),
+        max_concurrency: 8
+      )
+      |> Enum.map(fn {:ok, result} -> result end)
+
+    for {result, byte} <- Enum.with_index(results, 1) do
+      assert {:ok, [_ | _]} = result
+      assert result == Hailo.infer(model, %{@input => frame(byte)}, YoloV8, @parser_opts)
+    end
+
+    # Requests arriving together share device transfers
+    sizes = receive_batch_sizes(ref, [])
+    assert Enum.sum(sizes) == 8
+    assert Enum.max(sizes) > 1
+    :telemetry.detach(ref)
+  end
+
+  test "accepts lists of inputs and letterboxes natively", %{model: model, name: name} do
+    camera_frame = :binary.copy(<<1, 2, 3>>, 320 * 240)
+    [info] = model.pipeline.input_vstream_infos
+    {:ok, {input, letterbox}} = Preprocess.letterbox_input(camera_frame, info, width: 320, height: 240)
+
+    {:ok, {letterboxed, ^letterbox}} =
+      Preprocess.letterbox(camera_frame,
+        width: 320,
+        height: 240,
+        target_width: 640,
+        target_height: 640
+      )
+
+    assert [{:ok, objects}, {:ok, _}] =
+             Nx.Serving.batched_run(name, [%{@input => input}, %{@input => frame(3)}])
+
+    # Boxes come back in frame coordinates
+    assert {:ok, ^objects} =
+             Hailo.infer(
+               model,
+               %{@input => Nx.from_binary(letterboxed, :u8)},
+               YoloV8,
+               @parser_opts ++ [letterbox: letterbox]
+             )
+  end
+
+  test "fails each request of a batch the device rejects", %{model: model} do
+    # Frames shaped for this input are half the size the device expects
+    model =
+      update_in(model.pipeline.input_vstream_infos, fn [info] ->
+        [put_in(info.shape.height, 320)]
+      end)
+
+    serving = Hailo.Serving.new(model, YoloV8, parser_opts: @parser_opts, batch_size: 4)
+    name = :"#{__MODULE__}.#{System.unique_integer([:positive])}"
+    start_supervised!({Nx.Serving, serving: serving, name: name, batch_timeout: 50}, id: name)
+    frame = Nx.broadcast(Nx.tensor(1, type: :u8), {320, 640, 3})
+
+    assert [{:error, reason}, {:error, reason}] =
+             Nx.Serving.batched_run(name, [%{@input => frame}, %{@input => frame}])
+
+    assert is_binary(reason)
+
+    # The serving keeps running
+    assert {:error, ^reason} = Nx.Serving.batched_run(name, %{@input => frame})
+  end
+
+  defp receive_batch_sizes(ref, acc) do
+    receive do
+      {[:nx_hailo, :serving, :batch], ^ref, %{size: size, fill: fill}, %{name: "yolov8m.hef"}} ->
+        assert fill == size / 4
+        receive_batch_sizes(ref, [size | acc])
+    after
+      100 -> acc
+    end
+  end
+end
@@ -0,0 +1,95 @@
+defmodule NxHailo.Parsers.ClassificationTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Simulator
+  alias NxHailo.Parsers.Classification
+  alias NxHailo.Parsers.Classification.Prediction
+
+  @classes %{0 => "cat", 1 => "dog", 2 => "bird", 3 => "fish"}
+  @info %{format: %{type: :uint8}, quant_info: %{qp_zp: 10.0, qp_scale: 0.5}}
+
+  defp floats(values), do: for(v <- values, into: <<>>, do: <<v::float-32-native>>)
+
+  test "parse/2 returns the top classes of a raw uint8 output, best first" do
+    output = %{"logits" => <<12, 40, 30, 40>>}
+
+    assert {:ok, [first, second, third]} =
+             Classification.parse(output, key: "logits", info: @info, classes: @classes, top_k: 3)
+
+    # Ties go to the lowest class id
+    assert %Prediction{class_id: 1, class_name: "dog", score: 15.0} = first
+    assert %Prediction{class_id: 3, class_name: "fish", score: 15.0} = second
+    assert %Prediction{class_id: 2, score: 10.0} = third
+  end
+
+  test "parse/2 reads uint16 outputs" do
+    info = put_in(@info.format.type, :uint16)
+    output = %{"logits" => <<100::native-16, 900::native-16, 300::native-16>>}
+
+    assert {:ok, [%{class_id: 1, score: 445.0}]} =
+             Classification.parse(output, key: "logits", info: info, top_k: 1)
+  end
+
+  test "parse/2 reads float32 outputs without an info" do
+    output = %{"logits" => floats([0.5, -1.0, 2.5, 1.0])}
+
+    assert {:ok, [%{class_id: 2, class_name: "bird"}, %{class_id: 3}]} =
+             Classification.parse(output, key: "logits", classes: @classes, top_k: 2)
+  end
+
+  test "parse/2 softmaxes over the returned classes" do
+    output = %{"logits" => floats([0.0, :math.log(3), -5.0])}
+
+    assert {:ok, [%{class_id: 1, score: top}, %{class_id: 0, score: next}]} =
+             Classification.parse(output, key: "logits", top_k: 2, softmax: true)
+
+    assert_in_delta top, 0.75, 1.0e-6
+    assert_in_delta next, 0.25, 1.0e-6
+  end
+
+  test "parse/2 returns all classes when top_k is larger" do
+    assert {:ok, predictions} =
+             Classification.parse(%{"logits" => <<1, 2>>}, key: "logits", info: @info, top_k: 10)
+
+    assert Enum.map(predictions, & &1.class_id) == [1, 0]
+  end
+
+  test "raw and host-converted outputs give the same classes" do
+    config =
+      Simulator.yolov8(
+        latency_us: 0,
+        output_vstreams: [
+          %{
+            name: "classifier/logits",
+            format: %{type: :uint8, order: :nhwc},
+            shape: %{height: 1, width: 1, features: 1000},
+            quant_info: %{qp_zp: 12.0, qp_scale: 0.05}
+          }
+        ]
+      )
+
+    {:ok, vdevice} = Simulator.create_vdevice(config)
+    {:ok, ng} = API.configure_network_group(vdevice, "classifier.hef")
+    {:ok, raw} = API.create_pipeline(ng, raw_outputs: true, output_format_type: :float32)
+    {:ok, float} = API.create_pipeline(ng, output_format_type: :float32)
+
+    [input_info] = raw.input_vstream_infos
+    [info] = raw.output_vstream_infos
+    input = %{input_info.name => :binary.copy(<<7>>, input_info.frame_size)}
+    {:ok, raw_outputs} = API.infer(raw, input)
+    {:ok, float_outputs} = API.infer(float, input)
+
+    opts = [key: "classifier/logits", top_k: 10]
+    assert {:ok, from_raw} = Classification.parse(raw_outputs, [info: info] ++ opts)
+    assert {:ok, from_float} = Classification.parse(float_outputs, opts)
+    assert from_raw == from_float
+  end
+
+  test "parse/2 rejects outputs that do not match the info" do
+    info = put_in(@info.format.type, :uint16)
+
+    assert {:error, "Quantized data size" <> _} =
+             Classification.parse(%{"logits" => <<1, 2, 3>>}, key: "logits", info: info)
+  end
+end
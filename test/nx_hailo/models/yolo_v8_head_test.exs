@@ -0,0 +1,125 @@
+defmodule NxHailo.Parsers.YoloV8HeadTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Parsers.YoloV8
+  alias NxHailo.Parsers.YoloV8Head
+
+  @classes %{0 => "person", 1 => "bicycle", 2 => "car"}
+
+  # A 64x64 input with 4 DFL bins per edge, on a 2x2 and a 1x1 grid. Every
+  # edge splits its weight between bins 0 and 1, half a stride from the
+  # cell centre, so every box covers exactly its cell.
+  @edge [40, 40, 0, 0]
+
+  defp info(name, grid, features, type) do
+    %{
+      name: name,
+      shape: %{height: grid, width: grid, features: features},
+      format: %{type: type},
+      quant_info: %{qp_zp: 0.0, qp_scale: if(features == 16, do: 1.0, else: 0.01)}
+    }
+  end
+
+  defp infos(type) do
+    [
+      info("boxes_2", 2, 16, type),
+      info("scores_2", 2, 3, type),
+      info("boxes_1", 1, 16, type),
+      info("scores_1", 1, 3, type)
+    ]
+  end
+
+  # Scores per cell, as quantized values
+  @scores_2 [[90, 0, 0], [0, 0, 0], [0, 0, 0], [0, 0, 50]]
+  @scores_1 [[60, 0, 0]]
+
+  defp encode(values, :uint8), do: for(v <- values, into: <<>>, do: <<v>>)
+  defp encode(values, :float32), do: for(v <- values, into: <<>>, do: <<v::float-32-native>>)
+
+  defp outputs(:uint8) do
+    %{
+      "boxes_2" => encode(List.flatten(List.duplicate(@edge, 4 * 4)), :uint8),
+      "scores_2" => encode(List.flatten(@scores_2), :uint8),
+      "boxes_1" => encode(List.flatten(List.duplicate(@edge, 4)), :uint8),
+      "scores_1" => encode(List.flatten(@scores_1), :uint8)
+    }
+  end
+
+  # Real values, as a pipeline converting the outputs on the host sees them
+  defp outputs(:float32) do
+    %{
+      "boxes_2" => encode(List.flatten(List.duplicate(@edge, 4 * 4)), :float32),
+      "scores_2" => encode(for(v <- List.flatten(@scores_2), do: v / 100), :float32),
+      "boxes_1" => encode(List.flatten(List.duplicate(@edge, 4)), :float32),
+      "scores_1" => encode(for(v <- List.flatten(@scores_1), do: v / 100), :float32)
+    }
+  end
+
+  defp opts(type, opts \\ []) do
+    Keyword.merge(
+      [output_infos: infos(type), input_size: {64, 64}, reg_max: 4, classes: @classes],
+      opts
+    )
+  end
+
+  test "parse/2 decodes the boxes of every scale, best score first" do
+    assert {:ok, [first, second, third]} = YoloV8Head.parse(outputs(:uint8), opts(:uint8))
+
+    assert %YoloV8.RawDetectedObject{class_id: 0, class_name: "person"} = first
+    assert_in_delta first.score, 0.9, 1.0e-6
+    assert {first.ymin, first.xmin, first.ymax, first.xmax} == {0.0, 0.0, 0.5, 0.5}
+
+    # The only cell of the 1x1 grid covers the whole input
+    assert %{class_id: 0, ymin: 0.0, xmin: 0.0, ymax: 1.0, xmax: 1.0} = second
+    assert %{class_id: 2, class_name: "car", ymin: 0.5, xmin: 0.5} = third
+  end
+
+  test "raw and host-converted outputs give the same detections" do
+    {:ok, raw} = YoloV8Head.parse_packed(outputs(:uint8), opts(:uint8, number_of_classes: 3))
+    {:ok, float} = YoloV8Head.parse_packed(outputs(:float32), opts(:float32, number_of_classes: 3))
+
+    assert Nx.to_number(Nx.all_close(YoloV8.to_tensor(raw), YoloV8.to_tensor(float))) == 1
+  end
+
+  test "parse/2 suppresses overlapping boxes of a class" do
+    # The full-input box overlaps the best person box by an IoU of 0.25
+    assert {:ok, [%{score: first}, %{class_id: 2}]} =
+             YoloV8Head.parse(outputs(:uint8), opts(:uint8, iou_threshold: 0.2))
+
+    assert_in_delta first, 0.9, 1.0e-6
+  end
+
+  test "parse/2 filters by score, class and top_k" do
+    assert {:ok, [%{class_id: 0}, %{class_id: 0}]} =
+             YoloV8Head.parse(outputs(:uint8), opts(:uint8, score_threshold: 0.55))
+
+    assert {:ok, [%{class_id: 2}]} =
+             YoloV8Head.parse(outputs(:uint8), opts(:uint8, class_ids: [2]))
+
+    assert {:ok, [%{class_id: 0}]} = YoloV8Head.parse(outputs(:uint8), opts(:uint8, top_k: 1))
+  end
+
+  test "parse/2 applies the sigmoid to logits" do
+    assert {:ok, [%{class_id: 0, score: score} | _]} =
+             YoloV8Head.parse(outputs(:float32), opts(:float32, sigmoid: true))
+
+    assert_in_delta score, 1 / (1 + :math.exp(-0.9)), 1.0e-6
+  end
+
+  test "parse/2 remaps into the image space" do
+    assert {:ok, [%YoloV8.DetectedObject{xmin: 0, ymin: 0, xmax: 32, ymax: 32} | _]} =
+             YoloV8Head.parse(outputs(:uint8), opts(:uint8, input_shape: {64, 64}))
+  end
+
+  test "unpaired and malformed outputs are rejected" do
+    [_boxes | infos] = infos(:uint8)
+
+    assert {:error, "Expected one box and one score output on the 2x2 grid"} =
+             YoloV8Head.parse(outputs(:uint8), opts(:uint8, output_infos: infos))
+
+    outputs = %{outputs(:uint8) | "scores_1" => <<1, 2>>}
+
+    assert {:error, "Score output has 2 bytes, expected 3"} =
+             YoloV8Head.parse(outputs, opts(:uint8))
+  end
+end
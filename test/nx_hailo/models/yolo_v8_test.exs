@@ -0,0 +1,75 @@
+defmodule NxHailo.Parsers.YoloV8Test do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Parsers.YoloV8
+
+  @classes %{0 => "person", 1 => "bicycle", 2 => "car"}
+
+  # Three classes, up to 2 boxes each: a count per class followed by
+  # (ymin, xmin, ymax, xmax, score) tuples, zero padded to the frame size
+  defp nms_frame(boxes_by_class) do
+    data =
+      for boxes <- boxes_by_class, into: <<>> do
+        rows = for {ymin, xmin, ymax, xmax, score} <- boxes, do: [ymin, xmin, ymax, xmax, score]
+        <<length(boxes)::float-32-little>> <> floats(List.flatten(rows))
+      end
+
+    %{"out" => data <> :binary.copy(<<0>>, 3 * (1 + 2 * 5) * 4 - byte_size(data))}
+  end
+
+  defp floats(values), do: for(v <- values, into: <<>>, do: <<v::float-32-little>>)
+
+  setup do
+    %{
+      output:
+        nms_frame([
+          [{0.0, 0.0, 0.5, 0.5, 0.25}, {0.25, 0.25, 0.75, 0.75, 0.75}],
+          [],
+          [{0.5, 0.0, 1.0, 1.0, 0.5}]
+        ])
+    }
+  end
+
+  test "parse/2 returns the boxes best score first", %{output: output} do
+    assert {:ok, [first, second, third]} = YoloV8.parse(output, key: "out", classes: @classes)
+
+    assert %YoloV8.RawDetectedObject{class_id: 0, class_name: "person", score: 0.75, ymin: 0.25} =
+             first
+
+    assert %{class_id: 2, class_name: "car", score: 0.5} = second
+    assert %{class_id: 0, score: 0.25} = third
+  end
+
+  test "parse/2 filters by score, class and top_k", %{output: output} do
+    assert {:ok, [%{score: 0.75}, %{score: 0.5}]} =
+             YoloV8.parse(output, key: "out", classes: @classes, score_threshold: 0.4)
+
+    assert {:ok, [%{class_id: 2}]} =
+             YoloV8.parse(output, key: "out", classes: @classes, class_ids: [2])
+
+    assert {:ok, [%{score: 0.75}]} =
+             YoloV8.parse(output, key: "out", classes: @classes, top_k: 1)
+  end
+
+  test "parse/2 remaps like postprocess/2", %{output: output} do
+    input_shape = {480, 640}
+    {:ok, raw} = YoloV8.parse(output, key: "out", classes: @classes)
+
+    assert {:ok, YoloV8.postprocess(raw, input_shape)} ==
+             YoloV8.parse(output, key: "out", classes: @classes, input_shape: input_shape)
+  end
+
+  test "parse_packed/2 returns six floats per detection", %{output: output} do
+    assert {:ok, packed} = YoloV8.parse_packed(output, key: "out", number_of_classes: 3, top_k: 2)
+
+    assert YoloV8.to_tensor(packed) ==
+             Nx.tensor([[0.0, 0.75, 0.25, 0.25, 0.75, 0.75], [2.0, 0.5, 0.5, 0.0, 1.0, 1.0]],
+               type: :f32
+             )
+  end
+
+  test "malformed outputs are rejected" do
+    assert {:error, "Malformed NMS output" <> _} =
+             YoloV8.parse_packed(%{"out" => floats([3.0, 0.0])}, key: "out", number_of_classes: 3)
+  end
+end
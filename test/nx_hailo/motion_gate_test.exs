@@ -0,0 +1,112 @@
+defmodule NxHailo.MotionGateTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.MotionGate
+
+  @width 64
+  @height 48
+  @frame_opts [width: @width, height: @height]
+
+  defp grey_frame(level \\ 60), do: :binary.copy(<<level>>, @width * @height * 3)
+
+  # Paints a white 8x8 square at (x, y)
+  defp with_square(frame, x, y) do
+    Enum.reduce(y..(y + 7), frame, fn row, frame ->
+      offset = (row * @width + x) * 3
+      <<before::binary-size(offset), _::binary-size(24), rest::binary>> = frame
+      before <> :binary.copy(<<255>>, 24) <> rest
+    end)
+  end
+
+  defp counting_fun(result) do
+    fn ->
+      send(self(), :inferred)
+      {:ok, result}
+    end
+  end
+
+  test "reuses the stored result while the frame is unchanged" do
+    {:ok, gate} = MotionGate.new(refresh_interval: 0)
+
+    assert {:ok, :first} = MotionGate.run(gate, grey_frame(), @frame_opts, counting_fun(:first))
+    assert_received :inferred
+
+    # Noise below the threshold
+    assert {:ok, :first} =
+             MotionGate.run(gate, grey_frame(61), @frame_opts, counting_fun(:second))
+
+    refute_received :inferred
+
+    # A small object is enough to change its region
+    moved = with_square(grey_frame(), 16, 16)
+    assert {:ok, :third} = MotionGate.run(gate, moved, @frame_opts, counting_fun(:third))
+    assert_received :inferred
+    assert {:ok, {:unchanged, :third}} = MotionGate.check(gate, moved, @frame_opts)
+
+    assert {:ok, %{frames: 4, changed: 2, refreshed: 0, skipped: 2, skip_rate: 0.5}} =
+             MotionGate.stats(gate)
+  end
+
+  test "forces a refresh after the refresh interval" do
+    {:ok, gate} = MotionGate.new(refresh_interval: 2)
+    frame = grey_frame()
+
+    assert {:ok, :changed} = MotionGate.check(gate, frame, @frame_opts)
+    :ok = MotionGate.store(gate, [])
+
+    decisions = for _ <- 1..6, do: elem(MotionGate.check(gate, frame, @frame_opts), 1)
+
+    assert decisions == [
+             {:unchanged, []},
+             {:unchanged, []},
+             :refresh,
+             {:unchanged, []},
+             {:unchanged, []},
+             :refresh
+           ]
+  end
+
+  test "slow drift adds up against the reference" do
+    {:ok, gate} = MotionGate.new(threshold: 3, refresh_interval: 0)
+
+    assert {:ok, :changed} = MotionGate.check(gate, grey_frame(60), @frame_opts)
+    :ok = MotionGate.store(gate, :result)
+
+    assert {:ok, {:unchanged, :result}} = MotionGate.check(gate, grey_frame(61), @frame_opts)
+    assert {:ok, {:unchanged, :result}} = MotionGate.check(gate, grey_frame(62), @frame_opts)
+    assert {:ok, :changed} = MotionGate.check(gate, grey_frame(63), @frame_opts)
+    assert {:ok, %{last_score: score}} = MotionGate.stats(gate)
+    assert_in_delta score, 3.0, 0.01
+  end
+
+  test "frames count as changed without a stored result or after a new layout" do
+    {:ok, gate} = MotionGate.new()
+    frame = grey_frame()
+
+    assert {:ok, :changed} = MotionGate.check(gate, frame, @frame_opts)
+    assert {:ok, :changed} = MotionGate.check(gate, frame, @frame_opts)
+    :ok = MotionGate.store(gate, :result)
+    assert {:ok, {:unchanged, :result}} = MotionGate.check(gate, frame, @frame_opts)
+
+    assert {:ok, :changed} = MotionGate.check(gate, frame, [format: :bgr] ++ @frame_opts)
+
+    :ok = MotionGate.reset(gate)
+    assert {:ok, :changed} = MotionGate.check(gate, frame, @frame_opts)
+  end
+
+  test "errors from the inference make the next frame run again" do
+    {:ok, gate} = MotionGate.new()
+    frame = grey_frame()
+
+    assert {:error, :busy} = MotionGate.run(gate, frame, @frame_opts, fn -> {:error, :busy} end)
+    assert {:ok, :result} = MotionGate.run(gate, frame, @frame_opts, counting_fun(:result))
+    assert_received :inferred
+  end
+
+  test "rejects malformed input" do
+    assert {:error, "Motion gate block_size" <> _} = MotionGate.new(block_size: 0)
+
+    {:ok, gate} = MotionGate.new()
+    assert {:error, "Frame is too small" <> _} = MotionGate.check(gate, <<0>>, @frame_opts)
+  end
+end
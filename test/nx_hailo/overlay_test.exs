@@ -0,0 +1,127 @@
+defmodule NxHailo.OverlayTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Overlay
+  alias NxHailo.Parsers.YoloV8.DetectedObject
+  alias NxHailo.Preprocess
+
+  @width 64
+  @height 48
+
+  defp grey_frame, do: :binary.copy(<<60>>, @width * @height * 3)
+
+  defp pixel(image, x, y), do: binary_part(image, (y * @width + x) * 3, 3)
+
+  defp object(opts) do
+    struct!(
+      DetectedObject,
+      Keyword.merge([class_id: 0, class_name: "person", score: 0.9, track_id: nil], opts)
+    )
+  end
+
+  test "draws box outlines in the class colour and leaves the rest alone" do
+    objects = [object(xmin: 10, ymin: 20, xmax: 40, ymax: 40)]
+
+    assert {:ok, image} =
+             Overlay.draw(grey_frame(), objects,
+               width: @width,
+               height: @height,
+               thickness: 1,
+               show_scores: false
+             )
+
+    assert byte_size(image) == @width * @height * 3
+    # Class 0 is red, drawn on the outline only
+    assert pixel(image, 10, 30) == <<0xFF, 0x38, 0x38>>
+    assert pixel(image, 39, 30) == <<0xFF, 0x38, 0x38>>
+    assert pixel(image, 25, 30) == <<60, 60, 60>>
+    assert pixel(image, 60, 45) == <<60, 60, 60>>
+  end
+
+  test "keeps the channel order of BGR frames" do
+    objects = [object(xmin: 0, ymin: 30, xmax: 20, ymax: 40)]
+
+    assert {:ok, image} =
+             Overlay.draw(grey_frame(), objects, width: @width, height: @height, format: :bgr)
+
+    assert pixel(image, 0, 35) == <<0x38, 0x38, 0xFF>>
+  end
+
+  test "packed detections and track IDs give the same result as structs" do
+    objects = [
+      object(xmin: 10, ymin: 20, xmax: 40, ymax: 40, track_id: 7),
+      object(class_id: 2, class_name: "car", xmin: 30, ymin: 5, xmax: 60, ymax: 30)
+    ]
+
+    opts = [width: @width, height: @height, classes: %{0 => "person", 2 => "car"}]
+    assert {:ok, from_structs} = Overlay.draw(grey_frame(), objects, opts)
+
+    packed =
+      for o <- objects, into: <<>> do
+        <<o.class_id::float-32-native, o.score::float-32-native, o.ymin::float-32-native,
+          o.xmin::float-32-native, o.ymax::float-32-native, o.xmax::float-32-native>>
+      end
+
+    track_ids = <<7::native-unsigned-32, 0::native-unsigned-32>>
+
+    assert {:ok, ^from_structs} =
+             Overlay.draw(grey_frame(), packed, [track_ids: track_ids] ++ opts)
+
+    # The labels differ from an unlabelled drawing
+    assert {:ok, other} = Overlay.draw(grey_frame(), packed, width: @width, height: @height)
+    assert other != from_structs
+  end
+
+  test "draws the FPS badge in the bottom-right corner" do
+    assert {:ok, image} = Overlay.draw(grey_frame(), [], width: @width, height: @height, fps: 30)
+    assert pixel(image, @width - 1, @height - 1) == <<0, 0, 0xFF>>
+    assert pixel(image, 0, 0) == <<60, 60, 60>>
+  end
+
+  test "converts YUV frames to RGB" do
+    yuyv = :binary.copy(<<235, 128, 235, 128>>, div(@width, 2) * @height)
+
+    assert {:ok, image} = Overlay.draw(yuyv, [], width: @width, height: @height, format: :yuyv)
+    assert pixel(image, 5, 5) == <<255, 255, 255>>
+  end
+
+  test "encodes JPEGs that decode back to the frame" do
+    objects = [object(xmin: 0, ymin: 0, xmax: @width, ymax: @height)]
+
+    assert {:ok, <<0xFF, 0xD8, _::binary>> = jpeg} =
+             Overlay.draw(grey_frame(), objects,
+               width: @width,
+               height: @height,
+               encode: :jpeg,
+               quality: 90
+             )
+
+    assert {:ok, {image, %{width: @width, height: @height}}} =
+             Preprocess.decode_jpeg(jpeg, target_width: @width, target_height: @height)
+
+    <<r, g, b>> = pixel(image, 32, 40)
+    assert abs(r - 60) < 8 and abs(g - 60) < 8 and abs(b - 60) < 8
+
+    assert {:error, "JPEG quality" <> _} =
+             Overlay.draw(grey_frame(), [],
+               width: @width,
+               height: @height,
+               encode: :jpeg,
+               quality: 0
+             )
+  end
+
+  test "rejects malformed input" do
+    assert {:error, "Frame is too small" <> _} = Overlay.draw(<<0>>, [], width: 4, height: 4)
+
+    assert {:error, "Detections must be" <> _} =
+             Overlay.draw(grey_frame(), <<1, 2, 3>>, width: @width, height: @height)
+
+    assert {:error, "Track IDs must be" <> _} =
+             Overlay.draw(grey_frame(), <<0::size(24)-unit(8)>>,
+               width: @width,
+               height: @height,
+               track_ids: <<>>
+             )
+  end
+end
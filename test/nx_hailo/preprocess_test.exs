@@ -0,0 +1,121 @@
+defmodule NxHailo.PreprocessTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Simulator
+  alias NxHailo.Preprocess
+
+  defp rgb_frame(width, height) do
+    for y <- 0..(height - 1), x <- 0..(width - 1), into: <<>>, do: <<x, y, 200>>
+  end
+
+  test "letterbox/2 pads the short side with grey" do
+    frame = rgb_frame(8, 4)
+
+    assert {:ok, {image, letterbox}} =
+             Preprocess.letterbox(frame, width: 8, height: 4, target_width: 8, target_height: 8)
+
+    assert %{scale: 1.0, pad_x: +0.0, pad_y: 2.0, width: 8, height: 4} = letterbox
+    assert byte_size(image) == 8 * 8 * 3
+
+    # Two rows of padding, the frame itself, two more rows of padding
+    assert binary_part(image, 0, 2 * 8 * 3) == :binary.copy(<<114>>, 2 * 8 * 3)
+    assert binary_part(image, 2 * 8 * 3, 4 * 8 * 3) == frame
+    assert binary_part(image, 6 * 8 * 3, 2 * 8 * 3) == :binary.copy(<<114>>, 2 * 8 * 3)
+  end
+
+  test "letterbox/2 swaps BGR frames to RGB" do
+    assert {:ok, {<<3, 2, 1>>, _}} =
+             Preprocess.letterbox(<<1, 2, 3>>,
+               width: 1,
+               height: 1,
+               format: :bgr,
+               target_width: 1,
+               target_height: 1
+             )
+  end
+
+  test "letterbox/2 letterboxes a crop of the frame" do
+    # 4x2 RGB frame whose pixels hold their index
+    frame = for i <- 0..7, into: <<>>, do: <<i, i, i>>
+
+    assert {:ok, {<<5, 5, 5, 6, 6, 6>>, %{width: 2, height: 1}}} =
+             Preprocess.letterbox(frame,
+               width: 4,
+               height: 2,
+               crop: {1, 1, 2, 1},
+               target_width: 2,
+               target_height: 1
+             )
+
+    assert {:error, "Crop 2x2 at (3, 0) does not fit" <> _} =
+             Preprocess.letterbox(frame,
+               width: 4,
+               height: 2,
+               crop: {3, 0, 2, 2},
+               target_width: 2,
+               target_height: 2
+             )
+  end
+
+  test "letterbox/2 rejects frames smaller than described" do
+    assert {:error, "Frame is too small" <> _} =
+             Preprocess.letterbox(<<0>>, width: 2, height: 2, target_width: 4, target_height: 4)
+  end
+
+  test "letterbox inputs are written into the input buffer" do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 0))
+    {:ok, ng} = API.configure_network_group(vdevice, "yolov8m.hef")
+    {:ok, pipeline} = API.create_pipeline(ng)
+    [input_info] = pipeline.input_vstream_infos
+
+    frame = rgb_frame(160, 90)
+
+    {:ok, {image, letterbox}} =
+      Preprocess.letterbox(frame, width: 160, height: 90, target_width: 640, target_height: 640)
+
+    assert {:ok, {input, ^letterbox}} =
+             Preprocess.letterbox_input(frame, input_info, width: 160, height: 90)
+
+    assert {:ok, outputs} = API.infer(pipeline, %{input_info.name => image})
+    assert {:ok, ^outputs} = API.infer(pipeline, %{input_info.name => input})
+  end
+
+  describe "decode_jpeg/2" do
+    setup do
+      %{jpeg: File.read!(Path.join(:code.priv_dir(:nx_hailo), "test_image.jpg"))}
+    end
+
+    test "decodes at full size when the target is as large", %{jpeg: jpeg} do
+      assert {:ok, {image, letterbox}} =
+               Preprocess.decode_jpeg(jpeg, target_width: 640, target_height: 640)
+
+      assert byte_size(image) == 640 * 640 * 3
+      assert %{width: 640, height: 426, scale: 1.0, decode_scale: 1.0, pad_x: +0.0} = letterbox
+      assert letterbox.pad_y == 107.0
+      # Padding above the image
+      assert binary_part(image, 0, 640 * 3) == :binary.copy(<<114>>, 640 * 3)
+    end
+
+    test "downscales while decoding for small targets", %{jpeg: jpeg} do
+      assert {:ok, {image, letterbox}} =
+               Preprocess.decode_jpeg(jpeg, target_width: 160, target_height: 160)
+
+      assert byte_size(image) == 160 * 160 * 3
+      # The letterbox map still refers to the full-size image
+      assert %{width: 640, height: 426, scale: 0.25, decode_scale: 0.25} = letterbox
+    end
+
+    test "rejects data that is not a JPEG" do
+      assert {:error, "Failed to decode JPEG: " <> _} =
+               Preprocess.decode_jpeg(<<1, 2, 3>>, target_width: 8, target_height: 8)
+    end
+
+    test "decode_jpeg_input/2 fits the input vstream", %{jpeg: jpeg} do
+      info = %{shape: %{height: 320, width: 320}}
+
+      assert {:ok, {image, %{decode_scale: 0.5}}} = Preprocess.decode_jpeg_input(jpeg, info)
+      assert byte_size(image) == 320 * 320 * 3
+    end
+  end
+end
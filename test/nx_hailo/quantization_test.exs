@@ -0,0 +1,85 @@
+defmodule NxHailo.QuantizationTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Hailo.API
+  alias NxHailo.Hailo.Simulator
+  alias NxHailo.Quantization
+
+  @output "classifier/logits"
+
+  setup do
+    config =
+      Simulator.yolov8(
+        latency_us: 0,
+        output_vstreams: [
+          %{
+            name: @output,
+            format: %{type: :uint8, order: :nhwc},
+            shape: %{height: 4, width: 4, features: 10},
+            quant_info: %{qp_zp: 12.0, qp_scale: 0.05}
+          }
+        ]
+      )
+
+    {:ok, vdevice} = Simulator.create_vdevice(config)
+    {:ok, ng} = API.configure_network_group(vdevice, "classifier.hef")
+    {:ok, raw} = API.create_pipeline(ng, raw_outputs: true, output_format_type: :float32)
+    {:ok, float} = API.create_pipeline(ng, output_format_type: :float32)
+
+    [input_info] = raw.input_vstream_infos
+    input = %{input_info.name => :binary.copy(<<7>>, input_info.frame_size)}
+    {:ok, %{@output => raw_output}} = API.infer(raw, input)
+    {:ok, %{@output => float_output}} = API.infer(float, input)
+    [info] = raw.output_vstream_infos
+
+    %{info: info, raw_output: raw_output, float_output: float_output}
+  end
+
+  defp floats(binary), do: for(<<value::native-float-32 <- binary>>, do: value)
+
+  test "raw outputs keep the device type and quantization parameters", context do
+    assert %{format: %{type: :uint8}, frame_size: 160, quant_info: %{qp_zp: 12.0}} =
+             context.info
+
+    assert byte_size(context.raw_output) == 160
+    assert byte_size(context.float_output) == 160 * 4
+  end
+
+  test "dequantize/3 matches the host-converted output", context do
+    assert {:ok, dequantized} = Quantization.dequantize(context.raw_output, context.info)
+    assert dequantized == context.float_output
+
+    # Channels 2..4 of every position
+    assert {:ok, channels} =
+             Quantization.dequantize(context.raw_output, context.info, channels: {2, 3})
+
+    expected =
+      context.float_output
+      |> floats()
+      |> Enum.chunk_every(10)
+      |> Enum.flat_map(&Enum.slice(&1, 2, 3))
+
+    assert floats(channels) == expected
+  end
+
+  test "threshold/4 finds the same elements as filtering the dequantized output", context do
+    values = floats(context.float_output)
+    threshold = Enum.at(Enum.sort(values, :desc), 20)
+
+    expected =
+      values
+      |> Enum.with_index()
+      |> Enum.filter(fn {value, _index} -> value >= threshold end)
+
+    assert {:ok, result} = Quantization.threshold(context.raw_output, context.info, threshold)
+    {indices, found} = Quantization.to_lists(result)
+    assert Enum.zip(found, indices) == expected
+
+    assert {:ok, {<<>>, <<>>}} = Quantization.threshold(context.raw_output, context.info, 1.0e6)
+  end
+
+  test "invalid channel ranges are rejected", context do
+    assert {:error, "Channel range ends past" <> _} =
+             Quantization.dequantize(context.raw_output, context.info, channels: {8, 3})
+  end
+end
@@ -0,0 +1,136 @@
+defmodule NxHailo.TilingTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Hailo
+  alias NxHailo.Hailo.Simulator
+  alias NxHailo.Parsers.YoloV8.DetectedObject
+  alias NxHailo.Tiling
+
+  @classes %{0 => "person", 1 => "car"}
+
+  # NMS output of two classes: a count per class followed by
+  # (ymin, xmin, ymax, xmax, score) tuples of normalized coordinates
+  defp nms_frame(boxes_by_class) do
+    for boxes <- boxes_by_class, into: <<>> do
+      rows = for {ymin, xmin, ymax, xmax, score} <- boxes, do: [ymin, xmin, ymax, xmax, score]
+      floats([length(boxes) | List.flatten(rows)])
+    end
+  end
+
+  defp floats(values), do: for(v <- values, into: <<>>, do: <<v::float-32-native>>)
+
+  defp unpack(packed) do
+    for <<class_id::float-32-native, score::float-32-native, ymin::float-32-native,
+          xmin::float-32-native, ymax::float-32-native, xmax::float-32-native <- packed>>,
+        do: {trunc(class_id), score, ymin, xmin, ymax, xmax}
+  end
+
+  test "tiles/1 covers the frame with overlapping tiles" do
+    assert {:ok, tiles} = Tiling.tiles(width: 3840, height: 2160, tile_size: {640, 640})
+    assert length(tiles) == 8 * 4
+    assert Enum.all?(tiles, &match?({_, _, 640, 640}, &1))
+    assert {3200, 1520, 640, 640} = List.last(tiles)
+
+    # Neighbours overlap by at least 20% of the tile
+    [{x0, 0, _, _}, {x1, 0, _, _} | _] = tiles
+    assert x1 - x0 <= 512
+
+    assert {:ok, [{0, 0, 300, 200}]} = Tiling.tiles(width: 300, height: 200, tile_size: {640, 640})
+
+    assert {:ok, tiles} =
+             Tiling.tiles(width: 1000, height: 640, format: :yuyv, tile_size: {640, 640})
+
+    assert Enum.all?(tiles, fn {x, _, _, _} -> rem(x, 2) == 0 end)
+
+    # The last YUYV tile starts on an even column and still reaches the edge
+    assert {:ok, tiles} =
+             Tiling.tiles(width: 1001, height: 640, format: :yuyv, tile_size: {640, 640})
+
+    assert Enum.all?(tiles, fn {x, _, _, _} -> rem(x, 2) == 0 end)
+    assert {362, 0, 639, 640} = List.last(tiles)
+
+    assert {:error, "Tile overlap" <> _} =
+             Tiling.tiles(width: 100, height: 100, tile_size: {50, 50}, overlap: 1)
+  end
+
+  test "merge/3 maps tile boxes into the frame and drops duplicates" do
+    tiles = [{0, 0, 640, 640}, {512, 0, 640, 640}]
+
+    # The same person seen by both tiles at x 544..608, and a car only in
+    # the second tile
+    outputs = [
+      nms_frame([[{0.1, 0.85, 0.2, 0.95, 0.9}], []]),
+      nms_frame([[{0.1, 0.05, 0.2, 0.15, 0.8}], [{0.5, 0.5, 0.6, 0.6, 0.7}]])
+    ]
+
+    opts = [target_size: {640, 640}, number_of_classes: 2]
+
+    assert {:ok, packed} = Tiling.merge(outputs, tiles, opts)
+
+    assert [{0, score, 64.0, 544.0, 128.0, 608.0}, {1, _, 320.0, 832.0, 384.0, 896.0}] =
+             unpack(packed)
+
+    assert_in_delta score, 0.9, 1.0e-6
+
+    assert {:ok, packed} = Tiling.merge(outputs, tiles, [score_threshold: 0.75] ++ opts)
+    assert [{0, _, _, 544.0, _, _}] = unpack(packed)
+
+    assert {:error, "Expected one NMS output per tile"} = Tiling.merge(outputs, [], opts)
+  end
+
+  test "merge/3 maps boxes of letterboxed tiles back through the letterbox" do
+    # A 1280x640 tile is scaled by a half into the 640x640 input, centred
+    # with 160 pixels of padding above and below
+    outputs = [nms_frame([[{0.25, 0.5, 0.75, 1.0, 0.9}], []])]
+
+    assert {:ok, packed} =
+             Tiling.merge(outputs, [{100, 50, 1280, 640}],
+               target_size: {640, 640},
+               number_of_classes: 2
+             )
+
+    assert [{0, _, 50.0, 740.0, 690.0, 1380.0}] = unpack(packed)
+  end
+
+  test "the :ios match merges boxes cut off at a tile edge" do
+    tiles = [{0, 0, 640, 640}, {0, 0, 640, 640}]
+    whole = nms_frame([[{0.0, 0.0, 0.5, 0.5, 0.9}], []])
+    cut = nms_frame([[{0.0, 0.375, 0.5, 0.5, 0.6}], []])
+    opts = [target_size: {640, 640}, number_of_classes: 2]
+
+    assert {:ok, packed} = Tiling.merge([whole, cut], tiles, opts)
+    assert length(unpack(packed)) == 2
+
+    assert {:ok, packed} = Tiling.merge([whole, cut], tiles, [match: :ios] ++ opts)
+    assert [{0, _, _, _, _, _}] = unpack(packed)
+  end
+
+  test "infer/3 runs all tiles and the full frame as one batch" do
+    {:ok, vdevice} = Simulator.create_vdevice(Simulator.yolov8(latency_us: 0))
+    {:ok, model} = Hailo.load("yolov8m.hef", vdevice: vdevice)
+
+    width = 1280
+    height = 720
+    frame = :binary.copy(<<90>>, width * height * 3)
+
+    assert {:ok, objects, stats} =
+             Tiling.infer(model, frame,
+               width: width,
+               height: height,
+               key: "yolov8m/yolov8_nms_postprocess",
+               classes: Map.new(0..79, &{&1, "class #{&1}"})
+             )
+
+    # 3x2 tiles plus the full frame
+    assert %{tiles: 7, megapixels: megapixels, us_per_megapixel: cost} = stats
+    assert_in_delta megapixels, 0.9216, 1.0e-9
+    assert cost > 0
+
+    assert Enum.all?(objects, fn %DetectedObject{} = object ->
+             object.xmin >= 0 and object.xmax <= width and object.ymin >= 0 and
+               object.ymax <= height
+           end)
+
+    assert Enum.map(objects, & &1.score) == Enum.sort(Enum.map(objects, & &1.score), :desc)
+  end
+end
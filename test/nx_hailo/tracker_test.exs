@@ -0,0 +1,104 @@
+defmodule NxHailo.TrackerTest do
+  use ExUnit.Case, async: true
+
+  alias NxHailo.Parsers.YoloV8.DetectedObject
+  alias NxHailo.Tracker
+
+  defp object(class_id, x, y, score \\ 0.9) do
+    %DetectedObject{
+      class_id: class_id,
+      score: score,
+      xmin: x,
+      ymin: y,
+      xmax: x + 50,
+      ymax: y + 100
+    }
+  end
+
+  defp track_ids(tracker, objects) do
+    {:ok, objects} = Tracker.update(tracker, objects)
+    Enum.map(objects, & &1.track_id)
+  end
+
+  test "objects keep their ID as they move" do
+    {:ok, tracker} = Tracker.new()
+
+    ids =
+      for frame <- 0..19 do
+        track_ids(tracker, [object(0, 10 + frame * 5, 20), object(0, 400 - frame * 5, 200)])
+      end
+
+    assert [[a, b] | _] = ids
+    assert a != b
+    assert Enum.all?(ids, &(&1 == [a, b]))
+  end
+
+  test "new objects are only reported once their track is confirmed" do
+    {:ok, tracker} = Tracker.new(min_hits: 3)
+
+    # The first frames confirm tracks right away
+    for _ <- 1..3, do: track_ids(tracker, [object(0, 10, 10)])
+
+    assert [_, nil] = track_ids(tracker, [object(0, 10, 10), object(1, 300, 300)])
+    assert [_, nil] = track_ids(tracker, [object(0, 10, 10), object(1, 300, 300)])
+    assert [_, id] = track_ids(tracker, [object(0, 10, 10), object(1, 300, 300)])
+    assert is_integer(id)
+  end
+
+  test "tentative tracks are dropped on their first miss" do
+    {:ok, tracker} = Tracker.new(min_hits: 3)
+    for _ <- 1..3, do: track_ids(tracker, [object(0, 10, 10)])
+
+    assert [_, nil] = track_ids(tracker, [object(0, 10, 10), object(1, 300, 300)])
+    assert [_] = track_ids(tracker, [object(0, 10, 10)])
+
+    # The object starts over with a new track
+    assert [_, nil] = track_ids(tracker, [object(0, 10, 10), object(1, 300, 300)])
+    assert [_, nil] = track_ids(tracker, [object(0, 10, 10), object(1, 300, 300)])
+    assert [_, id] = track_ids(tracker, [object(0, 10, 10), object(1, 300, 300)])
+    assert is_integer(id)
+  end
+
+  test "tracks survive a few missed frames and low score detections" do
+    {:ok, tracker} = Tracker.new()
+    [id] = track_ids(tracker, [object(0, 100, 100)])
+
+    assert [] = track_ids(tracker, [])
+    assert [^id] = track_ids(tracker, [object(0, 102, 100)])
+    # Below the high threshold, but still matched to the existing track
+    assert [^id] = track_ids(tracker, [object(0, 104, 100, 0.3)])
+  end
+
+  test "different classes do not share tracks" do
+    {:ok, tracker} = Tracker.new()
+    [id] = track_ids(tracker, [object(0, 100, 100)])
+
+    assert [other] = track_ids(tracker, [object(1, 100, 100)])
+    assert other != id
+  end
+
+  test "the number of tracks stays bounded" do
+    {:ok, tracker} = Tracker.new(max_tracks: 4, max_age: 1000)
+
+    for frame <- 0..9 do
+      track_ids(tracker, for(i <- 0..2, do: object(0, frame * 300 + i * 100, 0)))
+    end
+
+    assert {:ok, %{tracks: 4, frames: 10}} = Tracker.stats(tracker)
+  end
+
+  test "update/2 takes packed detections" do
+    {:ok, tracker} = Tracker.new()
+
+    packed =
+      for value <- [0, 0.9, 0.1, 0.1, 0.3, 0.2, 2, 0.8, 0.5, 0.5, 0.9, 0.7], into: <<>> do
+        <<value / 1::float-32-native>>
+      end
+
+    assert {:ok, track_ids} = Tracker.update(tracker, packed)
+    assert [a, b] = Tracker.to_list(track_ids)
+    assert a > 0 and b > 0 and a != b
+
+    assert {:error, "Detections must be" <> _} = Tracker.update(tracker, <<1, 2, 3>>)
+  end
+end